@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,12 +9,63 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    alarm_rules.cpp \
+    batch_analysis.cpp \
+    bitrate_detect.cpp \
+    bounded_memory.cpp \
+    bus_health.cpp \
+    can_transport.cpp \
+    capture_codec.cpp \
+    capture_writer.cpp \
+    channel_monitor.cpp \
+    clock_sync.cpp \
+    dbc_decoder.cpp \
+    eds_dictionary.cpp \
+    imu_packing.cpp \
+    load_generator.cpp \
     main.cpp \
+    nmt_monitor.cpp \
+    node_config.cpp \
+    od_browser.cpp \
     pcan_qt.cpp \
+    sdo_client.cpp \
+    sdo_profiler.cpp \
+    sdo_transfer.cpp \
+    signal_pyramid.cpp \
+    sync_acquisition.cpp \
+    trace_import.cpp \
+    trigger_capture.cpp \
+    tx_scheduler.cpp \
 
 HEADERS += \
+    alarm_rules.h \
+    batch_analysis.h \
+    bitrate_detect.h \
+    bounded_memory.h \
+    bus_health.h \
+    can_transport.h \
+    canopen.h \
+    capture_codec.h \
+    capture_writer.h \
+    channel_monitor.h \
+    clock_sync.h \
+    dbc_decoder.h \
+    eds_dictionary.h \
+    imu_packing.h \
     include/PCANBasic.h \
+    load_generator.h \
+    nmt_monitor.h \
+    node_config.h \
+    od_browser.h \
     pcan_qt.h \
+    sdo_client.h \
+    sdo_profiler.h \
+    sdo_transfer.h \
+    signal_pyramid.h \
+    sync_acquisition.h \
+    trace_import.h \
+    trigger_capture.h \
+    tx_scheduler.h \
 
 FORMS += \
     pcan_qt.ui
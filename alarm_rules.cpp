@@ -0,0 +1,774 @@
+#include "alarm_rules.h"
+#include "clock_sync.h"
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMutexLocker>
+#include <QStringList>
+#include <cctype>
+#include <cmath>
+
+//rate fields and rate rules are refreshed this often
+#define ALARM_TICK_US       100000
+#define ALARM_RATE_WINDOW   1000000
+//samples waiting for the worker before new ones are dropped
+#define ALARM_MAX_PENDING   65536
+#define ALARM_MAX_STACK     32
+//a client this far behind is disconnected
+#define ALARM_MAX_BACKLOG   (1<<20)
+
+static const struct{
+    const char *name;
+    int field;
+}alarm_field_names[]={
+    {"acc.x",ALARM_ACC_X},{"acc.y",ALARM_ACC_Y},{"acc.z",ALARM_ACC_Z},
+    {"gyr.x",ALARM_GYR_X},{"gyr.y",ALARM_GYR_Y},{"gyr.z",ALARM_GYR_Z},
+    {"eul.x",ALARM_EUL_X},{"eul.y",ALARM_EUL_Y},{"eul.z",ALARM_EUL_Z},
+    {"roll",ALARM_EUL_X},{"pitch",ALARM_EUL_Y},{"yaw",ALARM_EUL_Z},
+    {"quat.w",ALARM_QUAT_W},{"quat.x",ALARM_QUAT_X},{"quat.y",ALARM_QUAT_Y},{"quat.z",ALARM_QUAT_Z},
+    {"hz.acc",ALARM_HZ_ACC},{"hz.gyr",ALARM_HZ_GYR},{"hz.eul",ALARM_HZ_EUL},{"hz.quat",ALARM_HZ_QUAT},
+    {"cfg.acc",ALARM_CFG_ACC},{"cfg.gyr",ALARM_CFG_GYR},{"cfg.eul",ALARM_CFG_EUL},{"cfg.quat",ALARM_CFG_QUAT}
+};
+
+//first field of each signal
+static const int alarm_signal_field[IMU_SIG_COUNT]={ALARM_ACC_X,ALARM_GYR_X,ALARM_EUL_X,ALARM_QUAT_W};
+
+static quint32 alarm_field_dep(int field)
+{
+    if(field>=ALARM_HZ_ACC)
+        return ALARM_DEP_RATE;
+    for(int s=IMU_SIG_COUNT-1;s>=0;s--){
+        if(field>=alarm_signal_field[s])
+            return 1u<<s;
+    }
+    return 0;
+}
+
+static inline float alarm_norm3(const float *f)
+{
+    return std::sqrt(f[0]*f[0]+f[1]*f[1]+f[2]*f[2]);
+}
+
+//----------------------------------------------------------------------------
+// Rule compiler
+//----------------------------------------------------------------------------
+//recursive descent over one rule, emitting stack ops
+class AlarmCompiler
+{
+public:
+    AlarmCompiler(const QByteArray &text, std::vector<alarmOp> &ops) : s(text), ops(ops) {}
+
+    bool compile(alarmRule &rule);
+    int max_depth=0;
+
+private:
+    void skip() {while(pos<s.size()&&s.at(pos)==' ') pos++;}
+    bool eat(char c)
+    {
+        skip();
+        if(pos<s.size()&&s.at(pos)==c){
+            pos++;
+            return true;
+        }
+        return false;
+    }
+    QByteArray word();
+    bool number(float &v);
+    void emit_op(quint8 code, quint8 field=0, float value=0);
+
+    bool expr();
+    bool term();
+    bool unary();
+    bool primary();
+
+    QByteArray s;
+    std::vector<alarmOp> &ops;
+    int first=0;
+    int pos=0;
+    int depth=0;
+    quint32 depends=0;
+};
+
+QByteArray AlarmCompiler::word()
+{
+    skip();
+    const int begin=pos;
+    while(pos<s.size()){
+        const char c=s.at(pos);
+        if(!(isalnum(uchar(c))||c=='.'||c=='_'))
+            break;
+        //exponent sign of a number
+        if((c=='e'||c=='E')&&pos+1<s.size()&&(s.at(pos+1)=='-'||s.at(pos+1)=='+')&&isdigit(uchar(s.at(begin))))
+            pos++;
+        pos++;
+    }
+    return s.mid(begin,pos-begin).toLower();
+}
+
+bool AlarmCompiler::number(float &v)
+{
+    const int at=pos;
+    bool ok=false;
+    const bool neg=eat('-');
+    v=word().toFloat(&ok);
+    if(neg)
+        v=-v;
+    if(!ok)
+        pos=at;
+    return ok;
+}
+
+void AlarmCompiler::emit_op(quint8 code, quint8 field, float value)
+{
+    const int n=int(ops.size())-first;
+    switch(code){
+    case ALARM_OP_FIELD: case ALARM_OP_CONST: case ALARM_OP_NORM3:
+        depth++;
+        break;
+    case ALARM_OP_NEG: case ALARM_OP_ABS: case ALARM_OP_SQRT:
+        //constant operand, folded
+        if(n>=1&&ops.back().code==ALARM_OP_CONST){
+            float &a=ops.back().value;
+            a=code==ALARM_OP_NEG?-a:code==ALARM_OP_ABS?std::fabs(a):std::sqrt(a);
+            return;
+        }
+        break;
+    default:
+        if(n>=2&&ops.back().code==ALARM_OP_CONST&&ops[ops.size()-2].code==ALARM_OP_CONST){
+            const float b=ops.back().value;
+            ops.pop_back();
+            float &a=ops.back().value;
+            switch(code){
+            case ALARM_OP_ADD: a+=b; break;
+            case ALARM_OP_SUB: a-=b; break;
+            case ALARM_OP_MUL: a*=b; break;
+            case ALARM_OP_DIV: a/=b; break;
+            case ALARM_OP_MIN: a=qMin(a,b); break;
+            case ALARM_OP_MAX: a=qMax(a,b); break;
+            }
+            depth--;
+            return;
+        }
+        depth--;
+        break;
+    }
+    max_depth=qMax(max_depth,depth);
+    alarmOp op;
+    op.code=code;
+    op.field=field;
+    op.value=value;
+    ops.push_back(op);
+}
+
+bool AlarmCompiler::expr()
+{
+    if(!term())
+        return false;
+    while(true){
+        if(eat('+')){
+            if(!term())
+                return false;
+            emit_op(ALARM_OP_ADD);
+        }
+        else if(eat('-')){
+            if(!term())
+                return false;
+            emit_op(ALARM_OP_SUB);
+        }
+        else
+            return true;
+    }
+}
+
+bool AlarmCompiler::term()
+{
+    if(!unary())
+        return false;
+    while(true){
+        if(eat('*')){
+            if(!unary())
+                return false;
+            emit_op(ALARM_OP_MUL);
+        }
+        else if(eat('/')){
+            if(!unary())
+                return false;
+            emit_op(ALARM_OP_DIV);
+        }
+        else
+            return true;
+    }
+}
+
+bool AlarmCompiler::unary()
+{
+    if(eat('-')){
+        if(!unary())
+            return false;
+        emit_op(ALARM_OP_NEG);
+        return true;
+    }
+    return primary();
+}
+
+bool AlarmCompiler::primary()
+{
+    if(eat('(')){
+        return expr()&&eat(')');
+    }
+    if(eat('|')){
+        //|acc| |gyr| |eul| as a norm, |expr| as abs()
+        const int at=pos;
+        const QByteArray w=word();
+        const int signal=w=="acc"?IMU_SIG_ACC:w=="gyr"?IMU_SIG_GYR:w=="eul"?IMU_SIG_EUL:-1;
+        if(signal>=0&&eat('|')){
+            depends|=1u<<signal;
+            emit_op(ALARM_OP_NORM3,quint8(alarm_signal_field[signal]));
+            return true;
+        }
+        pos=at;
+        if(!expr()||!eat('|'))
+            return false;
+        emit_op(ALARM_OP_ABS);
+        return true;
+    }
+
+    skip();
+    if(pos<s.size()&&(isdigit(uchar(s.at(pos)))||s.at(pos)=='.')){
+        float v;
+        if(!number(v))
+            return false;
+        emit_op(ALARM_OP_CONST,0,v);
+        return true;
+    }
+
+    const QByteArray w=word();
+    if(w.isEmpty())
+        return false;
+    if(eat('(')){
+        quint8 code;
+        int args=1;
+        if(w=="abs")
+            code=ALARM_OP_ABS;
+        else if(w=="sqrt")
+            code=ALARM_OP_SQRT;
+        else if(w=="min"||w=="max"){
+            code=w=="min"?ALARM_OP_MIN:ALARM_OP_MAX;
+            args=2;
+        }
+        else
+            return false;
+        if(!expr())
+            return false;
+        if(args==2&&!(eat(',')&&expr()))
+            return false;
+        if(!eat(')'))
+            return false;
+        emit_op(code);
+        return true;
+    }
+    for(const auto &f : alarm_field_names){
+        if(w==f.name){
+            depends|=alarm_field_dep(f.field);
+            emit_op(ALARM_OP_FIELD,quint8(f.field));
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AlarmCompiler::compile(alarmRule &rule)
+{
+    first=int(ops.size());
+    rule.first_op=first;
+    if(!expr())
+        return false;
+
+    skip();
+    if(pos>=s.size()||(s.at(pos)!='<'&&s.at(pos)!='>'))
+        return false;
+    rule.above=s.at(pos)=='>';
+    pos++;
+    eat('=');
+    if(!expr())
+        return false;
+
+    //options
+    while(true){
+        const QByteArray key=word();
+        if(key.isEmpty())
+            break;
+        float v;
+        if(!number(v)||v<0)
+            return false;
+        if(key=="hyst")
+            rule.hyst=v;
+        else if(key=="on")
+            rule.on_us=qint64(v*1000);
+        else if(key=="off")
+            rule.off_us=qint64(v*1000);
+        else
+            return false;
+    }
+    skip();
+    if(pos<s.size()||depth!=2||depends==0)
+        return false;
+
+    rule.n_ops=int(ops.size())-first;
+    rule.depends=depends;
+    const alarmOp *op=&ops[first];
+    if(rule.n_ops==2&&(op[0].code==ALARM_OP_FIELD||op[0].code==ALARM_OP_NORM3)&&op[1].code==ALARM_OP_CONST){
+        rule.simple=true;
+        rule.simple_code=op[0].code;
+        rule.simple_field=op[0].field;
+        rule.simple_value=op[1].value;
+    }
+    return true;
+}
+
+bool alarm_parse(const QString &text, alarmProgram &program, QString &error)
+{
+    program=alarmProgram();
+    const QStringList lines=text.split('\n');
+    for(int n=0;n<lines.size();n++){
+        QString line=lines.at(n);
+        const int comment=line.indexOf('#');
+        if(comment>=0)
+            line.truncate(comment);
+        line=line.simplified();
+        if(line.isEmpty())
+            continue;
+
+        alarmRule rule;
+        rule.text=line;
+        const int colon=line.indexOf(':');
+        if(colon>=0){
+            rule.name=line.left(colon).trimmed();
+            line=line.mid(colon+1);
+        }
+        if(rule.name.isEmpty())
+            rule.name=QObject::tr("rule %1").arg(program.rules.size()+1);
+
+        AlarmCompiler compiler(line.toLatin1(),program.ops);
+        const size_t n_ops=program.ops.size();
+        if(!compiler.compile(rule)||compiler.max_depth>ALARM_MAX_STACK){
+            program.ops.resize(n_ops);
+            error=QObject::tr("line %1: %2").arg(n+1).arg(lines.at(n).trimmed());
+            return false;
+        }
+        program.max_stack=qMax(program.max_stack,compiler.max_depth);
+        program.rules.append(rule);
+    }
+    if(program.rules.isEmpty()){
+        error=QObject::tr("no alarm rules");
+        return false;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// AlarmEngine
+//----------------------------------------------------------------------------
+AlarmEngine::AlarmEngine(QObject *parent)
+    : QThread(parent)
+    , nodes(ALARM_MAX_NODES)
+    , max_pending(ALARM_MAX_PENDING)
+{
+    qRegisterMetaType<alarmEvent>("alarmEvent");
+    for(int n=0;n<ALARM_MAX_NODES;n++){
+        for(int s=0;s<IMU_SIG_COUNT;s++)
+            cfg_hz[n][s]=0;
+    }
+}
+
+AlarmEngine::~AlarmEngine()
+{
+    stop_engine();
+}
+
+bool AlarmEngine::set_rules(const QString &text)
+{
+    alarmProgram compiled;
+    if(!alarm_parse(text,compiled,m_error))
+        return false;
+    m_error.clear();
+    if(!running){
+        load(compiled);
+        return true;
+    }
+    QMutexLocker lock(&mutex);
+    next_program=compiled;
+    program_changed=true;
+    return true;
+}
+
+void AlarmEngine::set_log(const QString &path)
+{
+    QMutexLocker lock(&mutex);
+    log_path=path;
+    log_changed=true;
+}
+
+void AlarmEngine::set_configured_hz(int node, int signal, float hz)
+{
+    if(node<0||node>=ALARM_MAX_NODES||signal<0||signal>=IMU_SIG_COUNT)
+        return;
+    QMutexLocker lock(&mutex);
+    cfg_hz[node][signal]=hz;
+    cfg_changed=true;
+}
+
+bool AlarmEngine::start_engine()
+{
+    if(running)
+        return true;
+    if(program.rules.isEmpty()){
+        m_error=tr("no alarm rules");
+        return false;
+    }
+    {
+        QMutexLocker lock(&mutex);
+        pending.clear();
+        pending.reserve(reserved);
+        n_dropped=0;
+        quit=false;
+    }
+    running=true;
+    start(QThread::LowPriority);
+    return true;
+}
+
+void AlarmEngine::stop_engine()
+{
+    if(!running)
+        return;
+    {
+        QMutexLocker lock(&mutex);
+        quit=true;
+        wake.wakeAll();
+    }
+    wait();
+    running=false;
+}
+
+void AlarmEngine::set_max_pending(int samples, bool reserve)
+{
+    QMutexLocker lock(&mutex);
+    max_pending=samples>0?size_t(qMax(samples,IMU_FD_MAX_SAMPLES)):ALARM_MAX_PENDING;
+    reserved=reserve?max_pending:0;
+}
+
+qint64 AlarmEngine::memory_bytes()
+{
+    //the worker's batch is as large as the queue it was swapped with
+    QMutexLocker lock(&mutex);
+    return qint64(2*pending.capacity()*sizeof(imuSample)+nodes.size()*sizeof(nodeState));
+}
+
+void AlarmEngine::post(const imuSample *samples, int n)
+{
+    QMutexLocker lock(&mutex);
+    if(pending.size()+size_t(n)>max_pending){
+        n_dropped+=quint64(n);
+        return;
+    }
+    pending.insert(pending.end(),samples,samples+n);
+    wake.wakeOne();
+}
+
+void AlarmEngine::load(const alarmProgram &compiled)
+{
+    program=compiled;
+    for(auto &dep : by_dep)
+        dep.clear();
+    for(int r=0;r<program.rules.size();r++){
+        for(int d=0;d<=IMU_SIG_COUNT;d++){
+            if(program.rules.at(r).depends&(1u<<d))
+                by_dep[d].push_back(r);
+        }
+    }
+    stack.assign(size_t(qMax(program.max_stack,2)),0.0f);
+    //rates restart with the next sample of each node
+    for(nodeState &node : nodes){
+        node.seen=false;
+        for(quint32 &c : node.count)
+            c=0;
+    }
+    counters.active=0;
+}
+
+void AlarmEngine::evaluate(int r, nodeState &node, int node_id, qint64 host_us)
+{
+    const alarmRule &rule=program.rules.at(r);
+    const float *f=node.fields;
+    float lhs, rhs;
+    if(rule.simple){
+        lhs=rule.simple_code==ALARM_OP_FIELD?f[rule.simple_field]:alarm_norm3(f+rule.simple_field);
+        rhs=rule.simple_value;
+    }
+    else{
+        float *sp=stack.data();
+        const alarmOp *op=program.ops.data()+rule.first_op;
+        const alarmOp *end=op+rule.n_ops;
+        for(;op<end;op++){
+            switch(op->code){
+            case ALARM_OP_FIELD: *sp++=f[op->field]; break;
+            case ALARM_OP_CONST: *sp++=op->value; break;
+            case ALARM_OP_NORM3: *sp++=alarm_norm3(f+op->field); break;
+            case ALARM_OP_ADD: sp--; sp[-1]+=sp[0]; break;
+            case ALARM_OP_SUB: sp--; sp[-1]-=sp[0]; break;
+            case ALARM_OP_MUL: sp--; sp[-1]*=sp[0]; break;
+            case ALARM_OP_DIV: sp--; sp[-1]/=sp[0]; break;
+            case ALARM_OP_NEG: sp[-1]=-sp[-1]; break;
+            case ALARM_OP_ABS: sp[-1]=std::fabs(sp[-1]); break;
+            case ALARM_OP_SQRT: sp[-1]=std::sqrt(sp[-1]); break;
+            case ALARM_OP_MIN: sp--; sp[-1]=qMin(sp[-1],sp[0]); break;
+            case ALARM_OP_MAX: sp--; sp[-1]=qMax(sp[-1],sp[0]); break;
+            }
+        }
+        lhs=stack[0];
+        rhs=stack[1];
+    }
+    counters.evaluations++;
+
+    //NaN compares false both ways and keeps the state
+    const float margin=rule.above?lhs-rhs:rhs-lhs;
+    ruleState &st=node.rules[size_t(r)];
+    const bool change=st.active?margin<-rule.hyst:margin>0;
+    if(!change){
+        st.pending=0;
+        return;
+    }
+    if(!st.pending){
+        st.pending=1;
+        st.since_us=host_us;
+    }
+    if(host_us-st.since_us<(st.active?rule.off_us:rule.on_us))
+        return;
+    st.pending=0;
+    st.active=!st.active;
+
+    alarmEvent ev;
+    ev.rule=r;
+    ev.name=rule.name;
+    ev.node=node_id;
+    ev.raised=st.active;
+    ev.value=lhs;
+    ev.threshold=rhs;
+    ev.host_us=host_us;
+    m_events.push_back(ev);
+    if(ev.raised){
+        counters.raised++;
+        counters.active++;
+    }
+    else{
+        counters.cleared++;
+        counters.active--;
+    }
+}
+
+void AlarmEngine::process(const imuSample &sample)
+{
+    if(sample.node>=ALARM_MAX_NODES||sample.signal>=IMU_SIG_COUNT)
+        return;
+    nodeState &node=nodes[sample.node];
+    if(!node.seen){
+        node.seen=true;
+        node.rules.assign(size_t(program.rules.size()),ruleState());
+        node.window_us=sample.host_us;
+    }
+    float *f=node.fields+alarm_signal_field[sample.signal];
+    const int axes=imu_signal_axes(sample.signal);
+    for(int a=0;a<axes;a++)
+        f[a]=sample.v[a];
+    node.count[sample.signal]++;
+    node.last_us=sample.host_us;
+    counters.samples++;
+
+    for(int r : by_dep[sample.signal])
+        evaluate(r,node,sample.node,sample.host_us);
+}
+
+void AlarmEngine::tick(qint64 host_us)
+{
+    for(int n=0;n<ALARM_MAX_NODES;n++){
+        nodeState &node=nodes[size_t(n)];
+        if(!node.seen)
+            continue;
+        const qint64 elapsed=host_us-node.window_us;
+        if(elapsed<ALARM_RATE_WINDOW)
+            continue;
+        for(int s=0;s<IMU_SIG_COUNT;s++){
+            node.fields[ALARM_HZ_ACC+s]=float(double(node.count[s])*1e6/elapsed);
+            node.count[s]=0;
+        }
+        node.window_us=host_us;
+        for(int r : by_dep[IMU_SIG_COUNT])
+            evaluate(r,node,n,host_us);
+    }
+}
+
+void AlarmEngine::write_log(const alarmEvent &ev)
+{
+    if(!log.isOpen())
+        return;
+    const QString line=QString("%1\t%2\t%3\tnode %4\t%5\t%6\n")
+            .arg(QDateTime::currentDateTime().toString(Qt::ISODateWithMs))
+            .arg(ev.raised?"RAISED":"CLEARED")
+            .arg(ev.name)
+            .arg(ev.node)
+            .arg(double(ev.value),0,'g',6)
+            .arg(double(ev.threshold),0,'g',6);
+    log.write(line.toUtf8());
+}
+
+alarmStats AlarmEngine::stats()
+{
+    QMutexLocker lock(&mutex);
+    if(!running)
+        return counters;
+    return published;
+}
+
+void AlarmEngine::run()
+{
+    //swapped with the queue, so both keep the reserved size
+    std::vector<imuSample> batch;
+    {
+        QMutexLocker lock(&mutex);
+        batch.reserve(reserved);
+    }
+    qint64 next_tick=0;
+    while(true){
+        QString open_path;
+        bool reopen=false;
+        {
+            QMutexLocker lock(&mutex);
+            if(!quit&&pending.empty())
+                wake.wait(&mutex,ALARM_TICK_US/1000);
+            if(quit)
+                break;
+            batch.swap(pending);
+            if(program_changed){
+                load(next_program);
+                program_changed=false;
+            }
+            if(cfg_changed){
+                for(int n=0;n<ALARM_MAX_NODES;n++){
+                    for(int s=0;s<IMU_SIG_COUNT;s++)
+                        nodes[size_t(n)].fields[ALARM_CFG_ACC+s]=cfg_hz[n][s];
+                }
+                cfg_changed=false;
+            }
+            if(log_changed){
+                open_path=log_path;
+                reopen=true;
+                log_changed=false;
+            }
+            counters.dropped=n_dropped;
+        }
+
+        if(reopen){
+            log.close();
+            if(!open_path.isEmpty()){
+                log.setFileName(open_path);
+                if(!log.open(QIODevice::WriteOnly|QIODevice::Append|QIODevice::Text))
+                    emit failed(tr("Alarm log %1: %2").arg(open_path).arg(log.errorString()));
+            }
+        }
+
+        for(const imuSample &s : batch)
+            process(s);
+        batch.clear();
+
+        const qint64 now=host_monotonic_us();
+        if(now>=next_tick){
+            tick(now);
+            next_tick=now+ALARM_TICK_US;
+        }
+
+        if(!m_events.empty()){
+            for(const alarmEvent &ev : m_events){
+                write_log(ev);
+                emit alarm(ev);
+            }
+            m_events.clear();
+            log.flush();
+        }
+
+        QMutexLocker lock(&mutex);
+        published=counters;
+    }
+    log.close();
+}
+
+//----------------------------------------------------------------------------
+// AlarmBroadcaster
+//----------------------------------------------------------------------------
+AlarmBroadcaster::AlarmBroadcaster(QObject *parent)
+    : QObject(parent)
+    , server(new QLocalServer(this))
+{
+    connect(server, &QLocalServer::newConnection, this, [this](){
+        while(QLocalSocket *socket=server->nextPendingConnection()){
+            sockets.append(socket);
+            connect(socket, &QLocalSocket::disconnected, this, [this,socket](){
+                sockets.removeAll(socket);
+                socket->deleteLater();
+            });
+        }
+    });
+}
+
+bool AlarmBroadcaster::listen(const QString &name)
+{
+    if(server->isListening())
+        return true;
+    //a server left behind by a crashed instance
+    QLocalServer::removeServer(name);
+    if(!server->listen(name)){
+        m_error=server->errorString();
+        return false;
+    }
+    return true;
+}
+
+void AlarmBroadcaster::close()
+{
+    server->close();
+    for(QLocalSocket *socket : sockets){
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    sockets.clear();
+}
+
+void AlarmBroadcaster::publish(const alarmEvent &ev)
+{
+    if(sockets.isEmpty())
+        return;
+    QJsonObject obj;
+    obj["time"]=QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+    obj["rule"]=ev.name;
+    obj["node"]=ev.node;
+    obj["state"]=ev.raised?"raised":"cleared";
+    obj["value"]=double(ev.value);
+    obj["threshold"]=double(ev.threshold);
+    obj["host_us"]=double(ev.host_us);
+    const QByteArray line=QJsonDocument(obj).toJson(QJsonDocument::Compact)+'\n';
+
+    for(int i=sockets.size()-1;i>=0;i--){
+        QLocalSocket *socket=sockets.at(i);
+        if(socket->bytesToWrite()>ALARM_MAX_BACKLOG){
+            sockets.removeAt(i);
+            socket->disconnect(this);
+            socket->abort();
+            socket->deleteLater();
+            continue;
+        }
+        socket->write(line);
+    }
+}
@@ -0,0 +1,222 @@
+#ifndef ALARM_RULES_H
+#define ALARM_RULES_H
+
+#include "imu_packing.h"
+#include <QFile>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <vector>
+
+class QLocalServer;
+class QLocalSocket;
+
+#define ALARM_MAX_NODES     128
+
+//per node values a rule can read; the sample fields are updated by every
+//decoded sample, the rate fields once per second from the sample counts
+enum alarmField{
+    ALARM_ACC_X=0, ALARM_ACC_Y, ALARM_ACC_Z,
+    ALARM_GYR_X, ALARM_GYR_Y, ALARM_GYR_Z,
+    ALARM_EUL_X, ALARM_EUL_Y, ALARM_EUL_Z,
+    ALARM_QUAT_W, ALARM_QUAT_X, ALARM_QUAT_Y, ALARM_QUAT_Z,
+    ALARM_HZ_ACC, ALARM_HZ_GYR, ALARM_HZ_EUL, ALARM_HZ_QUAT,       //measured [Hz]
+    ALARM_CFG_ACC, ALARM_CFG_GYR, ALARM_CFG_EUL, ALARM_CFG_QUAT,   //configured [Hz]
+    ALARM_FIELD_COUNT
+};
+
+//rules are evaluated when a field they read changes
+#define ALARM_DEP_RATE      (1u<<IMU_SIG_COUNT)
+
+enum alarmOpCode{
+    ALARM_OP_FIELD=0,   //push fields[field]
+    ALARM_OP_CONST,     //push value
+    ALARM_OP_NORM3,     //push |fields[field..field+2]|
+    ALARM_OP_ADD,
+    ALARM_OP_SUB,
+    ALARM_OP_MUL,
+    ALARM_OP_DIV,
+    ALARM_OP_NEG,
+    ALARM_OP_ABS,
+    ALARM_OP_SQRT,
+    ALARM_OP_MIN,
+    ALARM_OP_MAX
+};
+
+struct alarmOp{
+    quint8 code;
+    quint8 field;
+    float value;
+};
+
+//one compiled rule: the ops leave the left and the right side of the
+//comparison on the stack
+struct alarmRule{
+    QString name;
+    QString text;           //the line it was parsed from
+    int first_op=0;
+    int n_ops=0;
+    bool above=true;        //lhs > rhs raises
+    float hyst=0;           //clears when past the threshold by this much
+    qint64 on_us=0;         //condition held this long before raising
+    qint64 off_us=0;        //and before clearing
+    quint32 depends=0;      //1<<imuSignal and ALARM_DEP_RATE
+    //field compared with a constant, evaluated without the stack
+    bool simple=false;
+    quint8 simple_code=ALARM_OP_FIELD;
+    quint8 simple_field=0;
+    float simple_value=0;
+};
+
+//rule text with one rule per line, # starts a comment:
+//  <name>: <expr> <|<=|>|>= <expr> [hyst <h>] [on <ms>] [off <ms>]
+//expressions use + - * / ( ), numbers, abs() sqrt() min() max(), the
+//fields acc.x gyr.y eul.z quat.w, roll pitch yaw, |acc| |gyr|, the
+//measured rates hz.acc hz.gyr hz.eul hz.quat and the configured ones
+//cfg.acc cfg.gyr cfg.eul cfg.quat
+struct alarmProgram{
+    QVector<alarmRule> rules;
+    std::vector<alarmOp> ops;
+    int max_stack=0;
+};
+bool alarm_parse(const QString &text, alarmProgram &program, QString &error);
+
+struct alarmEvent{
+    int rule=0;
+    QString name;
+    int node=0;
+    bool raised=false;      //false when cleared
+    float value=0;          //left side of the comparison
+    float threshold=0;      //right side
+    qint64 host_us=0;
+};
+Q_DECLARE_METATYPE(alarmEvent)
+
+struct alarmStats{
+    quint64 samples=0;
+    quint64 dropped=0;      //worker too far behind
+    quint64 evaluations=0;
+    quint64 raised=0;
+    quint64 cleared=0;
+    int active=0;
+};
+
+
+//evaluates the alarm rules on every decoded sample off the GUI thread;
+//a rule raises after its condition held for on ms and clears after it was
+//false by more than the hysteresis for off ms, per rule and node
+class AlarmEngine : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit AlarmEngine(QObject *parent = nullptr);
+    ~AlarmEngine() override;
+
+    //compiles the rules, the state of every rule is reset
+    bool set_rules(const QString &text);
+    QString error() const {return m_error;}
+    int rule_count() const {return program.rules.size();}
+    //events are appended to path, empty for no log
+    void set_log(const QString &path);
+    void set_configured_hz(int node, int signal, float hz);
+    //samples queued for the worker before new ones are dropped (0 for the
+    //default), reserved by start_engine() when reserve is set
+    void set_max_pending(int samples, bool reserve);
+    //sample queue and node state [bytes]
+    qint64 memory_bytes();
+
+    bool start_engine();
+    void stop_engine();
+    bool is_running() const {return running;}
+
+    //read loop, queued for the worker
+    void post(const imuSample *samples, int n);
+
+    //worker side, also used by the benchmarks; events are appended to
+    //events() and taken by the caller
+    void process(const imuSample &sample);
+    void tick(qint64 host_us);
+    std::vector<alarmEvent> &events() {return m_events;}
+    void load(const alarmProgram &program);
+
+    alarmStats stats();
+
+signals:
+    void alarm(const alarmEvent &event);
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    struct ruleState{
+        quint8 active=0;
+        quint8 pending=0;
+        qint64 since_us=0;
+    };
+    struct nodeState{
+        bool seen=false;
+        float fields[ALARM_FIELD_COUNT]={0};
+        quint32 count[IMU_SIG_COUNT]={0};
+        qint64 window_us=0;
+        qint64 last_us=0;
+        std::vector<ruleState> rules;
+    };
+
+    void evaluate(int rule, nodeState &node, int node_id, qint64 host_us);
+    void write_log(const alarmEvent &event);
+
+    alarmProgram program;
+    std::vector<int> by_dep[IMU_SIG_COUNT+1];
+    std::vector<nodeState> nodes;
+    std::vector<float> stack;
+    std::vector<alarmEvent> m_events;
+    alarmStats counters;
+    QFile log;
+    QString m_error;
+    bool running=false;
+
+    //shared with the read loop and the GUI thread
+    QMutex mutex;
+    QWaitCondition wake;
+    std::vector<imuSample> pending;
+    size_t max_pending;
+    size_t reserved=0;
+    bool quit=false;
+    bool program_changed=false;
+    alarmProgram next_program;
+    QString log_path;
+    bool log_changed=false;
+    float cfg_hz[ALARM_MAX_NODES][IMU_SIG_COUNT];
+    bool cfg_changed=false;
+    quint64 n_dropped=0;
+    alarmStats published;
+};
+
+
+//writes every alarm event as a JSON line to the clients of a local socket
+class AlarmBroadcaster : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AlarmBroadcaster(QObject *parent = nullptr);
+
+    bool listen(const QString &name);
+    void close();
+    QString error() const {return m_error;}
+    int clients() const {return sockets.size();}
+
+    void publish(const alarmEvent &event);
+
+private:
+    QLocalServer *server;
+    QVector<QLocalSocket*> sockets;
+    QString m_error;
+};
+
+#endif // ALARM_RULES_H
@@ -0,0 +1,383 @@
+#include "batch_analysis.h"
+#include "capture_codec.h"
+#include "clock_sync.h"
+#include "trace_import.h"
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <memory>
+
+static const char *batch_signal_names[IMU_SIG_COUNT]={"acc","gyr","eul","quat"};
+
+//----------------------------------------------------------------------------
+// batchSeries
+//----------------------------------------------------------------------------
+void batchSeries::merge(const batchSeries &other, int axes)
+{
+    if(!other.frames)
+        return;
+    if(other.samples){
+        for(int a=0;a<axes;a++){
+            min[a]=samples?qMin(min[a],other.min[a]):other.min[a];
+            max[a]=samples?qMax(max[a],other.max[a]):other.max[a];
+            sum[a]+=other.sum[a];
+        }
+    }
+    //parallel form of the running variance
+    const quint64 n=intervals+other.intervals;
+    if(n){
+        const double delta=other.interval_mean_us-interval_mean_us;
+        interval_m2+=other.interval_m2+delta*delta*double(intervals)*double(other.intervals)/double(n);
+        interval_mean_us+=delta*double(other.intervals)/double(n);
+    }
+    intervals=n;
+    files+=other.files;
+    frames+=other.frames;
+    samples+=other.samples;
+    span_us+=other.span_us;
+    gaps+=other.gaps;
+    max_gap_us=qMax(max_gap_us,other.max_gap_us);
+}
+
+double batchSeries::jitter_us() const
+{
+    return intervals>1?std::sqrt(interval_m2/double(intervals-1)):0;
+}
+
+QStringList batch_collect(const QString &dir)
+{
+    QStringList paths;
+    QDirIterator it(dir,{"*.pqc","*.trc","*.log","*.asc"},QDir::Files,QDirIterator::Subdirectories);
+    while(it.hasNext())
+        paths.append(it.next());
+    paths.sort();
+    return paths;
+}
+
+//----------------------------------------------------------------------------
+// per file
+//----------------------------------------------------------------------------
+//series of one file; the stream state stays here, only the figures merge
+struct fileSeries{
+    batchSeries stats;
+    quint64 first_us=0;
+    quint64 last_us=0;
+};
+
+class FileAnalysis
+{
+public:
+    explicit FileAnalysis(imuPacking packing) : series(BATCH_SERIES)
+    {
+        unpacker.set_packing(packing);
+    }
+
+    void frame(const canFrame &frame);
+    //into the worker's totals, then ready for the next file
+    void finish(std::vector<batchSeries> &totals);
+
+private:
+    ImuUnpacker unpacker;
+    std::vector<fileSeries> series;
+    imuSample samples[IMU_FD_MAX_SAMPLES];
+};
+
+void FileAnalysis::frame(const canFrame &frame)
+{
+    const TPCANMsgFD &msg=frame.msg;
+    if(msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_RTR|PCAN_MESSAGE_STATUS|PCAN_MESSAGE_ECHO))
+        return;
+    const int node=int(msg.ID&0x7F);
+    const int signal=imu_signal_from_cobid(msg.ID,node);
+    if(signal<0)
+        return;
+
+    fileSeries &fs=series[size_t(node*IMU_SIG_COUNT+signal)];
+    batchSeries &s=fs.stats;
+    if(s.frames&&frame.ts_us>fs.last_us){
+        const quint64 interval=frame.ts_us-fs.last_us;
+        if(s.intervals>=BATCH_GAP_WARMUP&&interval>s.interval_mean_us*BATCH_GAP_FACTOR){
+            s.gaps++;
+            s.max_gap_us=qMax(s.max_gap_us,interval);
+        }
+        else{
+            s.intervals++;
+            const double delta=double(interval)-s.interval_mean_us;
+            s.interval_mean_us+=delta/double(s.intervals);
+            s.interval_m2+=delta*(double(interval)-s.interval_mean_us);
+        }
+    }
+    if(!s.frames)
+        fs.first_us=frame.ts_us;
+    fs.last_us=frame.ts_us;
+    s.frames++;
+
+    const int n=unpacker.decode(frame,node,samples,IMU_FD_MAX_SAMPLES);
+    const int axes=imu_signal_axes(signal);
+    for(int i=0;i<n;i++){
+        const float *v=samples[i].v;
+        for(int a=0;a<axes;a++){
+            s.min[a]=s.samples?qMin(s.min[a],v[a]):v[a];
+            s.max[a]=s.samples?qMax(s.max[a],v[a]):v[a];
+            s.sum[a]+=v[a];
+        }
+        s.samples++;
+    }
+}
+
+void FileAnalysis::finish(std::vector<batchSeries> &totals)
+{
+    for(int id=0;id<BATCH_SERIES;id++){
+        fileSeries &fs=series[size_t(id)];
+        if(!fs.stats.frames)
+            continue;
+        fs.stats.files=1;
+        fs.stats.span_us=fs.last_us-fs.first_us;
+        totals[size_t(id)].merge(fs.stats,imu_signal_axes(id%IMU_SIG_COUNT));
+        fs=fileSeries();
+    }
+    unpacker.reset();
+}
+
+static bool analyze_file(batchFile &file, FileAnalysis &analysis)
+{
+    if(file.path.endsWith(".pqc",Qt::CaseInsensitive)){
+        CaptureReader reader;
+        if(!reader.open(file.path)){
+            file.error=reader.error();
+            return false;
+        }
+        std::vector<canFrame> block;
+        while(reader.next(block)){
+            for(const canFrame &frame : block)
+                analysis.frame(frame);
+            file.frames+=block.size();
+        }
+        file.error=reader.error();
+        return file.error.isEmpty();
+    }
+
+    //the pool already runs one file per core
+    QFile in(file.path);
+    if(!in.open(QIODevice::ReadOnly)){
+        file.error=in.errorString();
+        return false;
+    }
+    const qint64 size=in.size();
+    uchar *data=size?in.map(0,size):nullptr;
+    if(size&&!data){
+        file.error=in.errorString();
+        return false;
+    }
+    std::vector<canFrame> frames;
+    traceImportStats stats;
+    const bool ok=TraceImporter::parse(reinterpret_cast<const char*>(data),size,frames,stats,file.error,1);
+    if(data)
+        in.unmap(data);
+    for(const canFrame &frame : frames)
+        analysis.frame(frame);
+    file.frames=frames.size();
+    return ok;
+}
+
+//----------------------------------------------------------------------------
+// work stealing pool
+//----------------------------------------------------------------------------
+struct workQueue{
+    QMutex mutex;
+    std::deque<int> items;
+};
+
+//fn(worker, item) for every item of the queues, worker 0 is the calling
+//thread; returns the items taken from another worker's queue
+static quint64 run_stealing(std::vector<workQueue> &queues, const std::function<void(int,int)> &fn)
+{
+    const int threads=int(queues.size());
+    std::atomic<quint64> steals(0);
+    auto work=[&](int self){
+        for(;;){
+            int item=-1;
+            {
+                QMutexLocker lock(&queues[size_t(self)].mutex);
+                if(!queues[size_t(self)].items.empty()){
+                    item=queues[size_t(self)].items.front();
+                    queues[size_t(self)].items.pop_front();
+                }
+            }
+            //the smallest files of a victim are at its back
+            for(int k=1;item<0&&k<threads;k++){
+                workQueue &victim=queues[size_t((self+k)%threads)];
+                QMutexLocker lock(&victim.mutex);
+                if(!victim.items.empty()){
+                    item=victim.items.back();
+                    victim.items.pop_back();
+                    steals++;
+                }
+            }
+            //nothing is added while running, so empty everywhere means done
+            if(item<0)
+                return;
+            fn(self,item);
+        }
+    };
+    std::vector<QThread*> helpers;
+    for(int t=1;t<threads;t++){
+        QThread *helper=QThread::create(work,t);
+        helper->start();
+        helpers.push_back(helper);
+    }
+    work(0);
+    for(QThread *helper : helpers){
+        helper->wait();
+        delete helper;
+    }
+    return steals;
+}
+
+//----------------------------------------------------------------------------
+// BatchAnalyzer
+//----------------------------------------------------------------------------
+BatchAnalyzer::BatchAnalyzer(QObject *parent)
+    : QThread(parent)
+{
+    qRegisterMetaType<batchStats>("batchStats");
+}
+
+BatchAnalyzer::~BatchAnalyzer()
+{
+    wait();
+}
+
+void BatchAnalyzer::analyze(const QStringList &file_paths, imuPacking mode, int n_threads)
+{
+    if(isRunning())
+        return;
+    {
+        QMutexLocker lock(&mutex);
+        paths=file_paths;
+        packing=mode;
+        threads=n_threads;
+    }
+    n_done=0;
+    n_total=file_paths.size();
+    start(QThread::LowPriority);
+}
+
+batchStats BatchAnalyzer::analyze_files(const QStringList &paths, imuPacking packing, int threads,
+                                        std::vector<batchSeries> &series, std::vector<batchFile> &files,
+                                        std::atomic<int> *done)
+{
+    const qint64 t0=host_monotonic_us();
+    batchStats stats;
+    files.assign(size_t(paths.size()),batchFile());
+    for(int i=0;i<paths.size();i++){
+        files[size_t(i)].path=paths.at(i);
+        files[size_t(i)].bytes=QFileInfo(paths.at(i)).size();
+        stats.bytes+=files[size_t(i)].bytes;
+    }
+    if(threads<=0)
+        threads=qMax(1,QThread::idealThreadCount());
+    threads=qMax(1,qMin(threads,paths.size()));
+
+    //largest first, dealt round robin, so every queue starts with a fair
+    //share and ends with the small files that are cheap to steal
+    std::vector<int> order(files.size());
+    for(size_t i=0;i<order.size();i++)
+        order[i]=int(i);
+    std::stable_sort(order.begin(),order.end(),[&](int a, int b){
+        return files[size_t(a)].bytes>files[size_t(b)].bytes;
+    });
+    std::vector<workQueue> queues(static_cast<size_t>(threads));
+    for(size_t i=0;i<order.size();i++)
+        queues[i%size_t(threads)].items.push_back(order[i]);
+
+    std::vector<std::vector<batchSeries>> totals(size_t(threads),std::vector<batchSeries>(BATCH_SERIES));
+    std::vector<std::unique_ptr<FileAnalysis>> analyses(static_cast<size_t>(threads));
+    for(auto &a : analyses)
+        a.reset(new FileAnalysis(packing));
+    stats.steals=run_stealing(queues,[&](int worker, int item){
+        FileAnalysis &analysis=*analyses[size_t(worker)];
+        analyze_file(files[size_t(item)],analysis);
+        //what was read of a broken file still counts
+        analysis.finish(totals[size_t(worker)]);
+        if(done)
+            (*done)++;
+    });
+
+    series.assign(BATCH_SERIES,batchSeries());
+    for(const auto &worker : totals){
+        for(int id=0;id<BATCH_SERIES;id++)
+            series[size_t(id)].merge(worker[size_t(id)],imu_signal_axes(id%IMU_SIG_COUNT));
+    }
+    for(const batchFile &file : files){
+        stats.files++;
+        stats.frames+=file.frames;
+        if(!file.error.isEmpty())
+            stats.failed++;
+    }
+    stats.threads=threads;
+    stats.elapsed_us=host_monotonic_us()-t0;
+    return stats;
+}
+
+void BatchAnalyzer::run()
+{
+    QStringList file_paths;
+    imuPacking mode;
+    int n_threads;
+    {
+        QMutexLocker lock(&mutex);
+        file_paths=paths;
+        mode=packing;
+        n_threads=threads;
+    }
+    std::vector<batchSeries> out_series;
+    std::vector<batchFile> out_files;
+    const batchStats out=analyze_files(file_paths,mode,n_threads,out_series,out_files,&n_done);
+    {
+        QMutexLocker lock(&mutex);
+        stats=out;
+        series.swap(out_series);
+        files.swap(out_files);
+    }
+    emit analyzed(out);
+}
+
+QStringList BatchAnalyzer::report()
+{
+    QMutexLocker lock(&mutex);
+    QStringList lines;
+    for(int id=0;id<int(series.size());id++){
+        const batchSeries &s=series[size_t(id)];
+        if(!s.frames)
+            continue;
+        const int signal=id%IMU_SIG_COUNT;
+        QStringList ranges;
+        for(int a=0;a<imu_signal_axes(signal)&&s.samples;a++){
+            ranges.append(tr("%1 .. %2 (mean %3)")
+                          .arg(double(s.min[a]),0,'g',4)
+                          .arg(double(s.max[a]),0,'g',4)
+                          .arg(s.sum[a]/s.samples,0,'g',4));
+        }
+        lines.append(tr("node %1 %2: %3 files, %4 samples at %5 Hz, jitter %6 us, %7 gaps (max %8 ms), %9")
+                     .arg(id/IMU_SIG_COUNT)
+                     .arg(batch_signal_names[signal])
+                     .arg(s.files)
+                     .arg(s.samples)
+                     .arg(s.rate_hz(),0,'f',2)
+                     .arg(s.jitter_us(),0,'f',0)
+                     .arg(s.gaps)
+                     .arg(s.max_gap_us/1000.0,0,'f',1)
+                     .arg(ranges.join(", ")));
+    }
+    for(const batchFile &file : files){
+        if(!file.error.isEmpty())
+            lines.append(tr("%1: %2").arg(file.path,file.error));
+    }
+    return lines;
+}
@@ -0,0 +1,108 @@
+#ifndef BATCH_ANALYSIS_H
+#define BATCH_ANALYSIS_H
+
+#include "imu_packing.h"
+#include <QThread>
+#include <QMutex>
+#include <QMetaType>
+#include <QStringList>
+#include <atomic>
+#include <vector>
+
+//one series per node and signal, like the pyramid
+#define BATCH_SERIES            (128*IMU_SIG_COUNT)
+//a TPDO interval this many times the mean so far is a gap, once the mean
+//is taken over enough intervals
+#define BATCH_GAP_FACTOR        2
+#define BATCH_GAP_WARMUP        16
+
+//timing and value range of one TPDO signal of one node; two of them merge
+//into the statistics of both streams
+struct batchSeries{
+    int files=0;
+    quint64 frames=0;
+    quint64 samples=0;
+    quint64 span_us=0;          //first to last frame, summed over the files
+    //regular frame intervals (gaps left out), running mean and M2
+    quint64 intervals=0;
+    double interval_mean_us=0;
+    double interval_m2=0;
+    quint64 gaps=0;
+    quint64 max_gap_us=0;
+    float min[4]={0};
+    float max[4]={0};
+    double sum[4]={0};
+
+    void merge(const batchSeries &other, int axes);
+    double rate_hz() const {return span_us?samples*1e6/span_us:0;}
+    double jitter_us() const;
+};
+
+struct batchFile{
+    QString path;
+    qint64 bytes=0;
+    quint64 frames=0;
+    QString error;              //empty when the file was read
+};
+
+struct batchStats{
+    int files=0;
+    int failed=0;
+    quint64 frames=0;
+    qint64 bytes=0;
+    qint64 elapsed_us=0;
+    int threads=0;
+    quint64 steals=0;           //files a worker took from another's queue
+    double mb_per_s() const {return elapsed_us?bytes/double(elapsed_us):0;}
+};
+Q_DECLARE_METATYPE(batchStats)
+
+//capture files (.pqc) and text traces below dir
+QStringList batch_collect(const QString &dir);
+
+//offline statistics over many recordings: the files are spread over a pool
+//of workers, each with its own queue, largest files first; a worker whose
+//queue ran dry steals from the back of the others. Captures are streamed a
+//block at a time, so a worker holds one block whatever the file size; text
+//traces are parsed whole. Every worker sums its files into its own series,
+//the workers are merged at the end
+class BatchAnalyzer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit BatchAnalyzer(QObject *parent = nullptr);
+    ~BatchAnalyzer() override;
+
+    //analyzes in the background, analyzed() when done, threads 0 = one per core
+    void analyze(const QStringList &paths, imuPacking packing, int threads=0);
+    int files_done() const {return n_done;}
+    int files_total() const {return n_total;}
+
+    //synchronous analysis, series indexed by node*IMU_SIG_COUNT+signal
+    static batchStats analyze_files(const QStringList &paths, imuPacking packing, int threads,
+                                    std::vector<batchSeries> &series, std::vector<batchFile> &files,
+                                    std::atomic<int> *done=nullptr);
+
+    //consolidated report of the last analysis, failed files last
+    QStringList report();
+
+signals:
+    void analyzed(const batchStats &stats);
+
+protected:
+    void run() override;
+
+private:
+    QMutex mutex;
+    QStringList paths;
+    imuPacking packing=IMU_PACK_NONE;
+    int threads=0;
+    std::atomic<int> n_done{0};
+    std::atomic<int> n_total{0};
+    batchStats stats;
+    std::vector<batchSeries> series;
+    std::vector<batchFile> files;
+};
+
+#endif // BATCH_ANALYSIS_H
@@ -0,0 +1,86 @@
+#include "alloc_count.h"
+#include <cerrno>
+#include <cstddef>
+
+#if defined(__GLIBC__)
+
+//the allocator itself, glibc exports it under these names
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+//constant initialized, the first use from inside malloc does not allocate
+static thread_local quint64 n_allocs=0;
+
+//defined in the executable, so they take the place of the libc ones for
+//Qt and libstdc++ (operator new) too; free() is left alone
+extern "C" {
+
+void *malloc(size_t size) noexcept
+{
+    n_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) noexcept
+{
+    n_allocs++;
+    return __libc_calloc(n,size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept
+{
+    n_allocs++;
+    return __libc_realloc(ptr,size);
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    n_allocs++;
+    return __libc_memalign(alignment,size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    n_allocs++;
+    return __libc_memalign(alignment,size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) noexcept
+{
+    n_allocs++;
+    void *ptr=__libc_memalign(alignment,size);
+    if(!ptr)
+        return ENOMEM;
+    *out=ptr;
+    return 0;
+}
+
+}
+
+bool alloc_count_supported()
+{
+    return true;
+}
+
+quint64 alloc_count()
+{
+    return n_allocs;
+}
+
+#else
+
+bool alloc_count_supported()
+{
+    return false;
+}
+
+quint64 alloc_count()
+{
+    return 0;
+}
+
+#endif
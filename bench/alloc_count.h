@@ -0,0 +1,12 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+#include <QtGlobal>
+
+//heap allocations made by the calling thread so far. malloc and its
+//relatives are replaced in the benchmark binary on glibc; elsewhere
+//nothing is counted and alloc_count_supported() is false
+bool alloc_count_supported();
+quint64 alloc_count();
+
+#endif // ALLOC_COUNT_H
@@ -0,0 +1,88 @@
+QT       += core gui network
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = pcan_bench
+
+# the GUI sources are built as they are, PCAN-Basic is replaced by a null
+# driver so the benchmarks run headless and without hardware
+SOURCES += \
+    ../alarm_rules.cpp \
+    ../batch_analysis.cpp \
+    ../bitrate_detect.cpp \
+    ../bounded_memory.cpp \
+    ../bus_health.cpp \
+    ../can_transport.cpp \
+    ../capture_codec.cpp \
+    ../capture_writer.cpp \
+    ../ch100_emulator.cpp \
+    ../channel_monitor.cpp \
+    ../clock_sync.cpp \
+    ../dbc_decoder.cpp \
+    ../eds_dictionary.cpp \
+    ../imu_packing.cpp \
+    ../load_generator.cpp \
+    ../nmt_monitor.cpp \
+    ../node_config.cpp \
+    ../od_browser.cpp \
+    ../pcan_qt.cpp \
+    ../sdo_client.cpp \
+    ../sdo_profiler.cpp \
+    ../sdo_server.cpp \
+    ../sdo_transfer.cpp \
+    ../signal_pyramid.cpp \
+    ../sync_acquisition.cpp \
+    ../trace_import.cpp \
+    ../trigger_capture.cpp \
+    ../tx_scheduler.cpp \
+    alloc_count.cpp \
+    bench_cases.cpp \
+    bench_main.cpp \
+    bench_runner.cpp \
+    pcanbasic_null.cpp \
+
+HEADERS += \
+    ../alarm_rules.h \
+    ../batch_analysis.h \
+    ../bitrate_detect.h \
+    ../bounded_memory.h \
+    ../bus_health.h \
+    ../can_transport.h \
+    ../canopen.h \
+    ../capture_codec.h \
+    ../capture_writer.h \
+    ../ch100_emulator.h \
+    ../channel_monitor.h \
+    ../clock_sync.h \
+    ../dbc_decoder.h \
+    ../eds_dictionary.h \
+    ../imu_packing.h \
+    ../include/PCANBasic.h \
+    ../load_generator.h \
+    ../nmt_monitor.h \
+    ../node_config.h \
+    ../od_browser.h \
+    ../pcan_qt.h \
+    ../sdo_client.h \
+    ../sdo_profiler.h \
+    ../sdo_server.h \
+    ../sdo_transfer.h \
+    ../signal_pyramid.h \
+    ../sync_acquisition.h \
+    ../trace_import.h \
+    ../trigger_capture.h \
+    ../tx_scheduler.h \
+    alloc_count.h \
+    bench_cases.h \
+    bench_runner.h \
+
+FORMS += \
+    ../pcan_qt.ui
+
+INCLUDEPATH += $$PWD/..
+# <Windows.h> of include/PCANBasic.h
+unix: INCLUDEPATH += $$PWD/compat
+DEPENDPATH += $$PWD/..
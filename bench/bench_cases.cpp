@@ -0,0 +1,1658 @@
+#include "bench_cases.h"
+#include "alloc_count.h"
+#include "pcan_qt.h"
+#include "alarm_rules.h"
+#include "batch_analysis.h"
+#include "bitrate_detect.h"
+#include "bus_health.h"
+#include "capture_codec.h"
+#include "capture_writer.h"
+#include "ch100_emulator.h"
+#include "dbc_decoder.h"
+#include "nmt_monitor.h"
+#include "sdo_profiler.h"
+#include "sdo_server.h"
+#include "sdo_transfer.h"
+#include "signal_pyramid.h"
+#include "sync_acquisition.h"
+#include "trace_import.h"
+#include "trigger_capture.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+
+//frames per 3 ms read tick on a fully loaded 1 Mbit/s bus
+#define PIPELINE_TICK_FRAMES    24
+//FD against classic frames: IDs the IMU decoder leaves alone
+#define FD_BENCH_ID             0x500
+#define FD_BENCH_IDS            16
+//accelerometer samples of one node, packed each way
+#define PACK_BENCH_NODE         8
+#define PACK_BENCH_SAMPLES      20000
+//bus-off recovery: a periodic frame keeps the TX thread writing throughout
+#define BUSOFF_BENCH_ID         0x7E0
+#define BUSOFF_BENCH_PERIOD_US  1000
+#define BUSOFF_BENCH_TIMEOUT_MS 5000
+//TX scheduler: queued frames in flight, periodic frames on their own IDs
+#define TX_BENCH_QUEUE          1024
+#define TX_BENCH_ID             0x580
+#define TX_BENCH_PERIODIC       4
+#define TX_BENCH_PERIOD_US      1000
+#define SDO_BENCH_NODE          5
+//object sizes: a typical configuration block and a firmware-sized one
+#define SDO_BENCH_SIZE          65536
+#define SDO_BENCH_SIZE_LARGE    (512*1024)
+//text traces are repeated up to this size, enough chunks for every core
+#define IMPORT_BENCH_SIZE       (32<<20)
+//messages per layout in the generated DBC
+#define DBC_BENCH_MESSAGES      64
+//alarm load: rules on every node, each node sending all four signals
+#define ALARM_BENCH_RULES       300
+#define ALARM_BENCH_NODES       16
+#define ALARM_BENCH_HZ          200
+//bounded memory read loop, frames counted after the warm-up
+#define BOUNDED_BENCH_MB        16
+#define BOUNDED_BENCH_FRAMES    100000
+//full network: every node with a heartbeat at this period, over the
+//synthetic TPDO traffic
+#define NMT_BENCH_PERIOD_US     100000
+#define NMT_BENCH_SECONDS       10
+//long recording for the zoom queries: one signal for this many hours at
+//100 Hz, plotted into this many pixels
+#define PYRAMID_BENCH_HOURS     12
+#define PYRAMID_BENCH_POINTS    1920
+//a campaign of captures of the synthetic stream, a quarter to all of it
+#define BATCH_BENCH_FILES       32
+//emulated network on a bus of its own, polled every step of a synthetic clock
+#define EMU_BENCH_NODES         32
+#define EMU_BENCH_HZ            100
+#define EMU_BENCH_STEP_US       100
+//SYNC acquisition of emulated nodes, a few cycles after the switch of the
+//transmission type are left out; the switch and the restore get 5 s each
+#define SYNC_BENCH_NODES        8
+#define SYNC_BENCH_PERIOD_US    5000
+#define SYNC_BENCH_WARMUP       4
+#define SYNC_BENCH_SDO_MS       5000
+//emulated nodes at a rate that is last but one of the candidates
+#define DETECT_BENCH_NODES      4
+//probes to emulated nodes that answer a share of the requests late
+#define PROF_BENCH_NODES        4
+#define PROF_BENCH_DELAY_MS     5
+#define PROF_BENCH_DELAY_PCT    20
+#define PROF_BENCH_HZ           2000
+
+static const char *bench_bitrate_fd="f_clock_mhz=80, nom_brp=10, nom_tseg1=12, nom_tseg2=3, nom_sjw=1, "
+                                    "data_brp=4, data_tseg1=7, data_tseg2=2, data_sjw=1";
+
+//results go here so the optimizer cannot drop the timed work
+static volatile int bench_sink;
+
+std::vector<canFrame> bench_synthetic_stream(int node_id, int rate_hz, int seconds)
+{
+    std::mt19937 rng(20211001);
+    std::vector<canFrame> frames;
+    qint16 raw[IMU_SIG_COUNT][4]={{0}};
+    const quint64 period_us=1000000/quint64(rate_hz);
+
+    for(int cycle=0;cycle<rate_hz*seconds;cycle++){
+        const quint64 t0=quint64(cycle)*period_us;
+        for(int signal=0;signal<IMU_SIG_COUNT;signal++){
+            const int axes=imu_signal_axes(signal);
+            canFrame frame;
+            frame.msg.ID=DWORD(0x180+0x100*signal+node_id);
+            frame.msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+            frame.msg.DLC=uchar(2*axes);
+            for(int a=0;a<axes;a++){
+                raw[signal][a]=qint16(qBound(-30000,raw[signal][a]+int(rng()%41)-20,30000));
+                frame.msg.DATA[2*a]=uchar(uint16_t(raw[signal][a])&0xFF);
+                frame.msg.DATA[2*a+1]=uchar(uint16_t(raw[signal][a])>>8);
+            }
+            //the TPDOs of one sample go out back to back
+            frame.ts_us=t0+quint64(signal)*130;
+            frame.host_us=qint64(frame.ts_us)+1500;
+            frames.push_back(frame);
+        }
+        if(cycle%rate_hz==0){
+            canFrame heartbeat;
+            heartbeat.msg.ID=DWORD(0x700+node_id);
+            heartbeat.msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+            heartbeat.msg.DLC=1;
+            heartbeat.msg.DATA[0]=0x05;
+            heartbeat.ts_us=t0+IMU_SIG_COUNT*130;
+            heartbeat.host_us=qint64(heartbeat.ts_us)+1500;
+            frames.push_back(heartbeat);
+        }
+    }
+    return frames;
+}
+
+//----------------------------------------------------------------------------
+// PcanQtBench
+//----------------------------------------------------------------------------
+PcanQtBench::PcanQtBench()
+{
+    //FD endpoints take classic and FD frames, so recorded FD traffic replays too
+    VirtualTransport *rx=new VirtualTransport(&bus);
+    rx->initialize_fd(PCAN_USBBUS1,bench_bitrate_fd);
+    generator=new VirtualTransport(&bus);
+    generator->initialize_fd(PCAN_USBBUS2,bench_bitrate_fd);
+
+    window=new PCAN_QT(nullptr,rx);
+    window->show();
+    synthetic=bench_synthetic_stream(8,100,60);
+}
+
+PcanQtBench::~PcanQtBench()
+{
+    delete window;
+    delete generator;
+}
+
+bool PcanQtBench::load_capture(const QString &path, QString &error)
+{
+    CaptureReader reader;
+    if(!reader.open(path)||!reader.read_all(recorded)){
+        error=reader.error();
+        recorded.clear();
+        return false;
+    }
+    if(recorded.empty()){
+        error=QObject::tr("%1 holds no frames.").arg(path);
+        return false;
+    }
+    //node of the first CH100 TPDO 1
+    for(const canFrame &frame : recorded){
+        if((frame.msg.ID&0x780)==0x180&&(frame.msg.ID&0x7F)){
+            recorded_node=int(frame.msg.ID&0x7F);
+            break;
+        }
+    }
+    return true;
+}
+
+void PcanQtBench::run(BenchRunner &runner)
+{
+    run_format(runner);
+
+    run_parsers(runner,"synthetic",synthetic,8);
+    run_pipeline(runner,"synthetic",synthetic,8);
+    run_capture(runner,"synthetic",synthetic);
+    run_fd(runner);
+    run_packing(runner);
+
+    if(!recorded.empty()){
+        run_parsers(runner,"recorded",recorded,recorded_node);
+        run_pipeline(runner,"recorded",recorded,recorded_node);
+        run_capture(runner,"recorded",recorded);
+    }
+
+    run_busoff(runner);
+    run_tx(runner);
+    run_sdo(runner);
+    run_import(runner);
+    run_dbc(runner);
+    run_trigger(runner);
+    run_alarms(runner);
+    run_bounded(runner);
+    run_nmt(runner);
+    run_pyramid(runner);
+    run_batch(runner);
+    run_emulator(runner);
+    run_sync(runner);
+    run_detect(runner);
+    run_sdo_profile(runner);
+}
+
+void PcanQtBench::run_format(BenchRunner &runner)
+{
+    uchar payload[64];
+    for(int i=0;i<64;i++)
+        payload[i]=uchar(i*37+11);
+
+    for(int len : {8,64}){
+        runner.run(QString("format.uchar_to_qstr.%1").arg(len),[this,&payload,len](qint64 n){
+            int sink=0;
+            for(qint64 i=0;i<n;i++)
+                sink+=window->uchar_to_qstr(payload,len).size();
+            bench_sink=sink;
+        },len);
+
+        const QString hex=window->uchar_to_qstr(payload,len);
+        runner.run(QString("format.qstr_to_uchar.%1").arg(len),[this,&hex,len](qint64 n){
+            uchar out[64]={0};
+            for(qint64 i=0;i<n;i++)
+                window->qstr_to_uchar(hex,out);
+            bench_sink=out[len-1];
+        },len);
+    }
+}
+
+void PcanQtBench::run_parsers(BenchRunner &runner, const QString &stream, const std::vector<canFrame> &frames, int node_id)
+{
+    window->node_id=ushort(node_id);
+    window->fd_mode=false;
+    for(const canFrame &frame : frames)
+        window->fd_mode|=(frame.msg.MSGTYPE&PCAN_MESSAGE_FD)!=0;
+    window->m_frames.clear();
+    window->m_unpacker.reset();
+
+    size_t pos=0;
+    runner.run("parser.data."+stream,[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            window->data_parser(frames[pos]);
+            if(++pos==frames.size())
+                pos=0;
+        }
+    });
+    runner.run("parser.imu."+stream,[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            window->imu_parser(frames[pos]);
+            if(++pos==frames.size())
+                pos=0;
+        }
+    });
+
+    //the rate table holds every ID of the stream
+    if(runner.selected("parser.calc_hz."+stream)){
+        for(const canFrame &frame : frames)
+            window->data_parser(frame);
+    }
+    runner.run("parser.calc_hz."+stream,[&](qint64 n){
+        for(qint64 i=0;i<n;i++)
+            window->calc_hz();
+    });
+}
+
+void PcanQtBench::run_pipeline(BenchRunner &runner, const QString &stream, const std::vector<canFrame> &frames, int node_id)
+{
+    window->node_id=ushort(node_id);
+
+    //one op is one frame: bus -> read loop -> parsers, then one paint per
+    //read tick like the event loop does after the timer slot
+    size_t pos=0;
+    auto pump=[&](qint64 n, bool render){
+        for(qint64 done=0;done<n;){
+            const qint64 batch=qMin<qint64>(PIPELINE_TICK_FRAMES,n-done);
+            for(qint64 i=0;i<batch;i++){
+                generator->write(frames[pos].msg);
+                if(++pos==frames.size())
+                    pos=0;
+            }
+            window->pcan_read();
+            if(render)
+                window->repaint();
+            done+=batch;
+        }
+    };
+    runner.run("pipeline.read."+stream,[&](qint64 n){pump(n,false);});
+    runner.run("pipeline.read_render."+stream,[&](qint64 n){pump(n,true);});
+}
+
+void PcanQtBench::run_fd(BenchRunner &runner)
+{
+    //one op is one frame through the read loop and data_parser(), the
+    //payload is the throughput; the wire rate is what the bus could carry
+    const canBitrates classic_rates=can_bitrates(PCAN_BAUD_1M);
+    const canBitrates fd_rates=can_bitrates_fd(bench_bitrate_fd);
+    const bool fd_mode=window->fd_mode;
+    window->fd_mode=true;
+    double payload_per_s[2]={0,0};
+    for(int len : {8,64}){
+        const QString name=QString("pipeline.read.fd%1").arg(len);
+        std::vector<TPCANMsgFD> msgs(FD_BENCH_IDS);
+        for(int i=0;i<FD_BENCH_IDS;i++){
+            TPCANMsgFD &msg=msgs[size_t(i)];
+            msg.ID=DWORD(FD_BENCH_ID+i);
+            msg.MSGTYPE=len>8?PCAN_MESSAGE_FD|PCAN_MESSAGE_BRS:PCAN_MESSAGE_STANDARD;
+            msg.DLC=can_len_to_dlc(len);
+            for(int b=0;b<len;b++)
+                msg.DATA[b]=uchar(i*7+b);
+        }
+        size_t pos=0;
+        runner.run(name,[&](qint64 n){
+            for(qint64 done=0;done<n;){
+                const qint64 batch=qMin<qint64>(PIPELINE_TICK_FRAMES,n-done);
+                for(qint64 i=0;i<batch;i++){
+                    generator->write(msgs[pos]);
+                    if(++pos==msgs.size())
+                        pos=0;
+                }
+                window->pcan_read();
+                done+=batch;
+            }
+        },len);
+        const double wire_us=can_frame_time_us(msgs[0],len>8?fd_rates:classic_rates);
+        runner.note(name,"wire_frames_per_s",1e6/wire_us);
+        runner.note(name,"wire_payload_kb_per_s",len*1e6/wire_us/1024);
+        if(runner.selected(name)&&!runner.is_list_only())
+            payload_per_s[len>8]=len*1e9/runner.results().last().ns_per_op;
+    }
+    if(payload_per_s[0]>0&&payload_per_s[1]>0)
+        runner.note("pipeline.read.fd64","payload_vs_classic",payload_per_s[1]/payload_per_s[0]);
+    window->fd_mode=fd_mode;
+}
+
+void PcanQtBench::run_packing(BenchRunner &runner)
+{
+    static const struct{const char *name; imuPacking mode;} cases[]={
+        {"imu.unpack.none",IMU_PACK_NONE},
+        {"imu.unpack.fd",IMU_PACK_FD},
+        {"imu.unpack.delta",IMU_PACK_DELTA},
+    };
+    std::mt19937 rng(20211001);
+    std::unique_ptr<qint16[][4]> raw(new qint16[PACK_BENCH_SAMPLES][4]());
+    for(int i=1;i<PACK_BENCH_SAMPLES;i++){
+        for(int a=0;a<3;a++)
+            raw[i][a]=qint16(qBound(-30000,raw[i-1][a]+int(rng()%41)-20,30000));
+    }
+    const canBitrates classic_rates=can_bitrates(PCAN_BAUD_1M);
+    const canBitrates fd_rates=can_bitrates_fd(bench_bitrate_fd);
+    double samples_per_s[3]={0,0,0};
+
+    for(int c=0;c<3;c++){
+        const QString name=cases[c].name;
+        const imuPacking mode=cases[c].mode;
+        if(!runner.selected(name))
+            continue;
+        std::vector<canFrame> frames;
+        DeltaBurstEncoder delta;
+        uchar seq=0;
+        double wire_us=0;
+        for(int pos=0;pos<PACK_BENCH_SAMPLES;){
+            canFrame frame;
+            TPCANMsgFD &msg=frame.msg;
+            msg.ID=DWORD(0x180+PACK_BENCH_NODE);
+            int used=1;
+            if(mode==IMU_PACK_FD)
+                used=ImuPacker::pack_fd(IMU_SIG_ACC,raw.get()+pos,PACK_BENCH_SAMPLES-pos,seq++,msg);
+            else if(mode==IMU_PACK_DELTA)
+                used=delta.encode(raw.get()+pos,PACK_BENCH_SAMPLES-pos,msg);
+            else{
+                msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+                msg.DLC=6;
+                for(int a=0;a<3;a++){
+                    msg.DATA[2*a]=uchar(uint16_t(raw[pos][a])&0xFF);
+                    msg.DATA[2*a+1]=uchar(uint16_t(raw[pos][a])>>8);
+                }
+            }
+            pos+=used;
+            //10 ms per sample, the frame leaves with its last one
+            frame.ts_us=TPCANTimestampFD(pos)*10000;
+            frame.host_us=qint64(frame.ts_us);
+            wire_us+=can_frame_time_us(msg,mode==IMU_PACK_FD?fd_rates:classic_rates);
+            frames.push_back(frame);
+        }
+
+        //every sample comes back as it went in
+        ImuUnpacker unpacker;
+        unpacker.set_packing(mode);
+        imuSample samples[IMU_FD_MAX_SAMPLES];
+        int decoded=0;
+        bool same=true;
+        for(const canFrame &frame : frames){
+            const int n=unpacker.decode(frame,PACK_BENCH_NODE,samples,IMU_FD_MAX_SAMPLES);
+            for(int i=0;i<n&&decoded<PACK_BENCH_SAMPLES;i++,decoded++){
+                for(int a=0;a<3;a++)
+                    same=same&&samples[i].raw[a]==raw[decoded][a];
+            }
+        }
+
+        //one op is one frame
+        const size_t count=frames.size();
+        runner.run(name,[&](qint64 n){
+            int sink=0;
+            for(qint64 i=0;i<n;i++)
+                sink+=unpacker.decode(frames[size_t(i)%count],PACK_BENCH_NODE,samples,IMU_FD_MAX_SAMPLES);
+            bench_sink=sink;
+        });
+        const double per_frame=double(PACK_BENCH_SAMPLES)/count;
+        runner.note(name,"samples_per_frame",per_frame);
+        runner.note(name,"wire_samples_per_s",PACK_BENCH_SAMPLES*1e6/wire_us);
+        if(runner.is_list_only())
+            continue;
+        runner.check(name,decoded==PACK_BENCH_SAMPLES&&same,
+                     QString("%1 of %2 samples decoded, values %3").arg(decoded).arg(PACK_BENCH_SAMPLES).arg(same?"equal":"differ"));
+        samples_per_s[c]=per_frame*1e9/runner.results().last().ns_per_op;
+    }
+    for(int c=1;c<3;c++){
+        if(samples_per_s[0]>0&&samples_per_s[c]>0)
+            runner.note(cases[c].name,"samples_vs_unpacked",samples_per_s[c]/samples_per_s[0]);
+    }
+
+    //a one-sample FD frame is 7 bytes long, below the classic DLC limit
+    if(runner.selected("imu.unpack.fd")&&!runner.is_list_only()){
+        canFrame frame;
+        frame.msg.ID=DWORD(0x180+PACK_BENCH_NODE);
+        ImuPacker::pack_fd(IMU_SIG_ACC,raw.get()+1,1,0,frame.msg);
+        ImuUnpacker unpacker;
+        unpacker.set_packing(IMU_PACK_FD);
+        imuSample samples[IMU_FD_MAX_SAMPLES];
+        const int n=unpacker.decode(frame,PACK_BENCH_NODE,samples,IMU_FD_MAX_SAMPLES);
+        runner.check("imu.unpack.fd",n==1&&samples[0].raw[0]==raw[1][0]&&samples[0].raw[2]==raw[1][2],
+                     QString("one-sample FD frame (DLC %1) decoded as %2 samples").arg(frame.msg.DLC).arg(n));
+    }
+}
+
+void PcanQtBench::run_capture(BenchRunner &runner, const QString &stream, const std::vector<canFrame> &frames)
+{
+    const QString enc_name="capture.encode."+stream;
+    const QString dec_name="capture.decode."+stream;
+    if(!runner.selected(enc_name)&&!runner.selected(dec_name))
+        return;
+
+    //blocks as the capture writer stores them
+    const size_t block=qMin<size_t>(frames.size(),CAPTURE_BLOCK_FRAMES);
+    double raw_bytes=0;
+    for(const canFrame &frame : frames)
+        raw_bytes+=capture_raw_size(frame);
+    std::vector<QByteArray> stored;
+    double stored_bytes=0;
+    for(size_t off=0;off<frames.size();off+=block){
+        QByteArray encoded;
+        capture_encode(&frames[off],int(qMin(block,frames.size()-off)),encoded);
+        stored.push_back(qCompress(encoded,1));
+        stored_bytes+=stored.back().size();
+    }
+    const double raw_per_frame=raw_bytes/double(frames.size());
+
+    size_t pos=0;
+    runner.run(enc_name,[&](qint64 n){
+        QByteArray encoded;
+        for(qint64 done=0;done<n;){
+            const size_t count=qMin(qMin(block,frames.size()-pos),size_t(n-done));
+            capture_encode(&frames[pos],int(count),encoded);
+            bench_sink=qCompress(encoded,1).size();
+            pos+=count;
+            if(pos>=frames.size())
+                pos=0;
+            done+=qint64(count);
+        }
+    },raw_per_frame);
+    runner.note(enc_name,"ratio",raw_bytes/qMax(stored_bytes,1.0));
+
+    size_t blk=0;
+    runner.run(dec_name,[&](qint64 n){
+        std::vector<canFrame> decoded;
+        for(qint64 done=0;done<n;){
+            decoded.clear();
+            capture_decode(qUncompress(stored[blk]),decoded);
+            if(++blk==stored.size())
+                blk=0;
+            done+=qint64(decoded.size())+(decoded.empty()?1:0);
+        }
+    },raw_per_frame);
+    if(runner.is_list_only()||!runner.selected(dec_name))
+        return;
+
+    //every stored block decodes to its frames; blocks come back in
+    //timestamp order, frames of one timestamp are compared by ID
+    auto by_time=[](const canFrame &a, const canFrame &b){
+        if(a.ts_us!=b.ts_us)
+            return a.ts_us<b.ts_us;
+        if(a.msg.ID!=b.msg.ID)
+            return a.msg.ID<b.msg.ID;
+        return a.msg.MSGTYPE<b.msg.MSGTYPE;
+    };
+    size_t mismatches=0;
+    QString first_mismatch;
+    std::vector<canFrame> decoded;
+    std::vector<canFrame> expected;
+    for(size_t b=0;b<stored.size();b++){
+        const size_t off=b*block;
+        expected.assign(frames.begin()+off,frames.begin()+qMin(off+block,frames.size()));
+        std::stable_sort(expected.begin(),expected.end(),by_time);
+        decoded.clear();
+        const bool ok=capture_decode(qUncompress(stored[b]),decoded);
+        std::stable_sort(decoded.begin(),decoded.end(),by_time);
+        if(!ok||decoded.size()!=expected.size()){
+            if(!mismatches++)
+                first_mismatch=QString("block %1: %2 of %3 frames").arg(b).arg(decoded.size()).arg(expected.size());
+            continue;
+        }
+        for(size_t i=0;i<expected.size();i++){
+            const canFrame &e=expected[i];
+            const canFrame &d=decoded[i];
+            if(d.msg.ID==e.msg.ID&&d.msg.MSGTYPE==e.msg.MSGTYPE&&d.msg.DLC==e.msg.DLC&&d.ts_us==e.ts_us
+                    &&d.host_us==e.host_us&&!memcmp(d.msg.DATA,e.msg.DATA,size_t(can_dlc_to_len(e.msg.DLC))))
+                continue;
+            if(!mismatches++)
+                first_mismatch=QString("block %1 frame %2: ID 0x%3 at %4 us").arg(b).arg(i).arg(e.msg.ID,0,16).arg(e.ts_us);
+        }
+    }
+    runner.check(dec_name,!mismatches,QString("%1 frames differ after the round trip, first %2").arg(mismatches).arg(first_mismatch));
+}
+
+void PcanQtBench::run_busoff(BenchRunner &runner)
+{
+    const QString name="bus.recovery";
+    if(!runner.selected(name))
+        return;
+
+    VirtualCanBus busoff_bus;
+    VirtualTransport can(&busoff_bus);
+    VirtualTransport peer(&busoff_bus);
+    can.initialize(PCAN_USBBUS1,PCAN_BAUD_1M);
+    peer.initialize(PCAN_USBBUS2,PCAN_BAUD_1M);
+    //no hardware recovery, every reset is the software's
+    can.set_busoff_recovery_us(quint64(BUSOFF_BENCH_TIMEOUT_MS)*10000);
+    TxScheduler tx(&can);
+    tx.start();
+    TPCANMsgFD periodic={};
+    periodic.ID=BUSOFF_BENCH_ID;
+    periodic.MSGTYPE=PCAN_MESSAGE_STANDARD;
+    periodic.DLC=1;
+    tx.add_periodic(periodic,BUSOFF_BENCH_PERIOD_US);
+    BusHealth health(&can,&tx);
+    health.start();
+
+    //one op is one bus-off: the bus-off comes back after each of the resets,
+    //so only the re-initialization, with the TX thread writing, clears it;
+    //the op ends with the first periodic frame on the bus again
+    int failed=0;
+    QString failure;
+    runner.run(name,[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            can.inject_bus_status(PCAN_ERROR_BUSOFF);
+            int resets=0;
+            bool resumed=false;
+            const qint64 deadline=host_monotonic_us()+BUSOFF_BENCH_TIMEOUT_MS*1000LL;
+            while(!resumed&&host_monotonic_us()<deadline){
+                health.poll();
+                if(health.state()==BUS_STATE_RECOVERING&&can.status()==PCAN_ERROR_OK&&resets<BUSOFF_RESET_ATTEMPTS){
+                    can.inject_bus_status(PCAN_ERROR_BUSOFF);
+                    resets++;
+                }
+                canFrame frame;
+                while(peer.read(frame)==PCAN_ERROR_OK){
+                    if(health.state()==BUS_STATE_ACTIVE&&frame.msg.ID==BUSOFF_BENCH_ID)
+                        resumed=true;
+                }
+                QThread::usleep(200);
+            }
+            if(!resumed||resets<BUSOFF_RESET_ATTEMPTS||tx.is_paused()){
+                failed++;
+                failure=QString("state %1, %2 resets, TX %3")
+                        .arg(BusHealth::state_name(health.state())).arg(resets)
+                        .arg(resumed?"resumed":"silent");
+            }
+        }
+    });
+    tx.shutdown();
+    health.stop();
+    if(runner.is_list_only())
+        return;
+
+    const busHealthStats &st=health.stats();
+    runner.note(name,"recovery_ms",st.last_recovery_ms);
+    runner.note(name,"recoveries",double(st.recoveries));
+    runner.check(name,!failed&&st.recoveries==st.busoff_count&&can.status()==PCAN_ERROR_OK,
+                 QString("%1 of %2 bus-offs not recovered: %3").arg(failed).arg(st.busoff_count).arg(failure));
+}
+
+void PcanQtBench::run_tx(BenchRunner &runner)
+{
+    if(!runner.selected("tx.queue")&&!runner.selected("tx.periodic"))
+        return;
+
+    VirtualCanBus tx_bus;
+    VirtualTransport can(&tx_bus);
+    VirtualTransport peer(&tx_bus);
+    can.initialize(PCAN_USBBUS1,PCAN_BAUD_1M);
+    peer.initialize(PCAN_USBBUS2,PCAN_BAUD_1M);
+    TxScheduler tx(&can);
+    tx.set_queue_limit(TX_BENCH_QUEUE);
+    tx.start(QThread::TimeCriticalPriority);
+
+    //one op is one frame from the queue to the other end of the bus
+    TPCANMsgFD msg={};
+    msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+    msg.DLC=8;
+    canFrame frame;
+    runner.run("tx.queue",[&](qint64 n){
+        qint64 queued=0;
+        qint64 received=0;
+        while(received<n){
+            while(queued<n&&queued-received<TX_BENCH_QUEUE){
+                msg.ID=DWORD(0x500+queued%16);
+                msg.DATA[0]=uchar(queued);
+                if(!tx.enqueue(msg,TX_PRIO_USER))
+                    break;
+                queued++;
+            }
+            while(peer.read(frame)==PCAN_ERROR_OK)
+                received++;
+        }
+    },8);
+
+    //one op is one period of the periodic frames; a periodic frame is added
+    //and removed all along, the list changes under the TX thread
+    int handles[TX_BENCH_PERIODIC];
+    for(int i=0;i<TX_BENCH_PERIODIC;i++){
+        msg.ID=DWORD(TX_BENCH_ID+i);
+        handles[i]=tx.add_periodic(msg,TX_BENCH_PERIOD_US);
+    }
+    TPCANMsgFD churn=msg;
+    churn.ID=TX_BENCH_ID+TX_BENCH_PERIODIC;
+    double rx_jitter_max_us=0;
+    runner.run("tx.periodic",[&](qint64 n){
+        qint64 received=0;
+        TPCANTimestampFD last_us=0;
+        while(received<n){
+            const int extra=tx.add_periodic(churn,TX_BENCH_PERIOD_US);
+            while(peer.read(frame)==PCAN_ERROR_OK){
+                if(frame.msg.ID!=TX_BENCH_ID)
+                    continue;
+                if(last_us)
+                    rx_jitter_max_us=qMax(rx_jitter_max_us,std::fabs(double(frame.ts_us-last_us)-TX_BENCH_PERIOD_US));
+                last_us=frame.ts_us;
+                received++;
+            }
+            tx.remove_periodic(extra);
+            QThread::usleep(100);
+        }
+    });
+    for(int handle : handles)
+        tx.remove_periodic(handle);
+    const txStats st=tx.stats();
+    tx.shutdown();
+    if(runner.is_list_only())
+        return;
+
+    runner.note("tx.queue","dropped",double(st.dropped));
+    runner.check("tx.queue",st.errors==0,QString("%1 writes failed").arg(st.errors));
+    runner.note("tx.periodic","frames",TX_BENCH_PERIODIC);
+    runner.note("tx.periodic","jitter_avg_us",st.jitter_avg_us);
+    runner.note("tx.periodic","jitter_max_us",st.jitter_max_us);
+    runner.note("tx.periodic","rx_jitter_max_us",rx_jitter_max_us);
+}
+
+void PcanQtBench::run_sdo(BenchRunner &runner)
+{
+    struct sdoCase{
+        const char *name;
+        bool upload;
+        sdoMode mode;
+        int size;
+    };
+    const sdoCase cases[]={
+        {"sdo.upload.block.64k",true,SDO_MODE_BLOCK,SDO_BENCH_SIZE},
+        {"sdo.upload.segmented.64k",true,SDO_MODE_SEGMENTED,SDO_BENCH_SIZE},
+        {"sdo.download.block.64k",false,SDO_MODE_BLOCK,SDO_BENCH_SIZE},
+        {"sdo.download.segmented.64k",false,SDO_MODE_SEGMENTED,SDO_BENCH_SIZE},
+        {"sdo.upload.block.512k",true,SDO_MODE_BLOCK,SDO_BENCH_SIZE_LARGE},
+        {"sdo.upload.segmented.512k",true,SDO_MODE_SEGMENTED,SDO_BENCH_SIZE_LARGE},
+        {"sdo.download.block.512k",false,SDO_MODE_BLOCK,SDO_BENCH_SIZE_LARGE},
+        {"sdo.download.segmented.512k",false,SDO_MODE_SEGMENTED,SDO_BENCH_SIZE_LARGE},
+    };
+    bool any=false;
+    for(const sdoCase &c : cases)
+        any|=runner.selected(c.name);
+    if(!any)
+        return;
+
+    //client engine and SdoServer on a bus of their own, the server is
+    //served from this thread
+    VirtualCanBus sdo_bus;
+    VirtualTransport client(&sdo_bus);
+    VirtualTransport server(&sdo_bus);
+    client.initialize(PCAN_USBBUS1,PCAN_BAUD_1M);
+    server.initialize(PCAN_USBBUS2,PCAN_BAUD_1M);
+    TxScheduler tx(&client);
+    SdoTransfer xfer(&tx);
+    SdoServer node(SDO_BENCH_NODE);
+
+    std::mt19937 rng(1);
+    QByteArray object(SDO_BENCH_SIZE_LARGE,0);
+    for(int i=0;i<object.size();i++)
+        object[i]=char(rng());
+    QByteArray data;
+
+    std::atomic<bool> done(false);
+    std::atomic<int> failures(0);
+    QByteArray uploaded;
+    QObject::connect(&xfer, &SdoTransfer::finished, &xfer, [&](const sdoTransferResult &result){
+        if(result.abort_code)
+            failures++;
+        uploaded=result.data;
+        done=true;
+    }, Qt::DirectConnection);
+    tx.start(QThread::TimeCriticalPriority);
+    xfer.start();
+
+    //the bytes that arrived, on the client after an upload and in the
+    //server object after a download
+    int mismatches=0;
+    auto transfer=[&](const sdoCase &c){
+        done=false;
+        if(c.upload){
+            xfer.upload(SDO_BENCH_NODE,0x2200,0,c.mode);
+        }
+        else{
+            node.set_object(0x2201,0,QByteArray());
+            xfer.download(SDO_BENCH_NODE,0x2201,0,data,c.mode);
+        }
+
+        canFrame frame;
+        std::vector<TPCANMsgFD> out;
+        while(!done){
+            bool idle=true;
+            while(server.read(frame)==PCAN_ERROR_OK){
+                idle=false;
+                out.clear();
+                node.process(frame.msg,out);
+                for(const TPCANMsgFD &msg : out)
+                    server.write(msg);
+            }
+            while(client.read(frame)==PCAN_ERROR_OK){
+                idle=false;
+                xfer.post_frame(frame);
+            }
+            if(idle)
+                QThread::yieldCurrentThread();
+        }
+        if((c.upload?uploaded:node.object(0x2201,0))!=data)
+            mismatches++;
+    };
+
+    for(const sdoCase &c : cases){
+        if(!runner.selected(c.name))
+            continue;
+        data=object.left(c.size);
+        node.set_object(0x2200,0,data);
+        failures=0;
+        mismatches=0;
+        runner.run(c.name,[&](qint64 n){
+            for(qint64 i=0;i<n;i++)
+                transfer(c);
+        },c.size);
+        runner.note(c.name,"failures",failures);
+        if(!runner.is_list_only())
+            runner.check(c.name,!failures&&!mismatches,QString("%1 transfers aborted, %2 with other bytes than the object").arg(failures).arg(mismatches));
+    }
+
+    xfer.shutdown();
+    tx.shutdown();
+}
+
+//the stream written as PCAN-View 2.1, candump -l and Vector ASC text
+static QByteArray bench_trace_text(traceFormat format, const std::vector<canFrame> &frames, quint64 &written)
+{
+    QByteArray text;
+    char line[256];
+    if(format==TRACE_PCAN_TRC)
+        text.append(";$FILEVERSION=2.1\n;$STARTTIME=44470.5\n;$COLUMNS=N,O,T,B,I,d,R,L,D\n");
+    else if(format==TRACE_VECTOR_ASC)
+        text.append("date Fri Oct 1 12:00:00.000 pm 2021\nbase hex  timestamps absolute\nBegin Triggerblock\n");
+
+    quint64 n=0;
+    quint64 base_us=0;
+    written=0;
+    while(text.size()<IMPORT_BENCH_SIZE){
+        for(const canFrame &frame : frames){
+            const quint64 ts=base_us+frame.ts_us;
+            const int len=can_dlc_to_len(frame.msg.DLC);
+            int pos=0;
+            if(format==TRACE_PCAN_TRC)
+                pos=snprintf(line,sizeof(line),"%7llu %13.3f DT 1      %04X Rx - %2d ",
+                             (unsigned long long)++n,ts/1000.0,uint(frame.msg.ID),len);
+            else if(format==TRACE_CANDUMP)
+                pos=snprintf(line,sizeof(line),"(%llu.%06llu) can0 %03X#",
+                             (unsigned long long)(1633089600+ts/1000000),(unsigned long long)(ts%1000000),uint(frame.msg.ID));
+            else
+                pos=snprintf(line,sizeof(line),"%11.6f 1  %-15X Rx   d %d ",ts/1e6,uint(frame.msg.ID),len);
+            for(int i=0;i<len;i++)
+                pos+=snprintf(line+pos,sizeof(line)-size_t(pos),format==TRACE_CANDUMP?"%02X":" %02X",frame.msg.DATA[i]);
+            line[pos++]='\n';
+            text.append(line,pos);
+            written++;
+        }
+        base_us+=frames.back().ts_us+1000;
+    }
+    return text;
+}
+
+void PcanQtBench::run_import(BenchRunner &runner)
+{
+    const struct{const char *name; traceFormat format;} cases[]={
+        {"import.trc",TRACE_PCAN_TRC},
+        {"import.candump",TRACE_CANDUMP},
+        {"import.asc",TRACE_VECTOR_ASC},
+    };
+    for(const auto &c : cases){
+        if(!runner.selected(c.name))
+            continue;
+        quint64 written;
+        const QByteArray text=bench_trace_text(c.format,synthetic,written);
+        std::vector<canFrame> frames;
+        traceImportStats stats;
+        QString error;
+        //one op is one whole import of the text
+        runner.run(c.name,[&](qint64 n){
+            for(qint64 i=0;i<n;i++)
+                TraceImporter::parse(text.constData(),text.size(),frames,stats,error);
+        },text.size());
+        runner.note(c.name,"frames",double(stats.frames));
+        runner.note(c.name,"threads",stats.threads);
+        if(!runner.is_list_only())
+            runner.check(c.name,stats.frames==written&&frames.size()==written,
+                         QString("%1 of %2 frames imported").arg(frames.size()).arg(written));
+    }
+}
+
+//a DBC of DBC_BENCH_MESSAGES messages per layout: byte aligned words,
+//bit packed intel/motorola fields and a multiplexed page message
+static QByteArray bench_dbc_text()
+{
+    QByteArray text="VERSION \"\"\n\nBU_: ECU BENCH\n\n";
+    for(int m=0;m<DBC_BENCH_MESSAGES;m++){
+        const int id=0x100+m;
+        text.append(QString("BO_ %1 Aligned%2: 8 ECU\n").arg(id).arg(m).toLatin1());
+        for(int i=0;i<4;i++)
+            text.append(QString(" SG_ Word%1_%2 : %3|16@1- (0.01,0) [-327.68|327.67] \"\" BENCH\n").arg(m).arg(i).arg(16*i).toLatin1());
+
+        text.append(QString("BO_ %1 Packed%2: 8 ECU\n").arg(id+0x200).arg(m).toLatin1());
+        //12 bit intel in bytes 0-1, 12 bit motorola from the MSB of byte 2,
+        //then 5 bit fields and flags
+        text.append(QString(" SG_ Lo%1 : 0|12@1+ (0.25,-100) [0|0] \"\" BENCH\n").arg(m).toLatin1());
+        text.append(QString(" SG_ Hi%1 : 23|12@0- (0.1,0) [0|0] \"\" BENCH\n").arg(m).toLatin1());
+        for(int i=0;i<5;i++)
+            text.append(QString(" SG_ Field%1_%2 : %3|5@1+ (1,0) [0|31] \"\" BENCH\n").arg(m).arg(i).arg(32+5*i).toLatin1());
+        for(int i=0;i<7;i++)
+            text.append(QString(" SG_ Flag%1_%2 : %3|1@1+ (1,0) [0|1] \"\" BENCH\n").arg(m).arg(i).arg(57+i).toLatin1());
+
+        text.append(QString("BO_ %1 Paged%2: 8 ECU\n").arg(0x80000000u|quint32(0x18FF0000+m)).arg(m).toLatin1());
+        text.append(QString(" SG_ Page%1 M : 0|8@1+ (1,0) [0|3] \"\" BENCH\n").arg(m).toLatin1());
+        for(int page=0;page<4;page++){
+            for(int i=0;i<3;i++)
+                text.append(QString(" SG_ P%1_%2_%3 m%2 : %4|16@1+ (0.5,0) [0|0] \"\" BENCH\n").arg(m).arg(page).arg(i).arg(8+16*i).toLatin1());
+        }
+    }
+    return text;
+}
+
+void PcanQtBench::run_dbc(BenchRunner &runner)
+{
+    const char *layouts[]={"aligned","packed","mux"};
+    bool any=runner.selected("dbc.compile");
+    for(const char *layout : layouts)
+        any|=runner.selected(QString("dbc.decode.%1").arg(layout))||runner.selected(QString("dbc.bitwise.%1").arg(layout));
+    if(!any)
+        return;
+
+    const QByteArray text=bench_dbc_text();
+    DbcDecoder dbc;
+    dbc.parse(text);
+    runner.run("dbc.compile",[&](qint64 n){
+        for(qint64 i=0;i<n;i++)
+            dbc.parse(text);
+    },text.size());
+    runner.note("dbc.compile","signals",dbc.signal_count());
+
+    std::vector<double> values(size_t(dbc.signal_count()));
+    std::mt19937 rng(1);
+    for(int l=0;l<3;l++){
+        //one frame of every message of the layout, random payloads
+        std::vector<canFrame> frames(DBC_BENCH_MESSAGES);
+        std::vector<int> frame_message(DBC_BENCH_MESSAGES);
+        double n_signals=0;
+        for(int m=0;m<DBC_BENCH_MESSAGES;m++){
+            canFrame &frame=frames[size_t(m)];
+            if(l==2){
+                frame.msg.ID=quint32(0x18FF0000+m);
+                frame.msg.MSGTYPE=PCAN_MESSAGE_EXTENDED;
+            }
+            else{
+                frame.msg.ID=quint32(0x100+m+(l==1?0x200:0));
+                frame.msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+            }
+            frame.msg.DLC=8;
+            for(int i=0;i<8;i++)
+                frame.msg.DATA[i]=uchar(rng());
+            frame.msg.DATA[0]&=l==2?3:0xFF;
+            n_signals+=dbc.decode(frame,values.data(),&frame_message[size_t(m)]);
+        }
+        const double signals_per_frame=n_signals/DBC_BENCH_MESSAGES;
+        const QString name=QString("dbc.decode.%1").arg(layouts[l]);
+
+        //the plans against the bit by bit reference: every signal present in
+        //the frame decoded to the same value, the others left alone
+        if(runner.selected(name)&&!runner.is_list_only()){
+            int mismatches=0;
+            QString first_mismatch;
+            for(int m=0;m<DBC_BENCH_MESSAGES;m++){
+                const canFrame &frame=frames[size_t(m)];
+                const dbcMessage &msg=dbc.message(frame_message[size_t(m)]);
+                std::fill(values.begin(),values.end(),qQNaN());
+                const int n=dbc.decode(frame,values.data());
+                int mux=-1;
+                for(int s=msg.first_signal;s<msg.first_signal+msg.n_signals;s++){
+                    if(dbc.signal(s).mux==DBC_MUX_SWITCH)
+                        mux=int(dbc.decode_signal(s,frame.msg.DATA,8));
+                }
+                int present=0;
+                for(int s=msg.first_signal;s<msg.first_signal+msg.n_signals;s++){
+                    const dbcSignal &sig=dbc.signal(s);
+                    const bool in_frame=sig.mux!=DBC_MUX_VALUE||sig.mux_value==mux;
+                    const double ref=dbc.decode_signal(s,frame.msg.DATA,8);
+                    present+=in_frame;
+                    if(in_frame?values[size_t(s)]==ref:std::isnan(values[size_t(s)]))
+                        continue;
+                    if(!mismatches++){
+                        first_mismatch=in_frame?QString("%1 = %2, bitwise %3").arg(sig.name).arg(values[size_t(s)]).arg(ref)
+                                               :QString("%1 = %2, not in the frame").arg(sig.name).arg(values[size_t(s)]);
+                    }
+                }
+                if(n!=present&&!mismatches++)
+                    first_mismatch=QString("%1: %2 signals decoded, %3 present").arg(msg.name).arg(n).arg(present);
+            }
+            runner.check(name,!mismatches,QString("%1 signals differ from the bitwise decode, first %2").arg(mismatches).arg(first_mismatch));
+        }
+
+        //one op is one frame through the dispatch table and its plan
+        runner.run(name,[&](qint64 n){
+            int sink=0;
+            for(qint64 i=0;i<n;i++)
+                sink+=dbc.decode(frames[size_t(i%DBC_BENCH_MESSAGES)],values.data());
+            bench_sink=sink;
+        },8);
+        runner.note(name,"signals_per_frame",signals_per_frame);
+        for(const benchResult &r : runner.results()){
+            if(r.name==name&&r.ns_per_op>0)
+                runner.note(name,"signals_per_s",signals_per_frame*1e9/r.ns_per_op);
+        }
+
+        //the same signals extracted bit by bit, what the plans save
+        const QString ref=QString("dbc.bitwise.%1").arg(layouts[l]);
+        runner.run(ref,[&](qint64 n){
+            for(qint64 i=0;i<n;i++){
+                const size_t f=size_t(i%DBC_BENCH_MESSAGES);
+                const canFrame &frame=frames[f];
+                const dbcMessage &msg=dbc.message(frame_message[f]);
+                for(int s=msg.first_signal;s<msg.first_signal+msg.n_signals;s++)
+                    values[size_t(s)]=dbc.decode_signal(s,frame.msg.DATA,8);
+            }
+        },8);
+    }
+}
+
+void PcanQtBench::run_trigger(BenchRunner &runner)
+{
+    if(!runner.selected("trigger.evaluate")&&!runner.selected("trigger.process"))
+        return;
+
+    //typical rules, thresholds out of reach so nothing is dumped
+    triggerConfig config;
+    QString error;
+    trigger_parse("pre 5\npost 2\n|acc| > 30\ngyr.z < -2000\nid 0x7E5\nid 0x080/0x7FF b0=0x10/0xF0\nbus_error\n",config,error);
+
+    //the decoded state the window would have after each frame
+    std::vector<imuData> states(synthetic.size());
+    ImuUnpacker unpacker;
+    imuData imu;
+    for(size_t i=0;i<synthetic.size();i++){
+        imuSample samples[IMU_FD_MAX_SAMPLES];
+        const int n=unpacker.decode(synthetic[i],8,samples,IMU_FD_MAX_SAMPLES);
+        if(n>0){
+            float *dst[IMU_SIG_COUNT]={imu.acc,imu.gyr,imu.eul,imu.quat};
+            for(int a=0;a<imu_signal_axes(samples[n-1].signal);a++)
+                dst[samples[n-1].signal][a]=samples[n-1].v[a];
+        }
+        states[i]=imu;
+    }
+
+    TriggerCapture trigger;
+    trigger.arm(config,QDir::tempPath());
+    const size_t count=synthetic.size();
+
+    //one op is one frame
+    runner.run("trigger.evaluate",[&](qint64 n){
+        int sink=0;
+        for(qint64 i=0;i<n;i++)
+            sink+=trigger.evaluate(synthetic[size_t(i)%count],states[size_t(i)%count]);
+        bench_sink=sink;
+    });
+    runner.note("trigger.evaluate","rules",config.rules.size());
+
+    //ring push and rules, as the read loop calls it
+    runner.run("trigger.process",[&](qint64 n){
+        qint64 host_us=0;
+        for(qint64 i=0;i<n;i++){
+            canFrame frame=synthetic[size_t(i)%count];
+            frame.host_us=host_us+=125;
+            trigger.process(frame,states[size_t(i)%count]);
+        }
+    });
+    const triggerStats st=trigger.stats();
+    runner.note("trigger.process","ring_frames",double(st.ring_frames));
+    runner.note("trigger.process","sampled_eval_ns",st.eval_ns_per_frame());
+    trigger.disarm();
+}
+
+void PcanQtBench::run_alarms(BenchRunner &runner)
+{
+    if(!runner.selected("alarm.compile")&&!runner.selected("alarm.evaluate"))
+        return;
+
+    //a mix of plain thresholds, debounced expressions and norms
+    const char *kinds[]={
+        "|acc| > %1",
+        "abs(roll) > %1 hyst 1 on 100",
+        "gyr.z*2 - gyr.x < -%1",
+        "max(abs(pitch),abs(yaw)) > %1 hyst 2 off 200",
+        "quat.w < 0.%1 hyst 0.01"
+    };
+    QString text;
+    for(int r=0;r<ALARM_BENCH_RULES;r++)
+        text.append(QString("r%1: %2\n").arg(r).arg(QString(kinds[r%5]).arg(r%40+5)));
+    const QByteArray utf8=text.toUtf8();
+
+    alarmProgram program;
+    QString error;
+    runner.run("alarm.compile",[&](qint64 n){
+        for(qint64 i=0;i<n;i++)
+            alarm_parse(text,program,error);
+    },utf8.size());
+    runner.note("alarm.compile","rules",program.rules.size());
+    runner.note("alarm.compile","ops",double(program.ops.size()));
+
+    //one second of samples, nodes interleaved as they arrive on the bus
+    const int count=ALARM_BENCH_NODES*IMU_SIG_COUNT*ALARM_BENCH_HZ;
+    std::vector<imuSample> samples(size_t(count));
+    for(int i=0;i<count;i++){
+        imuSample &s=samples[size_t(i)];
+        const float t=float(i/(ALARM_BENCH_NODES*IMU_SIG_COUNT))/ALARM_BENCH_HZ;
+        s.node=uchar(1+(i/IMU_SIG_COUNT)%ALARM_BENCH_NODES);
+        s.signal=uchar(i%IMU_SIG_COUNT);
+        s.host_us=qint64(i)*1000000/count;
+        s.v[0]=10*std::sin(6.0f*t+s.node);
+        s.v[1]=50*std::cos(2.0f*t);
+        s.v[2]=60*std::sin(3.0f*t);
+        s.v[3]=std::cos(t);
+    }
+
+    AlarmEngine engine;
+    engine.load(program);
+    //one op is one sample, repeats of the second go on in time
+    runner.run("alarm.evaluate",[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            imuSample s=samples[size_t(i%count)];
+            s.host_us+=(i/count)*1000000;
+            engine.process(s);
+            engine.events().clear();
+        }
+    });
+    const alarmStats st=engine.stats();
+    runner.note("alarm.evaluate","rules",program.rules.size());
+    runner.note("alarm.evaluate","evals_per_sample",st.samples?double(st.evaluations)/st.samples:0);
+    for(const benchResult &r : runner.results()){
+        if(r.name=="alarm.evaluate"&&r.ns_per_op>0)
+            runner.note("alarm.evaluate","core_pct_16x200hz",r.ns_per_op*count/1e7);
+    }
+}
+
+void PcanQtBench::run_bounded(BenchRunner &runner)
+{
+    const QString name="bounded.read";
+    if(!runner.selected(name))
+        return;
+
+    //bounded memory mode with every consumer of the read loop on: capture,
+    //trigger ring (a rule that never fires) and alarm rules
+    window->node_id=8;
+    window->m_frames.clear();
+    window->apply_memory_budget(qint64(BOUNDED_BENCH_MB)<<20);
+    QTemporaryDir dir;
+    triggerConfig trigger;
+    QString error;
+    trigger_parse("memory 1\nid 0x7FF\n",trigger,error);
+    window->m_capture->open(dir.filePath("bounded.pqc"));
+    window->m_trigger->arm(trigger,dir.path());
+    window->m_alarms->set_rules(window->alarm_rules);
+    window->m_alarms->start_engine();
+
+    //one op is one frame through the read loop; only allocations made
+    //inside pcan_read() count, the virtual bus queue is the test's own
+    size_t pos=0;
+    auto pump=[&](qint64 n){
+        quint64 allocs=0;
+        for(qint64 done=0;done<n;){
+            const qint64 batch=qMin<qint64>(PIPELINE_TICK_FRAMES,n-done);
+            for(qint64 i=0;i<batch;i++){
+                generator->write(synthetic[pos].msg);
+                if(++pos==synthetic.size())
+                    pos=0;
+            }
+            const quint64 before=alloc_count();
+            window->pcan_read();
+            allocs+=alloc_count()-before;
+            done+=batch;
+        }
+        return allocs;
+    };
+    //the calibration runs are the warm-up
+    runner.run(name,[&](qint64 n){pump(n);});
+
+    if(!runner.is_list_only()){
+        const quint64 allocs=pump(BOUNDED_BENCH_FRAMES);
+        qint64 used=0;
+        for(const memoryUsage &u : window->memory_usage())
+            used+=u.used;
+        runner.note(name,"allocs_per_frame",double(allocs)/BOUNDED_BENCH_FRAMES);
+        runner.note(name,"memory_mb",used/1048576.0);
+        runner.note(name,"capture_dropped",double(window->m_capture->stats().dropped));
+        if(alloc_count_supported())
+            runner.check(name,allocs==0,QString("%1 heap allocations in %2 frames after the warm-up")
+                         .arg(allocs).arg(BOUNDED_BENCH_FRAMES));
+    }
+
+    window->m_alarms->stop_engine();
+    window->m_trigger->disarm();
+    window->m_capture->close();
+    window->apply_memory_budget(0);
+}
+
+void PcanQtBench::run_nmt(BenchRunner &runner)
+{
+    const QString name="nmt.process";
+    if(!runner.selected(name))
+        return;
+
+    //127 nodes, heartbeats spread over the period, merged into the TPDOs
+    std::vector<canFrame> frames;
+    const quint64 duration_us=quint64(NMT_BENCH_SECONDS)*1000000;
+    for(const canFrame &frame : synthetic){
+        if(frame.ts_us<duration_us&&(frame.msg.ID&~0x7Fu)!=CO_HEARTBEAT)
+            frames.push_back(frame);
+    }
+    for(int node=1;node<128;node++){
+        for(quint64 t=quint64(node)*(NMT_BENCH_PERIOD_US/128);t<duration_us;t+=NMT_BENCH_PERIOD_US){
+            canFrame heartbeat;
+            heartbeat.msg.ID=DWORD(CO_HEARTBEAT+node);
+            heartbeat.msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+            heartbeat.msg.DLC=1;
+            heartbeat.msg.DATA[0]=NMT_STATE_OPERATIONAL;
+            heartbeat.ts_us=t;
+            heartbeat.host_us=qint64(t)+1500;
+            frames.push_back(heartbeat);
+        }
+    }
+    std::stable_sort(frames.begin(),frames.end(),[](const canFrame &a, const canFrame &b){
+        return a.ts_us<b.ts_us;
+    });
+
+    //one op is one frame, deadlines checked once per read tick
+    NmtMonitor nmt(nullptr);
+    const size_t count=frames.size();
+    size_t pos=0;
+    quint64 lap_us=0;
+    runner.run(name,[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            canFrame frame=frames[pos];
+            frame.ts_us+=lap_us;
+            frame.host_us+=qint64(lap_us);
+            nmt.process_frame(frame);
+            if(i%PIPELINE_TICK_FRAMES==0)
+                nmt.check(frame.host_us);
+            if(++pos==count){
+                pos=0;
+                lap_us+=duration_us;
+            }
+        }
+    });
+    const nmtStats st=nmt.stats();
+    runner.note(name,"nodes",st.nodes);
+    runner.note(name,"heartbeat_pct",100.0*127*(duration_us/NMT_BENCH_PERIOD_US)/count);
+    if(!runner.is_list_only())
+        runner.check(name,st.losses==0&&st.late==0,QString("%1 nodes reported lost, %2 heartbeats late on a punctual network")
+                     .arg(st.losses).arg(st.late));
+}
+
+void PcanQtBench::run_pyramid(BenchRunner &runner)
+{
+    if(!runner.selected("pyramid.append")&&!runner.selected("pyramid.query"))
+        return;
+
+    //the samples of the synthetic stream, decoded once
+    std::vector<imuSample> samples;
+    ImuUnpacker unpacker;
+    imuSample out[IMU_FD_MAX_SAMPLES];
+    for(const canFrame &frame : synthetic){
+        const int n=unpacker.decode(frame,8,out,IMU_FD_MAX_SAMPLES);
+        samples.insert(samples.end(),out,out+n);
+    }
+    const quint64 duration_us=synthetic.back().ts_us+1;
+
+    //one op is one sample, repeats of the stream go on in time
+    SignalPyramid live;
+    const size_t count=samples.size();
+    size_t pos=0;
+    quint64 lap_us=0;
+    runner.run("pyramid.append",[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            imuSample s=samples[pos];
+            s.ts_us+=lap_us;
+            live.append(&s,1);
+            if(++pos==count){
+                pos=0;
+                lap_us+=duration_us;
+            }
+        }
+    });
+    runner.note("pyramid.append","bytes_per_sample",live.samples()?double(live.memory_bytes())/live.samples():0);
+
+    //a 12 hour series, random ranges from a few seconds up to all of it
+    SignalPyramid pyramid;
+    const quint64 total=quint64(PYRAMID_BENCH_HOURS)*3600*100;
+    for(quint64 i=0;i<total;i++){
+        imuSample s;
+        s.node=8;
+        s.signal=IMU_SIG_ACC;
+        s.ts_us=i*10000;
+        s.v[0]=float(std::sin(i*1e-4));
+        s.v[1]=float(i%1000)/1000;
+        s.v[2]=-1;
+        pyramid.append(&s,1);
+    }
+    std::mt19937 rng(20211001);
+    const quint64 span_us=total*10000;
+    std::vector<pyramidBucket> buckets;
+    size_t max_points=0;
+    runner.run("pyramid.query",[&](qint64 n){
+        for(qint64 i=0;i<n;i++){
+            //log-uniform zoom
+            const quint64 width=quint64(std::exp(std::log(5e6)+(std::log(double(span_us))-std::log(5e6))*(rng()%1000)/999.0));
+            const quint64 t0=rng()%(span_us-qMin(width,span_us-1));
+            pyramid.query(8,IMU_SIG_ACC,t0,t0+width,PYRAMID_BENCH_POINTS,buckets);
+            max_points=qMax(max_points,buckets.size());
+        }
+        bench_sink=int(buckets.size());
+    });
+    const pyramidBucket all=pyramid.overview(8,IMU_SIG_ACC);
+    runner.note("pyramid.query","max_points",double(max_points));
+    if(!runner.is_list_only()){
+        runner.check("pyramid.query",max_points<=PYRAMID_BENCH_POINTS+1,
+                     QString("%1 points returned for %2 pixels").arg(max_points).arg(PYRAMID_BENCH_POINTS));
+        runner.check("pyramid.query",all.count==total&&all.min[2]==-1&&all.max[2]==-1,
+                     QString("overview holds %1 of %2 samples").arg(all.count).arg(total));
+    }
+}
+
+void PcanQtBench::run_batch(BenchRunner &runner)
+{
+    if(!runner.selected("batch.analyze.single")&&!runner.selected("batch.analyze.all"))
+        return;
+
+    QTemporaryDir dir;
+    qint64 bytes=0;
+    for(int f=0;f<BATCH_BENCH_FILES;f++){
+        QFile file(dir.filePath(QString("run%1.pqc").arg(f,3,10,QChar('0'))));
+        if(!file.open(QIODevice::WriteOnly))
+            return;
+        capture_write_header(file);
+        const int count=int(synthetic.size()*size_t(f%4+1)/4);
+        captureStats st;
+        for(int i=0;i<count;i+=CAPTURE_BLOCK_FRAMES)
+            capture_write_block(file,synthetic.data()+i,qMin(CAPTURE_BLOCK_FRAMES,count-i),1,st);
+        bytes+=file.size();
+    }
+    const QStringList paths=batch_collect(dir.path());
+
+    //one op is the whole campaign
+    std::vector<batchSeries> series;
+    std::vector<batchFile> files;
+    const struct{const char *name; int threads;} cases[]={
+        {"batch.analyze.single",1},
+        {"batch.analyze.all",0},
+    };
+    double ns_single=0;
+    quint64 samples_single=0;
+    for(const auto &c : cases){
+        if(!runner.selected(c.name))
+            continue;
+        batchStats stats;
+        runner.run(c.name,[&](qint64 n){
+            for(qint64 i=0;i<n;i++)
+                stats=BatchAnalyzer::analyze_files(paths,IMU_PACK_NONE,c.threads,series,files);
+        },double(bytes));
+        const batchSeries &acc=series[8*IMU_SIG_COUNT+IMU_SIG_ACC];
+        runner.note(c.name,"threads",stats.threads);
+        runner.note(c.name,"steals",double(stats.steals));
+        if(runner.is_list_only())
+            continue;
+        runner.check(c.name,stats.files==BATCH_BENCH_FILES&&!stats.failed&&std::fabs(acc.rate_hz()-100)<0.1&&!acc.gaps,
+                     QString("%1 of %2 files read, acc at %3 Hz with %4 gaps")
+                     .arg(stats.files-stats.failed).arg(BATCH_BENCH_FILES).arg(acc.rate_hz(),0,'f',2).arg(acc.gaps));
+        if(c.threads==1){
+            ns_single=runner.results().last().ns_per_op;
+            samples_single=acc.samples;
+        }
+        else if(ns_single>0){
+            runner.note(c.name,"speedup",ns_single/runner.results().last().ns_per_op);
+            runner.check(c.name,acc.samples==samples_single,
+                         QString("%1 samples merged from the workers, %2 from one thread").arg(acc.samples).arg(samples_single));
+        }
+    }
+}
+
+void PcanQtBench::run_emulator(BenchRunner &runner)
+{
+    const QString name="emulator.poll";
+    if(!runner.selected(name))
+        return;
+
+    VirtualCanBus emu_bus;
+    VirtualTransport nodes(&emu_bus);
+    VirtualTransport host(&emu_bus);
+    nodes.initialize(PCAN_USBBUS1,PCAN_BAUD_1M);
+    host.initialize(PCAN_USBBUS2,PCAN_BAUD_1M);
+    emuConfig config;
+    QString error;
+    emu_parse(QString("nodes 1-%1\nrate %2\n").arg(EMU_BENCH_NODES).arg(EMU_BENCH_HZ),config,error);
+    Ch100Emulator emulator;
+    if(!emulator.setup(config,&nodes))
+        return;
+
+    //TPDOs per COB-ID, the last SDO response
+    std::vector<quint64> tpdo(0x800,0);
+    quint64 received=0;
+    TPCANMsgFD sdo_response={};
+    canFrame frame;
+    auto drain=[&](){
+        while(host.read(frame)==PCAN_ERROR_OK){
+            const uint base=frame.msg.ID&~0x7Fu;
+            if(base==CO_SDO_TX){
+                sdo_response=frame.msg;
+            }
+            else if(base==0x180||base==0x280||base==0x380||base==0x480||base==0x680){
+                tpdo[frame.msg.ID]++;
+                received++;
+            }
+        }
+    };
+
+    //one op is one TPDO on the bus
+    qint64 now=0;
+    runner.run(name,[&](qint64 n){
+        const quint64 target=received+quint64(n);
+        while(received<target){
+            now+=EMU_BENCH_STEP_US;
+            emulator.poll(now);
+            drain();
+        }
+    });
+    runner.note(name,"nodes",EMU_BENCH_NODES);
+    if(runner.is_list_only())
+        return;
+
+    //the timers started one period after the boot at the first step
+    const quint64 period_us=1000000/EMU_BENCH_HZ;
+    const quint64 expected=quint64(now-EMU_BENCH_STEP_US)/period_us;
+    int off_rate=0;
+    for(int node=1;node<=EMU_BENCH_NODES;node++){
+        for(int n=0;n<4;n++){
+            const quint64 count=tpdo[ch100_tpdo_base[n]+uint(node)];
+            if(count+1<expected||count>expected)
+                off_rate++;
+        }
+    }
+    runner.check(name,off_rate==0,QString("%1 TPDOs off their rate, %2 frames expected each").arg(off_rate).arg(expected));
+
+    //the reads of fastsdo_readcfg() and the event timer write of
+    //on_BTN_change_tpdo_hz_clicked(), applied at once
+    auto sdo=[&](const TPCANMsgFD &req){
+        sdo_response=TPCANMsgFD();
+        host.write(req);
+        now+=EMU_BENCH_STEP_US;
+        emulator.poll(now);
+        drain();
+        return sdo_response;
+    };
+    const uint timer_ms=sdo_value(sdo(sdo_upload_request(EMU_BENCH_NODES,0x1800,5)));
+    runner.check(name,timer_ms==1000/EMU_BENCH_HZ,QString("0x1800 sub 5 read %1 ms").arg(timer_ms));
+    const TPCANMsgFD written=sdo(sdo_download_expedited(1,0x1801,5,5,2));
+    const quint64 before=tpdo[0x281];
+    for(int i=0;i<1000000/EMU_BENCH_STEP_US;i++){
+        now+=EMU_BENCH_STEP_US;
+        emulator.poll(now);
+        drain();
+    }
+    const quint64 gyr=tpdo[0x281]-before;
+    runner.check(name,written.DATA[0]==SDO_DOWNLOAD_RESP&&gyr>=199&&gyr<=200,
+                 QString("TPDO 2 of node 1 sent %1 times in 1 s after setting 5 ms").arg(gyr));
+}
+
+void PcanQtBench::run_sync(BenchRunner &runner)
+{
+    const QString name="sync.cycle";
+    if(!runner.selected(name))
+        return;
+
+    VirtualCanBus sync_bus;
+    VirtualTransport nodes(&sync_bus);
+    VirtualTransport host(&sync_bus);
+    nodes.initialize(PCAN_USBBUS1,PCAN_BAUD_1M);
+    host.initialize(PCAN_USBBUS2,PCAN_BAUD_1M);
+    emuConfig config;
+    QString error;
+    emu_parse(QString("nodes 1-%1\n").arg(SYNC_BENCH_NODES),config,error);
+    Ch100Emulator emulator;
+    if(!emulator.setup(config,&nodes))
+        return;
+    emulator.start_emulation();
+    TxScheduler tx(&host);
+    tx.start(QThread::TimeCriticalPriority);
+    SdoClient sdo(&tx);
+    SyncAcquisition sync(&host,&tx,&sdo);
+
+    canFrame frame;
+    auto drain=[&]{
+        while(host.read(frame)==PCAN_ERROR_OK){
+            if(!sdo.process_frame(frame))
+                sync.process_frame(frame);
+        }
+        QThread::usleep(50);
+    };
+    //the TPDO parameters of all nodes, 0x1800+n sub 1, 2 and 5 in a row
+    auto read_params=[&]{
+        QHash<quint32,int> at;
+        QVector<QByteArray> values(SYNC_BENCH_NODES*SYNC_TPDOS*3);
+        QMetaObject::Connection c=QObject::connect(&sdo, &SdoClient::finished, &sdo, [&](const sdoResult &r){
+            if(at.contains(r.id)&&!r.abort_code)
+                values[at.take(r.id)]=r.data;
+        }, Qt::DirectConnection);
+        for(int node=1;node<=SYNC_BENCH_NODES;node++){
+            for(int n=0;n<SYNC_TPDOS;n++){
+                const uchar subs[]={1,2,5};
+                for(int k=0;k<3;k++)
+                    at.insert(sdo.read(node,ushort(0x1800+n),subs[k]),((node-1)*SYNC_TPDOS+n)*3+k);
+            }
+        }
+        QElapsedTimer t;
+        t.start();
+        while(sdo.pending()&&t.elapsed()<SYNC_BENCH_SDO_MS)
+            drain();
+        QObject::disconnect(c);
+        return values;
+    };
+    const QVector<QByteArray> before=read_params();
+
+    //every cycle past the warm-up has to hold all TPDOs of all nodes; the
+    //warm-up starts once the TPDOs are switched to SYNC
+    quint64 warm_until=~0ULL;
+    quint64 last_index=0;
+    quint64 cycles=0;
+    quint64 incomplete=0;
+    QString first_incomplete;
+    QObject::connect(&sync, &SyncAcquisition::cycle_complete, &sync, [&](const syncCycle &cycle){
+        cycles++;
+        last_index=cycle.index;
+        if(cycle.index<=warm_until)
+            return;
+        bool all=cycle.n_nodes==SYNC_BENCH_NODES&&cycle.received==cycle.expected;
+        for(int i=0;i<cycle.n_nodes;i++){
+            for(int n=0;n<SYNC_TPDOS;n++)
+                all=all&&cycle.valid[i][n]&&cycle.frames[i][n].msg.ID==ch100_tpdo_base[n]+cycle.nodes[i];
+        }
+        if(!all&&!incomplete++)
+            first_incomplete=QString("cycle %1: %2 of %3 TPDOs").arg(cycle.index).arg(cycle.received).arg(cycle.expected);
+    }, Qt::DirectConnection);
+
+    QVector<int> ids;
+    for(int id=1;id<=SYNC_BENCH_NODES;id++)
+        ids.append(id);
+    sync.start(ids,SYNC_BENCH_PERIOD_US);
+    QElapsedTimer t;
+    t.start();
+    while(sync.is_configuring()&&t.elapsed()<SYNC_BENCH_SDO_MS)
+        drain();
+    warm_until=last_index+SYNC_BENCH_WARMUP;
+
+    //one op is one SYNC cycle
+    runner.run(name,[&](qint64 n){
+        const quint64 target=cycles+quint64(n);
+        while(cycles<target)
+            drain();
+    });
+    sync.stop();
+    t.restart();
+    while(sync.is_configuring()&&t.elapsed()<SYNC_BENCH_SDO_MS)
+        drain();
+    const QVector<QByteArray> after=read_params();
+    emulator.stop_emulation();
+    tx.shutdown();
+    if(runner.is_list_only())
+        return;
+
+    int changed=0;
+    for(int i=0;i<before.size();i++)
+        changed+=before[i].isEmpty()||after[i]!=before[i];
+    runner.check(name,!changed&&!sync.stats().sdo_failures,
+                 QString("%1 TPDO parameters not restored, %2 SDO requests failed")
+                 .arg(changed).arg(sync.stats().sdo_failures));
+
+    const syncStats st=sync.stats();
+    runner.note(name,"nodes",SYNC_BENCH_NODES);
+    runner.note(name,"completeness_avg",st.completeness_avg);
+    runner.note(name,"jitter_max_us",st.jitter_max_us);
+    runner.check(name,st.hw_timestamps&&cycles>SYNC_BENCH_WARMUP&&!incomplete,
+                 QString("%1 of %2 cycles incomplete, first %3").arg(incomplete).arg(cycles).arg(first_incomplete));
+}
+
+void PcanQtBench::run_detect(BenchRunner &runner)
+{
+    const QString name="detect.bitrate";
+    if(!runner.selected(name))
+        return;
+
+    VirtualCanBus detect_bus;
+    VirtualTransport nodes(&detect_bus);
+    VirtualTransport listener(&detect_bus);
+    nodes.initialize(PCAN_USBBUS1,PCAN_BAUD_250K);
+    emuConfig config;
+    QString error;
+    emu_parse(QString("nodes 1-%1\n").arg(DETECT_BENCH_NODES),config,error);
+    Ch100Emulator emulator;
+    if(!emulator.setup(config,&nodes))
+        return;
+    emulator.start_emulation();
+
+    //one op is one detection, node discovery included
+    const QVector<TPCANBaudrate> candidates={PCAN_BAUD_1M,PCAN_BAUD_500K,PCAN_BAUD_250K,PCAN_BAUD_125K};
+    detectResult result;
+    bool ok=true;
+    runner.run(name,[&](qint64 n){
+        for(qint64 i=0;i<n;i++)
+            ok=BitrateDetector::detect_bitrate(&listener,PCAN_USBBUS2,candidates,result,error)&&ok;
+    });
+    emulator.stop_emulation();
+    if(runner.is_list_only())
+        return;
+
+    runner.note(name,"lock_ms",result.lock_us/1000.0);
+    QList<int> expected;
+    for(int id=1;id<=DETECT_BENCH_NODES;id++)
+        expected.append(id);
+    runner.check(name,ok&&result.bitrate==PCAN_BAUD_250K,
+                 QString("detected %1 kbit/s, %2").arg(result.bps/1000).arg(ok?BitrateDetector::report(result).join("; "):error));
+    runner.check(name,result.nodes()==expected,QString("%1 nodes seen").arg(result.nodes().size()));
+    //listen-only: the emulated nodes never saw a frame or an error of the detector
+    const emuStats stats=emulator.stats();
+    runner.check(name,stats.sdo_requests==0&&stats.nmt_commands==0&&nodes.status()==PCAN_ERROR_OK,
+                 QString("emulated nodes disturbed, status 0x%1").arg(nodes.status(),0,16));
+}
+
+void PcanQtBench::run_sdo_profile(BenchRunner &runner)
+{
+    const QString name="sdo.profile";
+    if(!runner.selected(name))
+        return;
+
+    VirtualCanBus prof_bus;
+    VirtualTransport nodes(&prof_bus);
+    VirtualTransport host(&prof_bus);
+    nodes.initialize(PCAN_USBBUS1,PCAN_BAUD_1M);
+    host.initialize(PCAN_USBBUS2,PCAN_BAUD_1M);
+    emuConfig emu;
+    QString error;
+    emu_parse(QString("nodes 1-%1\nsdo_delay %2 %3\n").arg(PROF_BENCH_NODES).arg(PROF_BENCH_DELAY_MS).arg(PROF_BENCH_DELAY_PCT),emu,error);
+    Ch100Emulator emulator;
+    if(!emulator.setup(emu,&nodes))
+        return;
+    TxScheduler tx(&host);
+    SdoProfiler profiler(&host,&tx);
+    sdoProfileConfig config;
+    sdo_profile_parse(QString("nodes 1-%1\nobject 0x1000 0\nobject 0x1018 4\nrate %2\n").arg(PROF_BENCH_NODES).arg(PROF_BENCH_HZ),config,error);
+    emulator.start_emulation();
+    tx.start(QThread::TimeCriticalPriority);
+    profiler.start(config);
+
+    //one op is one probe answered or timed out, the read loop is this one
+    canFrame frame;
+    runner.run(name,[&](qint64 n){
+        const sdoProfileStats start=profiler.stats();
+        const quint64 target=start.answered+start.timeouts+quint64(n);
+        for(;;){
+            const sdoProfileStats now=profiler.stats();
+            if(now.answered+now.timeouts>=target)
+                break;
+            profiler.tick(host_monotonic_us());
+            while(host.read(frame)==PCAN_ERROR_OK){
+                frame.host_us=host_monotonic_us();
+                profiler.process_frame(frame);
+            }
+            QThread::usleep(50);
+        }
+    });
+    profiler.stop();
+    tx.shutdown();
+    emulator.stop_emulation();
+    if(runner.is_list_only())
+        return;
+
+    const sdoProfileStats stats=profiler.stats();
+    const latencyHistogram all=profiler.total();
+    runner.note(name,"p50_us",all.percentile(50));
+    runner.note(name,"p99_us",all.percentile(99));
+    runner.note(name,"load_pct",stats.load_pct);
+    runner.check(name,stats.answered&&stats.hw_timed==stats.answered,
+                 QString("%1 of %2 round trips timed from echo frames").arg(stats.hw_timed).arg(stats.answered));
+    //the late responses, from the bucket of the delay on
+    quint64 late=0;
+    for(size_t b=PROF_BENCH_DELAY_MS*1000/SDO_PROF_BUCKET_US;b<all.buckets.size();b++)
+        late+=all.buckets[b];
+    const double late_pct=all.n?late*100.0/all.n:0;
+    runner.check(name,late_pct>PROF_BENCH_DELAY_PCT/2&&late_pct<PROF_BENCH_DELAY_PCT*2&&all.percentile(50)<PROF_BENCH_DELAY_MS*1000,
+                 QString("%1 % of the responses %2 ms late or more, p50 %3 us").arg(late_pct,0,'f',1).arg(PROF_BENCH_DELAY_MS).arg(all.percentile(50)));
+    int empty=0;
+    for(int node=1;node<=PROF_BENCH_NODES;node++)
+        empty+=profiler.node_histogram(node).n?0:1;
+    for(int i=0;i<config.objects.size();i++)
+        empty+=profiler.object_histogram(i).n?0:1;
+    runner.check(name,empty==0&&stats.load_pct>0,QString("%1 node or object histograms empty, load %2 %").arg(empty).arg(stats.load_pct,0,'f',1));
+}
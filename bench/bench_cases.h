@@ -0,0 +1,58 @@
+#ifndef BENCH_CASES_H
+#define BENCH_CASES_H
+
+#include "bench_runner.h"
+#include "can_transport.h"
+#include <vector>
+
+class PCAN_QT;
+
+//CH100 traffic of one node: TPDO 1..4 at rate_hz with random walk data and
+//a 1 Hz heartbeat, in timestamp order
+std::vector<canFrame> bench_synthetic_stream(int node_id, int rate_hz, int seconds);
+
+//the main window on a virtual bus, fed by a second endpoint; the cases
+//reach into the window as a friend, so they time the code the GUI runs
+class PcanQtBench
+{
+public:
+    PcanQtBench();
+    ~PcanQtBench();
+
+    //recorded stream, a capture file from Acquisition > Record capture
+    bool load_capture(const QString &path, QString &error);
+
+    void run(BenchRunner &runner);
+
+private:
+    void run_format(BenchRunner &runner);
+    void run_parsers(BenchRunner &runner, const QString &stream, const std::vector<canFrame> &frames, int node_id);
+    void run_pipeline(BenchRunner &runner, const QString &stream, const std::vector<canFrame> &frames, int node_id);
+    void run_capture(BenchRunner &runner, const QString &stream, const std::vector<canFrame> &frames);
+    void run_busoff(BenchRunner &runner);
+    void run_tx(BenchRunner &runner);
+    void run_fd(BenchRunner &runner);
+    void run_packing(BenchRunner &runner);
+    void run_sdo(BenchRunner &runner);
+    void run_import(BenchRunner &runner);
+    void run_dbc(BenchRunner &runner);
+    void run_trigger(BenchRunner &runner);
+    void run_alarms(BenchRunner &runner);
+    void run_bounded(BenchRunner &runner);
+    void run_nmt(BenchRunner &runner);
+    void run_pyramid(BenchRunner &runner);
+    void run_batch(BenchRunner &runner);
+    void run_emulator(BenchRunner &runner);
+    void run_sync(BenchRunner &runner);
+    void run_detect(BenchRunner &runner);
+    void run_sdo_profile(BenchRunner &runner);
+
+    VirtualCanBus bus;
+    VirtualTransport *generator;
+    PCAN_QT *window;
+    std::vector<canFrame> synthetic;
+    std::vector<canFrame> recorded;
+    int recorded_node=8;
+};
+
+#endif // BENCH_CASES_H
@@ -0,0 +1,131 @@
+#include "bench_cases.h"
+#include "bench_runner.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <cstdio>
+
+//pcan_bench [--filter re] [--capture file.pqc] [--out results.json]
+//           [--baseline baseline.json] [--threshold pct|name=pct]...
+//
+//exit code 0: ok, 1: usage or file error, 2: a case regressed against the
+//baseline, 3: a check of a case failed
+
+static QJsonObject read_json(const QString &path, QString &error)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        error=file.errorString();
+        return QJsonObject();
+    }
+    QJsonParseError parse;
+    const QJsonDocument doc=QJsonDocument::fromJson(file.readAll(),&parse);
+    if(!doc.isObject())
+        error=parse.errorString();
+    return doc.object();
+}
+
+int main(int argc, char *argv[])
+{
+    //no display needed, the window is painted offscreen
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM","offscreen");
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("pcan_bench");
+
+    QCommandLineParser cli;
+    cli.setApplicationDescription("PCAN_QT hot path benchmarks, results as JSON.");
+    cli.addHelpOption();
+    QCommandLineOption opt_filter("filter","Run the cases matching <regex> only.","regex");
+    QCommandLineOption opt_list("list","List the case names and exit.");
+    QCommandLineOption opt_capture("capture","Also run the stream cases on a recorded capture.","file.pqc");
+    QCommandLineOption opt_out("out","Write the JSON results to <file> instead of stdout.","file");
+    QCommandLineOption opt_baseline("baseline","Compare against the results in <file>.","file");
+    QCommandLineOption opt_threshold("threshold","Regression threshold in percent, for all cases (<pct>) "
+                                     "or one case (<name>=<pct>), default 10.","pct");
+    QCommandLineOption opt_min_time("min-time-ms","Minimum time per repetition, default 200.","ms","200");
+    QCommandLineOption opt_reps("repetitions","Timed repetitions per case, the median is kept, default 5.","n","5");
+    cli.addOptions({opt_filter,opt_list,opt_capture,opt_out,opt_baseline,opt_threshold,opt_min_time,opt_reps});
+    cli.process(app);
+
+    BenchRunner runner;
+    runner.set_filter(cli.value(opt_filter));
+    runner.set_list_only(cli.isSet(opt_list));
+    runner.set_min_time_ms(cli.value(opt_min_time).toInt());
+    runner.set_repetitions(cli.value(opt_reps).toInt());
+
+    double default_threshold=10;
+    QHash<QString,double> thresholds;
+    for(const QString &value : cli.values(opt_threshold)){
+        const int eq=value.lastIndexOf('=');
+        if(eq<0)
+            default_threshold=value.toDouble();
+        else
+            thresholds.insert(value.left(eq),value.mid(eq+1).toDouble());
+    }
+
+    QString error;
+    QJsonObject baseline;
+    if(cli.isSet(opt_baseline)){
+        baseline=read_json(cli.value(opt_baseline),error);
+        if(!error.isEmpty()){
+            fprintf(stderr,"baseline %s: %s\n",qPrintable(cli.value(opt_baseline)),qPrintable(error));
+            return 1;
+        }
+    }
+
+    {
+        PcanQtBench bench;
+        if(cli.isSet(opt_capture)&&!bench.load_capture(cli.value(opt_capture),error)){
+            fprintf(stderr,"capture %s: %s\n",qPrintable(cli.value(opt_capture)),qPrintable(error));
+            return 1;
+        }
+        bench.run(runner);
+    }
+
+    if(cli.isSet(opt_list)){
+        for(const benchResult &result : runner.results())
+            printf("%s\n",qPrintable(result.name));
+        return 0;
+    }
+
+    //human readable summary on stderr, stdout stays machine readable
+    const QVector<benchComparison> cmp=bench_compare(baseline,runner.results(),default_threshold,thresholds);
+    int regressions=0;
+    for(const benchResult &result : runner.results()){
+        QString line=QString("%1 %2 ns/op").arg(result.name,-36).arg(result.ns_per_op,12,'f',1);
+        if(result.bytes_per_op>0)
+            line.append(QString(" %1 MB/s").arg(result.bytes_per_op/result.ns_per_op*1e3,9,'f',1));
+        for(const benchComparison &c : cmp){
+            if(c.name!=result.name)
+                continue;
+            line.append(QString("  %1%2% (limit %3%)%4")
+                        .arg(c.change_pct>=0?"+":"").arg(c.change_pct,0,'f',1)
+                        .arg(c.threshold_pct,0,'f',0)
+                        .arg(c.regressed?"  REGRESSION":""));
+            regressions+=c.regressed?1:0;
+        }
+        fprintf(stderr,"%s\n",qPrintable(line));
+    }
+
+    const QByteArray json=QJsonDocument(runner.to_json()).toJson();
+    if(cli.isSet(opt_out)){
+        QFile file(cli.value(opt_out));
+        if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate)||file.write(json)!=json.size()){
+            fprintf(stderr,"%s: %s\n",qPrintable(cli.value(opt_out)),qPrintable(file.errorString()));
+            return 1;
+        }
+    }
+    else{
+        fwrite(json.constData(),1,size_t(json.size()),stdout);
+    }
+
+    if(regressions)
+        fprintf(stderr,"%d case(s) regressed against %s\n",regressions,qPrintable(cli.value(opt_baseline)));
+    for(const QString &failed : runner.failed_checks())
+        fprintf(stderr,"CHECK FAILED %s\n",qPrintable(failed));
+    if(!runner.failed_checks().isEmpty())
+        return 3;
+    return regressions?2:0;
+}
@@ -0,0 +1,127 @@
+#include "bench_runner.h"
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSysInfo>
+#include <algorithm>
+#include <vector>
+
+bool BenchRunner::selected(const QString &name) const
+{
+    return filter.pattern().isEmpty()||filter.match(name).hasMatch();
+}
+
+void BenchRunner::run(const QString &name, const std::function<void(qint64)> &fn, double bytes_per_op)
+{
+    if(!selected(name))
+        return;
+
+    benchResult result;
+    result.name=name;
+    result.bytes_per_op=bytes_per_op;
+    if(list_only){
+        m_results.append(result);
+        return;
+    }
+
+    //calibration, also the warm-up: grow n until a run takes a tenth of
+    //the minimum time, then scale it up to the minimum time
+    QElapsedTimer timer;
+    qint64 n=1;
+    for(;;){
+        timer.start();
+        fn(n);
+        const qint64 ns=qMax<qint64>(timer.nsecsElapsed(),1);
+        if(ns>=min_time_ns/10||n>=(qint64(1)<<40)){
+            n=qMax<qint64>(1,qint64(double(n)*double(min_time_ns)/double(ns)));
+            break;
+        }
+        n*=ns<min_time_ns/100?10:2;
+    }
+
+    std::vector<double> per_op;
+    for(int r=0;r<repetitions;r++){
+        timer.start();
+        fn(n);
+        per_op.push_back(double(timer.nsecsElapsed())/double(n));
+    }
+    std::sort(per_op.begin(),per_op.end());
+
+    result.iterations=n;
+    result.ns_per_op=per_op[per_op.size()/2];
+    result.spread_pct=result.ns_per_op>0?(per_op.back()-per_op.front())/result.ns_per_op*100:0;
+    m_results.append(result);
+}
+
+void BenchRunner::note(const QString &name, const QString &key, double value)
+{
+    for(benchResult &result : m_results){
+        if(result.name==name)
+            result.extra.insert(key,value);
+    }
+}
+
+void BenchRunner::check(const QString &name, bool ok, const QString &text)
+{
+    note(name,"check_ok",ok?1:0);
+    if(!ok)
+        m_failed.append(name+": "+text);
+}
+
+QJsonObject BenchRunner::to_json() const
+{
+    QJsonArray cases;
+    for(const benchResult &result : m_results){
+        QJsonObject obj=result.extra;
+        obj.insert("name",result.name);
+        obj.insert("iterations",double(result.iterations));
+        obj.insert("ns_per_op",result.ns_per_op);
+        obj.insert("ops_per_s",result.ns_per_op>0?1e9/result.ns_per_op:0);
+        obj.insert("spread_pct",result.spread_pct);
+        if(result.bytes_per_op>0&&result.ns_per_op>0)
+            obj.insert("mb_per_s",result.bytes_per_op/result.ns_per_op*1e3);
+        cases.append(obj);
+    }
+
+    QJsonObject root;
+    root.insert("schema",1);
+    root.insert("created",QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    root.insert("host",QSysInfo::machineHostName());
+    root.insert("os",QSysInfo::prettyProductName());
+    root.insert("cpu_arch",QSysInfo::currentCpuArchitecture());
+    root.insert("qt",QString(qVersion()));
+    root.insert("min_time_ms",double(min_time_ns/1000000));
+    root.insert("repetitions",repetitions);
+    root.insert("results",cases);
+    if(!m_failed.isEmpty())
+        root.insert("failed_checks",QJsonArray::fromStringList(m_failed));
+    return root;
+}
+
+QVector<benchComparison> bench_compare(const QJsonObject &baseline, const QVector<benchResult> &results,
+                                       double default_threshold_pct, const QHash<QString,double> &thresholds)
+{
+    QHash<QString,QJsonObject> base;
+    for(const QJsonValue &value : baseline.value("results").toArray()){
+        const QJsonObject obj=value.toObject();
+        base.insert(obj.value("name").toString(),obj);
+    }
+
+    QVector<benchComparison> out;
+    for(const benchResult &result : results){
+        if(!base.contains(result.name))
+            continue;
+        const QJsonObject obj=base.value(result.name);
+        benchComparison cmp;
+        cmp.name=result.name;
+        cmp.baseline_ns=obj.value("ns_per_op").toDouble();
+        cmp.current_ns=result.ns_per_op;
+        if(cmp.baseline_ns<=0)
+            continue;
+        cmp.change_pct=(cmp.current_ns/cmp.baseline_ns-1)*100;
+        cmp.threshold_pct=thresholds.value(result.name,obj.value("threshold_pct").toDouble(default_threshold_pct));
+        cmp.regressed=cmp.change_pct>cmp.threshold_pct;
+        out.append(cmp);
+    }
+    return out;
+}
@@ -0,0 +1,70 @@
+#ifndef BENCH_RUNNER_H
+#define BENCH_RUNNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <functional>
+
+struct benchResult{
+    QString name;
+    qint64 iterations=0;    //operations per timed repetition
+    double ns_per_op=0;     //median of the repetitions
+    double spread_pct=0;    //(slowest-fastest)/median of the repetitions
+    double bytes_per_op=0;  //0 when the case has no byte throughput
+    QJsonObject extra;      //case specific figures (ratios, failures)
+};
+
+//the operation count is calibrated to the minimum time first, then a few
+//repetitions are timed and the median is kept, so one preempted run does
+//not show up as a regression
+class BenchRunner
+{
+public:
+    void set_min_time_ms(int ms) {min_time_ns=qint64(qMax(1,ms))*1000000;}
+    void set_repetitions(int n) {repetitions=qMax(1,n);}
+    void set_filter(const QString &pattern) {filter=QRegularExpression(pattern);}
+    void set_list_only(bool on) {list_only=on;}
+    bool is_list_only() const {return list_only;}
+
+    bool selected(const QString &name) const;
+    //fn(n) runs n operations
+    void run(const QString &name, const std::function<void(qint64)> &fn, double bytes_per_op=0);
+    //attaches a figure to the result of name
+    void note(const QString &name, const QString &key, double value);
+    //a property the case has to hold, pcan_bench fails when one does not
+    void check(const QString &name, bool ok, const QString &text);
+    const QStringList &failed_checks() const {return m_failed;}
+
+    const QVector<benchResult> &results() const {return m_results;}
+    QJsonObject to_json() const;
+
+private:
+    qint64 min_time_ns=200000000;
+    int repetitions=5;
+    bool list_only=false;
+    QRegularExpression filter;
+    QVector<benchResult> m_results;
+    QStringList m_failed;
+};
+
+
+//a case regresses when its ns_per_op is above the baseline by more than
+//the threshold. Thresholds: command line per case, then "threshold_pct"
+//of the case in the baseline file, then the default
+struct benchComparison{
+    QString name;
+    double baseline_ns=0;
+    double current_ns=0;
+    double change_pct=0;
+    double threshold_pct=0;
+    bool regressed=false;
+};
+
+QVector<benchComparison> bench_compare(const QJsonObject &baseline, const QVector<benchResult> &results,
+                                       double default_threshold_pct, const QHash<QString,double> &thresholds);
+
+#endif // BENCH_RUNNER_H
@@ -0,0 +1,16 @@
+#ifndef BENCH_COMPAT_WINDOWS_H
+#define BENCH_COMPAT_WINDOWS_H
+
+//stand-in for <Windows.h> on the Linux builds (benchmarks, C API,
+//emulator): include/PCANBasic.h is kept as the vendor ships it and takes
+//these types from <Windows.h>; sizes as in PCAN-Basic for Linux
+#include <cstdint>
+
+typedef uint8_t  BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint64_t UINT64;
+typedef char*    LPSTR;
+#define __stdcall
+
+#endif // BENCH_COMPAT_WINDOWS_H
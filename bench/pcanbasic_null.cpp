@@ -0,0 +1,77 @@
+#include "include/PCANBasic.h"
+#include <cstring>
+
+//PCAN-Basic without a driver: no channels, every call fails, so the window
+//and its threads come up as on a PC without PCAN hardware
+
+TPCANStatus __stdcall CAN_Initialize(TPCANHandle, TPCANBaudrate, TPCANType, DWORD, WORD)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_InitializeFD(TPCANHandle, TPCANBitrateFD)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_Uninitialize(TPCANHandle)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_Reset(TPCANHandle)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_GetStatus(TPCANHandle)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_Read(TPCANHandle, TPCANMsg*, TPCANTimestamp*)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_ReadFD(TPCANHandle, TPCANMsgFD*, TPCANTimestampFD*)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_Write(TPCANHandle, TPCANMsg*)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_WriteFD(TPCANHandle, TPCANMsgFD*)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_FilterMessages(TPCANHandle, DWORD, DWORD, TPCANMode)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_GetValue(TPCANHandle, TPCANParameter, void*, DWORD)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_SetValue(TPCANHandle, TPCANParameter, void*, DWORD)
+{
+    return PCAN_ERROR_NODRIVER;
+}
+
+TPCANStatus __stdcall CAN_GetErrorText(TPCANStatus, WORD, LPSTR Buffer)
+{
+    strcpy(Buffer,"PCAN-Basic is not available in this build");
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus __stdcall CAN_LookUpChannel(LPSTR, TPCANHandle *FoundChannel)
+{
+    *FoundChannel=PCAN_NONEBUS;
+    return PCAN_ERROR_NODRIVER;
+}
@@ -0,0 +1,224 @@
+#include "bitrate_detect.h"
+#include "canopen.h"
+#include "clock_sync.h"
+#include "load_generator.h"
+#include <QMutexLocker>
+#include <cstring>
+
+QList<int> detectResult::nodes() const
+{
+    QList<int> ids;
+    for(int id=1;id<128;id++){
+        if(seen[id])
+            ids.append(id);
+    }
+    return ids;
+}
+
+//node id and DETECT_SEEN_* bit of a TPDO or heartbeat COB-ID, 0 otherwise
+static int seen_bit(uint id, int &node)
+{
+    if(id>CO_HEARTBEAT&&id<CO_HEARTBEAT+128){
+        node=int(id-CO_HEARTBEAT);
+        return DETECT_SEEN_HEARTBEAT;
+    }
+    for(int n=0;n<5;n++){
+        if(id>ch100_tpdo_base[n]&&id<ch100_tpdo_base[n]+128){
+            node=int(id-ch100_tpdo_base[n]);
+            return 1<<n;
+        }
+    }
+    return 0;
+}
+
+static TPCANStatus listen_only(CanTransport *can, TPCANHandle channel, bool on)
+{
+    DWORD value=on?PCAN_PARAMETER_ON:PCAN_PARAMETER_OFF;
+    return can->preset_value(channel,PCAN_LISTEN_ONLY,&value,sizeof(value));
+}
+
+//reads until until_us, a frame moves it to DETECT_DWELL_MS after the frame,
+//up to the deadline; with stop_on_lock also stops at the first error or
+//once DETECT_MIN_FRAMES clean frames came in
+static void listen(CanTransport *can, detectCandidate &candidate, detectResult &seen,
+                   qint64 until_us, qint64 deadline_us, bool stop_on_lock, const std::atomic<bool> *quit)
+{
+    const qint64 t0=host_monotonic_us();
+    qint64 now=t0;
+    while(now<until_us&&now<deadline_us&&!(quit&&*quit)){
+        canFrame frame;
+        TPCANStatus result;
+        while((result=can->read(frame))==PCAN_ERROR_OK){
+            const TPCANMsgFD &msg=frame.msg;
+            if(msg.MSGTYPE&PCAN_MESSAGE_ERRFRAME){
+                candidate.errors++;
+                continue;
+            }
+            if(msg.MSGTYPE&(PCAN_MESSAGE_STATUS|PCAN_MESSAGE_ECHO))
+                continue;
+            candidate.frames++;
+            int node=0;
+            const int bit=(msg.MSGTYPE&PCAN_MESSAGE_EXTENDED)?0:seen_bit(msg.ID,node);
+            if(bit)
+                seen.seen[node]|=uchar(bit);
+            until_us=qMax(until_us,host_monotonic_us()+DETECT_DWELL_MS*1000);
+        }
+        if((result&PCAN_ERROR_ANYBUSERR)||(can->status()&PCAN_ERROR_ANYBUSERR))
+            candidate.errors++;
+        if(stop_on_lock&&(candidate.errors||candidate.frames>=DETECT_MIN_FRAMES))
+            break;
+        QThread::usleep(DETECT_POLL_US);
+        now=host_monotonic_us();
+    }
+    candidate.listened_us+=host_monotonic_us()-t0;
+}
+
+//----------------------------------------------------------------------------
+// BitrateDetector
+//----------------------------------------------------------------------------
+BitrateDetector::BitrateDetector(QObject *parent)
+    : QThread(parent)
+{
+    qRegisterMetaType<detectResult>("detectResult");
+}
+
+BitrateDetector::~BitrateDetector()
+{
+    quit=true;
+    wait();
+}
+
+void BitrateDetector::detect(CanTransport *transport, TPCANHandle handle, const QVector<TPCANBaudrate> &rates)
+{
+    if(isRunning())
+        return;
+    {
+        QMutexLocker lock(&mutex);
+        can=transport;
+        channel=handle;
+        candidates=rates;
+    }
+    quit=false;
+    start();
+}
+
+bool BitrateDetector::detect_bitrate(CanTransport *can, TPCANHandle channel, const QVector<TPCANBaudrate> &candidates,
+                                     detectResult &result, QString &error, const std::atomic<bool> *quit)
+{
+    result=detectResult();
+    if(candidates.isEmpty()){
+        error=tr("no candidate bit rate");
+        return false;
+    }
+    //without listen-only a wrong rate would destroy frames of the running
+    //bus with error frames
+    if(listen_only(can,channel,true)!=PCAN_ERROR_OK){
+        error=tr("the channel has no listen-only mode");
+        return false;
+    }
+    for(TPCANBaudrate bitrate : candidates){
+        detectCandidate candidate;
+        candidate.bitrate=bitrate;
+        result.tried.append(candidate);
+    }
+
+    const qint64 t0=host_monotonic_us();
+    const qint64 deadline=t0+DETECT_TIMEOUT_MS*1000;
+    int taken=-1;
+    for(int i=0;taken<0&&host_monotonic_us()<deadline&&!(quit&&*quit);i=(i+1)%candidates.size()){
+        detectCandidate &candidate=result.tried[i];
+        const TPCANStatus status=can->initialize(channel,candidate.bitrate);
+        if(status!=PCAN_ERROR_OK){
+            listen_only(can,channel,false);
+            char text[256];
+            CAN_GetErrorText(status,0,text);
+            error=tr("channel: %1").arg(QString::fromLatin1(text));
+            return false;
+        }
+        DWORD on=PCAN_PARAMETER_ON;
+        can->set_value(PCAN_ALLOW_ERROR_FRAMES,&on,sizeof(on));
+
+        //the frames of a round count only if the whole round was clean
+        detectCandidate round;
+        detectResult seen;
+        listen(can,round,seen,host_monotonic_us()+DETECT_DWELL_MS*1000,deadline,true,quit);
+        candidate.errors+=round.errors;
+        candidate.listened_us+=round.listened_us;
+        if(!round.errors)
+            candidate.frames+=round.frames;
+        if(!round.errors&&round.frames>=DETECT_MIN_FRAMES){
+            taken=i;
+            result.lock_us=host_monotonic_us()-t0;
+            memcpy(result.seen,seen.seen,sizeof(result.seen));
+            //the nodes that send slower than the first frames came in
+            listen(can,candidate,result,host_monotonic_us()+DETECT_DISCOVERY_MS*1000,
+                   host_monotonic_us()+DETECT_DISCOVERY_MS*1000,false,quit);
+        }
+        can->uninitialize();
+    }
+    listen_only(can,channel,false);
+    result.elapsed_us=host_monotonic_us()-t0;
+
+    if(taken<0){
+        error=quit&&*quit?tr("cancelled"):tr("no bit rate with error-free traffic in %1 ms").arg(DETECT_TIMEOUT_MS);
+        return false;
+    }
+    const detectCandidate &candidate=result.tried.at(taken);
+    result.bitrate=candidate.bitrate;
+    result.bps=can_bitrates(candidate.bitrate).nominal;
+    result.frames=candidate.frames;
+    return true;
+}
+
+void BitrateDetector::run()
+{
+    CanTransport *transport;
+    TPCANHandle handle;
+    QVector<TPCANBaudrate> rates;
+    {
+        QMutexLocker lock(&mutex);
+        transport=can;
+        handle=channel;
+        rates=candidates;
+    }
+    detectResult result;
+    QString error;
+    if(detect_bitrate(transport,handle,rates,result,error,&quit))
+        emit detected(result);
+    else
+        emit failed(error);
+}
+
+QStringList BitrateDetector::report(const detectResult &result)
+{
+    QStringList lines;
+    for(const detectCandidate &c : result.tried){
+        if(!c.listened_us)
+            continue;
+        lines.append(tr("%1 kbit/s: %2 frames, %3 errors in %4 ms")
+                     .arg(can_bitrates(c.bitrate).nominal/1000)
+                     .arg(c.frames)
+                     .arg(c.errors)
+                     .arg(c.listened_us/1000.0,0,'f',0));
+    }
+    if(!result.bitrate)
+        return lines;
+    lines.append(tr("bit rate %1 kbit/s, detected in %2 ms (%3 ms with node discovery)")
+                 .arg(result.bps/1000)
+                 .arg(result.lock_us/1000.0,0,'f',0)
+                 .arg(result.elapsed_us/1000.0,0,'f',0));
+    QStringList nodes;
+    for(int id : result.nodes()){
+        QStringList what;
+        for(int n=0;n<5;n++){
+            if(result.seen[id]&(1<<n))
+                what.append(tr("TPDO%1").arg(n+1));
+        }
+        if(result.seen[id]&DETECT_SEEN_HEARTBEAT)
+            what.append(tr("heartbeat"));
+        nodes.append(tr("%1 (%2)").arg(id).arg(what.join(' ')));
+    }
+    lines.append(nodes.isEmpty()?tr("no CANopen node seen")
+                                :tr("nodes: %1").arg(nodes.join(", ")));
+    return lines;
+}
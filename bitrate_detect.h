@@ -0,0 +1,82 @@
+#ifndef BITRATE_DETECT_H
+#define BITRATE_DETECT_H
+
+#include "can_transport.h"
+#include <QThread>
+#include <QMutex>
+#include <QMetaType>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+//error-free frames that take a candidate bit rate
+#define DETECT_MIN_FRAMES       8
+//a candidate is left after this long without a frame
+#define DETECT_DWELL_MS         60
+//all candidates are tried again until this
+#define DETECT_TIMEOUT_MS       3000
+//listening at the detected rate for the nodes that send slower
+#define DETECT_DISCOVERY_MS     250
+#define DETECT_POLL_US          500
+//detectResult::seen: bit n for TPDO n+1, this one for the heartbeat
+#define DETECT_SEEN_HEARTBEAT   0x20
+
+struct detectCandidate{
+    TPCANBaudrate bitrate=0;
+    int frames=0;               //error-free frames, summed over the rounds
+    int errors=0;               //error frames and error states
+    qint64 listened_us=0;
+};
+
+struct detectResult{
+    TPCANBaudrate bitrate=0;    //0 when nothing was detected
+    quint32 bps=0;
+    qint64 lock_us=0;           //start to the rate being taken
+    qint64 elapsed_us=0;        //discovery window included
+    int frames=0;               //frames at the detected rate
+    uchar seen[128]={0};        //per node id, DETECT_SEEN_* bits
+    QVector<detectCandidate> tried;
+
+    QList<int> nodes() const;
+};
+Q_DECLARE_METATYPE(detectResult)
+
+//bit rate and node discovery of a running bus: the channel is opened in
+//listen-only mode at one candidate rate after the other, so no frame, no
+//acknowledge and no error frame is ever sent. A wrong rate shows as error
+//frames or a rising receive error counter, the right one as clean frames;
+//the node ids come from the TPDO and heartbeat COB-IDs of those frames
+class BitrateDetector : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit BitrateDetector(QObject *parent = nullptr);
+    ~BitrateDetector() override;
+
+    //detects in the background on a closed channel, detected() when done
+    void detect(CanTransport *transport, TPCANHandle channel, const QVector<TPCANBaudrate> &candidates);
+    void cancel() {quit=true;}
+
+    //synchronous detection, the channel is left closed; false with error
+    //when the transport has no listen-only mode or the channel fails
+    static bool detect_bitrate(CanTransport *can, TPCANHandle channel, const QVector<TPCANBaudrate> &candidates,
+                               detectResult &result, QString &error, const std::atomic<bool> *quit=nullptr);
+    static QStringList report(const detectResult &result);
+
+signals:
+    void detected(const detectResult &result);
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    QMutex mutex;
+    CanTransport *can=nullptr;
+    TPCANHandle channel=0;
+    QVector<TPCANBaudrate> candidates;
+    std::atomic<bool> quit{false};
+};
+
+#endif // BITRATE_DETECT_H
@@ -0,0 +1,106 @@
+#include "bounded_memory.h"
+#include <cstring>
+
+memoryBudget memory_budget_split(qint64 total)
+{
+    memoryBudget budget;
+    budget.total=total;
+    budget.capture=total*BUDGET_CAPTURE_PCT/100;
+    budget.trigger=total*BUDGET_TRIGGER_PCT/100;
+    budget.alarms=total*BUDGET_ALARM_PCT/100;
+    budget.log=total*BUDGET_LOG_PCT/100;
+    return budget;
+}
+
+//----------------------------------------------------------------------------
+// FixedArena
+//----------------------------------------------------------------------------
+void FixedArena::reserve(size_t bytes)
+{
+    const size_t n=(bytes+sizeof(std::max_align_t)-1)/sizeof(std::max_align_t);
+    block.reset(n?new std::max_align_t[n]:nullptr);
+    m_capacity=n*sizeof(std::max_align_t);
+    m_used=0;
+}
+
+//----------------------------------------------------------------------------
+// FrameTable
+//----------------------------------------------------------------------------
+FrameTable::FrameTable(int slots)
+    : n_slots(qBound(1,slots,0x7FFF))
+{
+    //twice the slots, so the extended ID probes stay short
+    ext_mask=1;
+    while(ext_mask<quint32(2*n_slots))
+        ext_mask<<=1;
+    ext_mask--;
+
+    arena.reserve(size_t(n_slots)*sizeof(frameSlot)+(0x800+ext_mask+1)*sizeof(qint16)+3*alignof(std::max_align_t));
+    this->slots=arena.alloc<frameSlot>(size_t(n_slots));
+    std_index=arena.alloc<qint16>(0x800);
+    ext_index=arena.alloc<qint16>(ext_mask+1);
+    clear();
+}
+
+void FrameTable::clear()
+{
+    memset(std_index,0xFF,0x800*sizeof(qint16));
+    memset(ext_index,0xFF,(ext_mask+1)*sizeof(qint16));
+    for(int i=0;i<used;i++)
+        slots[i]=frameSlot();
+    used=0;
+    n_overflow=0;
+}
+
+int FrameTable::ext_slot(quint32 id, bool insert)
+{
+    quint32 h=(id*2654435761u)&ext_mask;
+    for(;;){
+        const int s=ext_index[h];
+        if(s<0){
+            if(!insert||used>=n_slots)
+                return -1;
+            ext_index[h]=qint16(used);
+            return used++;
+        }
+        if(slots[s].id==id)
+            return s;
+        h=(h+1)&ext_mask;
+    }
+}
+
+void FrameTable::update(const canFrame &frame)
+{
+    const bool extended=(frame.msg.MSGTYPE&PCAN_MESSAGE_EXTENDED)!=0;
+    const quint32 id=frame.msg.ID;
+    int s;
+    if(!extended&&id<0x800){
+        s=std_index[id];
+        if(s<0&&used<n_slots){
+            s=used++;
+            std_index[id]=qint16(s);
+        }
+    }
+    else{
+        s=ext_slot(id,true);
+    }
+    if(s<0){
+        n_overflow++;
+        return;
+    }
+
+    frameSlot &slot=slots[s];
+    slot.id=id;
+    slot.extended=extended;
+    slot.len=uchar(can_dlc_to_len(frame.msg.DLC));
+    memcpy(slot.data,frame.msg.DATA,slot.len);
+    slot.count++;
+}
+
+void FrameTable::tick()
+{
+    for(int i=0;i<used;i++){
+        slots[i].hz=slots[i].count;
+        slots[i].count=0;
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef BOUNDED_MEMORY_H
+#define BOUNDED_MEMORY_H
+
+#include "can_transport.h"
+#include <QString>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+//IDs the frame table keeps, the rest is only counted
+#define FRAME_TABLE_SLOTS       256
+#define MEMORY_BUDGET_MIN_MB    4
+//message box lines are budgeted at this size, text and layout
+#define MEMORY_LOG_LINE_BYTES   256
+
+//shares of the memory budget in percent; the rest is left to the fixed
+//tables (frame table, DBC, decoders) and the widgets
+#define BUDGET_CAPTURE_PCT      40
+#define BUDGET_TRIGGER_PCT      35
+#define BUDGET_ALARM_PCT        10
+#define BUDGET_LOG_PCT          5
+
+//budget of each subsystem in bounded memory mode [bytes]
+struct memoryBudget{
+    qint64 total=0;
+    qint64 capture=0;       //capture writer block pool
+    qint64 trigger=0;       //pre-trigger ring
+    qint64 alarms=0;        //samples queued for the alarm worker
+    qint64 log=0;           //message box text
+};
+memoryBudget memory_budget_split(qint64 total);
+
+//one line of the memory report, limit 0 when the subsystem is not bounded
+struct memoryUsage{
+    QString name;
+    qint64 used=0;
+    qint64 limit=0;
+};
+
+
+//one block allocated up front and handed out by bumping an offset;
+//nothing is freed on its own, reset() takes everything back at once
+class FixedArena
+{
+public:
+    explicit FixedArena(size_t bytes=0) {reserve(bytes);}
+
+    //allocates a new block, whatever was handed out is gone
+    void reserve(size_t bytes);
+    void reset() {m_used=0;}
+
+    //n value-initialized objects, nullptr when the block is full
+    template<typename T> T *alloc(size_t n);
+
+    size_t capacity() const {return m_capacity;}
+    size_t used() const {return m_used;}
+
+private:
+    std::unique_ptr<std::max_align_t[]> block;
+    size_t m_capacity=0;
+    size_t m_used=0;
+};
+
+template<typename T> T *FixedArena::alloc(size_t n)
+{
+    static_assert(std::is_trivially_destructible<T>::value,"arena objects are never destroyed");
+    static_assert(alignof(T)<=alignof(std::max_align_t),"arena alignment");
+    const size_t start=(m_used+alignof(T)-1)&~(alignof(T)-1);
+    if(n>(m_capacity-qMin(start,m_capacity))/sizeof(T))
+        return nullptr;
+    m_used=start+n*sizeof(T);
+    T *out=reinterpret_cast<T*>(reinterpret_cast<char*>(block.get())+start);
+    for(size_t i=0;i<n;i++)
+        new(out+i) T();
+    return out;
+}
+
+
+//latest payload, frame count and rate of one CAN ID
+struct frameSlot{
+    quint32 id=0;
+    bool extended=false;
+    uchar len=0;
+    uchar data[64]={0};
+    quint32 count=0;        //frames since the last tick()
+    quint32 hz=0;           //frames in the last second
+};
+
+//the received IDs as shown in the CAN RX box, in a fixed number of slots
+//carved from one arena; update() never allocates, IDs past the last slot
+//are only counted in overflow()
+class FrameTable
+{
+public:
+    explicit FrameTable(int slots=FRAME_TABLE_SLOTS);
+
+    void clear();
+    void update(const canFrame &frame);
+    //once a second, the frames counted since the last tick become hz
+    void tick();
+
+    int size() const {return used;}
+    quint64 overflow() const {return n_overflow;}
+    size_t memory_bytes() const {return arena.capacity();}
+
+    //standard IDs in ascending order, then the extended ones as they came
+    template<typename F> void for_each(F fn) const;
+
+private:
+    int ext_slot(quint32 id, bool insert);
+
+    FixedArena arena;
+    frameSlot *slots=nullptr;
+    qint16 *std_index=nullptr;      //0x800 entries, -1 for unseen IDs
+    qint16 *ext_index=nullptr;      //open addressing over ext_mask+1 entries
+    quint32 ext_mask=0;
+    int n_slots=0;
+    int used=0;
+    quint64 n_overflow=0;
+};
+
+template<typename F> void FrameTable::for_each(F fn) const
+{
+    for(int id=0;id<0x800;id++){
+        if(std_index[id]>=0)
+            fn(slots[std_index[id]]);
+    }
+    for(int i=0;i<used;i++){
+        if(slots[i].extended)
+            fn(slots[i]);
+    }
+}
+
+#endif // BOUNDED_MEMORY_H
@@ -0,0 +1,178 @@
+#include "bus_health.h"
+#include "clock_sync.h"
+
+//give the controller's own 128x11 recessive bit recovery this long before
+//stepping in, then back off from the first software attempt up to the cap
+#define BUSOFF_HW_GRACE_MS      200
+#define BUSOFF_RETRY_MIN_MS     50
+#define BUSOFF_RETRY_MAX_MS     2000
+
+BusHealth::BusHealth(CanTransport *can, TxScheduler *tx, QObject *parent)
+    : QObject(parent)
+    , can(can)
+    , tx(tx)
+{
+    tmr_poll=new QTimer(this);
+    tmr_poll->setInterval(50);
+    connect(tmr_poll, &QTimer::timeout, this, &BusHealth::poll);
+}
+
+void BusHealth::configure_channel()
+{
+    DWORD on=PCAN_PARAMETER_ON;
+    if(can->set_value(PCAN_ALLOW_ERROR_FRAMES,&on,sizeof(on))!=PCAN_ERROR_OK)
+        emit message(tr("Bus health: error frames not supported by this channel"));
+    hw_autoreset=can->set_value(PCAN_BUSOFF_AUTORESET,&on,sizeof(on))==PCAN_ERROR_OK;
+}
+
+void BusHealth::restart_channel(bool full)
+{
+    //the TX thread must not be inside write() while the channel goes down
+    const bool was_paused=tx&&tx->is_paused();
+    if(tx)
+        tx->set_paused(true);
+    if(!full)
+        can->reset();
+    else if(can->reinitialize()==PCAN_ERROR_OK)
+        configure_channel();
+    if(tx)
+        tx->set_paused(was_paused);
+}
+
+void BusHealth::start()
+{
+    m_stats=busHealthStats();
+    m_state=BUS_STATE_ACTIVE;
+    attempts=0;
+    configure_channel();
+    tmr_poll->start();
+}
+
+void BusHealth::stop()
+{
+    tmr_poll->stop();
+}
+
+QString BusHealth::state_name(busState state)
+{
+    switch(state){
+    case BUS_STATE_ACTIVE: return "ACTIVE";
+    case BUS_STATE_WARNING: return "WARNING";
+    case BUS_STATE_PASSIVE: return "PASSIVE";
+    case BUS_STATE_OFF: return "BUS-OFF";
+    case BUS_STATE_RECOVERING: return "RECOVERING";
+    }
+    return "?";
+}
+
+QString BusHealth::summary() const
+{
+    return tr("Bus %1, err frames %2, REC/TEC %3/%4, bus-off %5, last recovery %6 ms")
+            .arg(state_name(m_state))
+            .arg(m_stats.error_frames)
+            .arg(int(m_stats.rx_error_counter))
+            .arg(int(m_stats.tx_error_counter))
+            .arg(m_stats.busoff_count)
+            .arg(m_stats.last_recovery_ms,0,'f',1);
+}
+
+void BusHealth::set_state(busState state)
+{
+    if(state==m_state)
+        return;
+    m_state=state;
+    emit state_changed(state);
+}
+
+bool BusHealth::process_frame(const canFrame &frame)
+{
+    const TPCANMessageType type=frame.msg.MSGTYPE;
+
+    if(type&PCAN_MESSAGE_ERRFRAME){
+        //ID: error type, DATA[2]/[3]: receive/transmit error counters
+        m_stats.error_frames++;
+        switch(frame.msg.ID){
+        case 1: m_stats.bit_errors++; break;
+        case 2: m_stats.form_errors++; break;
+        case 4: m_stats.stuff_errors++; break;
+        default: m_stats.other_errors++; break;
+        }
+        m_stats.rx_error_counter=frame.msg.DATA[2];
+        m_stats.tx_error_counter=frame.msg.DATA[3];
+        return true;
+    }
+    if(type&PCAN_MESSAGE_STATUS){
+        process_status(can->status());
+        return true;
+    }
+    return false;
+}
+
+void BusHealth::process_status(TPCANStatus status)
+{
+    if(status&PCAN_ERROR_QOVERRUN)
+        m_stats.rx_overruns++;
+
+    if(status&PCAN_ERROR_BUSOFF){
+        if(m_state!=BUS_STATE_OFF&&m_state!=BUS_STATE_RECOVERING)
+            enter_busoff();
+    }
+    else if(m_state==BUS_STATE_OFF||m_state==BUS_STATE_RECOVERING){
+        //left to poll(), which measures the recovery
+    }
+    else if(status&PCAN_ERROR_BUSPASSIVE)
+        set_state(BUS_STATE_PASSIVE);
+    else if(status&(PCAN_ERROR_BUSWARNING|PCAN_ERROR_BUSLIGHT))
+        set_state(BUS_STATE_WARNING);
+}
+
+void BusHealth::enter_busoff()
+{
+    m_stats.busoff_count++;
+    busoff_since_us=host_monotonic_us();
+    attempts=0;
+    next_attempt_us=busoff_since_us+(hw_autoreset?BUSOFF_HW_GRACE_MS:0)*1000LL;
+    set_state(BUS_STATE_OFF);
+    emit message(tr("Bus health: bus-off detected"));
+}
+
+void BusHealth::poll()
+{
+    TPCANStatus status=can->status();
+
+    if(m_state!=BUS_STATE_OFF&&m_state!=BUS_STATE_RECOVERING){
+        if(status&PCAN_ERROR_BUSOFF)
+            enter_busoff();
+        else if(!(status&PCAN_ERROR_ANYBUSERR))
+            set_state(BUS_STATE_ACTIVE);
+        else
+            process_status(status);
+        return;
+    }
+
+    const qint64 now=host_monotonic_us();
+    if(!(status&PCAN_ERROR_ANYBUSERR)&&status!=PCAN_ERROR_INITIALIZE){
+        double ms=double(now-busoff_since_us)/1000.0;
+        m_stats.recoveries++;
+        m_stats.last_recovery_ms=ms;
+        m_stats.max_recovery_ms=qMax(m_stats.max_recovery_ms,ms);
+        m_stats.rx_error_counter=0;
+        m_stats.tx_error_counter=0;
+        set_state(BUS_STATE_ACTIVE);
+        emit recovered(ms);
+        emit message(tr("Bus health: recovered from bus-off in %1 ms (%2 attempts)")
+                     .arg(ms,0,'f',1).arg(attempts));
+        return;
+    }
+
+    if(now<next_attempt_us)
+        return;
+
+    set_state(BUS_STATE_RECOVERING);
+    attempts++;
+    //after a few resets the controller did not come back, start the
+    //channel from scratch
+    restart_channel(attempts>BUSOFF_RESET_ATTEMPTS);
+    qint64 backoff=qMin<qint64>(BUSOFF_RETRY_MIN_MS<<qMin(attempts-1,6),BUSOFF_RETRY_MAX_MS);
+    next_attempt_us=now+backoff*1000;
+}
@@ -0,0 +1,86 @@
+#ifndef BUS_HEALTH_H
+#define BUS_HEALTH_H
+
+#include "can_transport.h"
+#include "tx_scheduler.h"
+#include <QObject>
+#include <QTimer>
+
+//CAN_Reset attempts before a full re-initialization
+#define BUSOFF_RESET_ATTEMPTS   3
+
+enum busState{
+    BUS_STATE_ACTIVE=0,
+    BUS_STATE_WARNING,
+    BUS_STATE_PASSIVE,
+    BUS_STATE_OFF,
+    BUS_STATE_RECOVERING
+};
+
+struct busHealthStats{
+    quint64 error_frames=0;
+    quint64 bit_errors=0;
+    quint64 form_errors=0;
+    quint64 stuff_errors=0;
+    quint64 other_errors=0;
+    uchar rx_error_counter=0;
+    uchar tx_error_counter=0;
+    quint64 busoff_count=0;
+    quint64 rx_overruns=0;
+    quint64 recoveries=0;
+    double last_recovery_ms=0;
+    double max_recovery_ms=0;
+};
+
+//watches error frames and controller status of one channel and brings it
+//back from bus-off in the background: hardware auto-reset first, then
+//CAN_Reset, then a full re-initialization, with growing back-off. The
+//acquisition state (frame table, decoders) is left untouched; the TX
+//scheduler, when given, is paused while the channel is reset.
+class BusHealth : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BusHealth(CanTransport *can, TxScheduler *tx = nullptr, QObject *parent = nullptr);
+
+    void start();
+    void stop();
+
+    //from the read loop: returns true when the frame was an error/status
+    //frame and must not be decoded as data
+    bool process_frame(const canFrame &frame);
+    void process_status(TPCANStatus status);
+
+    busState state() const {return m_state;}
+    const busHealthStats &stats() const {return m_stats;}
+    QString summary() const;
+    static QString state_name(busState state);
+
+public slots:
+    void poll();
+
+signals:
+    void state_changed(int state);
+    void recovered(double ms);
+    void message(QString text);
+
+private:
+    void set_state(busState state);
+    void enter_busoff();
+    void configure_channel();
+    void restart_channel(bool full);
+
+    CanTransport *can;
+    TxScheduler *tx;
+    QTimer *tmr_poll;
+    busState m_state=BUS_STATE_ACTIVE;
+    busHealthStats m_stats;
+
+    bool hw_autoreset=false;
+    qint64 busoff_since_us=0;
+    qint64 next_attempt_us=0;
+    int attempts=0;
+};
+
+#endif // BUS_HEALTH_H
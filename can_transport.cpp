@@ -0,0 +1,715 @@
+#include "can_transport.h"
+#include <QMutexLocker>
+#include <chrono>
+#ifdef Q_OS_LINUX
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#endif
+
+static qint64 steady_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//----------------------------------------------------------------------------
+// CanTransport
+//----------------------------------------------------------------------------
+TPCANStatus CanTransport::reinitialize()
+{
+    //the settings of the last successful initialization, also after a
+    //failed attempt left the channel closed
+    TPCANHandle channel=last_channel;
+    bool fd=last_fd_mode;
+    TPCANBaudrate bitrate=last_bitrate;
+    QByteArray bitrate_fd=last_bitrate_fd;
+    if(!channel)
+        return PCAN_ERROR_INITIALIZE;
+
+    const QList<QPair<TPCANParameter,DWORD>> saved=options;
+    if(channel_handle)
+        uninitialize();
+    TPCANStatus result=fd?initialize_fd(channel,bitrate_fd):initialize(channel,bitrate);
+    if(result==PCAN_ERROR_OK){
+        for(auto option : saved)
+            set_value(option.first,&option.second,sizeof(option.second));
+    }
+    else{
+        options=saved;
+    }
+    return result;
+}
+
+bool CanTransport::acquire_echo()
+{
+    if(echo_users){
+        echo_users++;
+        return true;
+    }
+    echo_before=PCAN_PARAMETER_OFF;
+    get_value(PCAN_ALLOW_ECHO_FRAMES,&echo_before,sizeof(echo_before));
+    DWORD on=PCAN_PARAMETER_ON;
+    if(set_value(PCAN_ALLOW_ECHO_FRAMES,&on,sizeof(on))!=PCAN_ERROR_OK)
+        return false;
+    echo_users=1;
+    return true;
+}
+
+void CanTransport::release_echo()
+{
+    if(!echo_users||--echo_users)
+        return;
+    if(echo_before!=PCAN_PARAMETER_ON){
+        DWORD off=PCAN_PARAMETER_OFF;
+        set_value(PCAN_ALLOW_ECHO_FRAMES,&off,sizeof(off));
+    }
+}
+
+void CanTransport::remember_option(TPCANParameter param, const void *buffer, DWORD len)
+{
+    //the on/off style channel options, enough to restore a channel
+    if(len!=sizeof(DWORD))
+        return;
+    const DWORD value=*static_cast<const DWORD*>(buffer);
+    for(auto &option : options){
+        if(option.first==param){
+            option.second=value;
+            return;
+        }
+    }
+    options.append(qMakePair(param,value));
+}
+
+//----------------------------------------------------------------------------
+// PcanTransport
+//----------------------------------------------------------------------------
+TPCANStatus PcanTransport::initialize(TPCANHandle channel, TPCANBaudrate bitrate)
+{
+    TPCANStatus result=CAN_Initialize(channel,bitrate);
+    if(result==PCAN_ERROR_OK){
+        channel_handle=last_channel=channel;
+        fd_mode=last_fd_mode=false;
+        last_bitrate=bitrate;
+    }
+    return result;
+}
+
+TPCANStatus PcanTransport::initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd)
+{
+    //CAN_InitializeFD takes a non-const string
+    QByteArray tmp=bitrate_fd;
+    TPCANStatus result=CAN_InitializeFD(channel,tmp.data());
+    if(result==PCAN_ERROR_OK){
+        channel_handle=last_channel=channel;
+        fd_mode=last_fd_mode=true;
+        last_bitrate_fd=bitrate_fd;
+    }
+    return result;
+}
+
+TPCANStatus PcanTransport::uninitialize()
+{
+    TPCANStatus result=CAN_Uninitialize(channel_handle);
+    channel_handle=0;
+    fd_mode=false;
+    options.clear();
+    return result;
+}
+
+TPCANStatus PcanTransport::read(canFrame &frame)
+{
+    if(fd_mode)
+        return CAN_ReadFD(channel_handle,&frame.msg,&frame.ts_us);
+
+    TPCANMsg msg;
+    TPCANTimestamp timestamp;
+    TPCANStatus result=CAN_Read(channel_handle,&msg,&timestamp);
+    if(result==PCAN_ERROR_OK){
+        frame.msg=can_msg_to_fd(msg);
+        frame.ts_us=can_timestamp_to_fd(timestamp);
+    }
+    return result;
+}
+
+TPCANStatus PcanTransport::write(const TPCANMsgFD &msg)
+{
+    TPCANMsgFD tmp=msg;
+    if(fd_mode)
+        return CAN_WriteFD(channel_handle,&tmp);
+
+    if(msg.DLC>8)
+        return PCAN_ERROR_ILLDATA;
+    TPCANMsg classic;
+    classic.ID=msg.ID;
+    classic.MSGTYPE=msg.MSGTYPE;
+    classic.LEN=msg.DLC;
+    for(int i=0;i<8;i++)
+        classic.DATA[i]=msg.DATA[i];
+    return CAN_Write(channel_handle,&classic);
+}
+
+TPCANStatus PcanTransport::status()
+{
+    return CAN_GetStatus(channel_handle);
+}
+
+TPCANStatus PcanTransport::reset()
+{
+    return CAN_Reset(channel_handle);
+}
+
+TPCANStatus PcanTransport::get_value(TPCANParameter param, void *buffer, DWORD len)
+{
+    return CAN_GetValue(channel_handle,param,buffer,len);
+}
+
+TPCANStatus PcanTransport::set_value(TPCANParameter param, void *buffer, DWORD len)
+{
+    TPCANStatus result=CAN_SetValue(channel_handle,param,buffer,len);
+    if(result==PCAN_ERROR_OK)
+        remember_option(param,buffer,len);
+    return result;
+}
+
+TPCANStatus PcanTransport::preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len)
+{
+    return CAN_SetValue(channel,param,buffer,len);
+}
+
+//----------------------------------------------------------------------------
+// VirtualCanBus
+//----------------------------------------------------------------------------
+VirtualCanBus::VirtualCanBus()
+    : t0_ns(steady_ns())
+{
+}
+
+void VirtualCanBus::attach(VirtualTransport *endpoint)
+{
+    QMutexLocker lock(&mutex);
+    if(!endpoints.contains(endpoint))
+        endpoints.append(endpoint);
+}
+
+void VirtualCanBus::detach(VirtualTransport *endpoint)
+{
+    QMutexLocker lock(&mutex);
+    endpoints.removeAll(endpoint);
+}
+
+TPCANTimestampFD VirtualCanBus::now_us() const
+{
+    return TPCANTimestampFD((steady_ns()-t0_ns)/1000);
+}
+
+TPCANStatus VirtualCanBus::transmit(VirtualTransport *sender, const TPCANMsgFD &msg)
+{
+    canFrame frame;
+    frame.msg=msg;
+    frame.ts_us=now_us();
+
+    QMutexLocker lock(&mutex);
+    for(VirtualTransport *endpoint : qAsConst(endpoints)){
+        if(endpoint==sender){
+            if(sender->echo_frames){
+                canFrame echo=frame;
+                echo.msg.MSGTYPE|=PCAN_MESSAGE_ECHO;
+                endpoint->deliver(echo);
+            }
+            continue;
+        }
+        //a classic controller cannot receive FD frames
+        if((msg.MSGTYPE&PCAN_MESSAGE_FD)&&!endpoint->is_fd())
+            continue;
+        if(!endpoint->same_bit_timing(sender)){
+            endpoint->deliver_bit_error(frame.ts_us);
+            continue;
+        }
+        endpoint->deliver(frame);
+    }
+    return PCAN_ERROR_OK;
+}
+
+//----------------------------------------------------------------------------
+// VirtualTransport
+//----------------------------------------------------------------------------
+VirtualTransport::VirtualTransport(VirtualCanBus *bus, int rx_queue_size)
+    : bus(bus)
+    , rx_queue_size(rx_queue_size)
+{
+}
+
+VirtualTransport::~VirtualTransport()
+{
+    bus->detach(this);
+}
+
+TPCANStatus VirtualTransport::initialize(TPCANHandle channel, TPCANBaudrate bitrate)
+{
+    last_bitrate=bitrate;
+    channel_handle=last_channel=channel;
+    fd_mode=last_fd_mode=false;
+    initialized=true;
+    bus->attach(this);
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus VirtualTransport::initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd)
+{
+    last_bitrate_fd=bitrate_fd;
+    channel_handle=last_channel=channel;
+    fd_mode=last_fd_mode=true;
+    initialized=true;
+    bus->attach(this);
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus VirtualTransport::uninitialize()
+{
+    bus->detach(this);
+    QMutexLocker lock(&mutex);
+    rx_queue.clear();
+    initialized=false;
+    injected_status=PCAN_ERROR_OK;
+    rx_errors=0;
+    options.clear();
+    return PCAN_ERROR_OK;
+}
+
+void VirtualTransport::inject_bus_status(TPCANStatus status)
+{
+    QMutexLocker lock(&mutex);
+    injected_status=status;
+    injected_at_us=bus->now_us();
+    if(!error_frames)
+        return;
+    //status change notification, the new state is read back with status()
+    canFrame frame;
+    frame.msg.MSGTYPE=PCAN_MESSAGE_STATUS;
+    frame.msg.DLC=4;
+    frame.ts_us=injected_at_us;
+    if(int(rx_queue.size())<rx_queue_size)
+        rx_queue.push_back(frame);
+}
+
+void VirtualTransport::inject_error_frame(uchar error_type, uchar rx_counter, uchar tx_counter)
+{
+    QMutexLocker lock(&mutex);
+    if(!error_frames||int(rx_queue.size())>=rx_queue_size)
+        return;
+    canFrame frame;
+    frame.msg.ID=error_type;
+    frame.msg.MSGTYPE=PCAN_MESSAGE_ERRFRAME;
+    frame.msg.DLC=4;
+    frame.msg.DATA[2]=rx_counter;
+    frame.msg.DATA[3]=tx_counter;
+    frame.ts_us=bus->now_us();
+    rx_queue.push_back(frame);
+}
+
+bool VirtualTransport::same_bit_timing(const VirtualTransport *other) const
+{
+    //classic and FD controllers are not compared, the nominal rate of a
+    //bit rate string is not decoded here
+    if(fd_mode!=other->fd_mode)
+        return true;
+    return fd_mode?last_bitrate_fd==other->last_bitrate_fd:last_bitrate==other->last_bitrate;
+}
+
+void VirtualTransport::deliver_bit_error(TPCANTimestampFD ts_us)
+{
+    QMutexLocker lock(&mutex);
+    if(bus_status()&PCAN_ERROR_BUSOFF)
+        return;
+    rx_errors=qMin(rx_errors+1,255);
+    if(!error_frames||int(rx_queue.size())>=rx_queue_size)
+        return;
+    canFrame frame;
+    frame.msg.ID=4;     //stuff error
+    frame.msg.MSGTYPE=PCAN_MESSAGE_ERRFRAME;
+    frame.msg.DLC=4;
+    frame.msg.DATA[2]=uchar(rx_errors);
+    frame.ts_us=ts_us;
+    rx_queue.push_back(frame);
+}
+
+//call with the mutex held
+TPCANStatus VirtualTransport::bus_status()
+{
+    if((injected_status&PCAN_ERROR_BUSOFF)&&busoff_autoreset
+            &&bus->now_us()-injected_at_us>=busoff_recovery_us)
+        injected_status=PCAN_ERROR_OK;
+    if(injected_status!=PCAN_ERROR_OK)
+        return injected_status;
+    return rx_errors>=128?PCAN_ERROR_BUSPASSIVE:rx_errors>=96?PCAN_ERROR_BUSWARNING:PCAN_ERROR_OK;
+}
+
+void VirtualTransport::deliver(const canFrame &frame)
+{
+    QMutexLocker lock(&mutex);
+    //a bus-off controller takes no part in the bus
+    if(bus_status()&PCAN_ERROR_BUSOFF)
+        return;
+    if(int(rx_queue.size())>=rx_queue_size){
+        rx_overrun=true;
+        return;
+    }
+    if(rx_errors)
+        rx_errors--;
+    rx_queue.push_back(frame);
+}
+
+TPCANStatus VirtualTransport::read(canFrame &frame)
+{
+    if(!initialized)
+        return PCAN_ERROR_INITIALIZE;
+
+    QMutexLocker lock(&mutex);
+    if(rx_queue.empty()){
+        TPCANStatus status=bus_status();
+        return status&PCAN_ERROR_ANYBUSERR?status:PCAN_ERROR_QRCVEMPTY;
+    }
+    //the overrun comes alone, the frame after the gap stays for the next read
+    if(rx_overrun){
+        rx_overrun=false;
+        return PCAN_ERROR_QOVERRUN;
+    }
+    frame=rx_queue.front();
+    rx_queue.pop_front();
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus VirtualTransport::write(const TPCANMsgFD &msg)
+{
+    if(!initialized)
+        return PCAN_ERROR_INITIALIZE;
+    if(!fd_mode&&msg.DLC>8)
+        return PCAN_ERROR_ILLDATA;
+    {
+        QMutexLocker lock(&mutex);
+        if(listen_only)
+            return PCAN_ERROR_ILLOPERATION;
+        if(bus_status()&PCAN_ERROR_BUSOFF)
+            return PCAN_ERROR_BUSOFF;
+    }
+    return bus->transmit(this,msg);
+}
+
+TPCANStatus VirtualTransport::status()
+{
+    if(!initialized)
+        return PCAN_ERROR_INITIALIZE;
+    QMutexLocker lock(&mutex);
+    return bus_status();
+}
+
+TPCANStatus VirtualTransport::reset()
+{
+    QMutexLocker lock(&mutex);
+    rx_queue.clear();
+    rx_overrun=false;
+    injected_status=PCAN_ERROR_OK;
+    rx_errors=0;
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus VirtualTransport::get_value(TPCANParameter param, void *buffer, DWORD len)
+{
+    bool *flag=param==PCAN_ALLOW_ECHO_FRAMES?&echo_frames
+              :param==PCAN_ALLOW_ERROR_FRAMES?&error_frames
+              :param==PCAN_BUSOFF_AUTORESET?&busoff_autoreset
+              :param==PCAN_LISTEN_ONLY?&listen_only:nullptr;
+    if(flag&&len>=sizeof(DWORD)){
+        *static_cast<DWORD*>(buffer)=*flag?PCAN_PARAMETER_ON:PCAN_PARAMETER_OFF;
+        return PCAN_ERROR_OK;
+    }
+    return PCAN_ERROR_ILLPARAMTYPE;
+}
+
+TPCANStatus VirtualTransport::set_value(TPCANParameter param, void *buffer, DWORD len)
+{
+    bool *flag=param==PCAN_ALLOW_ECHO_FRAMES?&echo_frames
+              :param==PCAN_ALLOW_ERROR_FRAMES?&error_frames
+              :param==PCAN_BUSOFF_AUTORESET?&busoff_autoreset
+              :param==PCAN_LISTEN_ONLY?&listen_only:nullptr;
+    if(flag&&len>=sizeof(DWORD)){
+        QMutexLocker lock(&mutex);
+        *flag=*static_cast<DWORD*>(buffer)==PCAN_PARAMETER_ON;
+        remember_option(param,buffer,len);
+        return PCAN_ERROR_OK;
+    }
+    return PCAN_ERROR_ILLPARAMTYPE;
+}
+
+TPCANStatus VirtualTransport::preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len)
+{
+    Q_UNUSED(channel);
+    if(param!=PCAN_LISTEN_ONLY||len<sizeof(DWORD))
+        return PCAN_ERROR_ILLPARAMTYPE;
+    QMutexLocker lock(&mutex);
+    listen_only=*static_cast<DWORD*>(buffer)==PCAN_PARAMETER_ON;
+    return PCAN_ERROR_OK;
+}
+
+#ifdef Q_OS_LINUX
+//----------------------------------------------------------------------------
+// SocketCanTransport
+//----------------------------------------------------------------------------
+SocketCanTransport::SocketCanTransport(const QByteArray &interface)
+    : ifname(interface)
+{
+}
+
+SocketCanTransport::~SocketCanTransport()
+{
+    if(sock>=0)
+        ::close(sock);
+}
+
+TPCANStatus SocketCanTransport::open_socket(TPCANHandle channel, bool fd)
+{
+    if(sock>=0)
+        return PCAN_ERROR_INITIALIZE;
+    const int s=::socket(PF_CAN,SOCK_RAW|SOCK_NONBLOCK,CAN_RAW);
+    if(s<0)
+        return PCAN_ERROR_NODRIVER;
+
+    ifreq ifr;
+    memset(&ifr,0,sizeof(ifr));
+    strncpy(ifr.ifr_name,ifname.constData(),IFNAMSIZ-1);
+    if(::ioctl(s,SIOCGIFINDEX,&ifr)<0){
+        ::close(s);
+        return PCAN_ERROR_ILLHW;
+    }
+    const int on=1;
+    if(fd&&::setsockopt(s,SOL_CAN_RAW,CAN_RAW_FD_FRAMES,&on,sizeof(on))<0){
+        ::close(s);
+        return PCAN_ERROR_ILLMODE;
+    }
+    ::setsockopt(s,SOL_SOCKET,SO_TIMESTAMP,&on,sizeof(on));
+    //error frames are always taken, the bus state is read from them
+    const can_err_mask_t errors=CAN_ERR_MASK;
+    ::setsockopt(s,SOL_CAN_RAW,CAN_RAW_ERR_FILTER,&errors,sizeof(errors));
+
+    sockaddr_can addr;
+    memset(&addr,0,sizeof(addr));
+    addr.can_family=AF_CAN;
+    addr.can_ifindex=ifr.ifr_ifindex;
+    if(::bind(s,reinterpret_cast<sockaddr*>(&addr),sizeof(addr))<0){
+        ::close(s);
+        return PCAN_ERROR_ILLHW;
+    }
+    sock=s;
+    channel_handle=last_channel=channel;
+    fd_mode=last_fd_mode=fd;
+    bus_state=PCAN_ERROR_OK;
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus SocketCanTransport::initialize(TPCANHandle channel, TPCANBaudrate bitrate)
+{
+    TPCANStatus result=open_socket(channel,false);
+    if(result==PCAN_ERROR_OK)
+        last_bitrate=bitrate;
+    return result;
+}
+
+TPCANStatus SocketCanTransport::initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd)
+{
+    TPCANStatus result=open_socket(channel,true);
+    if(result==PCAN_ERROR_OK)
+        last_bitrate_fd=bitrate_fd;
+    return result;
+}
+
+TPCANStatus SocketCanTransport::uninitialize()
+{
+    if(sock>=0)
+        ::close(sock);
+    sock=-1;
+    channel_handle=0;
+    fd_mode=false;
+    echo_frames=false;
+    error_frames=false;
+    options.clear();
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus SocketCanTransport::read(canFrame &frame)
+{
+    if(sock<0)
+        return PCAN_ERROR_INITIALIZE;
+
+    for(;;){
+        canfd_frame cf;
+        iovec iov;
+        iov.iov_base=&cf;
+        iov.iov_len=sizeof(cf);
+        char control[CMSG_SPACE(sizeof(timeval))];
+        msghdr mh;
+        memset(&mh,0,sizeof(mh));
+        mh.msg_iov=&iov;
+        mh.msg_iovlen=1;
+        mh.msg_control=control;
+        mh.msg_controllen=sizeof(control);
+
+        const ssize_t n=::recvmsg(sock,&mh,0);
+        if(n<0){
+            if(errno==EAGAIN||errno==EWOULDBLOCK)
+                return bus_state&PCAN_ERROR_ANYBUSERR?bus_state:PCAN_ERROR_QRCVEMPTY;
+            return PCAN_ERROR_UNKNOWN;
+        }
+        if(n!=CAN_MTU&&n!=CANFD_MTU)
+            continue;
+
+        frame=canFrame();
+        for(cmsghdr *c=CMSG_FIRSTHDR(&mh);c;c=CMSG_NXTHDR(&mh,c)){
+            if(c->cmsg_level==SOL_SOCKET&&c->cmsg_type==SO_TIMESTAMP){
+                timeval tv;
+                memcpy(&tv,CMSG_DATA(c),sizeof(tv));
+                frame.ts_us=TPCANTimestampFD(tv.tv_sec)*1000000+TPCANTimestampFD(tv.tv_usec);
+            }
+        }
+
+        if(cf.can_id&CAN_ERR_FLAG){
+            if(cf.can_id&CAN_ERR_BUSOFF)
+                bus_state=PCAN_ERROR_BUSOFF;
+            else if(cf.can_id&CAN_ERR_RESTARTED)
+                bus_state=PCAN_ERROR_OK;
+            else if(cf.can_id&CAN_ERR_CRTL){
+                if(cf.data[1]&(CAN_ERR_CRTL_RX_PASSIVE|CAN_ERR_CRTL_TX_PASSIVE))
+                    bus_state=PCAN_ERROR_BUSPASSIVE;
+                else if(cf.data[1]&(CAN_ERR_CRTL_RX_WARNING|CAN_ERR_CRTL_TX_WARNING))
+                    bus_state=PCAN_ERROR_BUSWARNING;
+                else if(cf.data[1]&CAN_ERR_CRTL_ACTIVE)
+                    bus_state=PCAN_ERROR_OK;
+            }
+            if(!error_frames)
+                continue;
+            //same layout as the virtual bus: counters in bytes 2 and 3
+            frame.msg.ID=cf.can_id&CAN_ERR_MASK;
+            frame.msg.MSGTYPE=PCAN_MESSAGE_ERRFRAME;
+            frame.msg.DLC=4;
+            frame.msg.DATA[2]=cf.data[7];
+            frame.msg.DATA[3]=cf.data[6];
+            return PCAN_ERROR_OK;
+        }
+
+        const bool extended=cf.can_id&CAN_EFF_FLAG;
+        frame.msg.ID=cf.can_id&(extended?CAN_EFF_MASK:CAN_SFF_MASK);
+        frame.msg.MSGTYPE=extended?PCAN_MESSAGE_EXTENDED:PCAN_MESSAGE_STANDARD;
+        if(cf.can_id&CAN_RTR_FLAG)
+            frame.msg.MSGTYPE|=PCAN_MESSAGE_RTR;
+        if(n==CANFD_MTU){
+            frame.msg.MSGTYPE|=PCAN_MESSAGE_FD;
+            if(cf.flags&CANFD_BRS)
+                frame.msg.MSGTYPE|=PCAN_MESSAGE_BRS;
+            if(cf.flags&CANFD_ESI)
+                frame.msg.MSGTYPE|=PCAN_MESSAGE_ESI;
+        }
+        //MSG_CONFIRM: the frame was sent from this socket
+        if(mh.msg_flags&MSG_CONFIRM)
+            frame.msg.MSGTYPE|=PCAN_MESSAGE_ECHO;
+        const int len=qMin(int(cf.len),n==CANFD_MTU?64:8);
+        frame.msg.DLC=can_len_to_dlc(len);
+        memcpy(frame.msg.DATA,cf.data,size_t(len));
+        return PCAN_ERROR_OK;
+    }
+}
+
+TPCANStatus SocketCanTransport::write(const TPCANMsgFD &msg)
+{
+    if(sock<0)
+        return PCAN_ERROR_INITIALIZE;
+    const bool fd_frame=msg.MSGTYPE&PCAN_MESSAGE_FD;
+    if(fd_frame?!fd_mode:msg.DLC>8)
+        return PCAN_ERROR_ILLDATA;
+    if(bus_state&PCAN_ERROR_BUSOFF)
+        return PCAN_ERROR_BUSOFF;
+
+    canfd_frame cf;
+    memset(&cf,0,sizeof(cf));
+    cf.can_id=msg.ID;
+    if(msg.MSGTYPE&PCAN_MESSAGE_EXTENDED)
+        cf.can_id|=CAN_EFF_FLAG;
+    if(msg.MSGTYPE&PCAN_MESSAGE_RTR)
+        cf.can_id|=CAN_RTR_FLAG;
+    cf.len=uchar(can_dlc_to_len(msg.DLC));
+    if(msg.MSGTYPE&PCAN_MESSAGE_BRS)
+        cf.flags|=CANFD_BRS;
+    memcpy(cf.data,msg.DATA,cf.len);
+
+    const size_t size=fd_frame?CANFD_MTU:CAN_MTU;
+    if(::write(sock,&cf,size)==ssize_t(size))
+        return PCAN_ERROR_OK;
+    return errno==ENOBUFS||errno==EAGAIN?PCAN_ERROR_QXMTFULL:PCAN_ERROR_UNKNOWN;
+}
+
+TPCANStatus SocketCanTransport::status()
+{
+    if(sock<0)
+        return PCAN_ERROR_INITIALIZE;
+    return bus_state;
+}
+
+TPCANStatus SocketCanTransport::reset()
+{
+    if(sock<0)
+        return PCAN_ERROR_INITIALIZE;
+    //the receive queue is emptied, as CAN_Reset does
+    canfd_frame cf;
+    while(::recv(sock,&cf,sizeof(cf),0)>0){
+    }
+    bus_state=PCAN_ERROR_OK;
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus SocketCanTransport::get_value(TPCANParameter param, void *buffer, DWORD len)
+{
+    bool *flag=param==PCAN_ALLOW_ECHO_FRAMES?&echo_frames
+              :param==PCAN_ALLOW_ERROR_FRAMES?&error_frames:nullptr;
+    if(flag&&len>=sizeof(DWORD)){
+        *static_cast<DWORD*>(buffer)=*flag?PCAN_PARAMETER_ON:PCAN_PARAMETER_OFF;
+        return PCAN_ERROR_OK;
+    }
+    return PCAN_ERROR_ILLPARAMTYPE;
+}
+
+TPCANStatus SocketCanTransport::set_value(TPCANParameter param, void *buffer, DWORD len)
+{
+    if(sock<0)
+        return PCAN_ERROR_INITIALIZE;
+    if(len<sizeof(DWORD)||(param!=PCAN_ALLOW_ECHO_FRAMES&&param!=PCAN_ALLOW_ERROR_FRAMES))
+        return PCAN_ERROR_ILLPARAMTYPE;
+    const bool on=*static_cast<DWORD*>(buffer)==PCAN_PARAMETER_ON;
+    if(param==PCAN_ALLOW_ECHO_FRAMES){
+        const int value=on;
+        if(::setsockopt(sock,SOL_CAN_RAW,CAN_RAW_RECV_OWN_MSGS,&value,sizeof(value))<0)
+            return PCAN_ERROR_ILLOPERATION;
+        echo_frames=on;
+    }
+    else{
+        error_frames=on;
+    }
+    remember_option(param,buffer,len);
+    return PCAN_ERROR_OK;
+}
+
+TPCANStatus SocketCanTransport::preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len)
+{
+    //listen-only is a setting of the interface (ip link ... listen-only on),
+    //not of a socket
+    Q_UNUSED(channel);
+    Q_UNUSED(param);
+    Q_UNUSED(buffer);
+    Q_UNUSED(len);
+    return PCAN_ERROR_ILLPARAMTYPE;
+}
+#endif
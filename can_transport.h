@@ -0,0 +1,237 @@
+#ifndef CAN_TRANSPORT_H
+#define CAN_TRANSPORT_H
+
+#include "include/PCANBasic.h"
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QMutex>
+#include <deque>
+
+//a received frame, always carried in the FD layout so classic and FD
+//channels share one decode path
+struct canFrame{
+    TPCANMsgFD msg={};
+    TPCANTimestampFD ts_us=0;  //hardware timestamp [us]
+    qint64 host_us=0;          //ts_us mapped to the host monotonic clock [us]
+};
+
+//CAN FD data length code <-> payload length
+inline int can_dlc_to_len(uchar dlc)
+{
+    static const uchar lens[16]={0,1,2,3,4,5,6,7,8,12,16,20,24,32,48,64};
+    return lens[dlc&0x0F];
+}
+inline uchar can_len_to_dlc(int len)
+{
+    if(len<=8) return uchar(len<0?0:len);
+    if(len<=12) return 9;
+    if(len<=16) return 10;
+    if(len<=20) return 11;
+    if(len<=24) return 12;
+    if(len<=32) return 13;
+    if(len<=48) return 14;
+    return 15;
+}
+
+//classic message/timestamp -> FD layout
+inline TPCANMsgFD can_msg_to_fd(const TPCANMsg &msg)
+{
+    TPCANMsgFD fd={};
+    fd.ID=msg.ID;
+    fd.MSGTYPE=msg.MSGTYPE;
+    fd.DLC=msg.LEN;
+    for(int i=0;i<msg.LEN&&i<8;i++)
+        fd.DATA[i]=msg.DATA[i];
+    return fd;
+}
+inline TPCANTimestampFD can_timestamp_to_fd(const TPCANTimestamp &ts)
+{
+    //Total Microseconds = micros + 1000 * millis + 0x100000000 * 1000 * millis_overflow
+    return TPCANTimestampFD(ts.micros)
+            +1000ULL*ts.millis
+            +0x100000000ULL*1000ULL*ts.millis_overflow;
+}
+
+
+//abstraction over the PCAN-Basic channel calls, so the acquisition path can
+//run against real hardware or an in-process virtual bus
+class CanTransport
+{
+public:
+    virtual ~CanTransport() {}
+
+    virtual TPCANStatus initialize(TPCANHandle channel, TPCANBaudrate bitrate)=0;
+    virtual TPCANStatus initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd)=0;
+    virtual TPCANStatus uninitialize()=0;
+    //frame is only valid with PCAN_ERROR_OK; PCAN_ERROR_QOVERRUN reports
+    //lost frames without one, the queue is read on after it
+    virtual TPCANStatus read(canFrame &frame)=0;
+    virtual TPCANStatus write(const TPCANMsgFD &msg)=0;
+    virtual TPCANStatus status()=0;
+    virtual TPCANStatus reset()=0;
+    virtual TPCANStatus get_value(TPCANParameter param, void *buffer, DWORD len)=0;
+    virtual TPCANStatus set_value(TPCANParameter param, void *buffer, DWORD len)=0;
+    //option of a channel not initialized yet, applied by the next
+    //initialize(): PCAN_LISTEN_ONLY has to be on before the controller is
+    virtual TPCANStatus preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len)=0;
+
+    //uninitialize and initialize again with the last successful settings,
+    //channel options set since then are applied again
+    TPCANStatus reinitialize();
+
+    //echo frames shared by the timing consumers: the first acquire switches
+    //them on, the last release puts back the setting found by the first;
+    //false when the channel has no echo frames
+    bool acquire_echo();
+    void release_echo();
+
+    bool is_fd() const {return fd_mode;}
+    TPCANHandle channel() const {return channel_handle;}
+    //bit rate of the last successful initialization
+    TPCANBaudrate bitrate() const {return last_bitrate;}
+    const QByteArray &bitrate_fd() const {return last_bitrate_fd;}
+
+protected:
+    //implementations call this after a successful set_value
+    void remember_option(TPCANParameter param, const void *buffer, DWORD len);
+
+    TPCANHandle channel_handle=0;
+    bool fd_mode=false;
+    TPCANHandle last_channel=0;
+    bool last_fd_mode=false;
+    TPCANBaudrate last_bitrate=0;
+    QByteArray last_bitrate_fd;
+    QList<QPair<TPCANParameter,DWORD>> options;
+    int echo_users=0;
+    DWORD echo_before=PCAN_PARAMETER_OFF;
+};
+
+
+//PCAN-Basic hardware channel
+class PcanTransport : public CanTransport
+{
+public:
+    TPCANStatus initialize(TPCANHandle channel, TPCANBaudrate bitrate) override;
+    TPCANStatus initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd) override;
+    TPCANStatus uninitialize() override;
+    TPCANStatus read(canFrame &frame) override;
+    TPCANStatus write(const TPCANMsgFD &msg) override;
+    TPCANStatus status() override;
+    TPCANStatus reset() override;
+    TPCANStatus get_value(TPCANParameter param, void *buffer, DWORD len) override;
+    TPCANStatus set_value(TPCANParameter param, void *buffer, DWORD len) override;
+    TPCANStatus preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len) override;
+};
+
+
+class VirtualTransport;
+
+//in-process bus: every frame written by one endpoint is delivered to all the
+//other attached endpoints, timestamped with the bus clock
+class VirtualCanBus
+{
+public:
+    VirtualCanBus();
+
+    void attach(VirtualTransport *endpoint);
+    void detach(VirtualTransport *endpoint);
+    TPCANStatus transmit(VirtualTransport *sender, const TPCANMsgFD &msg);
+    TPCANTimestampFD now_us() const;
+
+private:
+    QMutex mutex;
+    QList<VirtualTransport*> endpoints;
+    qint64 t0_ns;
+};
+
+class VirtualTransport : public CanTransport
+{
+public:
+    explicit VirtualTransport(VirtualCanBus *bus, int rx_queue_size=32768);
+    ~VirtualTransport() override;
+
+    TPCANStatus initialize(TPCANHandle channel, TPCANBaudrate bitrate) override;
+    TPCANStatus initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd) override;
+    TPCANStatus uninitialize() override;
+    TPCANStatus read(canFrame &frame) override;
+    TPCANStatus write(const TPCANMsgFD &msg) override;
+    TPCANStatus status() override;
+    TPCANStatus reset() override;
+    TPCANStatus get_value(TPCANParameter param, void *buffer, DWORD len) override;
+    TPCANStatus set_value(TPCANParameter param, void *buffer, DWORD len) override;
+    TPCANStatus preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len) override;
+
+    //called by the bus
+    void deliver(const canFrame &frame);
+    VirtualCanBus *virtual_bus() const {return bus;}
+
+    //called by the bus for a frame sent at another bit rate, which this
+    //controller only sees as a stuff error
+    void deliver_bit_error(TPCANTimestampFD ts_us);
+    bool same_bit_timing(const VirtualTransport *other) const;
+
+    //fault injection: a bus error status sticks until reset(), or until
+    //the auto-reset delay has passed when PCAN_BUSOFF_AUTORESET is on
+    void inject_bus_status(TPCANStatus status);
+    void inject_error_frame(uchar error_type, uchar rx_counter, uchar tx_counter);
+    void set_busoff_recovery_us(quint64 us) {busoff_recovery_us=us;}
+
+private:
+    friend class VirtualCanBus;
+
+    TPCANStatus bus_status();
+
+    VirtualCanBus *bus;
+    QMutex mutex;
+    std::deque<canFrame> rx_queue;
+    int rx_queue_size;
+    bool initialized=false;
+    bool rx_overrun=false;
+    bool echo_frames=false;
+    bool error_frames=false;
+    bool busoff_autoreset=false;
+    bool listen_only=false;
+    int rx_errors=0;            //receive error counter, warning at 96, passive at 128
+    TPCANStatus injected_status=PCAN_ERROR_OK;
+    TPCANTimestampFD injected_at_us=0;
+    quint64 busoff_recovery_us=3000;
+};
+
+#ifdef Q_OS_LINUX
+//Linux SocketCAN interface (can0, vcan0, ...). The bit rate is the one the
+//interface was brought up with, initialize() only binds to it; the handle
+//is kept for the channel() of the callers. Own frames come back tagged
+//PCAN_MESSAGE_ECHO when PCAN_ALLOW_ECHO_FRAMES is on, a bus-off error
+//frame sticks in status() until reset() or the controller restarts
+class SocketCanTransport : public CanTransport
+{
+public:
+    explicit SocketCanTransport(const QByteArray &interface);
+    ~SocketCanTransport() override;
+
+    TPCANStatus initialize(TPCANHandle channel, TPCANBaudrate bitrate) override;
+    TPCANStatus initialize_fd(TPCANHandle channel, const QByteArray &bitrate_fd) override;
+    TPCANStatus uninitialize() override;
+    TPCANStatus read(canFrame &frame) override;
+    TPCANStatus write(const TPCANMsgFD &msg) override;
+    TPCANStatus status() override;
+    TPCANStatus reset() override;
+    TPCANStatus get_value(TPCANParameter param, void *buffer, DWORD len) override;
+    TPCANStatus set_value(TPCANParameter param, void *buffer, DWORD len) override;
+    TPCANStatus preset_value(TPCANHandle channel, TPCANParameter param, void *buffer, DWORD len) override;
+
+    const QByteArray &interface_name() const {return ifname;}
+
+private:
+    TPCANStatus open_socket(TPCANHandle channel, bool fd);
+
+    QByteArray ifname;
+    int sock=-1;
+    bool echo_frames=false;
+    bool error_frames=false;
+    TPCANStatus bus_state=PCAN_ERROR_OK;
+};
+#endif
+
+#endif // CAN_TRANSPORT_H
@@ -0,0 +1,123 @@
+#ifndef CANOPEN_H
+#define CANOPEN_H
+
+#include "can_transport.h"
+
+//CiA 301 function codes (COB-ID = base + node id)
+#define CO_NMT              0x000
+#define CO_SYNC             0x080
+#define CO_EMCY             0x080
+#define CO_SDO_TX           0x580   //server -> client
+#define CO_SDO_RX           0x600   //client -> server
+#define CO_HEARTBEAT        0x700
+
+//CH100 manufacturer objects
+#define CH100_OD_BITRATE    0x2100  //UNSIGNED32, bit/s
+#define CH100_OD_NODE_ID    0x2101  //UNSIGNED32
+
+//CH100 TPDO 1..5 COB-ID bases
+static const uint ch100_tpdo_base[5]={0x180,0x280,0x380,0x480,0x680};
+
+//expedited SDO command specifiers
+#define SDO_UPLOAD_REQ      0x40
+#define SDO_DOWNLOAD_1B     0x2F
+#define SDO_DOWNLOAD_2B     0x2B
+#define SDO_DOWNLOAD_3B     0x27
+#define SDO_DOWNLOAD_4B     0x23
+#define SDO_DOWNLOAD_RESP   0x60
+#define SDO_ABORT           0x80
+
+//CiA 301 abort codes
+#define SDO_ABORT_TOGGLE        0x05030000u
+#define SDO_ABORT_TIMEOUT       0x05040000u
+#define SDO_ABORT_COMMAND       0x05040001u
+#define SDO_ABORT_BLKSIZE       0x05040002u
+#define SDO_ABORT_SEQNO         0x05040003u
+#define SDO_ABORT_CRC           0x05040004u
+#define SDO_ABORT_MEMORY        0x05040005u
+#define SDO_ABORT_NO_OBJECT     0x06020000u
+#define SDO_ABORT_LENGTH        0x06070010u
+
+//NMT commands
+#define NMT_START           0x01
+#define NMT_STOP            0x02
+#define NMT_PREOPERATIONAL  0x80
+#define NMT_RESET_NODE      0x81
+#define NMT_RESET_COMM      0x82
+
+inline TPCANMsgFD sdo_upload_request(int node, ushort index, uchar sub)
+{
+    TPCANMsgFD msg={};
+    msg.ID=CO_SDO_RX+node;
+    msg.DLC=8;
+    msg.DATA[0]=SDO_UPLOAD_REQ;
+    msg.DATA[1]=uchar(index&0xFF);
+    msg.DATA[2]=uchar(index>>8);
+    msg.DATA[3]=sub;
+    return msg;
+}
+
+inline TPCANMsgFD sdo_download_expedited(int node, ushort index, uchar sub, uint value, int size)
+{
+    static const uchar cmd[5]={0,SDO_DOWNLOAD_1B,SDO_DOWNLOAD_2B,SDO_DOWNLOAD_3B,SDO_DOWNLOAD_4B};
+    TPCANMsgFD msg={};
+    msg.ID=CO_SDO_RX+node;
+    msg.DLC=8;
+    msg.DATA[0]=cmd[size<1?1:(size>4?4:size)];
+    msg.DATA[1]=uchar(index&0xFF);
+    msg.DATA[2]=uchar(index>>8);
+    msg.DATA[3]=sub;
+    for(int i=0;i<4;i++)
+        msg.DATA[4+i]=uchar(value>>(8*i));
+    return msg;
+}
+
+inline TPCANMsgFD nmt_command(uchar command, int node)
+{
+    TPCANMsgFD msg={};
+    msg.ID=CO_NMT;
+    msg.DLC=2;
+    msg.DATA[0]=command;
+    msg.DATA[1]=uchar(node);
+    return msg;
+}
+
+inline TPCANMsgFD sdo_abort_request(int node, ushort index, uchar sub, uint code)
+{
+    TPCANMsgFD msg=sdo_download_expedited(node,index,sub,code,4);
+    msg.DATA[0]=SDO_ABORT;
+    return msg;
+}
+
+//CRC-16-CCITT (polynomial 0x1021, initial value 0) of block transfers
+inline quint16 sdo_crc16(const uchar *data, int len, quint16 crc=0)
+{
+    struct crcTable{
+        quint16 t[256];
+        crcTable()
+        {
+            for(int i=0;i<256;i++){
+                quint16 c=quint16(i<<8);
+                for(int b=0;b<8;b++)
+                    c=quint16(c&0x8000?(c<<1)^0x1021:c<<1);
+                t[i]=c;
+            }
+        }
+    };
+    static const crcTable table;
+    for(int i=0;i<len;i++)
+        crc=quint16(crc<<8^table.t[(crc>>8^data[i])&0xFF]);
+    return crc;
+}
+
+inline ushort sdo_index(const TPCANMsgFD &msg)
+{
+    return ushort(msg.DATA[1]|msg.DATA[2]<<8);
+}
+
+inline uint sdo_value(const TPCANMsgFD &msg)
+{
+    return uint(msg.DATA[4])|uint(msg.DATA[5])<<8|uint(msg.DATA[6])<<16|uint(msg.DATA[7])<<24;
+}
+
+#endif // CANOPEN_H
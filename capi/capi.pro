@@ -0,0 +1,37 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 hide_symbols
+
+TEMPLATE = lib
+TARGET = pcanqt
+
+# shared library behind capi/pcanqt.h, loaded by python/pcanqt.py; only
+# the pq_* functions are exported
+DEFINES += PCANQT_BUILD
+
+SOURCES += \
+    ../can_transport.cpp \
+    ../capture_codec.cpp \
+    ../clock_sync.cpp \
+    ../imu_packing.cpp \
+    ../trace_import.cpp \
+    pcanqt.cpp \
+
+HEADERS += \
+    ../can_transport.h \
+    ../capture_codec.h \
+    ../clock_sync.h \
+    ../imu_packing.h \
+    ../include/PCANBasic.h \
+    ../trace_import.h \
+    pcanqt.h \
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../x86/ -lPCANBasic
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../x86/ -lPCANBasicd
+else:unix:!macx: LIBS += -L$$PWD/../ -lPCANBasic
+
+INCLUDEPATH += $$PWD/..
+# <Windows.h> of include/PCANBasic.h
+unix: INCLUDEPATH += $$PWD/../bench/compat
+DEPENDPATH += $$PWD/..
@@ -0,0 +1,384 @@
+#include "pcanqt.h"
+#include "capture_codec.h"
+#include "clock_sync.h"
+#include "imu_packing.h"
+#include "trace_import.h"
+#include <QFile>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//pq_frames converted per decode call
+#define PQ_FEED_BATCH       256
+
+static thread_local std::string pq_error;
+
+static void pq_set_error(const QString &text)
+{
+    pq_error=text.toStdString();
+}
+
+struct pq_samples{
+    std::vector<quint64> ts_us[IMU_SIG_COUNT];
+    std::vector<qint64> host_us[IMU_SIG_COUNT];
+    std::vector<uchar> nodes[IMU_SIG_COUNT];
+    std::vector<float> values[IMU_SIG_COUNT];   //4 per sample
+};
+
+struct pq_decoder{
+    ImuUnpacker unpacker;
+    int node_id=0;
+    pq_samples *pending=nullptr;
+};
+
+struct pq_capture{
+    CaptureReader reader;
+    bool pqc=false;
+    bool done=false;
+    std::vector<canFrame> frames;
+    size_t pos=0;
+};
+
+struct pq_channel{
+    PcanTransport can;
+    ClockSync clock;
+};
+
+static void pq_from_frame(const canFrame &in, pq_frame &out)
+{
+    out.ts_us=in.ts_us;
+    out.host_us=in.host_us;
+    out.id=in.msg.ID;
+    out.msgtype=in.msg.MSGTYPE;
+    out.dlc=in.msg.DLC;
+    out.len=uchar(can_dlc_to_len(in.msg.DLC));
+    out.reserved=0;
+    memcpy(out.data,in.msg.DATA,out.len);
+    memset(out.data+out.len,0,sizeof(out.data)-out.len);
+}
+
+static void pq_to_frame(const pq_frame &in, canFrame &out)
+{
+    out.ts_us=in.ts_us;
+    out.host_us=in.host_us;
+    out.msg.ID=in.id;
+    out.msg.MSGTYPE=in.msgtype;
+    out.msg.DLC=in.dlc&0x0F;
+    memcpy(out.msg.DATA,in.data,size_t(can_dlc_to_len(out.msg.DLC)));
+}
+
+static bool pq_signal_ok(const pq_samples *samples, int signal)
+{
+    return samples&&signal>=0&&signal<IMU_SIG_COUNT;
+}
+
+//----------------------------------------------------------------------------
+// Samples
+//----------------------------------------------------------------------------
+int pq_api_version(void)
+{
+    return PQ_API_VERSION;
+}
+
+const char *pq_last_error(void)
+{
+    return pq_error.c_str();
+}
+
+size_t pq_samples_count(const pq_samples *samples, int signal)
+{
+    return pq_signal_ok(samples,signal)?samples->ts_us[signal].size():0;
+}
+
+const uint64_t *pq_samples_ts_us(const pq_samples *samples, int signal)
+{
+    static_assert(sizeof(quint64)==sizeof(uint64_t),"ts_us layout");
+    return pq_signal_ok(samples,signal)?reinterpret_cast<const uint64_t*>(samples->ts_us[signal].data()):nullptr;
+}
+
+const int64_t *pq_samples_host_us(const pq_samples *samples, int signal)
+{
+    return pq_signal_ok(samples,signal)?reinterpret_cast<const int64_t*>(samples->host_us[signal].data()):nullptr;
+}
+
+const uint8_t *pq_samples_nodes(const pq_samples *samples, int signal)
+{
+    return pq_signal_ok(samples,signal)?samples->nodes[signal].data():nullptr;
+}
+
+const float *pq_samples_values(const pq_samples *samples, int signal)
+{
+    return pq_signal_ok(samples,signal)?samples->values[signal].data():nullptr;
+}
+
+void pq_samples_free(pq_samples *samples)
+{
+    delete samples;
+}
+
+//----------------------------------------------------------------------------
+// Decoder
+//----------------------------------------------------------------------------
+pq_decoder *pq_decoder_new(int node_id)
+{
+    if(node_id<0||node_id>127){
+        pq_set_error(QString("node ID %1 out of range").arg(node_id));
+        return nullptr;
+    }
+    pq_decoder *decoder=new pq_decoder;
+    decoder->node_id=node_id;
+    decoder->pending=new pq_samples;
+    return decoder;
+}
+
+void pq_decoder_free(pq_decoder *decoder)
+{
+    if(!decoder)
+        return;
+    delete decoder->pending;
+    delete decoder;
+}
+
+void pq_decoder_set_packing(pq_decoder *decoder, int packing)
+{
+    if(decoder&&packing>=IMU_PACK_NONE&&packing<=IMU_PACK_DELTA){
+        decoder->unpacker.set_packing(imuPacking(packing));
+        decoder->unpacker.reset();
+    }
+}
+
+void pq_decoder_set_sample_period_us(pq_decoder *decoder, int signal, uint32_t period_us)
+{
+    if(decoder&&signal>=0&&signal<IMU_SIG_COUNT)
+        decoder->unpacker.set_sample_period_us(signal,period_us);
+}
+
+//the same decode as the window's imu_parser(), every sample kept
+static size_t pq_decode(pq_decoder *decoder, const canFrame *frames, size_t n)
+{
+    pq_samples &out=*decoder->pending;
+    imuSample samples[IMU_FD_MAX_SAMPLES];
+    size_t added=0;
+    for(size_t i=0;i<n;i++){
+        const canFrame &frame=frames[i];
+        if(frame.msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_ERRFRAME|PCAN_MESSAGE_STATUS))
+            continue;
+        const int node=decoder->node_id?decoder->node_id:int(frame.msg.ID&0x7F);
+        if(node==0)
+            continue;
+        const int k=decoder->unpacker.decode(frame,node,samples,IMU_FD_MAX_SAMPLES);
+        for(int j=0;j<k;j++){
+            const imuSample &s=samples[j];
+            out.ts_us[s.signal].push_back(s.ts_us);
+            out.host_us[s.signal].push_back(s.host_us);
+            out.nodes[s.signal].push_back(s.node);
+            std::vector<float> &v=out.values[s.signal];
+            v.insert(v.end(),s.v,s.v+4);
+        }
+        added+=size_t(k);
+    }
+    return added;
+}
+
+size_t pq_decoder_feed(pq_decoder *decoder, const pq_frame *frames, size_t n)
+{
+    if(!decoder||!frames)
+        return 0;
+    canFrame batch[PQ_FEED_BATCH];
+    size_t added=0;
+    for(size_t i=0;i<n;i+=PQ_FEED_BATCH){
+        const size_t k=qMin(n-i,size_t(PQ_FEED_BATCH));
+        for(size_t j=0;j<k;j++)
+            pq_to_frame(frames[i+j],batch[j]);
+        added+=pq_decode(decoder,batch,k);
+    }
+    return added;
+}
+
+pq_samples *pq_decoder_take(pq_decoder *decoder)
+{
+    if(!decoder)
+        return nullptr;
+    pq_samples *samples=decoder->pending;
+    decoder->pending=new pq_samples;
+    return samples;
+}
+
+pq_samples *pq_decoder_decode_file(pq_decoder *decoder, const char *path)
+{
+    if(!decoder){
+        pq_set_error("no decoder");
+        return nullptr;
+    }
+    pq_capture *capture=pq_capture_open(path);
+    if(!capture)
+        return nullptr;
+
+    //whole blocks straight from the reader, no pq_frame round trip
+    bool ok=true;
+    if(capture->pqc){
+        while(capture->reader.next(capture->frames))
+            pq_decode(decoder,capture->frames.data(),capture->frames.size());
+        if(!capture->reader.error().isEmpty()){
+            pq_set_error(capture->reader.error());
+            ok=false;
+        }
+    }
+    else{
+        pq_decode(decoder,capture->frames.data(),capture->frames.size());
+    }
+    pq_capture_close(capture);
+    return ok?pq_decoder_take(decoder):nullptr;
+}
+
+//----------------------------------------------------------------------------
+// Capture files
+//----------------------------------------------------------------------------
+pq_capture *pq_capture_open(const char *path)
+{
+    const QString file_path=QString::fromUtf8(path?path:"");
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly)){
+        pq_set_error(QString("%1: %2").arg(file_path,file.errorString()));
+        return nullptr;
+    }
+    quint32 magic=0;
+    const bool pqc=file.read(reinterpret_cast<char*>(&magic),sizeof(magic))==qint64(sizeof(magic))&&magic==CAPTURE_MAGIC;
+
+    pq_capture *capture=new pq_capture;
+    capture->pqc=pqc;
+    if(pqc){
+        file.close();
+        if(!capture->reader.open(file_path)){
+            pq_set_error(QString("%1: %2").arg(file_path,capture->reader.error()));
+            delete capture;
+            return nullptr;
+        }
+        return capture;
+    }
+
+    //text traces are parsed whole, on all cores
+    const qint64 size=file.size();
+    uchar *data=size?file.map(0,size):nullptr;
+    if(size&&!data){
+        pq_set_error(QString("%1: %2").arg(file_path,file.errorString()));
+        delete capture;
+        return nullptr;
+    }
+    traceImportStats stats;
+    QString error;
+    const bool ok=TraceImporter::parse(reinterpret_cast<const char*>(data),size,capture->frames,stats,error);
+    if(data)
+        file.unmap(data);
+    if(!ok){
+        pq_set_error(QString("%1: %2").arg(file_path,error));
+        delete capture;
+        return nullptr;
+    }
+    return capture;
+}
+
+int pq_capture_read(pq_capture *capture, pq_frame *out, int max)
+{
+    if(!capture||!out||max<0){
+        pq_set_error("invalid argument");
+        return -1;
+    }
+    int n=0;
+    while(n<max){
+        if(capture->pos>=capture->frames.size()){
+            if(!capture->pqc||capture->done)
+                break;
+            capture->pos=0;
+            if(!capture->reader.next(capture->frames)){
+                capture->done=true;
+                if(!capture->reader.error().isEmpty()){
+                    pq_set_error(capture->reader.error());
+                    return n?n:-1;
+                }
+                break;
+            }
+            continue;
+        }
+        pq_from_frame(capture->frames[capture->pos++],out[n++]);
+    }
+    return n;
+}
+
+void pq_capture_close(pq_capture *capture)
+{
+    delete capture;
+}
+
+//----------------------------------------------------------------------------
+// Acquisition
+//----------------------------------------------------------------------------
+static QString pq_status_text(TPCANStatus status)
+{
+    char text[256];
+    if(CAN_GetErrorText(status,0,text)!=PCAN_ERROR_OK)
+        return QString("PCAN status 0x%1").arg(status,0,16);
+    return QString::fromLatin1(text);
+}
+
+pq_channel *pq_channel_open(uint16_t channel, uint16_t btr0btr1, const char *bitrate_fd)
+{
+    pq_channel *ch=new pq_channel;
+    TPCANStatus result;
+    if(bitrate_fd&&*bitrate_fd)
+        result=ch->can.initialize_fd(TPCANHandle(channel),QByteArray(bitrate_fd));
+    else
+        result=ch->can.initialize(TPCANHandle(channel),TPCANBaudrate(btr0btr1));
+    if(result!=PCAN_ERROR_OK){
+        pq_set_error(pq_status_text(result));
+        delete ch;
+        return nullptr;
+    }
+    return ch;
+}
+
+int pq_channel_read(pq_channel *channel, pq_frame *out, int max)
+{
+    if(!channel||!out||max<0){
+        pq_set_error("invalid argument");
+        return -1;
+    }
+    int n=0;
+    canFrame frame;
+    while(n<max){
+        const TPCANStatus result=channel->can.read(frame);
+        if(result&PCAN_ERROR_QRCVEMPTY)
+            break;
+        if(result!=PCAN_ERROR_OK){
+            pq_set_error(pq_status_text(result));
+            return n?n:-1;
+        }
+        channel->clock.stamp(frame,host_monotonic_us());
+        pq_from_frame(frame,out[n++]);
+    }
+    return n;
+}
+
+int pq_channel_write(pq_channel *channel, const pq_frame *frame)
+{
+    if(!channel||!frame){
+        pq_set_error("invalid argument");
+        return -1;
+    }
+    canFrame tx;
+    pq_to_frame(*frame,tx);
+    const TPCANStatus result=channel->can.write(tx.msg);
+    if(result!=PCAN_ERROR_OK){
+        pq_set_error(pq_status_text(result));
+        return -1;
+    }
+    return 0;
+}
+
+void pq_channel_close(pq_channel *channel)
+{
+    if(!channel)
+        return;
+    channel->can.uninitialize();
+    delete channel;
+}
@@ -0,0 +1,122 @@
+#ifndef PCANQT_H
+#define PCANQT_H
+
+/*
+ * C API of the PCAN_QT acquisition and CH100 decode, for tools in other
+ * languages (python/pcanqt.py). Plain C, no Qt types; every object is an
+ * opaque handle created and freed by the library.
+ *
+ * Decoded samples come out as pq_samples: per signal, columns of
+ * timestamps, node IDs and values laid out for direct array views. The
+ * columns never move or change until pq_samples_free(), so callers can
+ * wrap the pointers without copying.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(PCANQT_BUILD)
+#    define PQ_API __declspec(dllexport)
+#  else
+#    define PQ_API __declspec(dllimport)
+#  endif
+#else
+#  define PQ_API __attribute__((visibility("default")))
+#endif
+
+/* bumped when a function or struct changes incompatibly */
+#define PQ_API_VERSION      1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CH100 TPDO signals, same order as TPDO 1-4 */
+enum pq_signal{
+    PQ_SIG_ACC=0,   /* accelerometer [G] */
+    PQ_SIG_GYR,     /* gyroscope [deg/s] */
+    PQ_SIG_EUL,     /* Euler angles [deg] */
+    PQ_SIG_QUAT,    /* quaternion w x y z */
+    PQ_SIG_COUNT
+};
+
+/* how the node packs several samples into one TPDO */
+enum pq_packing{
+    PQ_PACK_NONE=0, /* one sample per classic frame (CH100 default) */
+    PQ_PACK_FD,     /* header + up to 15 samples in one FD frame */
+    PQ_PACK_DELTA   /* classic key frames and int8 delta bursts */
+};
+
+/* one CAN or CAN FD frame */
+typedef struct pq_frame{
+    uint64_t ts_us;     /* hardware timestamp, or trace time [us] */
+    int64_t host_us;    /* host monotonic clock [us] */
+    uint32_t id;
+    uint8_t msgtype;    /* PCAN_MESSAGE_* flags */
+    uint8_t dlc;        /* FD data length code */
+    uint8_t len;        /* payload bytes, set on output, ignored on input */
+    uint8_t reserved;
+    uint8_t data[64];
+} pq_frame;
+
+typedef struct pq_samples pq_samples;
+typedef struct pq_decoder pq_decoder;
+typedef struct pq_capture pq_capture;
+typedef struct pq_channel pq_channel;
+
+PQ_API int pq_api_version(void);
+/* message of the last call that failed on this thread, "" when none */
+PQ_API const char *pq_last_error(void);
+
+/* ---- decoded samples ---------------------------------------------- */
+PQ_API size_t pq_samples_count(const pq_samples *samples, int signal);
+/* sample times: the frame time, moved back by the sample period for the
+   earlier samples of a packed frame */
+PQ_API const uint64_t *pq_samples_ts_us(const pq_samples *samples, int signal);
+PQ_API const int64_t *pq_samples_host_us(const pq_samples *samples, int signal);
+PQ_API const uint8_t *pq_samples_nodes(const pq_samples *samples, int signal);
+/* count rows of 4 floats, scaled to physical units; 3-axis signals leave
+   the 4th column 0 */
+PQ_API const float *pq_samples_values(const pq_samples *samples, int signal);
+PQ_API void pq_samples_free(pq_samples *samples);
+
+/* ---- CH100 decode ------------------------------------------------- */
+/* node_id 0 decodes the TPDOs of every node */
+PQ_API pq_decoder *pq_decoder_new(int node_id);
+PQ_API void pq_decoder_free(pq_decoder *decoder);
+PQ_API void pq_decoder_set_packing(pq_decoder *decoder, int packing);
+/* TPDO event time of the signal, used to time packed samples */
+PQ_API void pq_decoder_set_sample_period_us(pq_decoder *decoder, int signal, uint32_t period_us);
+/* decodes frames into the pending samples, returns the samples added */
+PQ_API size_t pq_decoder_feed(pq_decoder *decoder, const pq_frame *frames, size_t n);
+/* hands over the pending samples, the decoder goes on with empty ones */
+PQ_API pq_samples *pq_decoder_take(pq_decoder *decoder);
+/* batch mode: decodes a whole capture file (see pq_capture_open) in one
+   call and returns its samples together with any pending ones; NULL on
+   error */
+PQ_API pq_samples *pq_decoder_decode_file(pq_decoder *decoder, const char *path);
+
+/* ---- capture files ------------------------------------------------ */
+/* .pqc captures, PCAN-View .trc, candump logs and Vector .asc; path is
+   UTF-8 */
+PQ_API pq_capture *pq_capture_open(const char *path);
+/* next frames in file order, 0 at the end, -1 on error */
+PQ_API int pq_capture_read(pq_capture *capture, pq_frame *out, int max);
+PQ_API void pq_capture_close(pq_capture *capture);
+
+/* ---- acquisition -------------------------------------------------- */
+/* PCAN-Basic channel (PCAN_USBBUS1...), classic with a BTR0BTR1 bitrate
+   or FD when bitrate_fd is a PCAN-Basic FD bitrate string */
+PQ_API pq_channel *pq_channel_open(uint16_t channel, uint16_t btr0btr1, const char *bitrate_fd);
+/* frames received since the last call, host_us from the adapter clock
+   fit; returns the count read (at most max) or -1 on a driver error */
+PQ_API int pq_channel_read(pq_channel *channel, pq_frame *out, int max);
+PQ_API int pq_channel_write(pq_channel *channel, const pq_frame *frame);
+PQ_API void pq_channel_close(pq_channel *channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCANQT_H */
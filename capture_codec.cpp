@@ -0,0 +1,259 @@
+#include "capture_codec.h"
+#include "clock_sync.h"
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+
+static inline void put_varint(QByteArray &out, quint64 v)
+{
+    while(v>=0x80){
+        out.append(char(v|0x80));
+        v>>=7;
+    }
+    out.append(char(v));
+}
+
+static inline bool get_varint(const uchar *&p, const uchar *end, quint64 &v)
+{
+    v=0;
+    for(int shift=0;shift<64&&p<end;shift+=7){
+        uchar b=*p++;
+        v|=quint64(b&0x7F)<<shift;
+        if(!(b&0x80))
+            return true;
+    }
+    return false;
+}
+
+static inline quint64 zigzag(qint64 v)
+{
+    return (quint64(v)<<1)^quint64(v>>63);
+}
+
+static inline qint64 unzigzag(quint64 v)
+{
+    return qint64(v>>1)^-qint64(v&1);
+}
+
+int capture_raw_size(const canFrame &frame)
+{
+    //ts 8, host 8, ID 4, type 1, DLC 1, payload
+    return 22+can_dlc_to_len(frame.msg.DLC);
+}
+
+//----------------------------------------------------------------------------
+// block codec
+//----------------------------------------------------------------------------
+namespace {
+//previous frame of a group, both sides of the codec keep the same state
+struct groupState{
+    quint64 ts=0;
+    qint64 delta=0;
+    qint64 offset=0;
+    uchar dlc=0;
+    uchar data[64]={0};
+};
+}
+
+void capture_encode(const canFrame *frames, int n, QByteArray &out)
+{
+    out.clear();
+    if(n<=0)
+        return;
+    out.reserve(n*8);
+
+    //groups in order of first appearance
+    QHash<quint64,int> group_of;
+    std::vector<std::vector<int>> groups;
+    for(int i=0;i<n;i++){
+        const quint64 key=quint64(frames[i].msg.ID)<<8|frames[i].msg.MSGTYPE;
+        int g=group_of.value(key,-1);
+        if(g<0){
+            g=int(groups.size());
+            group_of.insert(key,g);
+            groups.emplace_back();
+        }
+        groups[size_t(g)].push_back(i);
+    }
+
+    const quint64 base_ts=frames[0].ts_us;
+    put_varint(out,base_ts);
+    put_varint(out,groups.size());
+    for(const std::vector<int> &g : groups){
+        const TPCANMsgFD &first=frames[g.front()].msg;
+        put_varint(out,first.ID);
+        out.append(char(first.MSGTYPE));
+        put_varint(out,g.size());
+
+        groupState st;
+        st.ts=base_ts;
+        for(int i : g){
+            const canFrame &f=frames[i];
+            const qint64 delta=qint64(f.ts_us-st.ts);
+            const bool dlc_changed=f.msg.DLC!=st.dlc;
+            //delta of deltas is 0 for a steady period
+            put_varint(out,zigzag(delta-st.delta)<<1|(dlc_changed?1:0));
+            if(dlc_changed)
+                out.append(char(f.msg.DLC));
+            const qint64 offset=f.host_us-qint64(f.ts_us);
+            put_varint(out,zigzag(offset-st.offset));
+
+            const int len=can_dlc_to_len(f.msg.DLC);
+            const uchar *d=f.msg.DATA;
+            int b=0;
+            for(;b+1<len;b+=2){
+                qint16 cur=qint16(d[b]|d[b+1]<<8);
+                qint16 prev=qint16(st.data[b]|st.data[b+1]<<8);
+                put_varint(out,zigzag(qint16(cur-prev)));
+            }
+            if(b<len)
+                out.append(char(d[b]-st.data[b]));
+
+            st.ts=f.ts_us;
+            st.delta=delta;
+            st.offset=offset;
+            st.dlc=f.msg.DLC;
+            std::memcpy(st.data,d,size_t(len));
+        }
+    }
+}
+
+bool capture_decode(const QByteArray &in, std::vector<canFrame> &out)
+{
+    const uchar *p=reinterpret_cast<const uchar*>(in.constData());
+    const uchar *end=p+in.size();
+    const size_t start=out.size();
+    if(in.isEmpty())
+        return true;
+
+    quint64 base_ts,n_groups;
+    if(!get_varint(p,end,base_ts)||!get_varint(p,end,n_groups))
+        return false;
+    for(quint64 gi=0;gi<n_groups;gi++){
+        quint64 id,count;
+        if(!get_varint(p,end,id)||p>=end)
+            return false;
+        const uchar type=*p++;
+        if(!get_varint(p,end,count))
+            return false;
+        //every frame takes at least 2 bytes, never trust count further
+        if(count>quint64(end-p))
+            return false;
+
+        groupState st;
+        st.ts=base_ts;
+        for(quint64 k=0;k<count;k++){
+            quint64 v;
+            if(!get_varint(p,end,v))
+                return false;
+            if(v&1){
+                if(p>=end)
+                    return false;
+                st.dlc=*p++&0x0F;
+            }
+            st.delta+=unzigzag(v>>1);
+            st.ts+=quint64(st.delta);
+            if(!get_varint(p,end,v))
+                return false;
+            st.offset+=unzigzag(v);
+
+            const int len=can_dlc_to_len(st.dlc);
+            int b=0;
+            for(;b+1<len;b+=2){
+                if(!get_varint(p,end,v))
+                    return false;
+                qint16 prev=qint16(st.data[b]|st.data[b+1]<<8);
+                qint16 cur=qint16(prev+qint16(unzigzag(v)));
+                st.data[b]=uchar(quint16(cur)&0xFF);
+                st.data[b+1]=uchar(quint16(cur)>>8);
+            }
+            if(b<len){
+                if(p>=end)
+                    return false;
+                st.data[b]=uchar(st.data[b]+*p++);
+            }
+
+            canFrame f;
+            f.msg.ID=DWORD(id);
+            f.msg.MSGTYPE=type;
+            f.msg.DLC=st.dlc;
+            std::memcpy(f.msg.DATA,st.data,size_t(len));
+            f.ts_us=st.ts;
+            f.host_us=qint64(st.ts)+st.offset;
+            out.push_back(f);
+        }
+    }
+
+    //groups were written one after another, interleave them again
+    std::stable_sort(out.begin()+start,out.end(),[](const canFrame &a, const canFrame &b){
+        return a.ts_us<b.ts_us;
+    });
+    return p==end;
+}
+
+//----------------------------------------------------------------------------
+// CaptureReader
+//----------------------------------------------------------------------------
+bool CaptureReader::open(const QString &path)
+{
+    close();
+    file.setFileName(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        m_error=file.errorString();
+        return false;
+    }
+    if(file.read(reinterpret_cast<char*>(&header),sizeof(header))!=qint64(sizeof(header))
+            ||header.magic!=CAPTURE_MAGIC||header.version!=CAPTURE_VERSION){
+        m_error=QObject::tr("not a capture file");
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureReader::close()
+{
+    file.close();
+    header=captureFileHeader();
+    m_error.clear();
+    n_frames=0;
+    n_raw=0;
+    t_decode_us=0;
+}
+
+bool CaptureReader::next(std::vector<canFrame> &frames)
+{
+    frames.clear();
+    captureBlockHeader hdr;
+    if(file.read(reinterpret_cast<char*>(&hdr),sizeof(hdr))!=qint64(sizeof(hdr)))
+        return false;
+    QByteArray stored=file.read(hdr.stored_size);
+    if(stored.size()!=int(hdr.stored_size)){
+        m_error=QObject::tr("truncated block");
+        return false;
+    }
+
+    const qint64 t0=host_monotonic_us();
+    QByteArray encoded=qUncompress(stored);
+    frames.reserve(hdr.frames);
+    if(encoded.size()!=int(hdr.encoded_size)||!capture_decode(encoded,frames)||frames.size()!=hdr.frames){
+        m_error=QObject::tr("corrupt block");
+        frames.clear();
+        return false;
+    }
+    t_decode_us+=host_monotonic_us()-t0;
+
+    n_frames+=frames.size();
+    for(const canFrame &f : frames)
+        n_raw+=quint64(capture_raw_size(f));
+    return true;
+}
+
+bool CaptureReader::read_all(std::vector<canFrame> &frames)
+{
+    frames.clear();
+    std::vector<canFrame> block;
+    while(next(block))
+        frames.insert(frames.end(),block.begin(),block.end());
+    return m_error.isEmpty();
+}
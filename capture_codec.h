@@ -0,0 +1,71 @@
+#ifndef CAPTURE_CODEC_H
+#define CAPTURE_CODEC_H
+
+#include "can_transport.h"
+#include <QFile>
+#include <vector>
+
+//capture file (.pqc): a file header followed by independent blocks
+//
+//inside a block frames are grouped by (COB-ID, message type); per group
+//the timestamps are stored as varint delta-of-deltas, the host offset as
+//a varint delta and the payload as zigzag varint deltas of int16 words
+//against the previous frame of the same ID. Periodic TPDOs with slowly
+//changing data shrink to a few bytes per frame before qCompress runs
+#define CAPTURE_MAGIC           0x46435150u   //"PQCF"
+#define CAPTURE_VERSION         1u
+#define CAPTURE_BLOCK_FRAMES    8192
+
+struct captureFileHeader{
+    quint32 magic;
+    quint32 version;
+    qint64 created_ms;      //UTC, ms since epoch
+};
+
+struct captureBlockHeader{
+    quint32 frames;
+    quint32 encoded_size;   //before compression
+    quint32 stored_size;    //bytes following this header
+    quint32 reserved;
+    quint64 first_ts_us;
+    quint64 last_ts_us;
+};
+
+//size of a frame stored flat (timestamps, ID, type, DLC, payload), the
+//reference for compression ratios
+int capture_raw_size(const canFrame &frame);
+
+//frames -> encoded block, not yet compressed
+void capture_encode(const canFrame *frames, int n, QByteArray &out);
+//encoded block -> frames in timestamp order (appended to out)
+bool capture_decode(const QByteArray &in, std::vector<canFrame> &out);
+
+
+//sequential reader, blocks are decoded one at a time
+class CaptureReader
+{
+public:
+    bool open(const QString &path);
+    void close();
+    QString error() const {return m_error;}
+
+    //next block of frames, false at the end of the file or on error
+    bool next(std::vector<canFrame> &frames);
+    //whole file
+    bool read_all(std::vector<canFrame> &frames);
+
+    qint64 created_ms() const {return header.created_ms;}
+    quint64 frames_read() const {return n_frames;}
+    quint64 raw_bytes() const {return n_raw;}
+    qint64 decode_us() const {return t_decode_us;}
+
+private:
+    QFile file;
+    captureFileHeader header={};
+    QString m_error;
+    quint64 n_frames=0;
+    quint64 n_raw=0;
+    qint64 t_decode_us=0;
+};
+
+#endif // CAPTURE_CODEC_H
@@ -0,0 +1,196 @@
+#include "capture_writer.h"
+#include "clock_sync.h"
+#include <QDateTime>
+#include <QMutexLocker>
+
+//blocks waiting for the writer before frames are dropped
+#define CAPTURE_MAX_PENDING     64
+#define CAPTURE_FLUSH_MS        1000
+//written blocks kept for reuse when there is no block pool
+#define CAPTURE_SPARE_BLOCKS    2
+
+bool capture_write_header(QFile &file)
+{
+    captureFileHeader hdr;
+    hdr.magic=CAPTURE_MAGIC;
+    hdr.version=CAPTURE_VERSION;
+    hdr.created_ms=QDateTime::currentMSecsSinceEpoch();
+    return file.write(reinterpret_cast<const char*>(&hdr),sizeof(hdr))==qint64(sizeof(hdr));
+}
+
+bool capture_write_block(QFile &file, const canFrame *frames, int n, int level, captureStats &stats)
+{
+    const qint64 t0=host_monotonic_us();
+    QByteArray encoded;
+    capture_encode(frames,n,encoded);
+    QByteArray stored=qCompress(encoded,level);
+    const qint64 elapsed=host_monotonic_us()-t0;
+
+    captureBlockHeader hdr={};
+    hdr.frames=quint32(n);
+    hdr.encoded_size=quint32(encoded.size());
+    hdr.stored_size=quint32(stored.size());
+    hdr.first_ts_us=frames[0].ts_us;
+    hdr.last_ts_us=frames[0].ts_us;
+    quint64 raw=0;
+    for(int i=0;i<n;i++){
+        hdr.first_ts_us=qMin(hdr.first_ts_us,frames[i].ts_us);
+        hdr.last_ts_us=qMax(hdr.last_ts_us,frames[i].ts_us);
+        raw+=quint64(capture_raw_size(frames[i]));
+    }
+
+    stats.frames+=quint64(n);
+    stats.blocks++;
+    stats.raw_bytes+=raw;
+    stats.encoded_bytes+=quint64(encoded.size());
+    stats.stored_bytes+=sizeof(hdr)+quint64(stored.size());
+    stats.encode_us+=elapsed;
+    return file.write(reinterpret_cast<const char*>(&hdr),sizeof(hdr))==qint64(sizeof(hdr))
+            &&file.write(stored)==stored.size();
+}
+
+CaptureWriter::CaptureWriter(QObject *parent)
+    : QThread(parent)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+}
+
+bool CaptureWriter::open(const QString &path)
+{
+    close();
+    file.setFileName(path);
+    if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate)){
+        m_error=file.errorString();
+        return false;
+    }
+    capture_write_header(file);
+
+    m_stats=captureStats();
+    m_error.clear();
+    current.clear();
+    current.reserve(CAPTURE_BLOCK_FRAMES);
+    pending.reserve(size_t(qMax(CAPTURE_MAX_PENDING,pool_blocks)));
+    spare.reserve(size_t(qMax(CAPTURE_SPARE_BLOCKS,pool_blocks)));
+    //the whole pool up front, the current block is one of it
+    while(int(spare.size())<pool_blocks-1){
+        spare.emplace_back();
+        spare.back().reserve(CAPTURE_BLOCK_FRAMES);
+    }
+    quit=false;
+    start(QThread::LowPriority);
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    if(!isRunning()&&!file.isOpen())
+        return;
+    {
+        QMutexLocker lock(&mutex);
+        quit=true;
+        wake.wakeAll();
+    }
+    //the thread writes whatever is left before it exits
+    wait();
+    file.close();
+    current=std::vector<canFrame>();
+    spare.clear();
+}
+
+void CaptureWriter::append(const canFrame &frame)
+{
+    QMutexLocker lock(&mutex);
+    if(current.empty())
+        current_started_us=host_monotonic_us();
+    current.push_back(frame);
+    if(current.size()<CAPTURE_BLOCK_FRAMES)
+        return;
+
+    //a full queue drops the block and refills the same buffer
+    if(pool_blocks?spare.empty():pending.size()>=CAPTURE_MAX_PENDING){
+        m_stats.dropped+=current.size();
+        current.clear();
+        return;
+    }
+    pending.push_back(std::move(current));
+    wake.wakeOne();
+    next_block();
+}
+
+void CaptureWriter::next_block()
+{
+    if(!spare.empty()){
+        current=std::move(spare.back());
+        spare.pop_back();
+        return;
+    }
+    current=std::vector<canFrame>();
+    current.reserve(CAPTURE_BLOCK_FRAMES);
+}
+
+qint64 CaptureWriter::memory_bytes()
+{
+    QMutexLocker lock(&mutex);
+    size_t frames=current.capacity()+writing;
+    for(const std::vector<canFrame> &block : pending)
+        frames+=block.capacity();
+    for(const std::vector<canFrame> &block : spare)
+        frames+=block.capacity();
+    return qint64(frames*sizeof(canFrame));
+}
+
+captureStats CaptureWriter::stats()
+{
+    QMutexLocker lock(&mutex);
+    return m_stats;
+}
+
+void CaptureWriter::run()
+{
+    QMutexLocker lock(&mutex);
+    for(;;){
+        if(pending.empty()&&!quit)
+            wake.wait(&mutex,CAPTURE_FLUSH_MS);
+
+        //a slow stream still reaches the disk every second
+        if(pending.empty()&&!current.empty()
+                &&(quit||host_monotonic_us()-current_started_us>=CAPTURE_FLUSH_MS*1000LL)){
+            pending.push_back(std::move(current));
+            next_block();
+        }
+        if(pending.empty()){
+            if(quit)
+                break;
+            continue;
+        }
+
+        std::vector<canFrame> block=std::move(pending.front());
+        pending.erase(pending.begin());
+        writing=block.capacity();
+        lock.unlock();
+        captureStats st;
+        const bool ok=capture_write_block(file,block.data(),int(block.size()),compression_level,st);
+        lock.relock();
+        writing=0;
+        block.clear();
+        if(int(spare.size())<qMax(CAPTURE_SPARE_BLOCKS,pool_blocks))
+            spare.push_back(std::move(block));
+
+        m_stats.frames+=st.frames;
+        m_stats.blocks+=st.blocks;
+        m_stats.raw_bytes+=st.raw_bytes;
+        m_stats.encoded_bytes+=st.encoded_bytes;
+        m_stats.stored_bytes+=st.stored_bytes;
+        m_stats.encode_us+=st.encode_us;
+        if(!ok&&m_error.isEmpty()){
+            m_error=file.errorString();
+            lock.unlock();
+            emit failed(m_error);
+            lock.relock();
+        }
+    }
+}
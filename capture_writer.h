@@ -0,0 +1,82 @@
+#ifndef CAPTURE_WRITER_H
+#define CAPTURE_WRITER_H
+
+#include "capture_codec.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+
+struct captureStats{
+    quint64 frames=0;
+    quint64 blocks=0;
+    quint64 dropped=0;          //frames lost to a full write queue
+    quint64 raw_bytes=0;        //capture_raw_size() sum
+    quint64 encoded_bytes=0;
+    quint64 stored_bytes=0;
+    qint64 encode_us=0;         //delta encoding + compression time
+    double ratio() const {return stored_bytes?double(raw_bytes)/stored_bytes:0;}
+    double encode_mb_s() const {return encode_us?raw_bytes/double(encode_us):0;}
+};
+
+//file header and one block (header + compressed payload) appended to
+//file, shared by the recorder and the trigger dumps
+bool capture_write_header(QFile &file);
+bool capture_write_block(QFile &file, const canFrame *frames, int n, int level, captureStats &stats);
+
+//records frames into a .pqc capture. append() only copies the frame into
+//the current block; encoding, compression and file writes run on the
+//writer thread, a partial block is flushed after a second at the latest
+class CaptureWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureWriter(QObject *parent = nullptr);
+    ~CaptureWriter() override;
+
+    bool open(const QString &path);
+    void close();
+    bool is_open() const {return file.isOpen();}
+    QString error() const {return m_error;}
+
+    //qCompress level, 1 is fast and already gets most of the gain
+    void set_compression_level(int level) {compression_level=qBound(-1,level,9);}
+
+    //bounded memory: open() allocates a pool of blocks and append() only
+    //ever takes blocks from it, frames are dropped while the writer holds
+    //all of them; 0 allocates blocks on demand
+    void set_block_pool(int blocks) {pool_blocks=blocks>0?qMax(blocks,3):0;}
+    //blocks held, pending and the one being written included [bytes]
+    qint64 memory_bytes();
+
+    void append(const canFrame &frame);
+    captureStats stats();
+
+signals:
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    void next_block();
+
+    QFile file;
+    QString m_error;
+    int compression_level=1;
+    int pool_blocks=0;
+
+    QMutex mutex;
+    QWaitCondition wake;
+    std::vector<canFrame> current;
+    //oldest first, the capacity is reserved so queueing never allocates
+    std::vector<std::vector<canFrame>> pending;
+    //written blocks kept for reuse
+    std::vector<std::vector<canFrame>> spare;
+    size_t writing=0;
+    qint64 current_started_us=0;
+    bool quit=false;
+    captureStats m_stats;
+};
+
+#endif // CAPTURE_WRITER_H
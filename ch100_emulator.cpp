@@ -0,0 +1,718 @@
+#include "ch100_emulator.h"
+#include "canopen.h"
+#include "clock_sync.h"
+#include "load_generator.h"
+#include "nmt_monitor.h"
+#include <QMutexLocker>
+#include <cmath>
+#include <cstring>
+
+//identity of the emulated nodes, 0x1018 sub 1..3; the serial is 0x10000+node
+#define EMU_VENDOR_ID           0x454D5500u   //"\0UME"
+#define EMU_PRODUCT_CODE        100
+#define EMU_REVISION            1
+#define EMU_PRESSURE_PA         101325
+#define EMU_PI                  3.14159265358979323846
+
+static QByteArray le_bytes(quint32 v, int size)
+{
+    QByteArray data(size,0);
+    for(int i=0;i<size;i++)
+        data[i]=char(v>>(8*i));
+    return data;
+}
+
+static quint32 le_value(const QByteArray &data)
+{
+    quint32 v=0;
+    for(int i=0;i<data.size()&&i<4;i++)
+        v|=quint32(uchar(data[i]))<<(8*i);
+    return v;
+}
+
+static QString state_name(uchar state)
+{
+    switch(state){
+    case NMT_STATE_STOPPED: return QObject::tr("stopped");
+    case NMT_STATE_OPERATIONAL: return QObject::tr("operational");
+    case NMT_STATE_PREOPERATIONAL: return QObject::tr("pre-operational");
+    default: return QObject::tr("boot-up");
+    }
+}
+
+//xorshift32, as the load generator
+static inline quint32 emu_random(quint32 &state)
+{
+    state^=state<<13;
+    state^=state>>17;
+    state^=state<<5;
+    return state;
+}
+
+//"1-32" or "5", appended to ids
+static bool parse_nodes(const QString &token, QList<int> &ids)
+{
+    bool ok=true;
+    const QStringList range=token.split('-');
+    const int from=range.at(0).toInt(&ok);
+    int to=from;
+    if(ok&&range.size()==2)
+        to=range.at(1).toInt(&ok);
+    ok&=range.size()<=2&&from>=1&&to<=127&&from<=to;
+    for(int id=from;ok&&id<=to;id++){
+        if(!ids.contains(id))
+            ids.append(id);
+    }
+    return ok;
+}
+
+bool emu_parse(const QString &text, emuConfig &config, QString &error)
+{
+    config=emuConfig();
+    const QStringList lines=text.split('\n');
+    for(int n=0;n<lines.size();n++){
+        QString line=lines.at(n);
+        const int comment=line.indexOf('#');
+        if(comment>=0)
+            line.truncate(comment);
+        line=line.simplified();
+        if(line.isEmpty())
+            continue;
+
+        const QStringList t=line.split(' ');
+        const QString key=t.at(0).toLower();
+        bool ok=true;
+
+        if(key=="nodes"){
+            //nodes 1-32 40 41
+            ok=t.size()>=2;
+            for(int i=1;ok&&i<t.size();i++)
+                ok=parse_nodes(t.at(i),config.nodes);
+        }
+        else if(key=="rate"){
+            //rate <hz> [<tpdo 1..5>], all of TPDO 1..4 without one
+            ok=t.size()==2||t.size()==3;
+            const double hz=ok?t.at(1).toDouble(&ok):0;
+            ok&=hz>=0&&hz<=1000;
+            const int tpdo=ok&&t.size()==3?t.at(2).toInt(&ok):0;
+            ok&=tpdo>=0&&tpdo<=5;
+            for(int i=0;ok&&i<4;i++){
+                if(!tpdo||tpdo==i+1)
+                    config.rate_hz[i]=hz;
+            }
+            if(ok&&tpdo==5)
+                config.rate_hz[4]=hz;
+        }
+        else if(key=="heartbeat"||key=="jitter"||key=="seed"){
+            const int v=t.size()==2?t.at(1).toInt(&ok):-1;
+            ok&=v>=0&&v<=65535;
+            if(key=="heartbeat")
+                config.heartbeat_ms=v;
+            else if(key=="jitter")
+                config.jitter_us=v;
+            else
+                config.seed=quint32(v)|1;
+        }
+        else if(key=="packing"){
+            //packing none|delta|fd [<samples per frame>]
+            ok=t.size()>=2&&t.size()<=3;
+            const QString mode=ok?t.at(1).toLower():QString();
+            if(mode=="none"||mode=="delta")
+                config.packing=mode=="none"?IMU_PACK_NONE:IMU_PACK_DELTA;
+            else if(mode=="fd")
+                config.packing=IMU_PACK_FD;
+            else
+                ok=false;
+            if(ok&&t.size()==3){
+                config.fd_samples=t.at(2).toInt(&ok);
+                ok&=mode=="fd"&&config.fd_samples>=1&&config.fd_samples<=IMU_FD_MAX_SAMPLES;
+            }
+        }
+        else if(key=="preop"){
+            ok=t.size()==1;
+            config.autostart=false;
+        }
+        else if(key=="drop"){
+            config.drop_pct=t.size()==2?t.at(1).toDouble(&ok):-1;
+            ok&=config.drop_pct>=0&&config.drop_pct<=100;
+        }
+        else if(key=="sdo_delay"){
+            //sdo_delay <ms> [<pct of the responses>]
+            ok=t.size()==2||t.size()==3;
+            if(ok)
+                config.sdo_delay_ms=t.at(1).toInt(&ok);
+            if(ok&&t.size()==3)
+                config.sdo_delay_pct=t.at(2).toDouble(&ok);
+            ok&=config.sdo_delay_ms>=0&&config.sdo_delay_pct>=0&&config.sdo_delay_pct<=100;
+        }
+        else if(key=="busoff"){
+            //busoff <every s> <ms>
+            ok=t.size()==3;
+            if(ok)
+                config.busoff_every_s=t.at(1).toInt(&ok);
+            if(ok)
+                config.busoff_ms=t.at(2).toInt(&ok);
+            ok&=config.busoff_every_s>0&&config.busoff_ms>0;
+        }
+        else{
+            ok=false;
+        }
+
+        if(!ok){
+            error=QObject::tr("line %1: %2").arg(n+1).arg(lines.at(n).trimmed());
+            return false;
+        }
+    }
+    if(config.nodes.isEmpty())
+        config.nodes<<1<<2<<3<<4;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Ch100Emulator
+//----------------------------------------------------------------------------
+Ch100Emulator::Ch100Emulator(QObject *parent)
+    : QThread(parent)
+{
+    for(int &i : node_by_id)
+        i=-1;
+}
+
+Ch100Emulator::~Ch100Emulator()
+{
+    stop_emulation();
+}
+
+bool Ch100Emulator::setup(const emuConfig &cfg, CanTransport *transport)
+{
+    if(isRunning()){
+        m_error=tr("The emulator is already running.");
+        return false;
+    }
+    if(!transport->channel()){
+        m_error=tr("The emulator channel is not initialized.");
+        return false;
+    }
+    if(cfg.packing==IMU_PACK_FD&&!transport->is_fd()){
+        m_error=tr("FD packing needs a CAN FD channel.");
+        return false;
+    }
+    config=cfg;
+    if(config.nodes.isEmpty())
+        config.nodes<<1<<2<<3<<4;
+    can=transport;
+
+    QMutexLocker lock(&mutex);
+    nodes.clear();
+    nodes.resize(size_t(config.nodes.size()));
+    for(int &i : node_by_id)
+        i=-1;
+    for(int i=0;i<config.nodes.size();i++){
+        build(nodes[size_t(i)],config.nodes.at(i),nullptr);
+        nodes[size_t(i)].phase=config.nodes.at(i)*1.7;
+        node_by_id[config.nodes.at(i)]=i;
+    }
+    events=decltype(events)();
+    delayed.clear();
+    booted=false;
+    busoff_next_node=0;
+    rng_state=config.seed|1;
+    st=emuStats();
+    st.nodes=int(nodes.size());
+    m_error.clear();
+    return true;
+}
+
+//the object dictionary of a node at power-on; the objects written over
+//SDO are kept from old, as they were stored in the node
+void Ch100Emulator::build(emuNode &node, int id, const emuNode *old)
+{
+    node.sdo.reset(new SdoServer(id));
+    node.id=id;
+    SdoServer &sdo=*node.sdo;
+
+    const canBitrates rates=can->is_fd()?can_bitrates_fd(can->bitrate_fd()):can_bitrates(can->bitrate());
+    sdo.set_object(0x1000,0,le_bytes(0,4));
+    sdo.set_object(0x1017,0,le_bytes(quint32(config.heartbeat_ms),2));
+    sdo.set_object(0x1018,0,le_bytes(4,1));
+    sdo.set_object(0x1018,1,le_bytes(EMU_VENDOR_ID,4));
+    sdo.set_object(0x1018,2,le_bytes(EMU_PRODUCT_CODE,4));
+    sdo.set_object(0x1018,3,le_bytes(EMU_REVISION,4));
+    sdo.set_object(0x1018,4,le_bytes(0x10000u+quint32(id),4));
+    sdo.set_object(CH100_OD_BITRATE,0,le_bytes(rates.nominal?rates.nominal:500000,4));
+    sdo.set_object(CH100_OD_NODE_ID,0,le_bytes(quint32(id),4));
+    for(int n=0;n<5;n++){
+        const ushort index=ushort(0x1800+n);
+        const double hz=config.rate_hz[n];
+        sdo.set_object(index,0,le_bytes(5,1));
+        sdo.set_object(index,1,le_bytes(ch100_tpdo_base[n]+uint(id),4));
+        sdo.set_object(index,2,le_bytes(0xFE,1));
+        sdo.set_object(index,5,le_bytes(hz>0?quint32(qMax(1.0,std::round(1000/hz))):0,2));
+    }
+    if(!old)
+        return;
+
+    static const struct{ushort index; uchar sub;} stored[]={
+        {0x1017,0}, {CH100_OD_BITRATE,0},
+        {0x1800,2}, {0x1800,5}, {0x1801,2}, {0x1801,5}, {0x1802,2}, {0x1802,5},
+        {0x1803,2}, {0x1803,5}, {0x1804,2}, {0x1804,5}
+    };
+    for(const auto &o : stored)
+        sdo.set_object(o.index,o.sub,old->sdo->object(o.index,o.sub));
+    //the COB-IDs follow the node id, unless they were disabled
+    for(int n=0;n<5;n++){
+        if(old->cob_id[n]&0x80000000u)
+            sdo.set_object(ushort(0x1800+n),1,le_bytes(old->cob_id[n],4));
+    }
+}
+
+void Ch100Emulator::boot(emuNode &node, qint64 now_us, bool reset_node)
+{
+    if(reset_node){
+        //0x2101 is applied on reset, unless it collides with another node
+        const int index=int(&node-nodes.data());
+        const int id=int(le_value(node.sdo->object(CH100_OD_NODE_ID,0)));
+        if(id!=node.id&&id>=1&&id<=127&&node_by_id[id]<0){
+            emuNode old;
+            old.sdo=std::move(node.sdo);
+            for(int n=0;n<5;n++)
+                old.cob_id[n]=node.cob_id[n];
+            node_by_id[node.id]=-1;
+            build(node,id,&old);
+            node_by_id[id]=index;
+        }
+    }
+
+    for(int s=0;s<IMU_SIG_COUNT;s++){
+        node.n_pending[s]=0;
+        node.seq[s]=0;
+        node.delta[s].reset();
+    }
+    for(uint &c : node.sync_count)
+        c=0;
+    for(quint64 &p : node.period_us)
+        p=~0ULL;
+    node.state=config.autostart?NMT_STATE_OPERATIONAL:NMT_STATE_PREOPERATIONAL;
+
+    TPCANMsgFD bootup={};
+    bootup.ID=DWORD(CO_HEARTBEAT+node.id);
+    bootup.MSGTYPE=PCAN_MESSAGE_STANDARD;
+    bootup.DLC=1;
+    bootup.DATA[0]=NMT_STATE_BOOTUP;
+    send(bootup);
+
+    for(int i=0;i<EMU_TIMERS;i++)
+        apply_comm(node,i,now_us);
+}
+
+bool Ch100Emulator::apply_comm(emuNode &node, int index, qint64 now_us)
+{
+    quint64 period;
+    if(index==EMU_TIMER_HEARTBEAT){
+        period=quint64(le_value(node.sdo->object(0x1017,0)))*1000;
+    }
+    else{
+        const ushort od=ushort(0x1800+index);
+        const uint cob=le_value(node.sdo->object(od,1));
+        const uchar type=uchar(le_value(node.sdo->object(od,2)));
+        period=quint64(le_value(node.sdo->object(od,5)))*1000;
+        //SYNC driven and disabled TPDOs have no timer
+        if(cob&0x80000000u||type<0xFE)
+            period=0;
+        node.cob_id[index]=cob;
+        node.trans_type[index]=type;
+    }
+    if(period==node.period_us[index])
+        return false;
+    node.period_us[index]=period;
+    schedule(node,index,now_us);
+    return true;
+}
+
+void Ch100Emulator::schedule(emuNode &node, int index, qint64 now_us)
+{
+    //events of the old period are skipped when they come up
+    node.gen[index]++;
+    if(!node.period_us[index])
+        return;
+    emuEvent ev;
+    ev.due_us=now_us+qint64(node.period_us[index]);
+    ev.at_us=ev.due_us;
+    ev.node=int(&node-nodes.data());
+    ev.timer=index;
+    ev.gen=node.gen[index];
+    events.push(ev);
+}
+
+bool Ch100Emulator::send(const TPCANMsgFD &msg)
+{
+    const TPCANStatus result=can->write(msg);
+    if(result==PCAN_ERROR_OK)
+        return true;
+    if(result==PCAN_ERROR_QXMTFULL||result==PCAN_ERROR_XMTFULL)
+        st.tx_full++;
+    else
+        st.tx_errors++;
+    return false;
+}
+
+void Ch100Emulator::sample(const emuNode &node, int signal, qint64 t_us, qint16 *raw)
+{
+    //roll, pitch and yaw swing with periods of 5, 7.7 and 20 s [deg]
+    static const double amp[3]={20,10,90};
+    static const double hz[3]={0.2,0.13,0.05};
+    const double t=t_us*1e-6+node.phase;
+    double angle[3], rate[3];
+    for(int a=0;a<3;a++){
+        const double w=2*EMU_PI*hz[a];
+        angle[a]=amp[a]*std::sin(w*t);
+        rate[a]=amp[a]*w*std::cos(w*t);
+    }
+    const double r=angle[0]*EMU_PI/180, p=angle[1]*EMU_PI/180, y=angle[2]*EMU_PI/180;
+
+    double v[4]={0};
+    switch(signal){
+    case IMU_SIG_ACC:
+        v[0]=-std::sin(p);
+        v[1]=std::sin(r)*std::cos(p);
+        v[2]=std::cos(r)*std::cos(p);
+        break;
+    case IMU_SIG_GYR:
+        v[0]=rate[0];
+        v[1]=rate[1];
+        v[2]=rate[2];
+        break;
+    case IMU_SIG_EUL:
+        v[0]=angle[0];
+        v[1]=angle[1];
+        v[2]=angle[2];
+        break;
+    default:{
+        //ZYX order, w x y z
+        const double cr=std::cos(r/2), sr=std::sin(r/2);
+        const double cp=std::cos(p/2), sp=std::sin(p/2);
+        const double cy=std::cos(y/2), sy=std::sin(y/2);
+        v[0]=cr*cp*cy+sr*sp*sy;
+        v[1]=sr*cp*cy-cr*sp*sy;
+        v[2]=cr*sp*cy+sr*cp*sy;
+        v[3]=cr*cp*sy-sr*sp*cy;
+        break;
+    }
+    }
+
+    //+-2 LSB of noise
+    const float scale=imu_signal_scale(signal);
+    for(int a=0;a<4;a++){
+        const double x=std::round(v[a]/scale)+int(emu_random(rng_state)%5)-2;
+        raw[a]=a<imu_signal_axes(signal)?qint16(qBound(-32768.0,x,32767.0)):0;
+    }
+}
+
+void Ch100Emulator::send_tpdo(emuNode &node, int tpdo, qint64 sample_us)
+{
+    TPCANMsgFD msg={};
+    bool ready=true;
+
+    if(tpdo==4){
+        //TPDO 5: pressure [Pa], UNSIGNED32; the window does not decode it
+        const double pa=EMU_PRESSURE_PA+12*std::sin(sample_us*1e-6*0.1+node.phase);
+        const quint32 v=quint32(pa)+emu_random(rng_state)%3;
+        for(int i=0;i<4;i++)
+            msg.DATA[i]=uchar(v>>(8*i));
+        msg.DLC=4;
+    }
+    else{
+        const int signal=tpdo;
+        qint16 raw[4];
+        sample(node,signal,sample_us,raw);
+        st.samples++;
+        const imuPacking mode=signal==IMU_SIG_QUAT&&config.packing==IMU_PACK_DELTA?IMU_PACK_NONE:config.packing;
+        if(mode==IMU_PACK_NONE){
+            const int axes=imu_signal_axes(signal);
+            for(int a=0;a<axes;a++){
+                msg.DATA[2*a]=uchar(quint16(raw[a])&0xFF);
+                msg.DATA[2*a+1]=uchar(quint16(raw[a])>>8);
+            }
+            msg.DLC=uchar(2*axes);
+        }
+        else{
+            int &n=node.n_pending[signal];
+            for(int a=0;a<4;a++)
+                node.pending[signal][n][a]=raw[a];
+            n++;
+            int used=0;
+            if(mode==IMU_PACK_FD){
+                //a quaternion frame holds 7 samples at most
+                const int full=qMin(config.fd_samples,63/(2*imu_signal_axes(signal)));
+                ready=n>=full;
+                if(ready)
+                    used=ImuPacker::pack_fd(signal,node.pending[signal],n,node.seq[signal]++,msg);
+            }
+            else{
+                ready=n>=IMU_DELTA_MAX_SAMPLES;
+                if(ready)
+                    used=node.delta[signal].encode(node.pending[signal],n,msg);
+            }
+            for(int i=used;i<n;i++)
+                memcpy(node.pending[signal][i-used],node.pending[signal][i],sizeof(node.pending[signal][i]));
+            n-=used;
+        }
+    }
+    if(!ready)
+        return;
+
+    msg.ID=node.cob_id[tpdo]&0x7FF;
+    if(config.drop_pct>0&&emu_random(rng_state)%10000<config.drop_pct*100){
+        st.tpdo_dropped++;
+        return;
+    }
+    if(send(msg))
+        st.tpdo_sent++;
+}
+
+void Ch100Emulator::fire(const emuEvent &ev, qint64 now_us)
+{
+    emuNode &node=nodes[size_t(ev.node)];
+    if(ev.gen!=node.gen[ev.timer])
+        return;
+
+    //next period on the grid, jittered TPDOs keep their grid time
+    emuEvent next=ev;
+    next.due_us=ev.due_us+qint64(node.period_us[ev.timer]);
+    if(next.due_us<now_us-EMU_MAX_LAG_US)
+        next.due_us=now_us;
+    next.at_us=next.due_us;
+    if(config.jitter_us&&ev.timer!=EMU_TIMER_HEARTBEAT)
+        next.at_us+=qint64(emu_random(rng_state)%quint32(2*config.jitter_us+1))-config.jitter_us;
+    events.push(next);
+
+    //a bus-off node keeps its timers, it only does not send
+    if(node.busoff_until)
+        return;
+    if(ev.timer==EMU_TIMER_HEARTBEAT){
+        TPCANMsgFD msg={};
+        msg.ID=DWORD(CO_HEARTBEAT+node.id);
+        msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+        msg.DLC=1;
+        msg.DATA[0]=node.state;
+        if(send(msg))
+            st.heartbeats++;
+        return;
+    }
+    if(node.state!=NMT_STATE_OPERATIONAL)
+        return;
+    st.late_max_us=qMax(st.late_max_us,now_us-ev.at_us);
+    send_tpdo(node,ev.timer,ev.due_us);
+}
+
+void Ch100Emulator::handle_nmt(uchar command, int target, qint64 now_us)
+{
+    st.nmt_commands++;
+    for(size_t i=0;i<nodes.size();i++){
+        emuNode &node=nodes[i];
+        if((target&&node.id!=target)||node.busoff_until)
+            continue;
+        switch(command){
+        case NMT_START: node.state=NMT_STATE_OPERATIONAL; break;
+        case NMT_STOP: node.state=NMT_STATE_STOPPED; break;
+        case NMT_PREOPERATIONAL: node.state=NMT_STATE_PREOPERATIONAL; break;
+        case NMT_RESET_NODE: boot(node,now_us,true); break;
+        case NMT_RESET_COMM: boot(node,now_us,false); break;
+        default: break;
+        }
+        if(target)
+            break;
+    }
+}
+
+void Ch100Emulator::handle(const canFrame &frame, qint64 now_us)
+{
+    const TPCANMsgFD &msg=frame.msg;
+    if(msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_RTR|PCAN_MESSAGE_ECHO|PCAN_MESSAGE_ERRFRAME|PCAN_MESSAGE_STATUS))
+        return;
+
+    if(msg.ID==CO_NMT){
+        if(msg.DLC>=2)
+            handle_nmt(msg.DATA[0],msg.DATA[1],now_us);
+        return;
+    }
+    if(msg.ID==CO_SYNC){
+        //TPDOs of transmission type 1..240 go on every nth SYNC
+        st.syncs++;
+        for(emuNode &node : nodes){
+            if(node.busoff_until||node.state!=NMT_STATE_OPERATIONAL)
+                continue;
+            for(int n=0;n<5;n++){
+                const uchar type=node.trans_type[n];
+                if(type<1||type>240||(node.cob_id[n]&0x80000000u))
+                    continue;
+                if(++node.sync_count[n]>=type){
+                    node.sync_count[n]=0;
+                    send_tpdo(node,n,now_us);
+                }
+            }
+        }
+        return;
+    }
+    if(msg.ID<=CO_SDO_RX||msg.ID>CO_SDO_RX+127)
+        return;
+
+    const int index=node_by_id[msg.ID-CO_SDO_RX];
+    if(index<0)
+        return;
+    emuNode &node=nodes[size_t(index)];
+    if(node.busoff_until||node.state==NMT_STATE_STOPPED)
+        return;
+
+    st.sdo_requests++;
+    responses.clear();
+    node.sdo->process(msg,responses);
+    //a written event timer, transmission type or heartbeat time applies at
+    //once; node id and bit rate wait for the reset, as on the CH100
+    for(int i=0;i<EMU_TIMERS;i++)
+        apply_comm(node,i,now_us);
+
+    for(const TPCANMsgFD &response : responses){
+        if(config.sdo_delay_ms&&emu_random(rng_state)%10000<config.sdo_delay_pct*100){
+            delayedFrame d;
+            d.at_us=now_us+qint64(config.sdo_delay_ms)*1000;
+            d.node=index;
+            d.msg=response;
+            delayed.push_back(d);
+            st.sdo_delayed++;
+        }
+        else{
+            send(response);
+        }
+    }
+}
+
+qint64 Ch100Emulator::poll(qint64 now_us)
+{
+    QMutexLocker lock(&mutex);
+    if(!can)
+        return now_us+EMU_POLL_US;
+    if(!booted){
+        booted=true;
+        t0_us=now_us;
+        next_busoff_us=now_us+qint64(config.busoff_every_s)*1000000;
+        for(emuNode &node : nodes)
+            boot(node,now_us,false);
+    }
+
+    canFrame frame;
+    for(;;){
+        const TPCANStatus result=can->read(frame);
+        if(result==PCAN_ERROR_OK)
+            handle(frame,now_us);
+        else if(result!=PCAN_ERROR_QOVERRUN)
+            break;
+    }
+
+    //SDO responses held back, they keep their order
+    while(!delayed.empty()&&delayed.front().at_us<=now_us){
+        if(!nodes[size_t(delayed.front().node)].busoff_until)
+            send(delayed.front().msg);
+        delayed.pop_front();
+    }
+
+    //bus-off: the node is off the bus for busoff_ms, then sends an EMCY
+    if(config.busoff_every_s&&!nodes.empty()&&now_us>=next_busoff_us){
+        emuNode &node=nodes[size_t(busoff_next_node++%int(nodes.size()))];
+        if(!node.busoff_until){
+            node.busoff_until=now_us+qint64(config.busoff_ms)*1000;
+            st.busoff_events++;
+        }
+        next_busoff_us+=qint64(config.busoff_every_s)*1000000;
+    }
+    for(emuNode &node : nodes){
+        if(!node.busoff_until||now_us<node.busoff_until)
+            continue;
+        node.busoff_until=0;
+        TPCANMsgFD emcy={};
+        emcy.ID=DWORD(CO_EMCY+node.id);
+        emcy.MSGTYPE=PCAN_MESSAGE_STANDARD;
+        emcy.DLC=8;
+        emcy.DATA[0]=uchar(EMU_EMCY_BUSOFF&0xFF);
+        emcy.DATA[1]=uchar(EMU_EMCY_BUSOFF>>8);
+        emcy.DATA[2]=0x11;  //error register: generic, communication
+        if(send(emcy))
+            st.emcy++;
+    }
+
+    while(!events.empty()&&events.top().at_us<=now_us){
+        const emuEvent ev=events.top();
+        events.pop();
+        fire(ev,now_us);
+    }
+
+    st.elapsed_us=now_us-t0_us;
+    qint64 next=now_us+EMU_POLL_US;
+    if(!events.empty())
+        next=qMin(next,events.top().at_us);
+    if(!delayed.empty())
+        next=qMin(next,delayed.front().at_us);
+    return next;
+}
+
+void Ch100Emulator::start_emulation()
+{
+    quit=false;
+    start(QThread::TimeCriticalPriority);
+}
+
+void Ch100Emulator::stop_emulation()
+{
+    quit=true;
+    wait();
+}
+
+void Ch100Emulator::run()
+{
+    while(!quit){
+        const qint64 now=host_monotonic_us();
+        const qint64 next=poll(now);
+        const qint64 wait_us=next-host_monotonic_us();
+        if(wait_us>EMU_SPIN_US)
+            QThread::usleep(quint64(wait_us-EMU_SPIN_US));
+        else if(wait_us>0)
+            QThread::yieldCurrentThread();
+    }
+}
+
+emuStats Ch100Emulator::stats()
+{
+    QMutexLocker lock(&mutex);
+    return st;
+}
+
+QString Ch100Emulator::summary()
+{
+    const emuStats s=stats();
+    const double seconds=qMax<qint64>(1,s.elapsed_us)/1e6;
+    return tr("%1 nodes, %2 TPDO/s, %3 dropped, %4 SDO requests (%5 delayed), %6 bus-off, late max %7 ms")
+            .arg(s.nodes).arg(s.tpdo_sent/seconds,0,'f',0).arg(s.tpdo_dropped)
+            .arg(s.sdo_requests).arg(s.sdo_delayed).arg(s.busoff_events)
+            .arg(s.late_max_us/1000.0,0,'f',2);
+}
+
+QStringList Ch100Emulator::report()
+{
+    QMutexLocker lock(&mutex);
+    QStringList lines;
+    for(const emuNode &node : nodes){
+        QStringList tpdo;
+        for(int n=0;n<5;n++){
+            if(node.cob_id[n]&0x80000000u)
+                tpdo<<"-";
+            else if(node.trans_type[n]<=240)
+                tpdo<<tr("SYNC/%1").arg(node.trans_type[n]);
+            else
+                tpdo<<(node.period_us[n]?tr("%1 Hz").arg(1e6/node.period_us[n],0,'g',4):tr("off"));
+        }
+        lines<<tr("node %1: %2, TPDO %3, %4 SDO transfers%5")
+               .arg(node.id).arg(state_name(node.state)).arg(tpdo.join(" "))
+               .arg(node.sdo->completed()).arg(node.busoff_until?tr(", bus-off"):QString());
+    }
+    return lines;
+}
@@ -0,0 +1,167 @@
+#ifndef CH100_EMULATOR_H
+#define CH100_EMULATOR_H
+
+#include "imu_packing.h"
+#include "sdo_server.h"
+#include <QThread>
+#include <QMutex>
+#include <QStringList>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <vector>
+
+//TPDO 1..5 and the heartbeat of every node are timers
+#define EMU_TIMERS              6
+#define EMU_TIMER_HEARTBEAT     5
+//the emulation thread polls the bus at least this often, it bounds the
+//SDO response time when no TPDO is due
+#define EMU_POLL_US             500
+//the last stretch before an event is spun, sleeps overshoot by ~60 us
+#define EMU_SPIN_US             100
+//timers that fell behind by more than this start again from now
+#define EMU_MAX_LAG_US          10000
+//EMCY error code sent when a node is back from bus-off
+#define EMU_EMCY_BUSOFF         0x8140
+
+struct emuConfig{
+    QList<int> nodes;               //node ids, 1..4 when empty
+    double rate_hz[5]={100,100,100,100,10};  //TPDO 1..5, 0 = off
+    int heartbeat_ms=1000;
+    imuPacking packing=IMU_PACK_NONE;
+    int fd_samples=IMU_FD_MAX_SAMPLES;  //samples per FD frame
+    bool autostart=true;            //operational after boot, as the CH100
+    //faults
+    double drop_pct=0;              //TPDOs not sent
+    int jitter_us=0;                //TPDO send time off the grid by up to +-jitter_us
+    int sdo_delay_ms=0;             //SDO responses held back
+    double sdo_delay_pct=100;       //share of the responses held back
+    int busoff_every_s=0;           //one node after the other goes bus-off
+    int busoff_ms=0;
+    quint32 seed=1;
+};
+bool emu_parse(const QString &text, emuConfig &config, QString &error);
+
+struct emuStats{
+    int nodes=0;
+    quint64 tpdo_sent=0;
+    quint64 tpdo_dropped=0;
+    quint64 samples=0;
+    quint64 heartbeats=0;
+    quint64 emcy=0;
+    quint64 sdo_requests=0;
+    quint64 sdo_delayed=0;
+    quint64 nmt_commands=0;
+    quint64 syncs=0;
+    quint64 busoff_events=0;
+    quint64 tx_full=0;              //frames lost to a full transmit queue
+    quint64 tx_errors=0;
+    qint64 late_max_us=0;           //TPDO sent after its time, jitter left out
+    qint64 elapsed_us=0;
+};
+
+//CH100 nodes on one CAN channel: each answers SDO from its own object
+//dictionary (identity, 0x2100/0x2101, TPDO communication parameters) and
+//sends TPDO 1..5 on the event timers of 0x1800+n sub 5, or every nth SYNC
+//for transmission types 1..240. Timers run on an absolute grid, so rates
+//stay exact whatever the polling latency. The payloads follow a slow
+//sinusoidal motion, acc being gravity seen by the rotated sensor. Faults:
+//dropped TPDOs, send time jitter, late SDO responses and nodes going
+//bus-off for a while, back with an EMCY
+class Ch100Emulator : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit Ch100Emulator(QObject *parent = nullptr);
+    ~Ch100Emulator() override;
+
+    //the transport is initialized by the caller and outlives the emulation;
+    //builds the nodes, which boot at the first poll
+    bool setup(const emuConfig &config, CanTransport *transport);
+    //polls in a thread of its own until stopped
+    void start_emulation();
+    void stop_emulation();
+    bool is_active() const {return isRunning();}
+
+    //handles the received frames and sends what came due at now_us,
+    //returns the time of the next event; for the thread or a caller that
+    //drives the emulation with its own clock
+    qint64 poll(qint64 now_us);
+
+    emuStats stats();
+    QString summary();
+    QStringList report();
+    QString error() const {return m_error;}
+
+signals:
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    struct emuNode{
+        std::unique_ptr<SdoServer> sdo;
+        int id=0;
+        uchar state=0;
+        quint32 gen[EMU_TIMERS]={0};   //bumped when a timer is set up again
+        quint64 period_us[EMU_TIMERS]={0};
+        uchar trans_type[5]={0};
+        uint cob_id[5]={0};         //bit 31 set: TPDO not valid
+        uint sync_count[5]={0};
+        qint64 busoff_until=0;      //0 when on the bus
+        //samples waiting for a packed frame, per signal
+        qint16 pending[IMU_SIG_COUNT][IMU_FD_MAX_SAMPLES][4];
+        int n_pending[IMU_SIG_COUNT]={0};
+        uchar seq[IMU_SIG_COUNT]={0};
+        DeltaBurstEncoder delta[IMU_SIG_COUNT];
+        double phase=0;
+    };
+    struct emuEvent{
+        qint64 at_us;               //send time, jitter included
+        qint64 due_us;              //grid time
+        int node;
+        int timer;
+        quint32 gen;
+        bool operator>(const emuEvent &o) const {return at_us>o.at_us;}
+    };
+    struct delayedFrame{
+        qint64 at_us;
+        int node;
+        TPCANMsgFD msg;
+    };
+
+    void build(emuNode &node, int id, const emuNode *old);
+    void boot(emuNode &node, qint64 now_us, bool reset_node);
+    void schedule(emuNode &node, int index, qint64 now_us);
+    //timers and TPDO COB-IDs from the object dictionary, true when changed
+    bool apply_comm(emuNode &node, int index, qint64 now_us);
+    void handle(const canFrame &frame, qint64 now_us);
+    void handle_nmt(uchar command, int target, qint64 now_us);
+    void fire(const emuEvent &ev, qint64 now_us);
+    void send_tpdo(emuNode &node, int tpdo, qint64 sample_us);
+    void sample(const emuNode &node, int signal, qint64 t_us, qint16 *raw);
+    bool send(const TPCANMsgFD &msg);
+
+    emuConfig config;
+    CanTransport *can=nullptr;
+    std::vector<emuNode> nodes;
+    std::priority_queue<emuEvent,std::vector<emuEvent>,std::greater<emuEvent>> events;
+    std::deque<delayedFrame> delayed;
+    std::vector<TPCANMsgFD> responses;
+    int node_by_id[128];
+    bool booted=false;
+    qint64 t0_us=0;
+    qint64 next_busoff_us=0;
+    int busoff_next_node=0;
+    quint32 rng_state=1;
+    std::atomic<bool> quit{false};
+    QString m_error;
+
+    QMutex mutex;
+    emuStats st;
+};
+
+#endif // CH100_EMULATOR_H
@@ -0,0 +1,104 @@
+#include "channel_monitor.h"
+#include "clock_sync.h"
+#include <QMutexLocker>
+
+ChannelMonitor::ChannelMonitor(QObject *parent)
+    : QThread(parent)
+{
+    qRegisterMetaType<TPCANChannelInformation>("TPCANChannelInformation");
+}
+
+ChannelMonitor::~ChannelMonitor()
+{
+    shutdown();
+}
+
+void ChannelMonitor::shutdown()
+{
+    {
+        QMutexLocker lock(&mutex);
+        quit=true;
+        wake.wakeAll();
+    }
+    wait();
+    QMutexLocker lock(&mutex);
+    quit=false;
+}
+
+void ChannelMonitor::rescan()
+{
+    QMutexLocker lock(&mutex);
+    rescan_requested=true;
+    wake.wakeAll();
+}
+
+QVector<TPCANChannelInformation> ChannelMonitor::channels()
+{
+    QMutexLocker lock(&mutex);
+    return known;
+}
+
+bool ChannelMonitor::scan(QVector<TPCANChannelInformation> &found)
+{
+    found.clear();
+    DWORD count=0;
+    if(CAN_GetValue(PCAN_NONEBUS,PCAN_ATTACHED_CHANNELS_COUNT,&count,sizeof(count))!=PCAN_ERROR_OK)
+        return false;
+    if(!count)
+        return true;
+    //one entry per channel, the old code read them all into a single struct
+    found.resize(int(count));
+    if(CAN_GetValue(PCAN_NONEBUS,PCAN_ATTACHED_CHANNELS,found.data(),
+                    DWORD(count*sizeof(TPCANChannelInformation)))!=PCAN_ERROR_OK){
+        found.clear();
+        return false;
+    }
+    return true;
+}
+
+void ChannelMonitor::run()
+{
+    QVector<TPCANChannelInformation> found;
+    QMutexLocker lock(&mutex);
+    while(!quit){
+        const bool report=rescan_requested;
+        rescan_requested=false;
+        lock.unlock();
+
+        const qint64 t0=host_monotonic_us();
+        const bool ok=scan(found);
+        const qint64 elapsed=host_monotonic_us()-t0;
+
+        lock.relock();
+        if(ok){
+            QVector<TPCANChannelInformation> previous=known;
+            known=found;
+            lock.unlock();
+
+            for(const TPCANChannelInformation &info : qAsConst(found)){
+                bool same=false;
+                for(const TPCANChannelInformation &old : qAsConst(previous)){
+                    if(old.channel_handle==info.channel_handle){
+                        same=old.device_id==info.device_id&&old.channel_condition==info.channel_condition;
+                        break;
+                    }
+                }
+                if(!same)
+                    emit channel_attached(info);
+            }
+            for(const TPCANChannelInformation &old : qAsConst(previous)){
+                bool present=false;
+                for(const TPCANChannelInformation &info : qAsConst(found))
+                    present|=info.channel_handle==old.channel_handle;
+                if(!present)
+                    emit channel_detached(old.channel_handle);
+            }
+            if(report)
+                emit scan_finished(found.size(),elapsed);
+            lock.relock();
+        }
+
+        if(!quit&&!rescan_requested)
+            wake.wait(&mutex,ulong(interval_ms));
+    }
+}
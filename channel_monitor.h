@@ -0,0 +1,53 @@
+#ifndef CHANNEL_MONITOR_H
+#define CHANNEL_MONITOR_H
+
+#include "include/PCANBasic.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMetaType>
+#include <QVector>
+
+Q_DECLARE_METATYPE(TPCANChannelInformation)
+
+//enumerates the attached PCAN channels off the UI thread and keeps
+//watching for plug/unplug: the driver query can take a while with several
+//USB adapters, so the window comes up first and channels stream in
+class ChannelMonitor : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit ChannelMonitor(QObject *parent = nullptr);
+    ~ChannelMonitor() override;
+
+    void set_interval_ms(int ms) {interval_ms=ms;}
+    //scan again right away instead of at the next interval
+    void rescan();
+    void shutdown();
+
+    //a copy of the last scan
+    QVector<TPCANChannelInformation> channels();
+
+signals:
+    //new channel, or a known one whose condition changed
+    void channel_attached(const TPCANChannelInformation &info);
+    void channel_detached(ushort handle);
+    //after the first scan and after every rescan()
+    void scan_finished(int count, qint64 elapsed_us);
+
+protected:
+    void run() override;
+
+private:
+    bool scan(QVector<TPCANChannelInformation> &found);
+
+    QMutex mutex;
+    QWaitCondition wake;
+    QVector<TPCANChannelInformation> known;
+    int interval_ms=500;
+    bool quit=false;
+    bool rescan_requested=true;
+};
+
+#endif // CHANNEL_MONITOR_H
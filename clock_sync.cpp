@@ -0,0 +1,179 @@
+#include "clock_sync.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+//a hardware stamp this far behind the previous one is a counter reset,
+//anything smaller is just reordering between the driver queues
+#define CLOCK_JUMP_US   1000000ULL
+
+qint64 host_monotonic_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ClockSync::ClockSync(quint64 bucket_us, int max_buckets)
+    : bucket_us(bucket_us)
+    , max_buckets(max_buckets)
+{
+    buckets.reserve(max_buckets);
+    fit_use.reserve(max_buckets);
+    fit_res.reserve(max_buckets);
+    fit_tmp.reserve(max_buckets);
+}
+
+void ClockSync::reset()
+{
+    have_raw=false;
+    unwrap_base=0;
+    last_raw=0;
+    last_hw=0;
+    buckets.clear();
+    have_current=false;
+    offset=0;
+    drift=0;
+    residual=0;
+    n_fit=0;
+}
+
+quint64 ClockSync::unwrap(TPCANTimestampFD raw_us)
+{
+    if(!have_raw){
+        have_raw=true;
+        last_raw=raw_us;
+        last_hw=raw_us;
+        return raw_us;
+    }
+
+    if(raw_us+CLOCK_JUMP_US<last_raw){
+        //the driver restarted its counter (re-init, bus-off reset, USB
+        //replug): continue the timeline where it stopped and drop the fit,
+        //the old offset no longer applies
+        unwrap_base=last_hw+1-raw_us;
+        n_jumps++;
+        buckets.clear();
+        have_current=false;
+        n_fit=0;
+    }
+    last_raw=raw_us;
+
+    quint64 hw=raw_us+unwrap_base;
+    if(hw>last_hw)
+        last_hw=hw;
+    return hw;
+}
+
+void ClockSync::add_observation(quint64 hw_us, qint64 host_us)
+{
+    const double delay=double(host_us)-double(hw_us);
+
+    if(!have_current){
+        current={hw_us,delay};
+        current_end=hw_us+bucket_us;
+        have_current=true;
+        if(n_fit==0){
+            ref_hw=hw_us;
+            offset=delay;
+        }
+        return;
+    }
+
+    if(hw_us<current_end){
+        if(delay<current.delay_us)
+            current={hw_us,delay};
+        //before the first fit, track the envelope directly
+        if(n_fit==0&&buckets.empty())
+            offset=qMin(offset,delay);
+        return;
+    }
+
+    if(int(buckets.size())>=max_buckets)
+        buckets.erase(buckets.begin());
+    buckets.push_back(current);
+    current={hw_us,delay};
+    current_end=hw_us+bucket_us;
+    refit();
+}
+
+void ClockSync::refit()
+{
+    const int n=int(buckets.size());
+    if(n<2){
+        ref_hw=buckets.empty()?ref_hw:buckets.back().hw_us;
+        offset=buckets.empty()?offset:buckets.back().delay_us;
+        drift=0;
+        n_fit=n;
+        return;
+    }
+
+    //least squares of delay over hw, relative to the newest bucket so the
+    //intercept is the current offset
+    const quint64 ref=buckets.back().hw_us;
+    //scratch kept between fits, the read loop does not allocate
+    std::vector<char> &use=fit_use;
+    use.assign(size_t(n),1);
+    double a=0,b=0;
+    for(int pass=0;pass<2;pass++){
+        double sx=0,sy=0,sxx=0,sxy=0;
+        int m=0;
+        for(int i=0;i<n;i++){
+            if(!use[i])
+                continue;
+            double x=double(qint64(buckets[i].hw_us-ref));
+            double y=buckets[i].delay_us;
+            sx+=x; sy+=y; sxx+=x*x; sxy+=x*y;
+            m++;
+        }
+        double den=m*sxx-sx*sx;
+        if(m<2||den==0){
+            a=sy/qMax(m,1);
+            b=0;
+        }else{
+            b=(m*sxy-sx*sy)/den;
+            a=(sy-b*sx)/m;
+        }
+
+        //residuals, median absolute deviation
+        std::vector<double> &res=fit_res;
+        res.resize(size_t(n));
+        for(int i=0;i<n;i++)
+            res[i]=std::fabs(buckets[i].delay_us-(a+b*double(qint64(buckets[i].hw_us-ref))));
+        std::vector<double> &tmp=fit_tmp;
+        tmp=res;
+        std::nth_element(tmp.begin(),tmp.begin()+n/2,tmp.end());
+        residual=tmp[n/2];
+        if(pass==1)
+            break;
+
+        //late deliveries only ever push the delay up, keep a floor so a
+        //perfectly clean envelope is not thinned out
+        const double limit=qMax(3*1.4826*residual,50.0);
+        int kept=0;
+        for(int i=0;i<n;i++){
+            use[i]=res[i]<=limit;
+            kept+=use[i];
+        }
+        if(kept==n)
+            break;
+    }
+
+    ref_hw=ref;
+    offset=a;
+    drift=b;
+    n_fit=n;
+}
+
+qint64 ClockSync::to_host_us(quint64 hw_us) const
+{
+    double dx=double(qint64(hw_us-ref_hw));
+    return qint64(double(hw_us)+offset+drift*dx);
+}
+
+void ClockSync::stamp(canFrame &frame, qint64 host_now_us)
+{
+    quint64 hw=unwrap(frame.ts_us);
+    frame.ts_us=hw;
+    add_observation(hw,host_now_us);
+    frame.host_us=to_host_us(hw);
+}
@@ -0,0 +1,71 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include "can_transport.h"
+#include <vector>
+
+//host monotonic clock [us], the common time base of all adapters
+qint64 host_monotonic_us();
+
+//maps one adapter's hardware timestamps onto the host monotonic clock
+//
+//the hardware timeline is unwrapped into a monotonic 64-bit microsecond
+//counter (driver resets and counter roll-overs are folded in), then
+//host = hw + offset + drift * (hw - ref) is fitted on the lower envelope
+//of (host - hw): the minimum per bucket is the sample with the least
+//queueing/polling delay, and outliers are rejected by MAD before refitting
+class ClockSync
+{
+public:
+    explicit ClockSync(quint64 bucket_us=250000, int max_buckets=64);
+
+    void reset();
+
+    //unwrap the hardware stamp, feed the fit and set frame.host_us
+    void stamp(canFrame &frame, qint64 host_now_us);
+
+    quint64 unwrap(TPCANTimestampFD raw_us);
+    void add_observation(quint64 hw_us, qint64 host_us);
+    qint64 to_host_us(quint64 hw_us) const;
+
+    bool is_locked() const {return n_fit>=4;}
+    double drift_ppm() const {return drift*1e6;}
+    double offset_us() const {return offset;}
+    double residual_us() const {return residual;}
+    quint64 discontinuities() const {return n_jumps;}
+
+private:
+    struct bucket{
+        quint64 hw_us;
+        double delay_us;  //host - hw
+    };
+
+    void refit();
+
+    //unwrapping
+    quint64 last_raw=0;
+    quint64 unwrap_base=0;
+    quint64 last_hw=0;
+    bool have_raw=false;
+    quint64 n_jumps=0;
+
+    //lower envelope buckets, oldest first
+    quint64 bucket_us;
+    int max_buckets;
+    std::vector<bucket> buckets;
+    std::vector<char> fit_use;
+    std::vector<double> fit_res;
+    std::vector<double> fit_tmp;
+    bucket current={0,0};
+    quint64 current_end=0;
+    bool have_current=false;
+
+    //fit result
+    quint64 ref_hw=0;
+    double offset=0;
+    double drift=0;
+    double residual=0;
+    int n_fit=0;
+};
+
+#endif // CLOCK_SYNC_H
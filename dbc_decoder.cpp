@@ -0,0 +1,503 @@
+#include "dbc_decoder.h"
+#include <QFile>
+#include <QList>
+#include <QtEndian>
+#include <QtNumeric>
+#include <algorithm>
+#include <cstring>
+
+//message ID of the pseudo message that holds signals of no message
+#define DBC_INDEPENDENT_ID  0xC0000000u
+#define DBC_EXTENDED_FLAG   0x80000000u
+
+static inline qint64 sign_extend(quint64 v, int length)
+{
+    if(length>=64)
+        return qint64(v);
+    const quint64 m=quint64(1)<<(length-1);
+    return qint64((v^m)-m);
+}
+
+static inline double bits_to_double(quint64 raw)
+{
+    double d;
+    memcpy(&d,&raw,8);
+    return d;
+}
+
+static inline double bits_to_float(quint32 raw)
+{
+    float f;
+    memcpy(&f,&raw,4);
+    return f;
+}
+
+//raw value of an op, before factor and offset; the switch is the only
+//branch that depends on the layout
+static inline double op_raw_value(const dbcPlanOp &op, const uchar *data)
+{
+    const uchar *p=data+op.byte;
+    switch(op.kind){
+    case DBC_OP_U8: return p[0];
+    case DBC_OP_S8: return qint8(p[0]);
+    case DBC_OP_U16_LE: return qFromLittleEndian<quint16>(p);
+    case DBC_OP_S16_LE: return qint16(qFromLittleEndian<quint16>(p));
+    case DBC_OP_U16_BE: return qFromBigEndian<quint16>(p);
+    case DBC_OP_S16_BE: return qint16(qFromBigEndian<quint16>(p));
+    case DBC_OP_U32_LE: return qFromLittleEndian<quint32>(p);
+    case DBC_OP_S32_LE: return qint32(qFromLittleEndian<quint32>(p));
+    case DBC_OP_U32_BE: return qFromBigEndian<quint32>(p);
+    case DBC_OP_S32_BE: return qint32(qFromBigEndian<quint32>(p));
+    case DBC_OP_F32_LE: return bits_to_float(qFromLittleEndian<quint32>(p));
+    case DBC_OP_F32_BE: return bits_to_float(qFromBigEndian<quint32>(p));
+    case DBC_OP_F64_LE: return bits_to_double(qFromLittleEndian<quint64>(p));
+    case DBC_OP_F64_BE: return bits_to_double(qFromBigEndian<quint64>(p));
+    case DBC_OP_BITS_LE:{
+        const quint64 v=(qFromLittleEndian<quint64>(p)>>op.shift)&op.mask;
+        return op.is_signed?double(sign_extend(v,op.length)):double(v);
+    }
+    case DBC_OP_BITS_BE:{
+        const quint64 v=(qFromBigEndian<quint64>(p)>>op.shift)&op.mask;
+        return op.is_signed?double(sign_extend(v,op.length)):double(v);
+    }
+    default:
+        return 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+// DbcDecoder
+//----------------------------------------------------------------------------
+DbcDecoder::DbcDecoder()
+{
+    clear();
+}
+
+void DbcDecoder::clear()
+{
+    messages.clear();
+    dbc_signals.clear();
+    plans.clear();
+    ops.clear();
+    ext_table.clear();
+    std::fill(std_table,std_table+0x800,qint16(-1));
+    m_error.clear();
+}
+
+bool DbcDecoder::load(const QString &path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        clear();
+        m_error=file.errorString();
+        return false;
+    }
+    return parse(file.readAll());
+}
+
+bool DbcDecoder::parse(const QByteArray &text)
+{
+    clear();
+
+    //signals belong to the last BO_, a BO_ that is skipped skips them too
+    bool in_message=false;
+    int line_no=0;
+    int pos=0;
+    const int n=text.size();
+    while(pos<n){
+        int end=text.indexOf('\n',pos);
+        if(end<0)
+            end=n;
+        const QByteArray line=text.mid(pos,end-pos).trimmed();
+        pos=end+1;
+        line_no++;
+
+        if(line.startsWith("BO_ ")){
+            const int before=messages.size();
+            if(!parse_message(line)){
+                m_error=QObject::tr("line %1: bad message definition").arg(line_no);
+                break;
+            }
+            in_message=messages.size()>before;
+        }
+        else if(line.startsWith("SG_ ")){
+            if(!in_message)
+                continue;
+            if(!parse_signal(line)){
+                m_error=QObject::tr("line %1: bad signal definition").arg(line_no);
+                break;
+            }
+        }
+        else if(line.startsWith("SIG_VALTYPE_ ")){
+            parse_value_type(line);
+        }
+        else if(!line.isEmpty()&&!line.startsWith("CM_")&&!line.startsWith("BA_")&&!line.startsWith("VAL_")){
+            in_message=false;
+        }
+    }
+    if(m_error.isEmpty()&&messages.isEmpty())
+        m_error=QObject::tr("no messages");
+    if(!m_error.isEmpty()){
+        messages.clear();
+        dbc_signals.clear();
+        return false;
+    }
+    compile();
+    return true;
+}
+
+bool DbcDecoder::parse_message(const QByteArray &line)
+{
+    //BO_ <id> <name>: <dlc> <transmitter>
+    const int colon=line.indexOf(':');
+    if(colon<0)
+        return false;
+    const QList<QByteArray> head=line.left(colon).simplified().split(' ');
+    const QList<QByteArray> tail=line.mid(colon+1).simplified().split(' ');
+    if(head.size()<3||tail.isEmpty())
+        return false;
+
+    bool ok=false;
+    const quint32 raw=quint32(head.at(1).toULongLong(&ok));
+    if(!ok)
+        return false;
+    if(raw==DBC_INDEPENDENT_ID)
+        return true;
+    const int dlc=tail.at(0).toInt(&ok);
+    if(!ok||dlc<0||dlc>64)
+        return false;
+
+    dbcMessage msg;
+    msg.name=QString::fromLatin1(head.at(2));
+    msg.extended=raw&DBC_EXTENDED_FLAG;
+    msg.id=raw&(msg.extended?0x1FFFFFFFu:0x7FFu);
+    msg.dlc=dlc;
+    msg.first_signal=dbc_signals.size();
+    messages.append(msg);
+    return true;
+}
+
+bool DbcDecoder::parse_signal(const QByteArray &line)
+{
+    //SG_ <name> [M|m<n>] : <start>|<length>@<1|0><+|-> (<factor>,<offset>) [<min>|<max>] "<unit>" <receivers>
+    const int colon=line.indexOf(':');
+    if(colon<0)
+        return false;
+    const QList<QByteArray> head=line.left(colon).simplified().split(' ');
+    if(head.size()<2)
+        return false;
+
+    dbcSignal s;
+    s.name=QString::fromLatin1(head.at(1));
+    s.message=messages.size()-1;
+    bool ok=true;
+    if(head.size()>2){
+        const QByteArray &mux=head.at(2);
+        if(mux=="M"){
+            s.mux=DBC_MUX_SWITCH;
+        }
+        else if(mux.startsWith('m')){
+            //m<n>M of extended multiplexing is taken as m<n>
+            int e=1;
+            while(e<mux.size()&&mux.at(e)>='0'&&mux.at(e)<='9')
+                e++;
+            s.mux=DBC_MUX_VALUE;
+            s.mux_value=mux.mid(1,e-1).toInt(&ok);
+            if(!ok||s.mux_value<0)
+                return false;
+        }
+    }
+
+    const QByteArray rest=line.mid(colon+1);
+    const int bar=rest.indexOf('|');
+    const int at=rest.indexOf('@',bar);
+    const int lp=rest.indexOf('(',at);
+    const int comma=rest.indexOf(',',lp);
+    const int rp=rest.indexOf(')',comma);
+    const int lb=rest.indexOf('[',rp);
+    const int bar2=rest.indexOf('|',lb);
+    const int rb=rest.indexOf(']',bar2);
+    if(bar<0||at<0||at+2>=rest.size()||lp<0||comma<0||rp<0||lb<0||bar2<0||rb<0)
+        return false;
+
+    bool ok_start, ok_len, ok_factor, ok_offset;
+    s.start_bit=rest.left(bar).trimmed().toInt(&ok_start);
+    s.length=rest.mid(bar+1,at-bar-1).trimmed().toInt(&ok_len);
+    s.little_endian=rest.at(at+1)=='1';
+    s.is_signed=rest.at(at+2)=='-';
+    //QByteArray::toDouble is locale independent
+    s.factor=rest.mid(lp+1,comma-lp-1).trimmed().toDouble(&ok_factor);
+    s.offset=rest.mid(comma+1,rp-comma-1).trimmed().toDouble(&ok_offset);
+    s.min=rest.mid(lb+1,bar2-lb-1).trimmed().toDouble();
+    s.max=rest.mid(bar2+1,rb-bar2-1).trimmed().toDouble();
+    if(!ok_start||!ok_len||!ok_factor||!ok_offset)
+        return false;
+
+    const int q1=rest.indexOf('"',rb);
+    const int q2=q1<0?-1:rest.indexOf('"',q1+1);
+    if(q2>q1)
+        s.unit=QString::fromLatin1(rest.mid(q1+1,q2-q1-1));
+
+    //the whole signal inside a 64 byte payload
+    if(s.length<1||s.length>64||s.start_bit<0)
+        return false;
+    const int first=s.little_endian?s.start_bit:(s.start_bit&~7)+7-(s.start_bit&7);
+    if(first+s.length>64*8)
+        return false;
+
+    dbc_signals.append(s);
+    messages.last().n_signals++;
+    return true;
+}
+
+void DbcDecoder::parse_value_type(const QByteArray &line)
+{
+    //SIG_VALTYPE_ <id> <signal> : <1|2>;
+    const int colon=line.indexOf(':');
+    if(colon<0)
+        return;
+    const QList<QByteArray> head=line.left(colon).simplified().split(' ');
+    if(head.size()<3)
+        return;
+    bool ok=false;
+    const quint32 raw=quint32(head.at(1).toULongLong(&ok));
+    const int type=line.mid(colon+1).replace(';',' ').trimmed().toInt();
+    const bool extended=raw&DBC_EXTENDED_FLAG;
+    const int m=find_message(raw&(extended?0x1FFFFFFFu:0x7FFu),extended);
+    if(!ok||m<0)
+        return;
+    const QString name=QString::fromLatin1(head.at(2));
+    const dbcMessage &msg=messages.at(m);
+    for(int i=msg.first_signal;i<msg.first_signal+msg.n_signals;i++){
+        if(dbc_signals.at(i).name==name)
+            dbc_signals[i].value_type=type;
+    }
+}
+
+int DbcDecoder::find_message(quint32 id, bool extended) const
+{
+    for(int i=0;i<messages.size();i++){
+        if(messages.at(i).id==id&&messages.at(i).extended==extended)
+            return i;
+    }
+    return -1;
+}
+
+int DbcDecoder::find_signal(const QString &name) const
+{
+    //"Signal" or "Message.Signal"
+    const int dot=name.indexOf('.');
+    for(int i=0;i<dbc_signals.size();i++){
+        const dbcSignal &s=dbc_signals.at(i);
+        if(dot<0){
+            if(s.name==name)
+                return i;
+        }
+        else if(s.name==name.mid(dot+1)&&messages.at(s.message).name==name.left(dot)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------------
+// decode plans
+//----------------------------------------------------------------------------
+void DbcDecoder::compile_op(const dbcSignal &s, int signal, dbcPlanOp &op) const
+{
+    const int len=s.length;
+    op.signal=signal;
+    op.length=quint8(len);
+    op.is_signed=s.is_signed;
+    op.factor=s.factor;
+    op.offset=s.offset;
+    op.mux_value=s.mux==DBC_MUX_VALUE?s.mux_value:-1;
+    op.mask=len>=64?~quint64(0):(quint64(1)<<len)-1;
+    op.shift=0;
+
+    //intel counts bits from the LSB of byte 0 upwards, motorola start bits
+    //are the MSB in the same numbering; both are turned into the first byte
+    //of a 64-bit window and the shift of the LSB in that window
+    int byte, window_bits;
+    bool aligned;
+    if(s.little_endian){
+        byte=s.start_bit/8;
+        window_bits=s.start_bit%8+len;
+        aligned=s.start_bit%8==0;
+        op.end=quint8((s.start_bit+len+7)/8);
+    }
+    else{
+        const int msb=(s.start_bit&~7)+7-(s.start_bit&7);
+        byte=msb/8;
+        window_bits=msb%8+len;
+        aligned=msb%8==0;
+        op.end=quint8((msb+len+7)/8);
+    }
+    op.byte=quint8(byte);
+
+    const bool le=s.little_endian;
+    if(s.value_type==DBC_VALUE_FLOAT&&len==32&&aligned)
+        op.kind=le?DBC_OP_F32_LE:DBC_OP_F32_BE;
+    else if(s.value_type==DBC_VALUE_DOUBLE&&len==64&&aligned)
+        op.kind=le?DBC_OP_F64_LE:DBC_OP_F64_BE;
+    else if(s.value_type!=DBC_VALUE_INT)
+        op.kind=DBC_OP_SLOW;
+    else if(aligned&&len==8)
+        op.kind=s.is_signed?DBC_OP_S8:DBC_OP_U8;
+    else if(aligned&&len==16)
+        op.kind=le?(s.is_signed?DBC_OP_S16_LE:DBC_OP_U16_LE):(s.is_signed?DBC_OP_S16_BE:DBC_OP_U16_BE);
+    else if(aligned&&len==32)
+        op.kind=le?(s.is_signed?DBC_OP_S32_LE:DBC_OP_U32_LE):(s.is_signed?DBC_OP_S32_BE:DBC_OP_U32_BE);
+    else if(window_bits<=64){
+        op.kind=le?DBC_OP_BITS_LE:DBC_OP_BITS_BE;
+        op.shift=quint8(le?s.start_bit%8:64-window_bits);
+    }
+    else
+        op.kind=DBC_OP_SLOW;
+}
+
+void DbcDecoder::compile()
+{
+    plans.clear();
+    ops.clear();
+    ext_table.clear();
+    std::fill(std_table,std_table+0x800,qint16(-1));
+
+    for(int m=0;m<messages.size();m++){
+        const dbcMessage &msg=messages.at(m);
+        dbcPlan plan;
+        plan.message=m;
+        plan.first_op=ops.size();
+        bool slow=false;
+
+        //the multiplexor goes first, its value selects the other signals
+        for(int pass=0;pass<2;pass++){
+            for(int i=msg.first_signal;i<msg.first_signal+msg.n_signals;i++){
+                const dbcSignal &s=dbc_signals.at(i);
+                if((s.mux==DBC_MUX_SWITCH)!=(pass==0))
+                    continue;
+                dbcPlanOp op;
+                compile_op(s,i,op);
+                if(s.mux==DBC_MUX_SWITCH&&plan.mux_op<0)
+                    plan.mux_op=ops.size();
+                plan.min_len=qMax(plan.min_len,int(op.end));
+                plan.padded|=(op.kind==DBC_OP_BITS_LE||op.kind==DBC_OP_BITS_BE)&&op.byte+8>64;
+                plan.scaled|=op.factor!=1||op.offset!=0;
+                slow|=op.kind==DBC_OP_SLOW;
+                ops.append(op);
+            }
+        }
+        plan.n_ops=ops.size()-plan.first_op;
+        plan.direct=plan.mux_op<0&&!slow;
+
+        const int p=plans.size();
+        plans.append(plan);
+        if(msg.extended)
+            ext_table.insert(msg.id,p);
+        else
+            std_table[msg.id]=qint16(p);
+    }
+}
+
+int DbcDecoder::decode(const canFrame &frame, double *values, int *message) const
+{
+    const TPCANMsgFD &msg=frame.msg;
+    int p=-1;
+    if(msg.MSGTYPE&PCAN_MESSAGE_EXTENDED){
+        QHash<quint32,int>::const_iterator it=ext_table.constFind(msg.ID);
+        if(it!=ext_table.constEnd())
+            p=it.value();
+    }
+    else if(msg.ID<0x800){
+        p=std_table[msg.ID];
+    }
+    if(p<0)
+        return -1;
+
+    const dbcPlan &plan=plans.at(p);
+    if(message)
+        *message=plan.message;
+    const int len=can_dlc_to_len(msg.DLC);
+    const uchar *data=msg.DATA;
+    uchar padded[64+8];
+    if(plan.padded){
+        memcpy(padded,msg.DATA,64);
+        memset(padded+64,0,8);
+        data=padded;
+    }
+    const dbcPlanOp *op=ops.constData()+plan.first_op;
+    const dbcPlanOp *const end=op+plan.n_ops;
+
+    //the common case: every signal is in the frame and none is multiplexed
+    if(plan.direct&&len>=plan.min_len){
+        if(plan.scaled){
+            for(;op!=end;++op)
+                values[op->signal]=op_raw_value(*op,data)*op->factor+op->offset;
+        }
+        else{
+            for(;op!=end;++op)
+                values[op->signal]=op_raw_value(*op,data);
+        }
+        return plan.n_ops;
+    }
+
+    int mux=-1;
+    if(plan.mux_op>=0){
+        const dbcPlanOp &m=ops.at(plan.mux_op);
+        if(m.end<=len)
+            mux=int(op_raw_value(m,data));
+    }
+    int n=0;
+    for(;op!=end;++op){
+        if(op->end>len||(op->mux_value>=0&&op->mux_value!=mux))
+            continue;
+        if(op->kind==DBC_OP_SLOW)
+            values[op->signal]=decode_signal(op->signal,data,len);
+        else
+            values[op->signal]=op_raw_value(*op,data)*op->factor+op->offset;
+        n++;
+    }
+    return n;
+}
+
+double DbcDecoder::decode_signal(int signal, const uchar *data, int len) const
+{
+    const dbcSignal &s=dbc_signals.at(signal);
+    quint64 raw=0;
+    if(s.little_endian){
+        if((s.start_bit+s.length+7)/8>len)
+            return qQNaN();
+        for(int i=s.length-1;i>=0;i--){
+            const int b=s.start_bit+i;
+            raw=raw<<1|((data[b>>3]>>(b&7))&1);
+        }
+    }
+    else{
+        const int msb=(s.start_bit&~7)+7-(s.start_bit&7);
+        if((msb+s.length+7)/8>len)
+            return qQNaN();
+        for(int i=0;i<s.length;i++){
+            const int b=msb+i;
+            raw=raw<<1|((data[b>>3]>>(7-(b&7)))&1);
+        }
+    }
+
+    double v;
+    if(s.value_type==DBC_VALUE_FLOAT)
+        v=bits_to_float(quint32(raw));
+    else if(s.value_type==DBC_VALUE_DOUBLE)
+        v=bits_to_double(raw);
+    else
+        v=s.is_signed?double(sign_extend(raw,s.length)):double(raw);
+    return v*s.factor+s.offset;
+}
+
+qint64 DbcDecoder::memory_bytes() const
+{
+    return qint64(sizeof(std_table))
+            +messages.capacity()*qint64(sizeof(dbcMessage))
+            +dbc_signals.capacity()*qint64(sizeof(dbcSignal))
+            +plans.capacity()*qint64(sizeof(dbcPlan))
+            +ops.capacity()*qint64(sizeof(dbcPlanOp))
+            +ext_table.capacity()*qint64(sizeof(quint32)+sizeof(int)+2*sizeof(void*));
+}
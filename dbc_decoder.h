@@ -0,0 +1,141 @@
+#ifndef DBC_DECODER_H
+#define DBC_DECODER_H
+
+#include "can_transport.h"
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#define DBC_MUX_NONE        0   //always present
+#define DBC_MUX_SWITCH      1   //the multiplexor (M)
+#define DBC_MUX_VALUE       2   //present when the multiplexor equals mux_value (m<n>)
+
+#define DBC_VALUE_INT       0
+#define DBC_VALUE_FLOAT     1   //SIG_VALTYPE_ 1, IEEE float
+#define DBC_VALUE_DOUBLE    2   //SIG_VALTYPE_ 2, IEEE double
+
+struct dbcSignal{
+    QString name;
+    QString unit;
+    int message=0;          //index into the message table
+    int start_bit=0;        //as written in the DBC (MSB for motorola)
+    int length=0;
+    bool little_endian=true;
+    bool is_signed=false;
+    int value_type=DBC_VALUE_INT;
+    int mux=DBC_MUX_NONE;
+    int mux_value=0;
+    double factor=1;
+    double offset=0;
+    double min=0;
+    double max=0;
+};
+
+struct dbcMessage{
+    QString name;
+    quint32 id=0;           //without the extended flag
+    bool extended=false;
+    int dlc=0;              //payload length in bytes
+    int first_signal=0;     //[first_signal,first_signal+n_signals) in the signal table
+    int n_signals=0;
+};
+
+
+//one step of a decode plan, the bit layout is resolved to a load, a shift
+//and a mask when the plan is compiled
+enum dbcOpKind{
+    DBC_OP_U8=0,        //byte aligned, the load is the value
+    DBC_OP_S8,
+    DBC_OP_U16_LE,
+    DBC_OP_S16_LE,
+    DBC_OP_U16_BE,
+    DBC_OP_S16_BE,
+    DBC_OP_U32_LE,
+    DBC_OP_S32_LE,
+    DBC_OP_U32_BE,
+    DBC_OP_S32_BE,
+    DBC_OP_F32_LE,
+    DBC_OP_F32_BE,
+    DBC_OP_F64_LE,
+    DBC_OP_F64_BE,
+    DBC_OP_BITS_LE,     //64-bit window load, shift and mask
+    DBC_OP_BITS_BE,
+    DBC_OP_SLOW         //wider than one window, bit by bit
+};
+
+struct dbcPlanOp{
+    quint8 kind;
+    quint8 byte;        //first byte of the load
+    quint8 shift;
+    quint8 length;
+    quint8 is_signed;
+    quint8 end;         //frame length the signal needs
+    qint32 mux_value;   //-1 when always present
+    quint64 mask;
+    double factor;
+    double offset;
+    int signal;         //index into the signal table and the value table
+};
+
+//all signals of one message, the multiplexor first
+struct dbcPlan{
+    int message=0;
+    int first_op=0;
+    int n_ops=0;
+    int mux_op=-1;      //op of the multiplexor, -1 when not multiplexed
+    int min_len=0;      //frames at least this long skip the per signal length check
+    bool padded=false;  //a window load reaches past byte 63
+    bool scaled=false;  //any factor/offset other than 1/0
+    bool direct=false;  //no multiplexing and no bit by bit op
+};
+
+
+//DBC signal database compiled to decode plans. Standard IDs dispatch
+//through a direct table, extended IDs through a hash; decoding a frame
+//writes the physical values into a flat table indexed like signal()
+class DbcDecoder
+{
+public:
+    DbcDecoder();
+
+    bool load(const QString &path);
+    //parses DBC text, used by load() and the benchmarks
+    bool parse(const QByteArray &text);
+    QString error() const {return m_error;}
+    void clear();
+
+    int message_count() const {return messages.size();}
+    int signal_count() const {return dbc_signals.size();}
+    const dbcMessage &message(int i) const {return messages.at(i);}
+    const dbcSignal &signal(int i) const {return dbc_signals.at(i);}
+    //-1 when the database has no such message
+    int find_message(quint32 id, bool extended) const;
+    int find_signal(const QString &name) const;
+
+    //writes the signals present in frame to values[signal], returns the
+    //number written or -1 when the frame has no plan
+    int decode(const canFrame &frame, double *values, int *message=nullptr) const;
+    //a single signal, without the plan
+    double decode_signal(int signal, const uchar *data, int len) const;
+    //tables and plans, names not counted [bytes]
+    qint64 memory_bytes() const;
+
+private:
+    bool parse_message(const QByteArray &line);
+    bool parse_signal(const QByteArray &line);
+    void parse_value_type(const QByteArray &line);
+    void compile();
+    void compile_op(const dbcSignal &s, int signal, dbcPlanOp &op) const;
+
+    QVector<dbcMessage> messages;
+    QVector<dbcSignal> dbc_signals;
+
+    QVector<dbcPlan> plans;
+    QVector<dbcPlanOp> ops;
+    qint16 std_table[0x800];
+    QHash<quint32,int> ext_table;
+    QString m_error;
+};
+
+#endif // DBC_DECODER_H
@@ -0,0 +1,372 @@
+#include "eds_dictionary.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <algorithm>
+#include <cstring>
+
+#define ODC_MAGIC       0x444F5150u   //"PQOD"
+#define ODC_VERSION     1u
+
+struct odcHeader{
+    quint32 magic;
+    quint32 version;
+    qint64 src_size;
+    qint64 src_mtime;
+    quint32 n_entries;
+    quint32 pool_size;
+};
+
+static inline quint32 entry_key(const odEntry &e)
+{
+    //objects (ARRAY/RECORD headers) sort before their sub 0
+    return quint32(e.index)<<16|quint32(e.sub)<<8|quint32(e.object_type==0x7?1:0);
+}
+
+//----------------------------------------------------------------------------
+// data types
+//----------------------------------------------------------------------------
+int od_type_size(int data_type)
+{
+    switch(data_type){
+    case OD_BOOLEAN: case OD_INTEGER8: case OD_UNSIGNED8: return 1;
+    case OD_INTEGER16: case OD_UNSIGNED16: return 2;
+    case OD_INTEGER32: case OD_UNSIGNED32: case OD_REAL32: return 4;
+    case OD_REAL64: case OD_INTEGER64: case OD_UNSIGNED64: return 8;
+    default: return 0;
+    }
+}
+
+QString od_type_name(int data_type)
+{
+    switch(data_type){
+    case OD_BOOLEAN: return "BOOLEAN";
+    case OD_INTEGER8: return "INTEGER8";
+    case OD_INTEGER16: return "INTEGER16";
+    case OD_INTEGER32: return "INTEGER32";
+    case OD_UNSIGNED8: return "UNSIGNED8";
+    case OD_UNSIGNED16: return "UNSIGNED16";
+    case OD_UNSIGNED32: return "UNSIGNED32";
+    case OD_REAL32: return "REAL32";
+    case OD_VISIBLE_STRING: return "VISIBLE_STRING";
+    case OD_OCTET_STRING: return "OCTET_STRING";
+    case OD_UNICODE_STRING: return "UNICODE_STRING";
+    case OD_DOMAIN: return "DOMAIN";
+    case OD_REAL64: return "REAL64";
+    case OD_INTEGER64: return "INTEGER64";
+    case OD_UNSIGNED64: return "UNSIGNED64";
+    default: return QString("0x%1").arg(data_type,4,16,QLatin1Char('0'));
+    }
+}
+
+bool od_encode(int data_type, const QString &text, QByteArray &out)
+{
+    bool ok=true;
+    const int size=od_type_size(data_type);
+    quint64 raw=0;
+
+    switch(data_type){
+    case OD_VISIBLE_STRING:
+        out=text.toLatin1();
+        return true;
+    case OD_UNICODE_STRING:
+        out=QByteArray(reinterpret_cast<const char*>(text.utf16()),text.size()*2);
+        return true;
+    case OD_OCTET_STRING:
+    case OD_DOMAIN:
+        out=QByteArray::fromHex(text.toLatin1());
+        return true;
+    case OD_REAL32:{
+        float f=text.toFloat(&ok);
+        quint32 u;
+        memcpy(&u,&f,4);
+        raw=u;
+        break;
+    }
+    case OD_REAL64:{
+        double d=text.toDouble(&ok);
+        memcpy(&raw,&d,8);
+        break;
+    }
+    case OD_BOOLEAN: case OD_INTEGER8: case OD_INTEGER16: case OD_INTEGER32: case OD_INTEGER64:
+        raw=quint64(text.trimmed().toLongLong(&ok,0));
+        break;
+    default:
+        raw=text.trimmed().toULongLong(&ok,0);
+        break;
+    }
+    if(!ok||!size)
+        return false;
+    out.resize(size);
+    for(int i=0;i<size;i++)
+        out[i]=char(raw>>(8*i));
+    return true;
+}
+
+QString od_decode(int data_type, const QByteArray &data)
+{
+    const int size=od_type_size(data_type);
+    if(!size){
+        if(data_type==OD_VISIBLE_STRING)
+            return QString::fromLatin1(data);
+        if(data_type==OD_UNICODE_STRING)
+            return QString::fromUtf16(reinterpret_cast<const ushort*>(data.constData()),data.size()/2);
+        return QString::fromLatin1(data.toHex(' ').toUpper());
+    }
+
+    quint64 raw=0;
+    for(int i=0;i<size&&i<data.size();i++)
+        raw|=quint64(uchar(data[i]))<<(8*i);
+
+    switch(data_type){
+    case OD_BOOLEAN: return raw?"TRUE":"FALSE";
+    case OD_INTEGER8: return QString::number(qint8(raw));
+    case OD_INTEGER16: return QString::number(qint16(raw));
+    case OD_INTEGER32: return QString::number(qint32(raw));
+    case OD_INTEGER64: return QString::number(qint64(raw));
+    case OD_REAL32:{
+        quint32 u=quint32(raw);
+        float f;
+        memcpy(&f,&u,4);
+        return QString::number(f);
+    }
+    case OD_REAL64:{
+        double d;
+        memcpy(&d,&raw,8);
+        return QString::number(d);
+    }
+    default:
+        return QString("%1 (0x%2)").arg(raw).arg(raw,size*2,16,QLatin1Char('0'));
+    }
+}
+
+//----------------------------------------------------------------------------
+// EdsDictionary
+//----------------------------------------------------------------------------
+QString EdsDictionary::cache_path(const QString &eds_path)
+{
+    return eds_path+".odc";
+}
+
+bool EdsDictionary::load(const QString &path)
+{
+    entries.clear();
+    pool.clear();
+    cache_hit=false;
+    m_error.clear();
+
+    QFileInfo info(path);
+    if(!info.exists()){
+        m_error=QObject::tr("%1 not found").arg(path);
+        return false;
+    }
+    const qint64 size=info.size();
+    const qint64 mtime=info.lastModified().toMSecsSinceEpoch();
+
+    if(read_cache(cache_path(path),size,mtime)){
+        cache_hit=true;
+        return true;
+    }
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly)){
+        m_error=file.errorString();
+        return false;
+    }
+    if(!parse_eds(file.readAll()))
+        return false;
+    write_cache(cache_path(path),size,mtime);
+    return true;
+}
+
+quint32 EdsDictionary::pool_add(const QByteArray &s)
+{
+    quint32 off=quint32(pool.size());
+    pool.append(s);
+    pool.append('\0');
+    return off;
+}
+
+QString EdsDictionary::name(int i) const
+{
+    return QString::fromLatin1(pool.constData()+entries.at(i).name_off);
+}
+
+QString EdsDictionary::default_value(int i) const
+{
+    return QString::fromLatin1(pool.constData()+entries.at(i).default_off);
+}
+
+bool EdsDictionary::parse_eds(const QByteArray &text)
+{
+    pool_add(QByteArray());   //offset 0 is the empty string
+
+    odEntry cur={};
+    bool in_object=false;
+    QByteArray cur_name, cur_default, cur_value;
+
+    auto flush=[&](){
+        if(!in_object)
+            return;
+        cur.name_off=pool_add(cur_name);
+        //a DCF ParameterValue is the configured value, prefer it
+        cur.default_off=pool_add(cur_value.isEmpty()?cur_default:cur_value);
+        entries.append(cur);
+        in_object=false;
+    };
+
+    int pos=0;
+    const int n=text.size();
+    while(pos<n){
+        int end=text.indexOf('\n',pos);
+        if(end<0)
+            end=n;
+        QByteArray line=text.mid(pos,end-pos).trimmed();
+        pos=end+1;
+        if(line.isEmpty()||line.startsWith(';'))
+            continue;
+
+        if(line.startsWith('[')){
+            flush();
+            QByteArray sec=line.mid(1,line.indexOf(']')-1).trimmed();
+            //object sections are [IIII] and [IIIIsubS], both in hex
+            if(sec.size()<4)
+                continue;
+            bool ok=false;
+            uint index=sec.left(4).toUInt(&ok,16);
+            if(!ok)
+                continue;
+            uint sub=0;
+            if(sec.size()>4){
+                if(sec.mid(4,3).toLower()!="sub")
+                    continue;
+                sub=sec.mid(7).toUInt(&ok,16);
+                if(!ok)
+                    continue;
+            }
+            cur=odEntry();
+            cur.index=quint16(index);
+            cur.sub=quint8(sub);
+            cur.object_type=0x7;
+            cur.access=OD_ACCESS_READ|OD_ACCESS_WRITE;
+            cur_name.clear();
+            cur_default.clear();
+            cur_value.clear();
+            in_object=true;
+            continue;
+        }
+        if(!in_object)
+            continue;
+
+        int eq=line.indexOf('=');
+        if(eq<0)
+            continue;
+        QByteArray key=line.left(eq).trimmed().toLower();
+        QByteArray val=line.mid(eq+1).trimmed();
+
+        if(key=="parametername")
+            cur_name=val;
+        else if(key=="objecttype")
+            cur.object_type=quint16(val.toUInt(nullptr,0));
+        else if(key=="datatype")
+            cur.data_type=quint16(val.toUInt(nullptr,0));
+        else if(key=="defaultvalue")
+            cur_default=val;
+        else if(key=="parametervalue")
+            cur_value=val;
+        else if(key=="accesstype"){
+            QByteArray a=val.toLower();
+            if(a=="ro")
+                cur.access=OD_ACCESS_READ;
+            else if(a=="wo")
+                cur.access=OD_ACCESS_WRITE;
+            else if(a=="const")
+                cur.access=OD_ACCESS_READ|OD_ACCESS_CONST;
+            else
+                cur.access=OD_ACCESS_READ|OD_ACCESS_WRITE;
+        }
+    }
+    flush();
+
+    std::sort(entries.begin(),entries.end(),[](const odEntry &a, const odEntry &b){
+        return entry_key(a)<entry_key(b);
+    });
+    if(entries.isEmpty()){
+        m_error=QObject::tr("no objects found");
+        return false;
+    }
+    return true;
+}
+
+bool EdsDictionary::read_cache(const QString &path, qint64 src_size, qint64 src_mtime)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray blob=file.readAll();
+    if(blob.size()<int(sizeof(odcHeader)))
+        return false;
+
+    odcHeader hdr;
+    memcpy(&hdr,blob.constData(),sizeof(hdr));
+    if(hdr.magic!=ODC_MAGIC||hdr.version!=ODC_VERSION
+            ||hdr.src_size!=src_size||hdr.src_mtime!=src_mtime)
+        return false;
+    const qint64 need=qint64(sizeof(hdr))+qint64(hdr.n_entries)*sizeof(odEntry)+hdr.pool_size;
+    if(blob.size()!=need)
+        return false;
+
+    entries.resize(int(hdr.n_entries));
+    memcpy(entries.data(),blob.constData()+sizeof(hdr),hdr.n_entries*sizeof(odEntry));
+    pool=blob.mid(int(sizeof(hdr)+hdr.n_entries*sizeof(odEntry)));
+
+    //every string inside the pool and terminated, else the EDS is parsed again
+    bool ok=!pool.isEmpty()&&pool.at(pool.size()-1)=='\0';
+    for(int i=0;ok&&i<entries.size();i++)
+        ok=entries.at(i).name_off<quint32(pool.size())&&entries.at(i).default_off<quint32(pool.size());
+    if(!ok){
+        entries.clear();
+        pool.clear();
+    }
+    return ok;
+}
+
+void EdsDictionary::write_cache(const QString &path, qint64 src_size, qint64 src_mtime) const
+{
+    odcHeader hdr;
+    hdr.magic=ODC_MAGIC;
+    hdr.version=ODC_VERSION;
+    hdr.src_size=src_size;
+    hdr.src_mtime=src_mtime;
+    hdr.n_entries=quint32(entries.size());
+    hdr.pool_size=quint32(pool.size());
+
+    //a missing cache only costs a re-parse, write errors are not fatal
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+        return;
+    file.write(reinterpret_cast<const char*>(&hdr),sizeof(hdr));
+    file.write(reinterpret_cast<const char*>(entries.constData()),entries.size()*sizeof(odEntry));
+    file.write(pool);
+}
+
+int EdsDictionary::find(quint16 index, quint8 sub) const
+{
+    odEntry key={};
+    key.index=index;
+    key.sub=sub;
+    key.object_type=0x7;
+    auto it=std::lower_bound(entries.constBegin(),entries.constEnd(),key,[](const odEntry &a, const odEntry &b){
+        return entry_key(a)<entry_key(b);
+    });
+    if(it==entries.constEnd()||it->index!=index||it->sub!=sub||it->object_type!=0x7)
+        return -1;
+    return int(it-entries.constBegin());
+}
+
+void EdsDictionary::range(quint16 index_lo, quint16 index_hi, int &first, int &last) const
+{
+    auto cmp=[](const odEntry &e, quint32 k){return entry_key(e)<k;};
+    first=int(std::lower_bound(entries.constBegin(),entries.constEnd(),quint32(index_lo)<<16,cmp)-entries.constBegin());
+    last=int(std::lower_bound(entries.constBegin(),entries.constEnd(),quint32(index_hi)<<16,cmp)-entries.constBegin());
+}
@@ -0,0 +1,82 @@
+#ifndef EDS_DICTIONARY_H
+#define EDS_DICTIONARY_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+//CiA 301 basic data types
+#define OD_BOOLEAN          0x0001
+#define OD_INTEGER8         0x0002
+#define OD_INTEGER16        0x0003
+#define OD_INTEGER32        0x0004
+#define OD_UNSIGNED8        0x0005
+#define OD_UNSIGNED16       0x0006
+#define OD_UNSIGNED32       0x0007
+#define OD_REAL32           0x0008
+#define OD_VISIBLE_STRING   0x0009
+#define OD_OCTET_STRING     0x000A
+#define OD_UNICODE_STRING   0x000B
+#define OD_DOMAIN           0x000F
+#define OD_REAL64           0x0011
+#define OD_INTEGER64        0x0015
+#define OD_UNSIGNED64       0x001B
+
+#define OD_ACCESS_READ      0x01
+#define OD_ACCESS_WRITE     0x02
+#define OD_ACCESS_CONST     0x04
+
+//one object or sub-object, names and defaults live in the string pool
+struct odEntry{
+    quint16 index;
+    quint8 sub;
+    quint8 access;
+    quint16 data_type;
+    quint16 object_type;
+    quint32 name_off;
+    quint32 default_off;
+};
+
+//fixed size of a data type in bytes, 0 for strings/domains
+int od_type_size(int data_type);
+QString od_type_name(int data_type);
+//text <-> little-endian SDO payload for a data type
+bool od_encode(int data_type, const QString &text, QByteArray &out);
+QString od_decode(int data_type, const QByteArray &data);
+
+
+//EDS/DCF object dictionary. The parsed form is a sorted entry table plus a
+//string pool, written next to the EDS as a binary cache (.odc) and loaded
+//back with a single read when the EDS has not changed.
+class EdsDictionary
+{
+public:
+    bool load(const QString &path);
+    bool from_cache() const {return cache_hit;}
+    QString error() const {return m_error;}
+
+    int count() const {return entries.size();}
+    const odEntry &entry(int i) const {return entries.at(i);}
+    //strings are decoded from the pool only when asked for
+    QString name(int i) const;
+    QString default_value(int i) const;
+
+    int find(quint16 index, quint8 sub) const;
+    //[first,last) of the entries in an index range
+    void range(quint16 index_lo, quint16 index_hi, int &first, int &last) const;
+
+    static QString cache_path(const QString &eds_path);
+
+private:
+    bool parse_eds(const QByteArray &text);
+    bool read_cache(const QString &path, qint64 src_size, qint64 src_mtime);
+    void write_cache(const QString &path, qint64 src_size, qint64 src_mtime) const;
+    quint32 pool_add(const QByteArray &s);
+
+    QVector<odEntry> entries;
+    QByteArray pool;
+    bool cache_hit=false;
+    QString m_error;
+};
+
+#endif // EDS_DICTIONARY_H
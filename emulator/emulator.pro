@@ -0,0 +1,37 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = ch100_emu
+
+# CH100 nodes without hardware: the emulator core of the window sources,
+# on a PCAN channel or a SocketCAN interface (vcan0 and the like)
+SOURCES += \
+    ../can_transport.cpp \
+    ../ch100_emulator.cpp \
+    ../clock_sync.cpp \
+    ../imu_packing.cpp \
+    ../load_generator.cpp \
+    ../sdo_server.cpp \
+    main.cpp \
+
+HEADERS += \
+    ../can_transport.h \
+    ../canopen.h \
+    ../ch100_emulator.h \
+    ../clock_sync.h \
+    ../imu_packing.h \
+    ../include/PCANBasic.h \
+    ../load_generator.h \
+    ../sdo_server.h \
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../x86/ -lPCANBasic
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../x86/ -lPCANBasicd
+else:unix:!macx: LIBS += -L$$PWD/../ -lPCANBasic
+
+INCLUDEPATH += $$PWD/..
+# <Windows.h> of include/PCANBasic.h
+unix: INCLUDEPATH += $$PWD/../bench/compat
+DEPENDPATH += $$PWD/..
@@ -0,0 +1,133 @@
+#include "ch100_emulator.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTimer>
+#include <cstdio>
+#include <memory>
+
+//ch100_emu (--pcan <handle> | --socketcan <interface>) [--bitrate kbit/s]
+//          [--fd <bit rate string>] [--config file] [--duration s]
+//
+//CH100 nodes on a CAN channel, for the window or the benchmarks on another
+//channel of the same bus. The config file takes the keys of emu_parse():
+//
+//  nodes 1-32              # node ids
+//  rate 200                # TPDO 1..4 [Hz], "rate 10 5" for TPDO 5 only
+//  packing fd 8            # none, delta, fd [samples per frame]
+//  heartbeat 1000          # [ms]
+//  drop 0.5                # faults: TPDOs lost [%]
+//  jitter 300              # send time off the grid [us]
+//  sdo_delay 50 10         # 10 % of the SDO responses 50 ms late
+//  busoff 30 200           # a node off the bus for 200 ms every 30 s
+//
+//exit code 0: ok, 1: usage, config or channel error
+
+static TPCANBaudrate baudrate(int kbit)
+{
+    switch(kbit){
+    case 125: return PCAN_BAUD_125K;
+    case 250: return PCAN_BAUD_250K;
+    case 500: return PCAN_BAUD_500K;
+    case 1000: return PCAN_BAUD_1M;
+    default: return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ch100_emu");
+
+    QCommandLineParser cli;
+    cli.setApplicationDescription("CH100 node emulator with fault injection.");
+    cli.addHelpOption();
+    QCommandLineOption opt_pcan("pcan","PCAN-Basic channel handle, e.g. 0x52.","handle");
+    QCommandLineOption opt_socketcan("socketcan","SocketCAN interface, e.g. vcan0 (Linux).","interface");
+    QCommandLineOption opt_bitrate("bitrate","Bit rate in kbit/s: 125, 250, 500 or 1000, default 500.","kbit","500");
+    QCommandLineOption opt_fd("fd","Open the channel as CAN FD with this bit rate string.","bitrate");
+    QCommandLineOption opt_config("config","Emulator configuration file.","file");
+    QCommandLineOption opt_duration("duration","Stop after <s> seconds, default never.","s","0");
+    cli.addOptions({opt_pcan,opt_socketcan,opt_bitrate,opt_fd,opt_config,opt_duration});
+    cli.process(app);
+
+    emuConfig config;
+    QString error;
+    if(cli.isSet(opt_config)){
+        QFile file(cli.value(opt_config));
+        if(!file.open(QIODevice::ReadOnly|QIODevice::Text)){
+            fprintf(stderr,"%s: %s\n",qPrintable(file.fileName()),qPrintable(file.errorString()));
+            return 1;
+        }
+        if(!emu_parse(QString::fromUtf8(file.readAll()),config,error)){
+            fprintf(stderr,"%s: %s\n",qPrintable(file.fileName()),qPrintable(error));
+            return 1;
+        }
+    }
+    else{
+        emu_parse(QString(),config,error);
+    }
+
+    std::unique_ptr<CanTransport> can;
+    TPCANHandle handle=0;
+    if(cli.isSet(opt_pcan)){
+        bool ok;
+        handle=TPCANHandle(cli.value(opt_pcan).toUInt(&ok,0));
+        if(!ok||!handle){
+            fprintf(stderr,"invalid channel handle %s\n",qPrintable(cli.value(opt_pcan)));
+            return 1;
+        }
+        can.reset(new PcanTransport());
+    }
+#ifdef Q_OS_LINUX
+    else if(cli.isSet(opt_socketcan)){
+        //any handle, the interface is the channel
+        handle=PCAN_USBBUS1;
+        can.reset(new SocketCanTransport(cli.value(opt_socketcan).toLatin1()));
+    }
+#endif
+    else{
+        fprintf(stderr,"a channel is needed, --pcan or --socketcan\n");
+        return 1;
+    }
+
+    const TPCANBaudrate bitrate=baudrate(cli.value(opt_bitrate).toInt());
+    if(!bitrate&&!cli.isSet(opt_fd)){
+        fprintf(stderr,"unsupported bit rate %s\n",qPrintable(cli.value(opt_bitrate)));
+        return 1;
+    }
+    const TPCANStatus result=cli.isSet(opt_fd)?can->initialize_fd(handle,cli.value(opt_fd).toLatin1())
+                                              :can->initialize(handle,bitrate);
+    if(result!=PCAN_ERROR_OK){
+        char strMsg[256];
+        CAN_GetErrorText(result, 0, strMsg);
+        fprintf(stderr,"channel: %s\n",strMsg);
+        return 1;
+    }
+
+    Ch100Emulator emulator;
+    if(!emulator.setup(config,can.get())){
+        fprintf(stderr,"%s\n",qPrintable(emulator.error()));
+        return 1;
+    }
+    emulator.start_emulation();
+
+    QTimer status;
+    QObject::connect(&status,&QTimer::timeout,[&emulator](){
+        printf("%s\n",qPrintable(emulator.summary()));
+        fflush(stdout);
+    });
+    status.start(1000);
+
+    const int duration_s=cli.value(opt_duration).toInt();
+    if(duration_s>0)
+        QTimer::singleShot(duration_s*1000,&app,&QCoreApplication::quit);
+    const int code=app.exec();
+
+    emulator.stop_emulation();
+    for(const QString &line : emulator.report())
+        printf("%s\n",qPrintable(line));
+    printf("%s\n",qPrintable(emulator.summary()));
+    can->uninitialize();
+    return code;
+}
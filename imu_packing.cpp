@@ -0,0 +1,241 @@
+#include "imu_packing.h"
+
+static inline qint16 rd_i16(const uchar *p)
+{
+    return qint16(uint(p[0])|uint(p[1])<<8);
+}
+static inline void wr_i16(uchar *p, qint16 v)
+{
+    p[0]=uchar(uint16_t(v)&0xFF);
+    p[1]=uchar(uint16_t(v)>>8);
+}
+
+int imu_signal_axes(int signal)
+{
+    return signal==IMU_SIG_QUAT?4:3;
+}
+
+float imu_signal_scale(int signal)
+{
+    static const float scale[IMU_SIG_COUNT]={1.0f/1000,1.0f/10,1.0f/100,1.0f/10000};
+    return (signal>=0&&signal<IMU_SIG_COUNT)?scale[signal]:1.0f;
+}
+
+int imu_signal_from_cobid(uint id, int node_id)
+{
+    switch(int(id)-node_id){
+    case 0x180: return IMU_SIG_ACC;
+    case 0x280: return IMU_SIG_GYR;
+    case 0x380: return IMU_SIG_EUL;
+    case 0x480: return IMU_SIG_QUAT;
+    default: return -1;
+    }
+}
+
+//----------------------------------------------------------------------------
+// ImuUnpacker
+//----------------------------------------------------------------------------
+ImuUnpacker::ImuUnpacker()
+{
+    for(int i=0;i<IMU_SIG_COUNT;i++)
+        period_us[i]=10000;
+}
+
+void ImuUnpacker::set_sample_period_us(int signal, uint period)
+{
+    if(signal>=0&&signal<IMU_SIG_COUNT)
+        period_us[signal]=period;
+}
+
+void ImuUnpacker::reset()
+{
+    for(auto &node : streams)
+        for(auto &s : node)
+            s=streamState();
+    n_decoded=0;
+    n_dropped=0;
+}
+
+void ImuUnpacker::finish(imuSample &s, const canFrame &frame, int node, int signal, int idx, int count)
+{
+    //the frame is sent when its last sample is taken
+    TPCANTimestampFD back=TPCANTimestampFD(count-1-idx)*period_us[signal];
+    s.ts_us=frame.ts_us>back?frame.ts_us-back:0;
+    s.host_us=frame.host_us-qint64(back);
+    s.node=uchar(node);
+    s.signal=uchar(signal);
+    const float scale=imu_signal_scale(signal);
+    for(int a=0;a<4;a++)
+        s.v[a]=float(s.raw[a])*scale;
+}
+
+int ImuUnpacker::decode(const canFrame &frame, int node_id, imuSample *out, int out_max)
+{
+    int signal=imu_signal_from_cobid(frame.msg.ID,node_id);
+    if(signal<0||out_max<=0||node_id<0||node_id>127)
+        return 0;
+
+    const int len=can_dlc_to_len(frame.msg.DLC);
+    const bool fd=frame.msg.MSGTYPE&PCAN_MESSAGE_FD;
+    int n=0;
+    if(fd&&packing_mode==IMU_PACK_FD)
+        n=decode_fd(frame,node_id,signal,out,out_max);
+    else if(!fd&&packing_mode==IMU_PACK_DELTA&&signal!=IMU_SIG_QUAT)
+        n=decode_delta(frame,node_id,signal,out,out_max);
+    else{
+        const int axes=imu_signal_axes(signal);
+        if(len<2*axes)
+            return 0;
+        for(int a=0;a<4;a++)
+            out[0].raw[a]=a<axes?rd_i16(frame.msg.DATA+2*a):0;
+        finish(out[0],frame,node_id,signal,0,1);
+        n=1;
+    }
+    n_decoded+=n;
+    return n;
+}
+
+int ImuUnpacker::decode_fd(const canFrame &frame, int node, int signal, imuSample *out, int out_max)
+{
+    const uchar *p=frame.msg.DATA;
+    const int len=can_dlc_to_len(frame.msg.DLC);
+    const int axes=imu_signal_axes(signal);
+    int count=p[0]&0x0F;
+    //never trust the header beyond the payload
+    count=qMin(count,(len-1)/(2*axes));
+    count=qMin(count,out_max);
+
+    streamState &st=streams[node][signal];
+    uchar seq=uchar(p[0]>>4);
+    if(st.synced&&seq!=uchar((st.seq+1)&0x0F))
+        n_dropped++;
+    st.seq=seq;
+    st.synced=true;
+
+    p++;
+    for(int i=0;i<count;i++){
+        for(int a=0;a<4;a++)
+            out[i].raw[a]=a<axes?rd_i16(p+2*a):0;
+        p+=2*axes;
+        finish(out[i],frame,node,signal,i,count);
+    }
+    return count;
+}
+
+int ImuUnpacker::decode_delta(const canFrame &frame, int node, int signal, imuSample *out, int out_max)
+{
+    const uchar *p=frame.msg.DATA;
+    if(can_dlc_to_len(frame.msg.DLC)<7)
+        return 0;
+
+    streamState &st=streams[node][signal];
+    const uchar hdr=p[0];
+    const uchar seq=hdr&0x0F;
+
+    if(hdr&IMU_DELTA_KEY){
+        st.last[0]=rd_i16(p+1);
+        st.last[1]=rd_i16(p+3);
+        st.last[2]=rd_i16(p+5);
+        st.seq=seq;
+        st.synced=true;
+        for(int a=0;a<4;a++)
+            out[0].raw[a]=a<3?st.last[a]:0;
+        finish(out[0],frame,node,signal,0,1);
+        return 1;
+    }
+
+    //a lost frame breaks the delta chain until the next key frame
+    if(!st.synced||seq!=uchar((st.seq+1)&0x0F)){
+        st.synced=false;
+        n_dropped++;
+        return 0;
+    }
+    st.seq=seq;
+
+    int count=qMin(int((hdr>>4)&0x07),IMU_DELTA_MAX_SAMPLES);
+    count=qMin(count,out_max);
+    for(int i=0;i<count;i++){
+        for(int a=0;a<3;a++){
+            st.last[a]=qint16(st.last[a]+qint8(p[1+3*i+a]));
+            out[i].raw[a]=st.last[a];
+        }
+        out[i].raw[3]=0;
+        finish(out[i],frame,node,signal,i,count);
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------------
+// encoders
+//----------------------------------------------------------------------------
+int ImuPacker::pack_fd(int signal, const qint16 (*raw)[4], int n, uchar seq, TPCANMsgFD &msg)
+{
+    const int axes=imu_signal_axes(signal);
+    const int count=qMin(qMin(n,IMU_FD_MAX_SAMPLES),63/(2*axes));
+
+    msg.DATA[0]=uchar((seq&0x0F)<<4|count);
+    uchar *p=msg.DATA+1;
+    for(int i=0;i<count;i++){
+        for(int a=0;a<axes;a++)
+            wr_i16(p+2*a,raw[i][a]);
+        p+=2*axes;
+    }
+    msg.DLC=can_len_to_dlc(1+count*2*axes);
+    //pad up to the DLC boundary
+    for(int i=1+count*2*axes;i<can_dlc_to_len(msg.DLC);i++)
+        msg.DATA[i]=0;
+    msg.MSGTYPE=PCAN_MESSAGE_FD|PCAN_MESSAGE_BRS;
+    return count;
+}
+
+int DeltaBurstEncoder::encode(const qint16 (*raw)[4], int n, TPCANMsgFD &msg)
+{
+    if(n<=0)
+        return 0;
+
+    seq=uchar((seq+1)&0x0F);
+    msg.DLC=8;
+    msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+    for(int i=0;i<8;i++)
+        msg.DATA[i]=0;
+
+    //how many of the pending samples fit as int8 deltas
+    int count=0;
+    if(synced&&frames_since_key<key_interval){
+        qint16 ref[3]={last[0],last[1],last[2]};
+        while(count<qMin(n,IMU_DELTA_MAX_SAMPLES)){
+            bool fits=true;
+            for(int a=0;a<3;a++){
+                int d=int(raw[count][a])-int(ref[a]);
+                if(d<-128||d>127)
+                    fits=false;
+            }
+            if(!fits)
+                break;
+            for(int a=0;a<3;a++)
+                ref[a]=raw[count][a];
+            count++;
+        }
+    }
+
+    if(count==0){
+        msg.DATA[0]=uchar(IMU_DELTA_KEY|1<<4|seq);
+        for(int a=0;a<3;a++){
+            wr_i16(msg.DATA+1+2*a,raw[0][a]);
+            last[a]=raw[0][a];
+        }
+        synced=true;
+        frames_since_key=0;
+        return 1;
+    }
+
+    msg.DATA[0]=uchar(count<<4|seq);
+    for(int i=0;i<count;i++){
+        for(int a=0;a<3;a++){
+            msg.DATA[1+3*i+a]=uchar(qint8(int(raw[i][a])-int(last[a])));
+            last[a]=raw[i][a];
+        }
+    }
+    frames_since_key++;
+    return count;
+}
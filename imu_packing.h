@@ -0,0 +1,119 @@
+#ifndef IMU_PACKING_H
+#define IMU_PACKING_H
+
+#include "can_transport.h"
+
+//CH100 TPDO signals, in COB-ID order (0x180/0x280/0x380/0x480 + node)
+enum imuSignal{
+    IMU_SIG_ACC=0,  //Accelerometer[G]
+    IMU_SIG_GYR,    //Gyroscope[deg/s]
+    IMU_SIG_EUL,    //Euler Angle[deg]
+    IMU_SIG_QUAT,   //Quaternion
+    IMU_SIG_COUNT
+};
+
+//how several samples of one signal share a frame
+enum imuPacking{
+    IMU_PACK_NONE=0,  //one sample per classic frame (CH100 default)
+    IMU_PACK_FD,      //header + n raw samples in one FD frame
+    IMU_PACK_DELTA    //classic frame: key frame or int8 deltas of 2 samples
+};
+
+//packed payload header byte:
+//  FD    : bits 0-3 sample count, bits 4-7 sequence
+//  delta : bit 7 key frame, bits 4-6 sample count, bits 0-3 sequence
+//key frames carry one absolute int16 sample, delta frames carry up to two
+//samples as int8 differences, so delta bursts exist for 3-axis signals only
+#define IMU_DELTA_KEY           0x80
+#define IMU_DELTA_MAX_SAMPLES   2
+#define IMU_FD_MAX_SAMPLES      15
+
+struct imuSample{
+    TPCANTimestampFD ts_us=0;
+    qint64 host_us=0;
+    uchar node=0;
+    uchar signal=0;
+    qint16 raw[4]={0};
+    float v[4]={0};
+};
+
+//latest value of every signal, as shown in the window
+struct imuData{
+    float acc[3]={0};
+    float gyr[3]={0};
+    float eul[3]={0};
+    float quat[4]={0};
+    float prs=0;
+};
+
+int imu_signal_axes(int signal);
+float imu_signal_scale(int signal);
+//-1 when the COB-ID is not a CH100 TPDO of this node
+int imu_signal_from_cobid(uint id, int node_id);
+
+
+//splits received TPDOs into samples and reconstructs per-sample timestamps
+//from the frame timestamp and the configured sample period
+class ImuUnpacker
+{
+public:
+    ImuUnpacker();
+
+    //how the nodes pack; FD packing applies to FD frames only, so a short
+    //packed frame is told from a classic one by its frame type
+    void set_packing(imuPacking mode) {packing_mode=mode;}
+    imuPacking packing() const {return packing_mode;}
+    void set_sample_period_us(int signal, uint period_us);
+    void reset();
+
+    //returns the number of samples written to out (at most out_max)
+    int decode(const canFrame &frame, int node_id, imuSample *out, int out_max);
+
+    quint64 decoded() const {return n_decoded;}
+    quint64 dropped() const {return n_dropped;}
+
+private:
+    struct streamState{
+        qint16 last[4]={0};
+        uchar seq=0;
+        bool synced=false;
+    };
+
+    int decode_fd(const canFrame &frame, int node, int signal, imuSample *out, int out_max);
+    int decode_delta(const canFrame &frame, int node, int signal, imuSample *out, int out_max);
+    void finish(imuSample &s, const canFrame &frame, int node, int signal, int idx, int count);
+
+    imuPacking packing_mode=IMU_PACK_NONE;
+    uint period_us[IMU_SIG_COUNT];
+    streamState streams[128][IMU_SIG_COUNT];
+    quint64 n_decoded=0;
+    quint64 n_dropped=0;
+};
+
+
+//node side encoders, used by the emulator and the benchmarks
+class ImuPacker
+{
+public:
+    //packs up to n samples of one signal into an FD frame, returns the count packed
+    static int pack_fd(int signal, const qint16 (*raw)[4], int n, uchar seq, TPCANMsgFD &msg);
+};
+
+class DeltaBurstEncoder
+{
+public:
+    explicit DeltaBurstEncoder(int key_interval=16) : key_interval(key_interval) {}
+
+    void reset() {synced=false; frames_since_key=0;}
+    //encodes the next frame from the pending samples, returns samples consumed
+    int encode(const qint16 (*raw)[4], int n, TPCANMsgFD &msg);
+
+private:
+    qint16 last[3]={0};
+    uchar seq=0;
+    bool synced=false;
+    int frames_since_key=0;
+    int key_interval;
+};
+
+#endif // IMU_PACKING_H
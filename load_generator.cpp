@@ -0,0 +1,549 @@
+#include "load_generator.h"
+#include "canopen.h"
+#include "clock_sync.h"
+#include <QMutexLocker>
+#include <QtEndian>
+#include <cstring>
+
+//the last stretch before a frame is due is spun, the OS timer is ~1 ms
+#define LOAD_SPIN_US            1000
+//a stall longer than this is not caught up with a burst
+#define LOAD_MAX_LAG_US         10000
+//PCAN_ERROR_QXMTFULL: retry after this long
+#define LOAD_RETRY_US           100
+
+canBitrates can_bitrates(TPCANBaudrate baudrate)
+{
+    static const struct{TPCANBaudrate code; quint32 bps;} table[]={
+        {PCAN_BAUD_1M,1000000}, {PCAN_BAUD_800K,800000}, {PCAN_BAUD_500K,500000},
+        {PCAN_BAUD_250K,250000}, {PCAN_BAUD_125K,125000}, {PCAN_BAUD_100K,100000},
+        {PCAN_BAUD_95K,95238}, {PCAN_BAUD_83K,83333}, {PCAN_BAUD_50K,50000},
+        {PCAN_BAUD_47K,47619}, {PCAN_BAUD_33K,33333}, {PCAN_BAUD_20K,20000},
+        {PCAN_BAUD_10K,10000}, {PCAN_BAUD_5K,5000}
+    };
+    canBitrates rates;
+    for(const auto &t : table){
+        if(t.code==baudrate)
+            rates.nominal=rates.data=t.bps;
+    }
+    return rates;
+}
+
+canBitrates can_bitrates_fd(const QByteArray &bitrate_fd)
+{
+    //"f_clock_mhz=80, nom_brp=10, nom_tseg1=12, ..." as CAN_InitializeFD takes it
+    const QList<QByteArray> items=bitrate_fd.split(',');
+    auto value=[&items](const QByteArray &name){
+        for(const QByteArray &item : items){
+            const int eq=item.indexOf('=');
+            if(eq>0&&item.left(eq).trimmed()==name)
+                return item.mid(eq+1).trimmed().toDouble();
+        }
+        return 0.0;
+    };
+    const double clock=value("f_clock")>0?value("f_clock"):value("f_clock_mhz")*1e6;
+    auto rate=[&](const QByteArray &phase){
+        const double tq=value(phase+"_brp")*(1+value(phase+"_tseg1")+value(phase+"_tseg2"));
+        return tq>0?quint32(clock/tq+0.5):0u;
+    };
+    canBitrates rates;
+    rates.nominal=rate("nom");
+    rates.data=rate("data");
+    if(!rates.data)
+        rates.data=rates.nominal;
+    return rates;
+}
+
+double can_frame_time_us(const TPCANMsgFD &msg, const canBitrates &rates)
+{
+    const int len=can_dlc_to_len(msg.DLC);
+    const bool ext=(msg.MSGTYPE&PCAN_MESSAGE_EXTENDED)!=0;
+    //CRC delimiter, ACK, EOF and interframe space, never stuffed
+    const int tail=13;
+    if(!(msg.MSGTYPE&PCAN_MESSAGE_FD)){
+        //SOF to CRC are stuffed, at worst one bit per four after the first
+        const int stuffed=(ext?54:34)+8*len;
+        return (stuffed+(stuffed-1)/4+tail)*1e6/rates.nominal;
+    }
+    //arbitration at the nominal rate: SOF, ID, SRR/RRS, IDE, FDF, res, BRS
+    const int arb=ext?36:17;
+    //data phase: ESI, DLC and data stuffed, then the stuff count and the
+    //CRC with their fixed stuff bits
+    const int crc=len>16?21:17;
+    const int dyn=5+8*len;
+    const int data=dyn+(dyn-1)/4+4+crc+(4+crc+3)/4;
+    const double data_bps=(msg.MSGTYPE&PCAN_MESSAGE_BRS)?rates.data:rates.nominal;
+    return (arb+(arb-1)/4+tail)*1e6/rates.nominal+data*1e6/data_bps;
+}
+
+bool load_parse(const QString &text, loadConfig &config, QString &error)
+{
+    config=loadConfig();
+    const QStringList lines=text.split('\n');
+    for(int n=0;n<lines.size();n++){
+        QString line=lines.at(n);
+        const int comment=line.indexOf('#');
+        if(comment>=0)
+            line.truncate(comment);
+        line=line.simplified();
+        if(line.isEmpty())
+            continue;
+
+        const QStringList t=line.split(' ');
+        const QString key=t.at(0).toLower();
+        bool ok=true;
+
+        if(key=="channel"){
+            //channel <handle>, or virtual for the bus of the receiver
+            ok=t.size()==2;
+            if(ok&&t.at(1).toLower()=="virtual")
+                config.channel=0;
+            else if(ok)
+                config.channel=TPCANHandle(t.at(1).toUInt(&ok,0));
+        }
+        else if(key=="load"){
+            //load <from> <to> [<step>] in percent of the bus
+            ok=t.size()==3||t.size()==4;
+            if(ok)
+                config.start_pct=t.at(1).toDouble(&ok);
+            if(ok)
+                config.stop_pct=t.at(2).toDouble(&ok);
+            if(ok&&t.size()==4)
+                config.step_pct=t.at(3).toDouble(&ok);
+            ok&=config.start_pct>0&&config.stop_pct>=config.start_pct&&config.stop_pct<=100&&config.step_pct>0;
+        }
+        else if(key=="step"||key=="latency"){
+            const double v=t.size()==2?t.at(1).toDouble(&ok):0;
+            ok&=v>0;
+            if(key=="step")
+                config.step_ms=quint32(v*1000);
+            else
+                config.max_latency_ms=quint32(v);
+        }
+        else if(key=="ch100"||key=="random"){
+            const int v=t.size()==2?t.at(1).toInt(&ok):-1;
+            ok&=v>=0&&v<=(key=="ch100"?127:100);
+            if(key=="ch100")
+                config.ch100_nodes=v;
+            else
+                config.random_pct=v;
+        }
+        else if(key=="burst"){
+            //burst <frames> <every ms>
+            ok=t.size()==3;
+            if(ok)
+                config.burst_frames=t.at(1).toInt(&ok);
+            if(ok)
+                config.burst_ms=t.at(2).toUInt(&ok);
+            ok&=config.burst_frames>=0&&config.burst_ms>0;
+        }
+        else if(key=="fd"){
+            ok=t.size()==1;
+            config.fd=true;
+        }
+        else{
+            ok=false;
+        }
+
+        if(!ok){
+            error=QObject::tr("line %1: %2").arg(n+1).arg(lines.at(n).trimmed());
+            return false;
+        }
+    }
+    if(!config.ch100_nodes&&!config.random_pct)
+        config.random_pct=100;
+    return true;
+}
+
+//xorshift32, the payload only has to change
+static inline quint32 load_random(quint32 &state)
+{
+    state^=state<<13;
+    state^=state>>17;
+    state^=state<<5;
+    return state;
+}
+
+//----------------------------------------------------------------------------
+// LoadGenerator
+//----------------------------------------------------------------------------
+LoadGenerator::LoadGenerator(QObject *parent)
+    : QThread(parent)
+    , send_us(new std::atomic<qint64>[LOAD_SEQ_RING])
+{
+    memset(std_ids,0,sizeof(std_ids));
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    stop_load();
+}
+
+bool LoadGenerator::start_load(const loadConfig &cfg, CanTransport *receiver)
+{
+    if(active){
+        m_error=tr("The load test is already running.");
+        return false;
+    }
+    if(!receiver->channel()){
+        m_error=tr("The receiving channel is not initialized.");
+        return false;
+    }
+    rates=receiver->is_fd()?can_bitrates_fd(receiver->bitrate_fd()):can_bitrates(receiver->bitrate());
+    if(!rates.nominal){
+        m_error=tr("Unknown bit rate of the receiving channel.");
+        return false;
+    }
+    if(cfg.fd&&!receiver->is_fd()){
+        m_error=tr("CAN FD load needs an FD receiving channel.");
+        return false;
+    }
+    config=cfg;
+
+    //the TX channel runs at the bit rate of the receiving one
+    TPCANHandle handle=config.channel;
+    if(!handle){
+        VirtualTransport *rx=dynamic_cast<VirtualTransport*>(receiver);
+        if(!rx){
+            m_error=tr("The receiving channel is not on a virtual bus.");
+            return false;
+        }
+        tx.reset(new VirtualTransport(rx->virtual_bus()));
+        //any handle, the virtual bus does not route by channel
+        handle=TPCANHandle(receiver->channel()+1);
+    }
+    else if(handle==receiver->channel()){
+        m_error=tr("The load needs a second channel, 0x%1 is the receiving one.").arg(handle,0,16);
+        return false;
+    }
+    else{
+        tx.reset(new PcanTransport());
+    }
+    const TPCANStatus result=receiver->is_fd()?tx->initialize_fd(handle,receiver->bitrate_fd())
+                                             :tx->initialize(handle,receiver->bitrate());
+    if(result!=PCAN_ERROR_OK){
+        char strMsg[256];
+        CAN_GetErrorText(result, 0, strMsg);
+        m_error=tr("Load channel 0x%1: %2").arg(handle,0,16).arg(strMsg);
+        tx.reset();
+        return false;
+    }
+
+    //CH100 TPDO 1..4 of each node: acc, gyr, eul 6 bytes, quat 8 bytes,
+    //from node ids no live node has
+    ch100_frames.clear();
+    memset(std_ids,0,sizeof(std_ids));
+    int nodes=0;
+    for(int node=LOAD_NODE_TOP;node>0&&nodes<config.ch100_nodes;node--){
+        if(config.live_nodes.contains(node))
+            continue;
+        nodes++;
+        for(int n=0;n<4;n++){
+            TPCANMsgFD msg={};
+            msg.ID=ch100_tpdo_base[n]+uint(node);
+            msg.MSGTYPE=PCAN_MESSAGE_STANDARD;
+            msg.DLC=n<3?6:8;
+            ch100_frames.push_back(msg);
+            std_ids[msg.ID]=true;
+        }
+    }
+
+    const int n_steps=qBound(1,int((config.stop_pct-config.start_pct)/config.step_pct+1e-9)+1,LOAD_MAX_STEPS);
+    {
+        QMutexLocker lock(&mutex);
+        tx_steps.assign(size_t(n_steps),txStep());
+        for(int s=0;s<n_steps;s++)
+            tx_steps[size_t(s)].target_pct=qMin(100.0,config.start_pct+s*config.step_pct);
+    }
+    rx_steps.assign(size_t(n_steps),rxStep());
+    for(rxStep &r : rx_steps)
+        r.histogram.assign(LOAD_LATENCY_BUCKETS+1,0);
+    for(int i=0;i<LOAD_SEQ_RING;i++)
+        send_us[i].store(0,std::memory_order_relaxed);
+
+    seq=0;
+    n_sent=0;
+    expected=0;
+    rx_pos=0;
+    ch100_pos=0;
+    rng_state=0x2545F491u;
+    steps_started=0;
+    quit=false;
+    m_error.clear();
+    active=true;
+    start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void LoadGenerator::stop_load()
+{
+    quit=true;
+    wait();
+    if(tx){
+        tx->uninitialize();
+        tx.reset();
+    }
+    active=false;
+}
+
+TPCANMsgFD LoadGenerator::next_frame()
+{
+    TPCANMsgFD msg;
+    if(ch100_frames.empty()||int(load_random(rng_state)%100)<config.random_pct){
+        msg={};
+        msg.ID=LOAD_EXT_BASE|(load_random(rng_state)&0xFFFF);
+        msg.MSGTYPE=PCAN_MESSAGE_EXTENDED;
+        //4 bytes at least, they hold the sequence number
+        if(config.fd){
+            msg.MSGTYPE|=PCAN_MESSAGE_FD|PCAN_MESSAGE_BRS;
+            msg.DLC=uchar(4+load_random(rng_state)%12);
+        }
+        else{
+            msg.DLC=uchar(4+load_random(rng_state)%5);
+        }
+    }
+    else{
+        msg=ch100_frames[size_t(ch100_pos)];
+        if(++ch100_pos==int(ch100_frames.size()))
+            ch100_pos=0;
+    }
+    const int len=can_dlc_to_len(msg.DLC);
+    for(int i=4;i<len;i+=4){
+        const quint32 r=load_random(rng_state);
+        memcpy(msg.DATA+i,&r,size_t(qMin(4,len-i)));
+    }
+    return msg;
+}
+
+//generator thread: numbers the frame and writes it, a full transmit queue
+//is waited out so the sequence has no gaps of our own
+bool LoadGenerator::send(TPCANMsgFD &msg, txStep &step)
+{
+    qToLittleEndian<quint32>(seq,msg.DATA);
+    std::atomic<qint64> &sent_at=send_us[seq&(LOAD_SEQ_RING-1)];
+    for(;;){
+        sent_at.store(host_monotonic_us(),std::memory_order_release);
+        const TPCANStatus result=tx->write(msg);
+        if(result==PCAN_ERROR_OK)
+            break;
+        if(result!=PCAN_ERROR_QXMTFULL&&result!=PCAN_ERROR_XMTFULL){
+            char strMsg[256];
+            CAN_GetErrorText(result, 0, strMsg);
+            emit failed(tr("Load test: TX failed: %1").arg(strMsg));
+            return false;
+        }
+        step.tx_full++;
+        if(quit)
+            return false;
+        QThread::usleep(LOAD_RETRY_US);
+    }
+    seq++;
+    n_sent.fetch_add(1,std::memory_order_relaxed);
+    step.sent++;
+    step.busy_us+=can_frame_time_us(msg,rates);
+    return true;
+}
+
+void LoadGenerator::run()
+{
+    int n_steps;
+    {
+        QMutexLocker lock(&mutex);
+        n_steps=int(tx_steps.size());
+    }
+    const qint64 burst_us=qint64(config.burst_ms)*1000;
+
+    for(int s=0;s<n_steps&&!quit;s++){
+        txStep step;
+        {
+            QMutexLocker lock(&mutex);
+            step.target_pct=tx_steps[size_t(s)].target_pct;
+        }
+        step_first_seq[s]=seq;
+        steps_started.store(s+1,std::memory_order_release);
+
+        //each frame takes its bus time divided by the target load, frames
+        //that came due while sleeping go out back to back
+        const qint64 t0=host_monotonic_us();
+        const qint64 end_us=t0+qint64(config.step_ms)*1000;
+        double next_us=double(t0);
+        qint64 next_burst_us=t0+burst_us;
+        bool ok=true;
+        for(qint64 now=t0;ok&&!quit&&now<end_us;now=host_monotonic_us()){
+            if(config.burst_frames&&now>=next_burst_us){
+                for(int i=0;ok&&i<config.burst_frames;i++){
+                    TPCANMsgFD msg=next_frame();
+                    ok=send(msg,step);
+                }
+                next_burst_us+=burst_us;
+            }
+            else if(now>=qint64(next_us)){
+                TPCANMsgFD msg=next_frame();
+                ok=send(msg,step);
+                next_us+=can_frame_time_us(msg,rates)*100.0/step.target_pct;
+                if(next_us<double(now-LOAD_MAX_LAG_US))
+                    next_us=double(now);
+            }
+            else if(next_us-now>LOAD_SPIN_US){
+                QThread::usleep(quint64(next_us-now-LOAD_SPIN_US));
+            }
+            else{
+                QThread::yieldCurrentThread();
+            }
+        }
+        step.elapsed_us=qMax<qint64>(1,host_monotonic_us()-t0);
+        {
+            QMutexLocker lock(&mutex);
+            tx_steps[size_t(s)]=step;
+        }
+        emit step_finished(s,step.target_pct);
+        if(!ok)
+            break;
+    }
+}
+
+int LoadGenerator::step_of(quint32 frame_seq)
+{
+    const int started=steps_started.load(std::memory_order_acquire);
+    if(!started)
+        return -1;
+    while(rx_pos+1<started&&frame_seq>=step_first_seq[rx_pos+1])
+        rx_pos++;
+    //a late frame of an earlier step
+    int s=rx_pos;
+    while(s>0&&frame_seq<step_first_seq[s])
+        s--;
+    return s;
+}
+
+bool LoadGenerator::process_frame(const canFrame &frame, qint64 now_us)
+{
+    if(!active)
+        return false;
+    const TPCANMsgFD &msg=frame.msg;
+    if(msg.MSGTYPE&PCAN_MESSAGE_EXTENDED){
+        if((msg.ID&0xFFFF0000u)!=LOAD_EXT_BASE)
+            return false;
+    }
+    else if(msg.ID>=0x800||!std_ids[msg.ID]){
+        return false;
+    }
+    if(can_dlc_to_len(msg.DLC)<4)
+        return true;
+
+    const quint32 frame_seq=qFromLittleEndian<quint32>(msg.DATA);
+    const int s=step_of(frame_seq);
+    if(s<0)
+        return true;
+    rxStep &step=rx_steps[size_t(s)];
+    step.received++;
+    if(frame_seq<expected)
+        step.reordered++;
+    else
+        expected=frame_seq+1;
+
+    //the ring slot is reused LOAD_SEQ_RING frames later
+    const qint64 sent_us=send_us[frame_seq&(LOAD_SEQ_RING-1)].load(std::memory_order_acquire);
+    const qint64 latency=now_us-sent_us;
+    if(!sent_us||latency<0)
+        return true;
+    step.latency_n++;
+    step.latency_sum_us+=double(latency);
+    step.latency_max_us=qMax(step.latency_max_us,double(latency));
+    step.wire_sum_us+=double(frame.host_us-sent_us);
+    step.histogram[size_t(qMin<qint64>(latency/LOAD_LATENCY_BUCKET_US,LOAD_LATENCY_BUCKETS))]++;
+    return true;
+}
+
+QVector<loadStep> LoadGenerator::steps()
+{
+    QVector<loadStep> out;
+    QMutexLocker lock(&mutex);
+    for(size_t s=0;s<tx_steps.size()&&s<rx_steps.size();s++){
+        const txStep &t=tx_steps[s];
+        const rxStep &r=rx_steps[s];
+        //still sending
+        if(!t.elapsed_us)
+            break;
+        loadStep step;
+        step.target_pct=t.target_pct;
+        step.achieved_pct=100.0*t.busy_us/double(t.elapsed_us);
+        step.sent=t.sent;
+        step.tx_full=t.tx_full;
+        step.received=r.received;
+        step.lost=t.sent>r.received?t.sent-r.received:0;
+        step.reordered=r.reordered;
+        if(r.latency_n){
+            step.latency_avg_us=r.latency_sum_us/double(r.latency_n);
+            step.latency_max_us=r.latency_max_us;
+            step.wire_avg_us=r.wire_sum_us/double(r.latency_n);
+            //upper edge of the bucket holding the 99th percentile
+            const quint64 rank=(r.latency_n*99+99)/100;
+            quint64 seen=0;
+            for(int b=0;b<=LOAD_LATENCY_BUCKETS;b++){
+                seen+=r.histogram[size_t(b)];
+                if(seen>=rank){
+                    step.latency_p99_us=b<LOAD_LATENCY_BUCKETS?qMin(double(b+1)*LOAD_LATENCY_BUCKET_US,r.latency_max_us):r.latency_max_us;
+                    break;
+                }
+            }
+        }
+        step.sustainable=step.sent&&!step.lost&&!step.reordered
+                &&step.latency_p99_us<=double(config.max_latency_ms)*1000;
+        out.append(step);
+    }
+    return out;
+}
+
+double LoadGenerator::max_sustainable_pct()
+{
+    double best=0;
+    for(const loadStep &step : steps()){
+        if(!step.sustainable)
+            break;
+        best=qMax(best,step.achieved_pct);
+    }
+    return best;
+}
+
+QStringList LoadGenerator::report()
+{
+    const QVector<loadStep> list=steps();
+    QStringList lines;
+    lines.append(tr("target  achieved      sent      lost  reordered  tx full  latency avg/p99/max [ms]  wire [ms]"));
+    for(const loadStep &s : list){
+        lines.append(QString("%1 %  %2 %  %3  %4  %5  %6  %7 / %8 / %9  %10  %11")
+                     .arg(s.target_pct,4,'f',0)
+                     .arg(s.achieved_pct,6,'f',1)
+                     .arg(s.sent,8)
+                     .arg(s.lost,8)
+                     .arg(s.reordered,9)
+                     .arg(s.tx_full,7)
+                     .arg(s.latency_avg_us/1000.0,7,'f',2)
+                     .arg(s.latency_p99_us/1000.0,0,'f',2)
+                     .arg(s.latency_max_us/1000.0,0,'f',2)
+                     .arg(s.wire_avg_us/1000.0,8,'f',2)
+                     .arg(s.sustainable?QString():tr("not sustained")));
+    }
+    const double best=max_sustainable_pct();
+    lines.append(best>0?tr("Max sustainable load %1 % of %2 kbit/s").arg(best,0,'f',1).arg(rates.nominal/1000)
+                       :tr("No load step was sustained"));
+    return lines;
+}
+
+QString LoadGenerator::summary()
+{
+    const int started=steps_started.load(std::memory_order_acquire);
+    quint64 received=0;
+    for(const rxStep &r : rx_steps)
+        received+=r.received;
+    QMutexLocker lock(&mutex);
+    const int n_steps=int(tx_steps.size());
+    const double target=started?tx_steps[size_t(started-1)].target_pct:0;
+    return tr("LOAD step %1/%2 %3 %, %4 sent, %5 received")
+            .arg(started)
+            .arg(n_steps)
+            .arg(target,0,'f',0)
+            .arg(n_sent.load(std::memory_order_relaxed))
+            .arg(received);
+}
@@ -0,0 +1,161 @@
+#ifndef LOAD_GENERATOR_H
+#define LOAD_GENERATOR_H
+
+#include "can_transport.h"
+#include <QThread>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//send times of the frames still on their way, by sequence number
+#define LOAD_SEQ_RING           65536
+//random frames use extended IDs from here, the low 16 bits vary
+#define LOAD_EXT_BASE           0x1F5A0000u
+//CH100-like frames come from node ids counted down from here, clear of the
+//low ids real nodes use
+#define LOAD_NODE_TOP           127
+#define LOAD_MAX_STEPS          64
+//latency histogram per step: buckets of this width, the last one open
+#define LOAD_LATENCY_BUCKET_US  100
+#define LOAD_LATENCY_BUCKETS    1000
+//frames still in flight are waited for this long after the last step
+#define LOAD_DRAIN_MS           500
+
+//nominal and data phase bit rate of a channel [bit/s], equal for classic CAN
+struct canBitrates{
+    quint32 nominal=0;
+    quint32 data=0;
+};
+canBitrates can_bitrates(TPCANBaudrate baudrate);
+canBitrates can_bitrates_fd(const QByteArray &bitrate_fd);
+//bus time of a frame with the worst case stuff bits, interframe space included [us]
+double can_frame_time_us(const TPCANMsgFD &msg, const canBitrates &rates);
+
+struct loadConfig{
+    //TX channel, 0 sends from a second endpoint of the receiver's virtual bus
+    TPCANHandle channel=PCAN_USBBUS2;
+    //bus load ramp [%]
+    double start_pct=10;
+    double stop_pct=90;
+    double step_pct=10;
+    quint32 step_ms=2000;
+    int ch100_nodes=4;          //TPDO 1..4 of N nodes from LOAD_NODE_TOP down
+    QVector<int> live_nodes;    //node ids on the bus, skipped by the CH100 frames
+    int random_pct=0;           //frames with random extended IDs and lengths
+    int burst_frames=0;         //sent back to back every burst_ms, on top of the load
+    quint32 burst_ms=100;
+    bool fd=false;              //random frames as CAN FD with bit rate switch
+    quint32 max_latency_ms=20;  //99th percentile a sustainable step stays below
+};
+bool load_parse(const QString &text, loadConfig &config, QString &error);
+
+//one step of the ramp: sent and tx_full come from the generator, the rest
+//from the frames the read loop saw
+struct loadStep{
+    double target_pct=0;
+    double achieved_pct=0;      //bus time of the frames sent over the step time
+    quint64 sent=0;
+    quint64 tx_full=0;          //writes refused by a full transmit queue
+    quint64 received=0;
+    quint64 lost=0;
+    quint64 reordered=0;
+    double latency_avg_us=0;    //write call to the read loop
+    double latency_p99_us=0;
+    double latency_max_us=0;
+    double wire_avg_us=0;       //write call to the receive timestamp
+    bool sustainable=false;
+};
+
+//end-to-end stress test: sends a CH100-like traffic mix at a stepped bus
+//load from its own channel, while the read loop of the receiving channel
+//hands every frame to process_frame(). Each frame carries a sequence
+//number in its first 4 bytes, so loss, reordering and latency are measured
+//on the frames as the application sees them; the generator's own frames
+//are claimed there and kept away from the decoders
+class LoadGenerator : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit LoadGenerator(QObject *parent = nullptr);
+    ~LoadGenerator() override;
+
+    //opens the TX channel with the bit rate of the receiver and starts the ramp
+    bool start_load(const loadConfig &config, CanTransport *receiver);
+    //stops sending and closes the TX channel, the results stay
+    void stop_load();
+    bool is_active() const {return active;}
+
+    //read loop, one ID lookup for frames not sent by the generator; true
+    //when the frame is one of ours and goes no further
+    bool process_frame(const canFrame &frame, qint64 now_us);
+
+    QVector<loadStep> steps();
+    //highest load of the steps from the start up to the first that lost
+    //frames or got too slow, 0 when the first one failed
+    double max_sustainable_pct();
+    QStringList report();
+    QString summary();
+    QString error() const {return m_error;}
+
+signals:
+    void step_finished(int step, double target_pct);
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    struct txStep{
+        double target_pct=0;
+        double busy_us=0;
+        qint64 elapsed_us=0;
+        quint64 sent=0;
+        quint64 tx_full=0;
+    };
+    struct rxStep{
+        quint64 received=0;
+        quint64 reordered=0;
+        quint64 latency_n=0;
+        double latency_sum_us=0;
+        double latency_max_us=0;
+        double wire_sum_us=0;
+        std::vector<quint32> histogram;
+    };
+
+    TPCANMsgFD next_frame();
+    bool send(TPCANMsgFD &msg, txStep &step);
+    int step_of(quint32 seq);
+
+    loadConfig config;
+    canBitrates rates;
+    std::unique_ptr<CanTransport> tx;
+    bool active=false;
+    std::atomic<bool> quit{false};
+    QString m_error;
+
+    //generator thread
+    quint32 seq=0;
+    int ch100_pos=0;
+    quint32 rng_state=1;
+    std::vector<TPCANMsgFD> ch100_frames;
+
+    //shared, the read loop looks up the send time and the step of a sequence
+    std::unique_ptr<std::atomic<qint64>[]> send_us;
+    quint32 step_first_seq[LOAD_MAX_STEPS+1];
+    std::atomic<int> steps_started{0};
+    std::atomic<quint64> n_sent{0};
+    QMutex mutex;
+    std::vector<txStep> tx_steps;
+
+    //read loop
+    bool std_ids[0x800];
+    quint32 expected=0;
+    int rx_pos=0;
+    std::vector<rxStep> rx_steps;
+};
+
+#endif // LOAD_GENERATOR_H
@@ -2,9 +2,11 @@
 
 #include <QApplication>
 #include <QFontDatabase>
+#include <QTimer>
 
 int main(int argc, char *argv[])
 {
+    const qint64 start_us=host_monotonic_us();
     QCoreApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QApplication a(argc, argv);
     QFontDatabase::addApplicationFont(":/fonts/DroidSansMono.ttf");
@@ -15,5 +17,9 @@ int main(int argc, char *argv[])
 
     PCAN_QT w;
     w.show();
+    //the first event loop turn runs once the window is on screen
+    QTimer::singleShot(0, &w, [&w,start_us](){
+        w.report_startup(start_us);
+    });
     return a.exec();
 }
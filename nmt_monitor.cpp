@@ -0,0 +1,209 @@
+#include "nmt_monitor.h"
+#include <limits>
+
+//a heartbeat is late this far past its period, the node is missing when
+//none came this far past it [percent of the period]
+#define NMT_LATE_PCT        25
+#define NMT_MISSING_PCT     50
+//learned periods follow the intervals with weight 1/8
+#define NMT_LEARN_SHIFT     3
+//longer intervals are outages, not periods
+#define NMT_LEARN_MAX_GAP   3
+
+#define NMT_NO_DEADLINE     std::numeric_limits<qint64>::max()
+
+NmtMonitor::NmtMonitor(TxScheduler *tx, QObject *parent)
+    : QObject(parent)
+    , tx(tx)
+{
+    clear();
+}
+
+void NmtMonitor::clear()
+{
+    for(auto &n : nodes){
+        const bool configured=n.configured;
+        const quint32 period=n.period_us;
+        n=nmtNode();
+        if(configured){
+            n.configured=true;
+            n.period_us=period;
+        }
+    }
+    next_deadline_us=NMT_NO_DEADLINE;
+}
+
+void NmtMonitor::set_period(int node, quint32 period_us)
+{
+    nmtNode &n=nodes[node&0x7F];
+    n.configured=period_us!=0;
+    n.period_us=period_us;
+    if(n.alive&&period_us){
+        n.deadline_us=n.last_host_us+qint64(period_us)*(100+NMT_MISSING_PCT)/100;
+        next_deadline_us=qMin(next_deadline_us,n.deadline_us);
+    }
+}
+
+void NmtMonitor::process_frame(const canFrame &frame)
+{
+    const TPCANMsgFD &msg=frame.msg;
+    if((msg.ID&~0x7Fu)!=CO_HEARTBEAT||msg.DLC<1
+            ||(msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_RTR|PCAN_MESSAGE_ECHO|PCAN_MESSAGE_STATUS)))
+        return;
+    const int id=int(msg.ID&0x7F);
+    if(!id)
+        return;
+
+    nmtNode &n=nodes[id];
+    const quint8 state=msg.DATA[0]&0x7F;
+
+    //a boot-up comes whenever the node restarted, it is no interval
+    if(state==NMT_STATE_BOOTUP){
+        n.boots++;
+    }
+    else if(n.heartbeats&&frame.ts_us>n.last_ts_us){
+        const quint64 interval=frame.ts_us-n.last_ts_us;
+        n.last_interval_us=quint32(qMin<quint64>(interval,0xFFFFFFFFu));
+        n.max_interval_us=qMax(n.max_interval_us,n.last_interval_us);
+        //after a loss the gap is already counted
+        if(n.alive&&n.period_us&&interval*100>quint64(n.period_us)*(100+NMT_LATE_PCT))
+            n.late++;
+        if(!n.configured){
+            if(!n.period_us)
+                n.period_us=n.last_interval_us;
+            else if(interval<quint64(n.period_us)*NMT_LEARN_MAX_GAP)
+                n.period_us=quint32(qint64(n.period_us)+((qint64(interval)-qint64(n.period_us))>>NMT_LEARN_SHIFT));
+        }
+    }
+    n.heartbeats++;
+    n.last_ts_us=frame.ts_us;
+    const qint64 silent_us=frame.host_us-n.last_host_us;
+    n.last_host_us=frame.host_us;
+
+    if(n.period_us){
+        n.deadline_us=frame.host_us+qint64(n.period_us)*(100+NMT_MISSING_PCT)/100;
+        next_deadline_us=qMin(next_deadline_us,n.deadline_us);
+    }
+    if(!n.alive){
+        n.alive=true;
+        if(n.losses)
+            emit node_back(id,silent_us);
+    }
+    if(state!=n.state){
+        const int from=n.state;
+        n.state=state;
+        emit state_changed(id,from,state);
+    }
+}
+
+void NmtMonitor::check(qint64 host_us)
+{
+    if(host_us<next_deadline_us)
+        return;
+
+    qint64 next=NMT_NO_DEADLINE;
+    for(int id=1;id<128;id++){
+        nmtNode &n=nodes[id];
+        if(!n.alive||!n.period_us)
+            continue;
+        if(host_us>=n.deadline_us){
+            n.alive=false;
+            n.losses++;
+            emit node_missing(id,host_us-n.last_host_us);
+            continue;
+        }
+        next=qMin(next,n.deadline_us);
+    }
+    next_deadline_us=next;
+}
+
+bool NmtMonitor::send(uchar command, int node)
+{
+    if(!tx||!tx->isRunning())
+        return false;
+    return tx->enqueue(nmt_command(command,node&0x7F),TX_PRIO_NMT);
+}
+
+int NmtMonitor::stop_idle(const QVector<int> &keep)
+{
+    int sent=0;
+    for(int id=1;id<128;id++){
+        const nmtNode &n=nodes[id];
+        if(!n.alive||n.state==NMT_STATE_STOPPED||keep.contains(id))
+            continue;
+        if(send(NMT_STOP,id))
+            sent++;
+    }
+    return sent;
+}
+
+nmtStats NmtMonitor::stats() const
+{
+    nmtStats s;
+    for(int id=1;id<128;id++){
+        const nmtNode &n=nodes[id];
+        if(!n.heartbeats)
+            continue;
+        s.nodes++;
+        s.heartbeats+=n.heartbeats;
+        s.late+=n.late;
+        s.losses+=n.losses;
+        if(!n.alive){
+            s.missing++;
+            continue;
+        }
+        switch(n.state){
+        case NMT_STATE_OPERATIONAL: s.operational++; break;
+        case NMT_STATE_PREOPERATIONAL: s.preoperational++; break;
+        case NMT_STATE_STOPPED: s.stopped++; break;
+        }
+    }
+    return s;
+}
+
+QString NmtMonitor::summary() const
+{
+    const nmtStats s=stats();
+    if(!s.nodes)
+        return QString();
+    return tr("NMT %1 nodes: %2 op, %3 pre-op, %4 stopped, %5 missing, %6 late")
+            .arg(s.nodes)
+            .arg(s.operational)
+            .arg(s.preoperational)
+            .arg(s.stopped)
+            .arg(s.missing)
+            .arg(s.late);
+}
+
+QStringList NmtMonitor::report() const
+{
+    QStringList lines;
+    for(int id=1;id<128;id++){
+        const nmtNode &n=nodes[id];
+        if(!n.heartbeats)
+            continue;
+        lines.append(tr("node %1: %2, heartbeat %3 ms%4 (last %5 ms, max %6 ms), %7 late, %8 lost, %9 boot-ups")
+                     .arg(id)
+                     .arg(n.alive?state_name(n.state):tr("missing"))
+                     .arg(n.period_us/1000.0,0,'f',1)
+                     .arg(n.configured?QString():tr(" learned"))
+                     .arg(n.last_interval_us/1000.0,0,'f',1)
+                     .arg(n.max_interval_us/1000.0,0,'f',1)
+                     .arg(n.late)
+                     .arg(n.losses)
+                     .arg(n.boots));
+    }
+    return lines;
+}
+
+QString NmtMonitor::state_name(int state)
+{
+    switch(state){
+    case NMT_STATE_BOOTUP: return tr("boot-up");
+    case NMT_STATE_STOPPED: return tr("stopped");
+    case NMT_STATE_OPERATIONAL: return tr("operational");
+    case NMT_STATE_PREOPERATIONAL: return tr("pre-operational");
+    case NMT_STATE_UNKNOWN: return tr("unknown");
+    }
+    return tr("0x%1").arg(state,2,16,QChar('0'));
+}
@@ -0,0 +1,88 @@
+#ifndef NMT_MONITOR_H
+#define NMT_MONITOR_H
+
+#include "canopen.h"
+#include "tx_scheduler.h"
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+//heartbeat states (CiA 301), bit 7 of the byte is the node guarding toggle
+#define NMT_STATE_BOOTUP            0x00
+#define NMT_STATE_STOPPED           0x04
+#define NMT_STATE_OPERATIONAL       0x05
+#define NMT_STATE_PREOPERATIONAL    0x7F
+#define NMT_STATE_UNKNOWN           0xFF
+
+struct nmtNode{
+    quint8 state=NMT_STATE_UNKNOWN;
+    bool alive=false;           //last heartbeat within its deadline
+    bool configured=false;      //period set, not learned
+    quint32 period_us=0;        //heartbeat producer time, 0 until known
+    quint64 last_ts_us=0;       //hardware time of the last heartbeat
+    qint64 last_host_us=0;
+    qint64 deadline_us=0;       //host time after which the node is missing
+    quint32 last_interval_us=0;
+    quint32 max_interval_us=0;
+    quint64 heartbeats=0;
+    quint64 late=0;
+    quint64 losses=0;           //times the node went silent
+    quint64 boots=0;
+};
+
+struct nmtStats{
+    int nodes=0;                //heard at least once
+    int operational=0;
+    int preoperational=0;
+    int stopped=0;
+    int missing=0;
+    quint64 heartbeats=0;
+    quint64 late=0;
+    quint64 losses=0;
+};
+
+//NMT master side: follows the state and heartbeat timing of every node
+//from its heartbeats (0x700+node), timed with the hardware timestamps,
+//and sends NMT commands. A node is late when a heartbeat comes a quarter
+//period after it was due and missing when none came for one and a half
+//periods; periods not set are learned from the heartbeats
+class NmtMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NmtMonitor(TxScheduler *tx, QObject *parent = nullptr);
+
+    void clear();
+    //heartbeat producer time of a node (0x1017), 0 learns it again
+    void set_period(int node, quint32 period_us);
+
+    //read loop, one table lookup per frame
+    void process_frame(const canFrame &frame);
+    //declares the nodes past their deadline, returns at once when none is due
+    void check(qint64 host_us);
+
+    //node 0 addresses every node
+    bool send(uchar command, int node=0);
+    //stops every running node but the ones in keep, returns the count
+    int stop_idle(const QVector<int> &keep);
+
+    const nmtNode &node(int id) const {return nodes[id&0x7F];}
+    nmtStats stats() const;
+    //empty while no node was heard
+    QString summary() const;
+    QStringList report() const;
+    static QString state_name(int state);
+
+signals:
+    void state_changed(int node, int from, int to);
+    void node_missing(int node, qint64 silent_us);
+    void node_back(int node, qint64 silent_us);
+
+private:
+    TxScheduler *tx;
+    nmtNode nodes[128];
+    qint64 next_deadline_us;
+};
+
+#endif // NMT_MONITOR_H
@@ -0,0 +1,202 @@
+#include "node_config.h"
+#include "clock_sync.h"
+#include <QSettings>
+
+#define CO_OD_IDENTITY      0x1018
+#define CO_OD_VERIFY_CONFIG 0x1020
+
+QString nodeIdentity::key() const
+{
+    return QString("%1-%2-%3-%4")
+            .arg(vendor_id,8,16,QLatin1Char('0'))
+            .arg(product_code,8,16,QLatin1Char('0'))
+            .arg(revision,8,16,QLatin1Char('0'))
+            .arg(serial,8,16,QLatin1Char('0'));
+}
+
+//----------------------------------------------------------------------------
+// NodeConfigCache
+//----------------------------------------------------------------------------
+static QSettings *cache_settings()
+{
+    static QSettings settings(QSettings::IniFormat,QSettings::UserScope,"PCAN_QT","node_config");
+    return &settings;
+}
+
+bool NodeConfigCache::lookup(const nodeIdentity &id, nodeConfig &cfg) const
+{
+    QSettings *s=cache_settings();
+    s->beginGroup(id.key());
+    const bool found=s->contains("bitrate");
+    if(found){
+        cfg.identity=id;
+        cfg.has_stamp=s->value("has_stamp").toBool();
+        cfg.config_date=s->value("config_date").toUInt();
+        cfg.config_time=s->value("config_time").toUInt();
+        cfg.bitrate=s->value("bitrate").toUInt();
+        cfg.node_id=s->value("node_id").toUInt();
+        const QStringList tpdo=s->value("tpdo_interval_ms").toStringList();
+        for(int i=0;i<5;i++)
+            cfg.tpdo_interval_ms[i]=i<tpdo.size()?quint16(tpdo.at(i).toUInt()):0;
+    }
+    s->endGroup();
+    return found;
+}
+
+void NodeConfigCache::store(const nodeConfig &cfg)
+{
+    QStringList tpdo;
+    for(quint16 ms : cfg.tpdo_interval_ms)
+        tpdo<<QString::number(ms);
+
+    QSettings *s=cache_settings();
+    s->beginGroup(cfg.identity.key());
+    s->setValue("has_stamp",cfg.has_stamp);
+    s->setValue("config_date",cfg.config_date);
+    s->setValue("config_time",cfg.config_time);
+    s->setValue("bitrate",cfg.bitrate);
+    s->setValue("node_id",cfg.node_id);
+    s->setValue("tpdo_interval_ms",tpdo);
+    s->endGroup();
+    s->sync();
+}
+
+void NodeConfigCache::remove(const nodeIdentity &id)
+{
+    QSettings *s=cache_settings();
+    s->remove(id.key());
+    s->sync();
+}
+
+//----------------------------------------------------------------------------
+// NodeConfigLoader
+//----------------------------------------------------------------------------
+NodeConfigLoader::NodeConfigLoader(SdoClient *sdo, QObject *parent)
+    : QObject(parent)
+    , sdo(sdo)
+{
+    qRegisterMetaType<nodeConfig>("nodeConfig");
+    connect(sdo, &SdoClient::finished, this, &NodeConfigLoader::sdo_finished);
+}
+
+void NodeConfigLoader::request(ushort index, uchar sub)
+{
+    outstanding.insert(sdo->read(node,index,sub));
+}
+
+void NodeConfigLoader::load(int node_id)
+{
+    node=node_id;
+    cfg=nodeConfig();
+    identity_ok=true;
+    read_ok=true;
+    outstanding.clear();
+    start_us=host_monotonic_us();
+
+    ph=PH_VALIDATE;
+    for(uchar sub=1;sub<=4;sub++)
+        request(CO_OD_IDENTITY,sub);
+    cfg.has_stamp=true;
+    request(CO_OD_VERIFY_CONFIG,1);
+    request(CO_OD_VERIFY_CONFIG,2);
+}
+
+void NodeConfigLoader::invalidate(int node_id)
+{
+    auto it=identities.find(node_id);
+    if(it==identities.end())
+        return;
+    cache.remove(it.value());
+    identities.erase(it);
+}
+
+//little-endian unsigned value of 1..4 bytes
+static quint32 le_value(const QByteArray &data)
+{
+    quint32 v=0;
+    for(int i=0;i<data.size()&&i<4;i++)
+        v|=quint32(uchar(data[i]))<<(8*i);
+    return v;
+}
+
+void NodeConfigLoader::sdo_finished(const sdoResult &result)
+{
+    if(!outstanding.remove(result.id))
+        return;
+
+    const quint32 v=le_value(result.data);
+    const bool ok=!result.abort_code;
+
+    if(result.index==CO_OD_IDENTITY){
+        identity_ok&=ok;
+        switch(result.sub){
+        case 1: cfg.identity.vendor_id=v; break;
+        case 2: cfg.identity.product_code=v; break;
+        case 3: cfg.identity.revision=v; break;
+        case 4: cfg.identity.serial=v; break;
+        }
+    }
+    else if(result.index==CO_OD_VERIFY_CONFIG){
+        cfg.has_stamp&=ok;
+        if(result.sub==1)
+            cfg.config_date=v;
+        else
+            cfg.config_time=v;
+    }
+    else{
+        read_ok&=ok;
+        if(result.index==CH100_OD_BITRATE)
+            cfg.bitrate=v;
+        else if(result.index==CH100_OD_NODE_ID)
+            cfg.node_id=v;
+        else if(result.index>=0x1800&&result.index<0x1805)
+            cfg.tpdo_interval_ms[result.index-0x1800]=quint16(v);
+    }
+
+    //a node that does not answer at all, drop the rest of the sequence
+    if(result.abort_code==SDO_ABORT_TIMEOUT&&ph==PH_VALIDATE&&result.index==CO_OD_IDENTITY&&result.sub==1){
+        sdo->cancel(node);
+        outstanding.clear();
+        ph=PH_IDLE;
+        emit failed(node,tr("node %1 does not respond").arg(node));
+        return;
+    }
+
+    if(!outstanding.isEmpty())
+        return;
+    if(ph==PH_VALIDATE)
+        validated();
+    else if(ph==PH_READ)
+        done(false);
+}
+
+void NodeConfigLoader::validated()
+{
+    nodeConfig cached;
+    //the identity does not change with the configuration, so without 0x1020
+    //(the CH100) nothing tells a stale entry apart and the objects are read
+    if(identity_ok&&cfg.has_stamp&&cache.lookup(cfg.identity,cached)&&cached.has_stamp
+            &&cached.config_date==cfg.config_date&&cached.config_time==cfg.config_time){
+        cfg=cached;
+        done(true);
+        return;
+    }
+
+    ph=PH_READ;
+    request(CH100_OD_BITRATE,0);
+    request(CH100_OD_NODE_ID,0);
+    for(int n=0;n<5;n++)
+        request(ushort(0x1800+n),5);
+}
+
+void NodeConfigLoader::done(bool from_cache)
+{
+    ph=PH_IDLE;
+    if(identity_ok){
+        identities.insert(node,cfg.identity);
+        //only a complete read of a device with 0x1020 is ever validated
+        if(!from_cache&&read_ok&&cfg.has_stamp)
+            cache.store(cfg);
+    }
+    emit loaded(node,cfg,from_cache,host_monotonic_us()-start_us);
+}
@@ -0,0 +1,84 @@
+#ifndef NODE_CONFIG_H
+#define NODE_CONFIG_H
+
+#include "sdo_client.h"
+#include <QObject>
+#include <QHash>
+#include <QSet>
+
+//0x1018 identity object
+struct nodeIdentity{
+    quint32 vendor_id=0;
+    quint32 product_code=0;
+    quint32 revision=0;
+    quint32 serial=0;
+    QString key() const;
+};
+
+//CH100 settings shown in the main window
+struct nodeConfig{
+    nodeIdentity identity;
+    bool has_stamp=false;       //0x1020 verify configuration is implemented
+    quint32 config_date=0;
+    quint32 config_time=0;
+    quint32 bitrate=0;          //bit/s
+    quint32 node_id=0;
+    quint16 tpdo_interval_ms[5]={0};
+};
+Q_DECLARE_METATYPE(nodeConfig)
+
+//last known configuration per device, persisted between sessions
+class NodeConfigCache
+{
+public:
+    bool lookup(const nodeIdentity &id, nodeConfig &cfg) const;
+    void store(const nodeConfig &cfg);
+    void remove(const nodeIdentity &id);
+};
+
+
+//reads a node's configuration: identity (0x1018) and configuration stamp
+//(0x1020) first, which is cheap to compare with the cache; the bitrate,
+//node ID and TPDO intervals are only read again when the cache entry is
+//missing or stale, or when the device has no 0x1020 to tell. Requests
+//are pipelined through SdoClient, so there are no fixed waits.
+class NodeConfigLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NodeConfigLoader(SdoClient *sdo, QObject *parent = nullptr);
+
+    void load(int node);
+    bool busy() const {return !outstanding.isEmpty();}
+    //the node's settings are about to change, forget the cached copy
+    void invalidate(int node);
+
+signals:
+    void loaded(int node, const nodeConfig &cfg, bool from_cache, qint64 elapsed_us);
+    void failed(int node, QString text);
+
+private slots:
+    void sdo_finished(const sdoResult &result);
+
+private:
+    enum phase{PH_IDLE=0, PH_VALIDATE, PH_READ};
+
+    void request(ushort index, uchar sub);
+    void validated();
+    void done(bool from_cache);
+
+    SdoClient *sdo;
+    NodeConfigCache cache;
+    QHash<int, nodeIdentity> identities;
+
+    phase ph=PH_IDLE;
+    int node=0;
+    nodeConfig cfg;
+    bool identity_ok=true;
+    bool read_ok=true;
+    QSet<quint32> outstanding;
+    qint64 start_us=0;
+};
+
+#endif // NODE_CONFIG_H
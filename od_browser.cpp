@@ -0,0 +1,238 @@
+#include "od_browser.h"
+#include "clock_sync.h"
+#include <QTreeWidget>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QLabel>
+#include <QPushButton>
+#include <QFileDialog>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QElapsedTimer>
+
+enum odColumn{COL_INDEX=0, COL_NAME, COL_TYPE, COL_ACCESS, COL_VALUE};
+
+//expedited SDO carries at most 4 bytes
+static bool needs_transfer(int data_type)
+{
+    int size=od_type_size(data_type);
+    return size==0||size>4;
+}
+
+OdBrowser::OdBrowser(SdoClient *sdo, SdoTransfer *xfer, int node_id, QWidget *parent)
+    : QDialog(parent)
+    , sdo(sdo)
+    , xfer(xfer)
+{
+    setWindowTitle(tr("Object Dictionary"));
+    resize(760,520);
+
+    QPushButton *btn_load=new QPushButton(tr("Load EDS..."));
+    sb_node=new QSpinBox();
+    sb_node->setRange(1,127);
+    sb_node->setValue(node_id);
+    QPushButton *btn_read_all=new QPushButton(tr("Read All"));
+
+    QHBoxLayout *top=new QHBoxLayout();
+    top->addWidget(btn_load);
+    top->addStretch();
+    top->addWidget(new QLabel(tr("Node ID:")));
+    top->addWidget(sb_node);
+    top->addWidget(btn_read_all);
+
+    tree=new QTreeWidget();
+    tree->setHeaderLabels({tr("Index"),tr("Name"),tr("Type"),tr("Access"),tr("Value")});
+    tree->setColumnWidth(COL_INDEX,110);
+    tree->setColumnWidth(COL_NAME,240);
+
+    line_value=new QLineEdit();
+    QPushButton *btn_read=new QPushButton(tr("Read"));
+    QPushButton *btn_write=new QPushButton(tr("Write"));
+    QHBoxLayout *bottom=new QHBoxLayout();
+    bottom->addWidget(new QLabel(tr("Value:")));
+    bottom->addWidget(line_value);
+    bottom->addWidget(btn_read);
+    bottom->addWidget(btn_write);
+
+    label_status=new QLabel();
+
+    QVBoxLayout *layout=new QVBoxLayout(this);
+    layout->addLayout(top);
+    layout->addWidget(tree);
+    layout->addLayout(bottom);
+    layout->addWidget(label_status);
+
+    connect(btn_load, &QPushButton::clicked, this, &OdBrowser::load_clicked);
+    connect(btn_read, &QPushButton::clicked, this, &OdBrowser::read_clicked);
+    connect(btn_write, &QPushButton::clicked, this, &OdBrowser::write_clicked);
+    connect(btn_read_all, &QPushButton::clicked, this, &OdBrowser::read_all_clicked);
+    connect(sdo, &SdoClient::finished, this, &OdBrowser::sdo_finished);
+    connect(xfer, &SdoTransfer::finished, this, &OdBrowser::transfer_finished);
+}
+
+void OdBrowser::load_clicked()
+{
+    QString path=QFileDialog::getOpenFileName(this,tr("Open EDS/DCF"),QString(),tr("CANopen EDS (*.eds *.dcf);;All files (*)"));
+    if(path.isEmpty())
+        return;
+
+    QElapsedTimer t;
+    t.start();
+    if(!dict.load(path)){
+        label_status->setText(tr("Load failed: %1").arg(dict.error()));
+        return;
+    }
+    populate();
+    label_status->setText(tr("%1 entries loaded in %2 ms (%3)")
+                          .arg(dict.count())
+                          .arg(t.nsecsElapsed()/1e6,0,'f',2)
+                          .arg(dict.from_cache()?tr("cache"):tr("parsed")));
+}
+
+void OdBrowser::populate()
+{
+    tree->clear();
+    items.clear();
+    QTreeWidgetItem *parent=nullptr;
+    quint16 parent_index=0;
+
+    for(int i=0;i<dict.count();i++){
+        const odEntry &e=dict.entry(i);
+        QTreeWidgetItem *item;
+        if(e.object_type!=0x7){
+            //ARRAY/RECORD header, its sub-objects go below
+            item=new QTreeWidgetItem(tree);
+            item->setText(COL_INDEX,QString("%1").arg(e.index,4,16,QLatin1Char('0')).toUpper());
+            item->setText(COL_NAME,dict.name(i));
+            parent=item;
+            parent_index=e.index;
+            continue;
+        }
+        if(parent&&parent_index==e.index)
+            item=new QTreeWidgetItem(parent);
+        else
+            item=new QTreeWidgetItem(tree);
+
+        item->setText(COL_INDEX,QString("%1sub%2").arg(e.index,4,16,QLatin1Char('0')).arg(e.sub,0,16).toUpper());
+        item->setText(COL_NAME,dict.name(i));
+        item->setText(COL_TYPE,od_type_name(e.data_type));
+        item->setText(COL_ACCESS,(e.access&OD_ACCESS_CONST)?"const"
+                                 :(e.access==OD_ACCESS_READ)?"ro"
+                                 :(e.access==OD_ACCESS_WRITE)?"wo":"rw");
+        item->setText(COL_VALUE,dict.default_value(i));
+        item->setData(0,Qt::UserRole,i);
+        items.insert(quint32(e.index)<<8|e.sub,item);
+    }
+}
+
+int OdBrowser::selected_entry() const
+{
+    QTreeWidgetItem *item=tree->currentItem();
+    if(!item||!item->data(0,Qt::UserRole).isValid())
+        return -1;
+    return item->data(0,Qt::UserRole).toInt();
+}
+
+void OdBrowser::read_entry(int i, bool bulk)
+{
+    const odEntry &e=dict.entry(i);
+    const quint32 key=quint32(e.index)<<8|e.sub;
+    if(needs_transfer(e.data_type)){
+        const quint32 id=xfer->upload(sb_node->value(),e.index,e.sub);
+        my_transfers.insert(id,key);
+        if(bulk)
+            bulk_transfers.insert(id);
+    }
+    else{
+        const quint32 id=sdo->read(sb_node->value(),e.index,e.sub);
+        my_requests.insert(id,key);
+        if(bulk)
+            bulk_requests.insert(id);
+    }
+}
+
+void OdBrowser::read_clicked()
+{
+    int i=selected_entry();
+    if(i<0)
+        return;
+    read_entry(i);
+}
+
+void OdBrowser::write_clicked()
+{
+    int i=selected_entry();
+    if(i<0)
+        return;
+    const odEntry &e=dict.entry(i);
+    QByteArray data;
+    if(!od_encode(e.data_type,line_value->text(),data)){
+        label_status->setText(tr("'%1' is not a valid %2").arg(line_value->text()).arg(od_type_name(e.data_type)));
+        return;
+    }
+    const quint32 key=quint32(e.index)<<8|e.sub;
+    if(needs_transfer(e.data_type))
+        my_transfers.insert(xfer->download(sb_node->value(),e.index,e.sub,data),key);
+    else
+        my_requests.insert(sdo->write(sb_node->value(),e.index,e.sub,data),key);
+}
+
+void OdBrowser::read_all_clicked()
+{
+    QVector<int> entries;
+    for(int i=0;i<dict.count();i++){
+        const odEntry &e=dict.entry(i);
+        if(e.object_type==0x7&&(e.access&OD_ACCESS_READ))
+            entries.append(i);
+    }
+    if(entries.isEmpty())
+        return;
+
+    bulk_start_us=host_monotonic_us();
+    //ids are handed out in order, so they are known before the first reply
+    for(int i : qAsConst(entries))
+        read_entry(i,true);
+}
+
+void OdBrowser::sdo_finished(const sdoResult &result)
+{
+    auto req=my_requests.find(result.id);
+    if(req==my_requests.end())
+        return;
+    const quint32 key=req.value();
+    my_requests.erase(req);
+    show_result(key,result.data,result.abort_code,result.write,bulk_requests.remove(result.id));
+}
+
+void OdBrowser::transfer_finished(const sdoTransferResult &result)
+{
+    auto req=my_transfers.find(result.id);
+    if(req==my_transfers.end())
+        return;
+    const quint32 key=req.value();
+    my_transfers.erase(req);
+    const bool bulk=bulk_transfers.remove(result.id);
+    if(!result.abort_code&&!bulk)
+        label_status->setText(tr("%1 bytes in %2 ms (%3 kB/s)")
+                              .arg(result.data.size())
+                              .arg(result.elapsed_us/1000.0,0,'f',1)
+                              .arg(result.bytes_per_s/1000.0,0,'f',1));
+    show_result(key,result.data,result.abort_code,!result.upload,bulk);
+}
+
+void OdBrowser::show_result(quint32 key, const QByteArray &data, quint32 abort_code, bool write, bool bulk)
+{
+    QTreeWidgetItem *item=items.value(key,nullptr);
+    if(item){
+        int i=item->data(0,Qt::UserRole).toInt();
+        if(abort_code)
+            item->setText(COL_VALUE,tr("abort 0x%1").arg(abort_code,8,16,QLatin1Char('0')));
+        else if(!write)
+            item->setText(COL_VALUE,od_decode(dict.entry(i).data_type,data));
+    }
+
+    if(bulk&&bulk_requests.isEmpty()&&bulk_transfers.isEmpty()){
+        double ms=(host_monotonic_us()-bulk_start_us)/1000.0;
+        label_status->setText(tr("Read all: %1 ms").arg(ms,0,'f',1));
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef OD_BROWSER_H
+#define OD_BROWSER_H
+
+#include "eds_dictionary.h"
+#include "sdo_client.h"
+#include "sdo_transfer.h"
+#include <QDialog>
+#include <QHash>
+#include <QSet>
+
+class QTreeWidget;
+class QTreeWidgetItem;
+class QLineEdit;
+class QSpinBox;
+class QLabel;
+
+//browses an EDS/DCF dictionary and reads/writes its entries over SDO,
+//objects larger than 4 bytes go through the block transfer engine
+class OdBrowser : public QDialog
+{
+    Q_OBJECT
+
+public:
+    OdBrowser(SdoClient *sdo, SdoTransfer *xfer, int node_id, QWidget *parent = nullptr);
+
+private slots:
+    void load_clicked();
+    void read_clicked();
+    void write_clicked();
+    void read_all_clicked();
+    void sdo_finished(const sdoResult &result);
+    void transfer_finished(const sdoTransferResult &result);
+
+private:
+    void populate();
+    int selected_entry() const;
+    void read_entry(int i, bool bulk=false);
+    void show_result(quint32 key, const QByteArray &data, quint32 abort_code, bool write, bool bulk);
+
+    SdoClient *sdo;
+    SdoTransfer *xfer;
+    EdsDictionary dict;
+    QTreeWidget *tree;
+    QLineEdit *line_value;
+    QSpinBox *sb_node;
+    QLabel *label_status;
+    //(index<<8|sub) -> tree item
+    QHash<quint32, QTreeWidgetItem*> items;
+    QHash<quint32, quint32> my_requests;
+    QHash<quint32, quint32> my_transfers;
+    //ids of the "read all" reads still open, other requests may run meanwhile
+    QSet<quint32> bulk_requests;
+    QSet<quint32> bulk_transfers;
+    qint64 bulk_start_us=0;
+};
+
+#endif // OD_BROWSER_H
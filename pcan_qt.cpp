@@ -1,16 +1,109 @@
 #include "pcan_qt.h"
 #include "include/PCANBasic.h"
 #include "ui_pcan_qt.h"
-
-PCAN_QT::PCAN_QT(QWidget *parent)
+#include <QMenu>
+#include <QInputDialog>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QTextDocument>
+#include "od_browser.h"
+
+PCAN_QT::PCAN_QT(QWidget *parent, CanTransport *can)
     : QMainWindow(parent)
     , ui(new Ui::PCAN_QT)
 {
     ui->setupUi(this);
 
-
-
-    scan_channels();
+    m_can=can?can:new PcanTransport();
+    m_tx=new TxScheduler(m_can,this);
+    connect(m_tx, &TxScheduler::sent, this, &PCAN_QT::pcan_sent);
+    connect(m_tx, &TxScheduler::error, this, [this](QString text, quint32 tag){
+        manual_tx_pending.remove(tag);
+        ui->TB_fastsdo_msgbox->append(text);
+    });
+    m_health=new BusHealth(m_can,m_tx,this);
+    connect(m_health, &BusHealth::message, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    m_sdo=new SdoClient(m_tx,this);
+    m_sync=new SyncAcquisition(m_can,m_tx,m_sdo,this);
+    connect(m_tx, &TxScheduler::sent, m_sync, &SyncAcquisition::on_sent);
+    connect(m_sync, &SyncAcquisition::cycle_complete, this, &PCAN_QT::sync_cycle_complete);
+    connect(m_sync, &SyncAcquisition::message, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    m_nmt=new NmtMonitor(m_tx,this);
+    connect(m_nmt, &NmtMonitor::state_changed, this, [this](int node, int from, int to){
+        ui->TB_fastsdo_msgbox->append(tr("NMT node %1: %2 -> %3")
+                                      .arg(node).arg(NmtMonitor::state_name(from)).arg(NmtMonitor::state_name(to)));
+    });
+    connect(m_nmt, &NmtMonitor::node_missing, this, [this](int node, qint64 silent_us){
+        ui->TB_fastsdo_msgbox->append(tr("NMT node %1: no heartbeat for %2 ms")
+                                      .arg(node).arg(silent_us/1000.0,0,'f',1));
+    });
+    connect(m_nmt, &NmtMonitor::node_back, this, [this](int node, qint64 silent_us){
+        ui->TB_fastsdo_msgbox->append(tr("NMT node %1: back after %2 ms")
+                                      .arg(node).arg(silent_us/1000.0,0,'f',1));
+    });
+    m_profiler=new SdoProfiler(m_can,m_tx,this);
+    connect(m_tx, &TxScheduler::sent, m_profiler, &SdoProfiler::on_sent);
+    m_xfer=new SdoTransfer(m_tx,this);
+    m_capture=new CaptureWriter(this);
+    m_indexer=new PyramidIndexer(this);
+    connect(m_indexer, &PyramidIndexer::indexed, this, &PCAN_QT::pyramid_indexed);
+    connect(m_indexer, &PyramidIndexer::failed, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    m_batch=new BatchAnalyzer(this);
+    connect(m_batch, &BatchAnalyzer::analyzed, this, &PCAN_QT::batch_analyzed);
+    m_detect=new BitrateDetector(this);
+    connect(m_detect, &BitrateDetector::detected, this, &PCAN_QT::bitrate_detected);
+    connect(m_detect, &BitrateDetector::failed, this, [this](QString text){
+        ui->TB_fastsdo_msgbox->append(tr("Bit rate detection: %1").arg(text));
+        ui->BTN_init->setEnabled(true);
+    });
+    m_import=new TraceImporter(this);
+    connect(m_import, &TraceImporter::imported, this, &PCAN_QT::trace_imported);
+    connect(m_import, &TraceImporter::failed, this, [this](QString text){
+        act_replay->setChecked(false);
+        pop_msgbox(text);
+    });
+    m_config=new NodeConfigLoader(m_sdo,this);
+    connect(m_config, &NodeConfigLoader::loaded, this, &PCAN_QT::node_config_loaded);
+    connect(m_config, &NodeConfigLoader::failed, this, [this](int node, QString text){
+        ui->GB_qsc_content->setEnabled(false);
+        ui->TB_fastsdo_msgbox->append(tr("Read config of node %1: %2").arg(node).arg(text));
+    });
+    connect(m_capture, &CaptureWriter::failed, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    m_trigger=new TriggerCapture(this);
+    connect(m_trigger, &TriggerCapture::failed, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    connect(m_trigger, &TriggerCapture::dumped, this, [this](QString path, int frames, QString rule){
+        ui->TB_fastsdo_msgbox->append(tr("Trigger \"%1\": %2 frames -> %3").arg(rule).arg(frames).arg(path));
+    });
+    m_alarms=new AlarmEngine(this);
+    m_alarm_server=new AlarmBroadcaster(this);
+    connect(m_alarms, &AlarmEngine::failed, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    connect(m_alarms, &AlarmEngine::alarm, m_alarm_server, &AlarmBroadcaster::publish);
+    connect(m_alarms, &AlarmEngine::alarm, this, [this](const alarmEvent &ev){
+        ui->TB_fastsdo_msgbox->append(tr("Alarm \"%1\" node %2 %3: %4 (limit %5)")
+                                      .arg(ev.name)
+                                      .arg(ev.node)
+                                      .arg(ev.raised?tr("raised"):tr("cleared"))
+                                      .arg(double(ev.value),0,'g',5)
+                                      .arg(double(ev.threshold),0,'g',5));
+    });
+
+    m_load=new LoadGenerator(this);
+    connect(m_load, &LoadGenerator::failed, ui->TB_fastsdo_msgbox, &QTextBrowser::append);
+    connect(m_load, &LoadGenerator::step_finished, this, [this](int step, double target_pct){
+        ui->TB_fastsdo_msgbox->append(tr("Load test: step %1 at %2 % sent").arg(step+1).arg(target_pct,0,'f',0));
+    });
+    //the last frames are still on their way when the generator is done
+    connect(m_load, &QThread::finished, this, [this](){
+        QTimer::singleShot(LOAD_DRAIN_MS, this, &PCAN_QT::finish_load_test);
+    });
+
+    //channels stream in from the monitor thread once the window is up
+    m_channels=new ChannelMonitor(this);
+    m_channels->set_interval_ms(250);
+    connect(m_channels, &ChannelMonitor::channel_attached, this, &PCAN_QT::channel_attached);
+    connect(m_channels, &ChannelMonitor::channel_detached, this, &PCAN_QT::channel_detached);
+    connect(m_channels, &ChannelMonitor::scan_finished, this, &PCAN_QT::channel_scan_finished);
+    m_channels->start(QThread::LowPriority);
 
     ui->CB_can_baud->clear();
     ui->CB_tpdo_channel->clear();
@@ -20,6 +113,15 @@ PCAN_QT::PCAN_QT(QWidget *parent)
     QStringList CB_tpdo_hz={"0", "5", "10", "20", "50", "100", "200"};
     ui->CB_bitrate->addItems({"125 kbit/s","250 kbit/s","500 kbit/s","1000 kbit/s"});
     ui->CB_bitrate->setCurrentIndex(2);
+    //500 kbit/s nominal, 2 Mbit/s data at 80 MHz
+    ui->Line_bitrate_fd->setText("f_clock_mhz=80, nom_brp=10, nom_tseg1=12, nom_tseg2=3, nom_sjw=1, "
+                                 "data_brp=4, data_tseg1=7, data_tseg2=2, data_sjw=1");
+    ui->Line_bitrate_fd->setEnabled(false);
+    connect(ui->CK_fd_mode, &QCheckBox::toggled, ui->Line_bitrate_fd, &QLineEdit::setEnabled);
+    connect(ui->CK_fd_mode, &QCheckBox::toggled, ui->CB_bitrate, &QComboBox::setDisabled);
+    connect(ui->CK_fd_mode, &QCheckBox::toggled, this, [this](bool checked){
+        ui->SB_fastsdo_dlc->setMaximum(checked?64:8);
+    });
     ui->CB_can_baud->addItems(t_can_baud_list);
     ui->CB_can_baud->setCurrentIndex(2);
     ui->CB_tpdo_channel->addItems(t_TPDO_list);
@@ -34,10 +136,131 @@ PCAN_QT::PCAN_QT(QWidget *parent)
     ui->GB_can_qsc->setEnabled(false);
 
 
+    QMenu *menu_acq=ui->menubar->addMenu(tr("Acquisition"));
+    QAction *act_delta=menu_acq->addAction(tr("Delta-encoded TPDO bursts"));
+    act_delta->setCheckable(true);
+    QAction *act_fd_pack=menu_acq->addAction(tr("FD-packed TPDO bursts"));
+    act_fd_pack->setCheckable(true);
+    //one packing at a time, none checked is one sample per frame
+    auto set_packing=[this,act_delta,act_fd_pack](){
+        m_unpacker.set_packing(act_fd_pack->isChecked()?IMU_PACK_FD
+                               :act_delta->isChecked()?IMU_PACK_DELTA:IMU_PACK_NONE);
+        m_unpacker.reset();
+        m_pyramid_unpacker.set_packing(m_unpacker.packing());
+        m_pyramid_unpacker.reset();
+    };
+    connect(act_delta, &QAction::toggled, this, [act_fd_pack,set_packing](bool checked){
+        if(checked)
+            act_fd_pack->setChecked(false);
+        set_packing();
+    });
+    connect(act_fd_pack, &QAction::toggled, this, [act_delta,set_packing](bool checked){
+        if(checked)
+            act_delta->setChecked(false);
+        set_packing();
+    });
+    QAction *act_sync=menu_acq->addAction(tr("SYNC acquisition"));
+    act_sync->setCheckable(true);
+    connect(act_sync, &QAction::triggered, this, [this,act_sync](bool checked){
+        act_sync->setChecked(checked?start_sync_acquisition():false);
+        if(!checked)
+            stop_sync_acquisition();
+    });
+    QAction *act_capture=menu_acq->addAction(tr("Record capture..."));
+    act_capture->setCheckable(true);
+    connect(act_capture, &QAction::triggered, this, [this,act_capture](bool checked){
+        act_capture->setChecked(checked?start_capture():false);
+        if(!checked)
+            stop_capture();
+    });
+
+    QAction *act_trigger=menu_acq->addAction(tr("Trigger capture..."));
+    act_trigger->setCheckable(true);
+    connect(act_trigger, &QAction::triggered, this, [this,act_trigger](bool checked){
+        act_trigger->setChecked(checked?start_trigger_capture():false);
+        if(!checked)
+            stop_trigger_capture();
+    });
+    QAction *act_alarms=menu_acq->addAction(tr("Alarm rules..."));
+    act_alarms->setCheckable(true);
+    connect(act_alarms, &QAction::triggered, this, [this,act_alarms](bool checked){
+        act_alarms->setChecked(checked?start_alarms():false);
+        if(!checked)
+            stop_alarms();
+    });
+
+    QAction *act_bounded=menu_acq->addAction(tr("Bounded memory..."));
+    act_bounded->setCheckable(true);
+    connect(act_bounded, &QAction::triggered, this, [this,act_bounded](bool checked){
+        act_bounded->setChecked(checked?start_bounded_memory():false);
+        if(!checked)
+            stop_bounded_memory();
+    });
+
+    connect(menu_acq->addAction(tr("Detect bit rate and nodes")), &QAction::triggered, this, &PCAN_QT::detect_bitrate);
+
+    act_replay=menu_acq->addAction(tr("Replay trace..."));
+    act_replay->setCheckable(true);
+    connect(act_replay, &QAction::triggered, this, [this](bool checked){
+        if(checked)
+            act_replay->setChecked(start_replay());
+        else
+            stop_replay();
+    });
+
+    QMenu *menu_tools=ui->menubar->addMenu(tr("Tools"));
+    connect(menu_tools->addAction(tr("Object Dictionary...")), &QAction::triggered, this, [this](){
+        OdBrowser *browser=new OdBrowser(m_sdo,m_xfer,ui->SB_curr_node_id->value(),this);
+        browser->setAttribute(Qt::WA_DeleteOnClose);
+        browser->show();
+    });
+    connect(menu_tools->addAction(tr("Load DBC...")), &QAction::triggered, this, &PCAN_QT::load_dbc);
+    connect(menu_tools->addAction(tr("Memory usage")), &QAction::triggered, this, &PCAN_QT::memory_report);
+    connect(menu_tools->addAction(tr("Index capture...")), &QAction::triggered, this, &PCAN_QT::index_capture);
+    connect(menu_tools->addAction(tr("Batch analysis...")), &QAction::triggered, this, &PCAN_QT::batch_analysis);
+    act_load=menu_tools->addAction(tr("Load test..."));
+    act_load->setCheckable(true);
+    connect(act_load, &QAction::triggered, this, [this](bool checked){
+        act_load->setChecked(checked?start_load_test():false);
+        if(!checked)
+            stop_load_test();
+    });
+    act_profile=menu_tools->addAction(tr("SDO latency profile..."));
+    act_profile->setCheckable(true);
+    connect(act_profile, &QAction::triggered, this, [this](bool checked){
+        act_profile->setChecked(checked?start_sdo_profile():false);
+        if(!checked)
+            stop_sdo_profile();
+    });
+
+    QMenu *menu_net=ui->menubar->addMenu(tr("Network"));
+    connect(menu_net->addAction(tr("Start all nodes")), &QAction::triggered, this, [this](){
+        send_nmt(NMT_START);
+    });
+    connect(menu_net->addAction(tr("Pre-operational all nodes")), &QAction::triggered, this, [this](){
+        send_nmt(NMT_PREOPERATIONAL);
+    });
+    connect(menu_net->addAction(tr("Stop all nodes")), &QAction::triggered, this, [this](){
+        send_nmt(NMT_STOP);
+    });
+    connect(menu_net->addAction(tr("Stop all but current node")), &QAction::triggered, this, &PCAN_QT::stop_idle_nodes);
+    menu_net->addSeparator();
+    connect(menu_net->addAction(tr("Node list")), &QAction::triggered, this, &PCAN_QT::node_report);
+
     tmr_read= new QTimer();
     connect(tmr_read, &QTimer::timeout, this, &PCAN_QT::pcan_read);
     tmr_read->setInterval(3);
 
+    //same cadence as the read loop
+    tmr_replay= new QTimer();
+    connect(tmr_replay, &QTimer::timeout, this, &PCAN_QT::replay_tick);
+    tmr_replay->setInterval(3);
+
+    //display refresh in bounded memory mode, the parsers only update tables
+    tmr_render= new QTimer();
+    connect(tmr_render, &QTimer::timeout, this, &PCAN_QT::render_display);
+    tmr_render->setInterval(100);
+
     tmr_1000ms= new QTimer();
     connect(tmr_1000ms, &QTimer::timeout, this, &PCAN_QT::calc_hz);
     tmr_1000ms->setInterval(1000);
@@ -46,7 +269,12 @@ PCAN_QT::PCAN_QT(QWidget *parent)
 
 PCAN_QT::~PCAN_QT()
 {
+    m_channels->shutdown();
+    //the detector works on m_can
+    m_detect->cancel();
+    m_detect->wait();
     delete ui;
+    delete m_can;
 
 
 }
@@ -59,7 +287,7 @@ void PCAN_QT::pop_msgbox(QString text)
     int ret = msgBox.exec();
 }
 
-QString PCAN_QT::uchar_to_qstr( unsigned char *str, const int len ){
+QString PCAN_QT::uchar_to_qstr( const unsigned char *str, const int len ){
     QString result = "";
     int lengthOfString = len;
 
@@ -78,7 +306,8 @@ QString PCAN_QT::uchar_to_qstr( unsigned char *str, const int len ){
 void PCAN_QT::qstr_to_uchar(QString qstr, uchar *str){
     QString hex_str="";
 
-    if(qstr.length()<=16){
+    //up to 64 bytes for CAN FD payloads
+    if(qstr.length()<=128){
         for (int c = 0; c < qstr.length(); ++c) {
             hex_str += qstr[c];
             if ( c % 2){
@@ -91,62 +320,120 @@ void PCAN_QT::qstr_to_uchar(QString qstr, uchar *str){
     }
 }
 
-void PCAN_QT::scan_channels()
+void PCAN_QT::report_startup(qint64 start_us)
 {
-    DWORD channelsCount;
-    ui->CB_can_channels->clear();
-    if (CAN_GetValue(PCAN_NONEBUS, PCAN_ATTACHED_CHANNELS_COUNT, &channelsCount, 4) == PCAN_ERROR_OK)
-    {
-        if (channelsCount > 0)
-        {
+    ui->TB_fastsdo_msgbox->append(tr("Window shown %1 ms after start.")
+                                  .arg((host_monotonic_us()-start_us)/1000.0,0,'f',1));
+}
 
-            if (CAN_GetValue(PCAN_NONEBUS, PCAN_ATTACHED_CHANNELS, &channels, channelsCount *sizeof(TPCANChannelInformation)) == PCAN_ERROR_OK)
-            {
-                for (int i = 0; i < (int)channelsCount; i++)
-                {
-                    QString dev_name=tr("%1,HND=%2,PCANID=%3").arg(channels.device_name).arg(channels.channel_handle).arg(channels.device_id);
-                    ui->CB_can_channels->addItem(dev_name);
-                }
-            }
-        }
+static QString channel_text(const TPCANChannelInformation &info)
+{
+    QString text=QString("%1,HND=%2,PCANID=%3").arg(info.device_name).arg(info.channel_handle).arg(info.device_id);
+    if(info.channel_condition==PCAN_CHANNEL_OCCUPIED)
+        text+=" (occupied)";
+    return text;
+}
+
+void PCAN_QT::channel_attached(const TPCANChannelInformation &info)
+{
+    int i=ui->CB_can_channels->findData(info.channel_handle);
+    if(i<0)
+        ui->CB_can_channels->addItem(channel_text(info),info.channel_handle);
+    else
+        ui->CB_can_channels->setItemText(i,channel_text(info));
+
+    if(link_lost&&info.channel_handle==channel_handle&&(info.channel_condition&PCAN_CHANNEL_AVAILABLE))
+        try_reconnect();
+}
+
+void PCAN_QT::channel_detached(ushort handle)
+{
+    int i=ui->CB_can_channels->findData(handle);
+    if(i>=0)
+        ui->CB_can_channels->removeItem(i);
+
+    if(link_lost||!m_can->channel()||m_can->channel()!=handle)
+        return;
+    //USB glitch or unplug: hold the TX queue and keep everything captured
+    //so far, the channel is opened again when the adapter is back
+    link_lost=true;
+    link_lost_us=host_monotonic_us();
+    reconnect_attempts=0;
+    tmr_read->stop();
+    m_tx->set_paused(true);
+    ui->TB_fastsdo_msgbox->append(tr("PCAN channel 0x%1 lost, waiting for the adapter to return.").arg(handle,0,16));
+}
+
+void PCAN_QT::channel_scan_finished(int count, qint64 elapsed_us)
+{
+    ui->TB_fastsdo_msgbox->append(tr("Channel scan: %1 channel(s) in %2 ms.")
+                                  .arg(count).arg(elapsed_us/1000.0,0,'f',1));
+}
+
+void PCAN_QT::try_reconnect()
+{
+    if(!link_lost)
+        return;
+    TPCANStatus result=m_can->reinitialize();
+    if(result!=PCAN_ERROR_OK){
+        //the driver may still be bringing the device up
+        if(++reconnect_attempts<20)
+            QTimer::singleShot(100, this, &PCAN_QT::try_reconnect);
+        else
+            ui->TB_fastsdo_msgbox->append(tr("PCAN channel 0x%1 could not be reopened.").arg(channel_handle,0,16));
+        return;
     }
 
+    link_lost=false;
+    //the hardware clock restarted with the channel
+    m_clock.reset();
+    m_tx->set_paused(false);
+    tmr_read->start();
+    connect_us=host_monotonic_us();
+    on_BTN_read_config_clicked();
+    ui->TB_fastsdo_msgbox->append(tr("PCAN channel 0x%1 reconnected after %2 ms.")
+                                  .arg(channel_handle,0,16)
+                                  .arg((host_monotonic_us()-link_lost_us)/1000.0,0,'f',1));
+}
+
+//"500 kbit/s" of CB_bitrate, 0 when unknown
+static TPCANBaudrate baudrate_of(const QString &text)
+{
+    switch(text.split(" ")[0].toUInt()){
+    case(125):
+        return PCAN_BAUD_125K;
+    case(250):
+        return PCAN_BAUD_250K;
+    case(500):
+        return PCAN_BAUD_500K;
+    case(1000):
+        return PCAN_BAUD_1M;
+    default:
+        return 0;
+    }
 }
 
 void PCAN_QT::can_init()
 {
     if(ui->CB_can_channels->count()){
-        channel_handle=ui->CB_can_channels->currentText().split(",")[1].remove("HND=").toUShort();
+        channel_handle=ui->CB_can_channels->currentData().toUInt();
     }else{channel_handle=0;}
 
     if(ui->CB_bitrate->count()){
-
-        uint tmp_bitrate=ui->CB_bitrate->currentText().split(" ")[0].toUInt();
-
-        switch(tmp_bitrate){
-        case(125):
-            bitrate=PCAN_BAUD_125K;
-            break;
-        case(250):
-            bitrate=PCAN_BAUD_250K;
-            break;
-        case(500):
-            bitrate=PCAN_BAUD_500K;
-            break;
-        case(1000):
-            bitrate=PCAN_BAUD_1M;
-            break;
-        default:
-            bitrate=0;
-            break;
-        }
+        bitrate=baudrate_of(ui->CB_bitrate->currentText());
     }
 
-    if(channel_handle&&bitrate){
+    fd_mode=ui->CK_fd_mode->isChecked();
+    QByteArray bitrate_fd=ui->Line_bitrate_fd->text().trimmed().toLatin1();
+
+    if(channel_handle&&(fd_mode?!bitrate_fd.isEmpty():bitrate!=0)){
         TPCANStatus result = 0;
         char strMsg[256];
         // The Plug & Play Channel (PCAN-USB) is initialized
-        result = CAN_Initialize(channel_handle,bitrate);
+        if(fd_mode)
+            result = m_can->initialize_fd(channel_handle,bitrate_fd);
+        else
+            result = m_can->initialize(channel_handle,bitrate);
         if(result != PCAN_ERROR_OK)
         {
             // An error occurred, get a text describing the error and show it
@@ -154,7 +441,16 @@ void PCAN_QT::can_init()
             pop_msgbox(strMsg);
         }
         else{
-            ui->TB_fastsdo_msgbox->append("PCAN-USB (Ch-1) was initialized.");
+            ui->TB_fastsdo_msgbox->append(tr("PCAN channel 0x%1 was initialized (%2).")
+                                          .arg(channel_handle,0,16)
+                                          .arg(fd_mode?tr("CAN FD"):ui->CB_bitrate->currentText()));
+            ui->CK_fd_mode->setEnabled(false);
+            m_clock.reset();
+            m_health->start();
+            m_tx->start(QThread::TimeCriticalPriority);
+            m_xfer->start();
+            connect_us=host_monotonic_us();
+            on_BTN_read_config_clicked();
 
             ui->BTN_init->setEnabled(false);
             ui->BTN_release->setEnabled(true);
@@ -172,289 +468,430 @@ void PCAN_QT::can_uninit()
 {
     tmr_read->stop();
     tmr_1000ms->stop();
-    CAN_Uninitialize(channel_handle);
+    m_health->stop();
+    stop_sync_acquisition();
+    //no responses are read past this point
+    if(m_sync->is_configuring())
+        ui->TB_fastsdo_msgbox->append(tr("SYNC: channel closed, the TPDO settings may not be restored."));
+    stop_load_test();
+    stop_sdo_profile();
+    m_sdo->cancel_all();
+    m_xfer->shutdown();
+    m_tx->set_paused(false);
+    m_tx->shutdown();
+    manual_tx_pending.clear();
+    m_can->uninitialize();
     channel_handle=0;
+    link_lost=false;
     bitrate=0;
-    tdpo_data.clear();
-    tdpo_hz.clear();
-    tdpo_ctr.clear();
+    m_frames.clear();
+    m_nmt->clear();
     config_tpdo_hz[5]={0};
     ui->BTN_init->setEnabled(true);
     ui->BTN_release->setEnabled(false);
     ui->GB_can_qsc->setEnabled(false);
+    ui->CK_fd_mode->setEnabled(true);
+    m_unpacker.reset();
 }
 
 void PCAN_QT::calc_hz()
 {
-    QMap<QString, int>::const_iterator itr = tdpo_ctr.constBegin();
-    while (itr != tdpo_ctr.constEnd()) {
-        tdpo_hz[itr.key()]=itr.value();
-        tdpo_ctr[itr.key()]=0;
-        ++itr;
+    m_frames.tick();
+    rx_changed=true;
+    if(m_pyramid.is_open()&&!m_pyramid.flush())
+        ui->TB_fastsdo_msgbox->append(tr("Pyramid: %1").arg(m_pyramid.error()));
+
+    QString status=m_health->summary();
+    if(m_sync->is_running()){
+        status.append(" | "+m_sync->summary());
+        if(sync_cycle_index)
+            status.append(tr(", cycle %1: %2/%3 TPDOs within %4 us")
+                          .arg(sync_cycle_index).arg(sync_cycle_received).arg(sync_cycle_expected)
+                          .arg(sync_cycle_spread_us,0,'f',0));
+    }
+    if(m_load->is_active())
+        status.append(" | "+m_load->summary());
+    if(m_profiler->is_active())
+        status.append(" | "+m_profiler->summary());
+    if(m_batch->isRunning())
+        status.append(tr(" | batch %1 of %2 files").arg(m_batch->files_done()).arg(m_batch->files_total()));
+    const QString nmt=m_nmt->summary();
+    if(!nmt.isEmpty())
+        status.append(" | "+nmt);
+    if(m_clock.is_locked()){
+        status.append(tr(" | HW clock drift %1 ppm, offset %2 us, jitter %3 us")
+                      .arg(m_clock.drift_ppm(),0,'f',1)
+                      .arg(qint64(m_clock.offset_us()))
+                      .arg(m_clock.residual_us(),0,'f',0));
     }
+    if(memory_budget){
+        qint64 used=0;
+        for(const memoryUsage &u : memory_usage())
+            used+=u.used;
+        status.append(tr(" | memory %1 of %2 MB").arg(used/1048576.0,0,'f',1).arg(memory_budget/1048576.0,0,'f',0));
+    }
+    ui->statusbar->showMessage(status);
+}
+
+void PCAN_QT::data_parser(const canFrame &frame)
+{
+    m_frames.update(frame);
+    rx_changed=true;
+    //bounded memory mode renders from the table on tmr_render
+    if(!memory_budget)
+        render_rx();
 }
 
-void PCAN_QT::data_parser(TPCANMsg msg)
+void PCAN_QT::render_rx()
 {
+    static const char hex_digits[]="0123456789ABCDEF";
+    //room for "XX " per byte of the largest payload the channel mode allows
+    const int data_width=fd_mode?3*64:30;
 
-    QString rx_display="";
+    QString rx_display;
+    rx_display.reserve((m_frames.size()+1)*(data_width+32));
     rx_display.append(tr("%1%2%3%4\n").arg(tr("TPDO").leftJustified(10,' '))
                       .arg(tr("DLC").leftJustified(10,' '))
-                      .arg(tr("DATA").leftJustified(30,' '))
+                      .arg(tr("DATA").leftJustified(data_width,' '))
                       .arg(tr("Hz").leftJustified(10,' ')));
 
-    QString tpdo_id_hex = QString("0x%1").arg(msg.ID, 3, 16, QLatin1Char( '0' ));
-    QString data=uchar_to_qstr(msg.DATA,msg.LEN);
-
-
-
-    tdpo_data[tpdo_id_hex]=data;
-
-    QMap<QString, QString>::const_iterator itr = tdpo_data.constBegin();
-    while (itr != tdpo_data.constEnd()) {
-        QString tmp_tdpo=itr.key();
-        int tmp_len=itr.value().length()/2;
-
-        QString tmp_data=itr.value();
-        for (int i = 2; i <= tmp_data.size(); i+=2+1)
-            tmp_data.insert(i, " ");
-
-        QString tmp_hz;
-        if (tdpo_hz.contains(tmp_tdpo))
-            tmp_hz = tr("%1").arg(tdpo_hz.value(tmp_tdpo));
-
-        rx_display.append(tr("%1%2%3%4\n").arg(tmp_tdpo.leftJustified(10,' '))
-                          .arg(QString::number(tmp_len).leftJustified(10,' '))
-                          .arg(tmp_data.leftJustified(30,' '))
-                          .arg(tmp_hz.leftJustified(10,' ')));
-        ++itr;
+    m_frames.for_each([&](const frameSlot &slot){
+        char hex[3*64];
+        for(int i=0;i<slot.len;i++){
+            hex[3*i]=hex_digits[slot.data[i]>>4];
+            hex[3*i+1]=hex_digits[slot.data[i]&0x0F];
+            hex[3*i+2]=' ';
+        }
+        rx_display.append(QString("%1%2%3%4\n").arg(QString("0x%1").arg(slot.id,3,16,QLatin1Char('0')).leftJustified(10,' '))
+                          .arg(QString::number(slot.len).leftJustified(10,' '))
+                          .arg(QString::fromLatin1(hex,3*slot.len).leftJustified(data_width,' '))
+                          .arg(QString::number(slot.hz).leftJustified(10,' ')));
+    });
+
+    //signals of the DBC messages received so far
+    for(int m=0;m<dbc_seen.size();m++){
+        if(!dbc_seen.at(m))
+            continue;
+        const dbcMessage &dm=m_dbc.message(m);
+        rx_display.append(QString("\n%1\n").arg(dm.name));
+        for(int i=dm.first_signal;i<dm.first_signal+dm.n_signals;i++){
+            const dbcSignal &sig=m_dbc.signal(i);
+            rx_display.append(QString("  %1%2 %3\n").arg(sig.name.leftJustified(28,' '))
+                              .arg(dbc_values.at(i),0,'g',8).arg(sig.unit));
+        }
     }
 
-
-    ui->Label_can_rx->setText(rx_display);
-
-    if(!tdpo_ctr.contains(tpdo_id_hex))
-        tdpo_ctr[tpdo_id_hex]=0;
-    else{
-        tdpo_ctr[tpdo_id_hex]+=1;
-    }
     ui->Label_can_rx->setText(rx_display);
-
-    //read config
-    if(flag_reading_cfg){
-        if(msg.ID-node_id==0x580){
-            flag_readcfg_succ=true;
-
-            QString qstr_data=uchar_to_qstr(msg.DATA,msg.LEN);
-
-            QString line=tr("(%1) PTO:%2, DLC:%3, DATA:%4")
-                    .arg("RX")
-                    .arg(tpdo_id_hex)
-                    .arg(msg.LEN)
-                    .arg(qstr_data);
-            ui->TB_fastsdo_msgbox->append(line);
-
-            QStringList datalist;
-            QRegularExpressionMatchIterator i = QRegularExpression("..?").globalMatch(qstr_data);
-            while (i.hasNext()) {
-                datalist << i.next().captured(0);
-            }
-            if(datalist.at(0)!="60"){
-                if(datalist.at(2)+datalist.at(1)=="2100"){//BAUD
-                    uint baud=(datalist.at(7).toUInt(NULL,16)<<24)
-                            +(datalist.at(6).toUInt(NULL,16)<<16)
-                            +(datalist.at(5).toUInt(NULL,16)<<8)
-                            +datalist.at(4).toUInt(NULL,16);
-                    for(int i=0;i<ui->CB_can_baud->count();i++){
-                        if(ui->CB_can_baud->itemText(i).toInt()==baud/1000){
-                            ui->CB_can_baud->setCurrentIndex(i);
-                        }
-                    }
-                }
-                else if(datalist.at(2)+datalist.at(1)=="2101"){//ID
-                    uint id=(datalist.at(7).toUInt(NULL,16)<<24)
-                            +(datalist.at(6).toUInt(NULL,16)<<16)
-                            +(datalist.at(5).toUInt(NULL,16)<<8)
-                            +datalist.at(4).toUInt(NULL,16);
-                    ui->SB_change_node_id->setValue(id);
-                }
-                else if(datalist.at(2)=="18"){//TPDO FREQUENCY
-
-                    uint freq=1000/((datalist.at(5).toUInt(NULL,16)<<8)
-                                    +datalist.at(4).toUInt(NULL,16));
-
-                    if(datalist.at(1)=="00"){config_tpdo_hz[0]=freq;}
-                    else if(datalist.at(1)=="01"){config_tpdo_hz[1]=freq;}
-                    else if(datalist.at(1)=="02"){config_tpdo_hz[2]=freq;}
-                    else if(datalist.at(1)=="03"){config_tpdo_hz[3]=freq;}
-                    else if(datalist.at(1)=="04"){config_tpdo_hz[4]=freq;}
-                    update_config_tpdo_hz();
-                }
-
-            }
-        }
-    }
+    rx_changed=false;
 }
 
-void PCAN_QT::imu_parser(TPCANMsg msg)
+void PCAN_QT::imu_parser(const canFrame &frame)
 {
+    const TPCANMsgFD &msg=frame.msg;
 
     if(node_id!=0){
         int TPDO=msg.ID-node_id;
 
-        if(TPDO==0x180){
-            //Accelerometer[G]
-            m_imu_data.acc[0]=((float)(int16_t)((uint)msg.DATA[0]|(uint)msg.DATA[1]<<8))/1000;
-            m_imu_data.acc[1]=((float)(int16_t)((uint)msg.DATA[2]|(uint)msg.DATA[3]<<8))/1000;
-            m_imu_data.acc[2]=((float)(int16_t)((uint)msg.DATA[4]|(uint)msg.DATA[5]<<8))/1000;
-        }
-        else if(TPDO==0x280){
-            //Gyroscope[deg/s]
-            m_imu_data.gyr[0]=((float)(int16_t)((uint)msg.DATA[0]|(uint)msg.DATA[1]<<8))/10;
-            m_imu_data.gyr[1]=((float)(int16_t)((uint)msg.DATA[2]|(uint)msg.DATA[3]<<8))/10;
-            m_imu_data.gyr[2]=((float)(int16_t)((uint)msg.DATA[4]|(uint)msg.DATA[5]<<8))/10;
-        }
-        else if(TPDO==0x380){
-            //Euler Angle[deg]
-            m_imu_data.eul[0]=((float)(int16_t)((uint)msg.DATA[0]|(uint)msg.DATA[1]<<8))/100;
-            m_imu_data.eul[1]=((float)(int16_t)((uint)msg.DATA[2]|(uint)msg.DATA[3]<<8))/100;
-            m_imu_data.eul[2]=((float)(int16_t)((uint)msg.DATA[4]|(uint)msg.DATA[5]<<8))/100;
-        }
-        else if(TPDO==0x480){
-            //Quaternion
-            m_imu_data.quat[0]=((float)(int16_t)((uint)msg.DATA[0]|(uint)msg.DATA[1]<<8))/10000;
-            m_imu_data.quat[1]=((float)(int16_t)((uint)msg.DATA[2]|(uint)msg.DATA[3]<<8))/10000;
-            m_imu_data.quat[2]=((float)(int16_t)((uint)msg.DATA[4]|(uint)msg.DATA[5]<<8))/10000;
-            m_imu_data.quat[3]=((float)(int16_t)((uint)msg.DATA[6]|(uint)msg.DATA[7]<<8))/10000;
+        //classic, FD packed and delta burst TPDOs all come out as samples,
+        //the display keeps the latest one of each signal
+        imuSample samples[IMU_FD_MAX_SAMPLES];
+        int n=m_unpacker.decode(frame,node_id,samples,IMU_FD_MAX_SAMPLES);
+        if(n>0){
+            const imuSample &last=samples[n-1];
+            float *dst[IMU_SIG_COUNT]={m_imu_data.acc,m_imu_data.gyr,m_imu_data.eul,m_imu_data.quat};
+            for(int a=0;a<imu_signal_axes(last.signal);a++)
+                dst[last.signal][a]=last.v[a];
+            //every sample, not only the displayed one
+            if(m_alarms->is_running())
+                m_alarms->post(samples,n);
         }
         else if(TPDO==0x680){
             m_imu_data.prs=0;
         }
 
-        QString str;
-
-        str.clear();
-
-        str.append(QString("%1%2%3%4\n").arg(tr(" "),20).arg(tr("X"),10).arg(tr("Y"),10).arg(tr("Z"),10));
-        str.append(QString("%1%2%3%4\n").arg(tr("Accelerometer[G] :").leftJustified(20,' ')).arg(QString::number(m_imu_data.acc[0], 'f', 3), 10).arg(QString::number(m_imu_data.acc[1], 'f', 3), 10).arg(QString::number(m_imu_data.acc[2], 'f', 3), 10));
-        str.append(QString("%1%2%3%4\n").arg(tr("Gyroscope[deg/s] :").leftJustified(20,' ')).arg(QString::number(m_imu_data.gyr[0], 'f', 3), 10).arg(QString::number(m_imu_data.gyr[1], 'f', 3), 10).arg(QString::number(m_imu_data.gyr[2], 'f', 3), 10));
-        str.append(QString("%1%2%3%4\n").arg(tr("Euler Angle[deg] :").leftJustified(20,' ')).arg(QString::number(m_imu_data.eul[0], 'f', 3), 10).arg(QString::number(m_imu_data.eul[1], 'f', 3), 10).arg(QString::number(m_imu_data.eul[2], 'f', 3), 10));
-        str.append(QString("%1%2%3%4%5\n").arg(tr(" "),20).arg(tr("W"),10).arg(tr("X"),10).arg(tr("Y"),10).arg(tr("Z"),10));
-        str.append(QString("%1%2%3%4%5\n").arg(tr("Quaternion :").leftJustified(20,' ')).arg(QString::number(m_imu_data.quat[0], 'f', 3), 10).arg(QString::number(m_imu_data.quat[1], 'f', 3), 10).arg(QString::number(m_imu_data.quat[2], 'f', 3), 10).arg(QString::number(m_imu_data.quat[3], 'f', 3), 10));
+        imu_changed=true;
+        if(!memory_budget)
+            render_imu();
+    }
+}
 
+void PCAN_QT::render_imu()
+{
+    QString str;
+
+    str.append(QString("%1%2%3%4\n").arg(tr(" "),20).arg(tr("X"),10).arg(tr("Y"),10).arg(tr("Z"),10));
+    str.append(QString("%1%2%3%4\n").arg(tr("Accelerometer[G] :").leftJustified(20,' ')).arg(QString::number(m_imu_data.acc[0], 'f', 3), 10).arg(QString::number(m_imu_data.acc[1], 'f', 3), 10).arg(QString::number(m_imu_data.acc[2], 'f', 3), 10));
+    str.append(QString("%1%2%3%4\n").arg(tr("Gyroscope[deg/s] :").leftJustified(20,' ')).arg(QString::number(m_imu_data.gyr[0], 'f', 3), 10).arg(QString::number(m_imu_data.gyr[1], 'f', 3), 10).arg(QString::number(m_imu_data.gyr[2], 'f', 3), 10));
+    str.append(QString("%1%2%3%4\n").arg(tr("Euler Angle[deg] :").leftJustified(20,' ')).arg(QString::number(m_imu_data.eul[0], 'f', 3), 10).arg(QString::number(m_imu_data.eul[1], 'f', 3), 10).arg(QString::number(m_imu_data.eul[2], 'f', 3), 10));
+    str.append(QString("%1%2%3%4%5\n").arg(tr(" "),20).arg(tr("W"),10).arg(tr("X"),10).arg(tr("Y"),10).arg(tr("Z"),10));
+    str.append(QString("%1%2%3%4%5\n").arg(tr("Quaternion :").leftJustified(20,' ')).arg(QString::number(m_imu_data.quat[0], 'f', 3), 10).arg(QString::number(m_imu_data.quat[1], 'f', 3), 10).arg(QString::number(m_imu_data.quat[2], 'f', 3), 10).arg(QString::number(m_imu_data.quat[3], 'f', 3), 10));
+    ui->Label_imudata->setText(str);
+    imu_changed=false;
+}
 
-        ui->Label_imudata->setText(str);
-    }
+void PCAN_QT::render_display()
+{
+    if(rx_changed)
+        render_rx();
+    if(imu_changed)
+        render_imu();
 }
 
 void PCAN_QT::pcan_read()
 {
-    TPCANMsg msg;
-    TPCANTimestamp timestamp;
+    canFrame frame;
     TPCANStatus result;
-    char strMsg[256];
 
-    do
+    for(;;)
     {
-        // Check the receive queue for new messages
-        result = CAN_Read(PCAN_USBBUS1,&msg,&timestamp);
-        if(result != PCAN_ERROR_QRCVEMPTY)
+        // Check the receive queue for new messages, classic frames are
+        // delivered in the FD layout with a 64-bit timestamp
+        result = m_can->read(frame);
+        if(result == PCAN_ERROR_OK)
+        {
+            // Error and status frames go to the bus supervisor, not to the decoders
+            if(m_health->process_frame(frame)){
+                // the trigger ring keeps them, a bus error can start a dump
+                if(m_trigger->is_armed()){
+                    m_clock.stamp(frame,host_monotonic_us());
+                    m_trigger->process_error(frame);
+                }
+                continue;
+            }
+
+            // Stamp with the unwrapped hardware time and the host time
+            m_clock.stamp(frame,host_monotonic_us());
+
+            // Echoes of our own frames only feed the timing consumers
+            m_sync->process_frame(frame);
+            m_profiler->process_frame(frame);
+            if(frame.msg.MSGTYPE & PCAN_MESSAGE_ECHO)
+                continue;
+            // Load test traffic is counted and dropped, it is no node's data
+            if(m_load->is_active()&&m_load->process_frame(frame,host_monotonic_us()))
+                continue;
+            dispatch_frame(frame);
+        }
+        else if(result & PCAN_ERROR_QRCVEMPTY)
         {
-            // Process the received message
-            data_parser(msg);
-            imu_parser(msg);
+            // Read until the queue is empty
+            break;
         }
         else
         {
-            // An error occurred, get a text describing the error and show it
-            // and handle the error
-            CAN_GetErrorText(result, 0, strMsg);
+            // Bus errors and overruns are handled in the background, a lost
+            // frame is no reason to stop draining the queue
+            m_health->process_status(result);
+            if(result != PCAN_ERROR_QOVERRUN)
+                break;
         }
-        // Try to read a message from the receive queue of the PCAN-USB, Channel 1,
-        // until the queue is empty
-    }while((result & PCAN_ERROR_QRCVEMPTY) != PCAN_ERROR_QRCVEMPTY);
+    }
 
+    // Nodes past their heartbeat deadline
+    m_nmt->check(host_monotonic_us());
 }
 
-void PCAN_QT::pcan_send(TPCANMsg msg)
+void PCAN_QT::dispatch_frame(const canFrame &frame)
 {
+    if(m_capture->is_open())
+        m_capture->append(frame);
+    // The pyramid of a recording indexes every node, as the indexer does
+    if(m_pyramid.is_open()&&!(frame.msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_RTR|PCAN_MESSAGE_STATUS))){
+        imuSample samples[IMU_FD_MAX_SAMPLES];
+        const int n=m_pyramid_unpacker.decode(frame,int(frame.msg.ID&0x7F),samples,IMU_FD_MAX_SAMPLES);
+        if(n>0)
+            m_pyramid.append(samples,n);
+    }
 
-    TPCANStatus result;
-    char strMsg[256];
-
-    // A CAN message is configured
-    //
-    msg.MSGTYPE = PCAN_MESSAGE_STANDARD;
-
-    // The message is sent using the PCAN-USB Channel 1
-    //
-    result = CAN_Write(PCAN_USBBUS1, &msg);
-    if(result != PCAN_ERROR_OK)
-    {
-        // An error occurred, get a text describing the error and show it
-        //
-        CAN_GetErrorText(result, 0, strMsg);
-        pop_msgbox(strMsg);
+    // Process the received message
+    if(!m_sdo->process_frame(frame))
+        m_xfer->post_frame(frame);
+    int dbc_message;
+    if(!dbc_values.isEmpty()&&m_dbc.decode(frame,dbc_values.data(),&dbc_message)>=0)
+        dbc_seen[dbc_message]=true;
+    m_nmt->process_frame(frame);
+    data_parser(frame);
+    imu_parser(frame);
+    if(m_trigger->is_armed())
+        m_trigger->process(frame,m_imu_data);
+}
 
+void PCAN_QT::replay_tick()
+{
+    //frames of the trace are due at their offset from the replay start
+    const qint64 now_us=host_monotonic_us();
+    const quint64 due_us=quint64(now_us-replay_start_us)+replay_first_us;
+    while(replay_pos<replay_frames.size()&&replay_frames[replay_pos].ts_us<=due_us){
+        canFrame frame=replay_frames[replay_pos++];
+        frame.host_us=replay_start_us+qint64(frame.ts_us-replay_first_us);
+        dispatch_frame(frame);
     }
-    else{
-        QString tpdo_id_hex = QString("0x%1").arg(msg.ID, 3, 16, QLatin1Char( '0' ));
-        QString line=tr("(%1) PTO:%2, DLC:%3, DATA:%4")
-                .arg("TX")
-                .arg(tpdo_id_hex)
-                .arg(msg.LEN)
-                .arg(uchar_to_qstr(msg.DATA,msg.LEN));
-        ui->TB_fastsdo_msgbox->append(line);
+    m_nmt->check(now_us);
+    if(replay_pos>=replay_frames.size()){
+        ui->TB_fastsdo_msgbox->append(tr("Replay finished, %1 frames.").arg(replay_frames.size()));
+        stop_replay();
     }
+}
 
+bool PCAN_QT::start_replay()
+{
+    QString path=QFileDialog::getOpenFileName(this,tr("Replay trace"),QString(),
+                                              tr("CAN traces (*.trc *.log *.asc *.pqc);;All files (*)"));
+    if(path.isEmpty())
+        return false;
+
+    //own captures are read directly, text traces are imported in the background
+    if(path.endsWith(".pqc",Qt::CaseInsensitive)){
+        CaptureReader reader;
+        std::vector<canFrame> frames;
+        if(!reader.open(path)||!reader.read_all(frames)){
+            pop_msgbox(reader.error());
+            return false;
+        }
+        begin_replay(std::move(frames));
+        return true;
+    }
+    ui->TB_fastsdo_msgbox->append(tr("Importing %1 ...").arg(path));
+    m_import->import(path);
+    return true;
 }
 
-void PCAN_QT::fastsdo_readcfg()
+bool PCAN_QT::load_dbc()
 {
-    TPCANMsg ask_msg;
+    QString path=QFileDialog::getOpenFileName(this,tr("Load DBC"),QString(),
+                                              tr("DBC files (*.dbc);;All files (*)"));
+    if(path.isEmpty())
+        return false;
+
+    const qint64 t0=host_monotonic_us();
+    if(!m_dbc.load(path)){
+        pop_msgbox(tr("Load DBC failed: %1").arg(m_dbc.error()));
+        dbc_values.clear();
+        dbc_seen.clear();
+        return false;
+    }
+    dbc_values.fill(0,m_dbc.signal_count());
+    dbc_seen.fill(false,m_dbc.message_count());
+    ui->TB_fastsdo_msgbox->append(tr("DBC %1: %2 messages, %3 signals, compiled in %4 ms")
+                                  .arg(path).arg(m_dbc.message_count()).arg(m_dbc.signal_count())
+                                  .arg((host_monotonic_us()-t0)/1000.0,0,'f',1));
+    return true;
+}
 
-    ask_msg.ID=node_id + 0x600;
-    ask_msg.LEN=8;
+void PCAN_QT::begin_replay(std::vector<canFrame> frames)
+{
+    replay_frames=std::move(frames);
+    replay_pos=0;
+    if(replay_frames.empty()){
+        stop_replay();
+        return;
+    }
+    replay_first_us=replay_frames.front().ts_us;
+    replay_start_us=host_monotonic_us();
+    node_id=ui->SB_curr_node_id->value();
+    m_unpacker.reset();
+    m_nmt->clear();
+    tmr_replay->start();
+    if(!tmr_1000ms->isActive())
+        tmr_1000ms->start();
+}
 
-    //bitrate
-    qstr_to_uchar("4000210000000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+void PCAN_QT::stop_replay()
+{
+    tmr_replay->stop();
+    std::vector<canFrame>().swap(replay_frames);
+    replay_pos=0;
+    act_replay->setChecked(false);
+    if(!channel_handle)
+        tmr_1000ms->stop();
+}
 
-    //read node id
-    qstr_to_uchar("4001210000000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+void PCAN_QT::trace_imported(const traceImportStats &stats)
+{
+    ui->TB_fastsdo_msgbox->append(tr("Imported %1 frames (%2, %3 lines skipped) in %4 ms, %5 MB/s on %6 threads.")
+                                  .arg(stats.frames)
+                                  .arg(trace_format_name(stats.format))
+                                  .arg(stats.skipped)
+                                  .arg(stats.elapsed_us/1000.0,0,'f',1)
+                                  .arg(stats.mb_per_s(),0,'f',0)
+                                  .arg(stats.threads));
+    if(act_replay->isChecked())
+        begin_replay(m_import->take_frames());
+    else
+        m_import->take_frames();
+}
 
-    //read freq of TPDO 1
-    qstr_to_uchar("4000180500000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+void PCAN_QT::pcan_send(TPCANMsgFD msg)
+{
+    // A CAN message is configured, payloads above 8 bytes go out as
+    // FD frames with bit rate switch
+    //
+    msg.MSGTYPE = PCAN_MESSAGE_STANDARD;
+    if(fd_mode && msg.DLC > 8)
+        msg.MSGTYPE |= PCAN_MESSAGE_FD | PCAN_MESSAGE_BRS;
 
-    //read freq of TPDO 2
-    qstr_to_uchar("4001180500000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+    if(!m_tx->isRunning()){
+        ui->TB_fastsdo_msgbox->append(tr("TX: channel is not initialized."));
+        return;
+    }
 
-    //read freq of TPDO 3
-    qstr_to_uchar("4002180500000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+    // The message is queued for the TX thread, network management first,
+    // then SDO, then everything else
+    //
+    txPriority prio=TX_PRIO_USER;
+    if(msg.ID==0x000||msg.ID==0x080||(msg.ID&0x780)==0x700)
+        prio=TX_PRIO_NMT;
+    else if((msg.ID&0x780)==0x600)
+        prio=TX_PRIO_SDO;
+    //tag 0 is for frames nobody follows
+    if(!++manual_tx_tag)
+        manual_tx_tag=1;
+    if(!m_tx->enqueue(msg,prio,manual_tx_tag))
+        ui->TB_fastsdo_msgbox->append(tr("TX: queue full, 0x%1 dropped.").arg(msg.ID,3,16,QLatin1Char('0')));
+    else
+        manual_tx_pending.insert(manual_tx_tag);
+}
 
-    //read freq of TPDO 4
-    qstr_to_uchar("4003180500000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+void PCAN_QT::pcan_sent(TPCANMsgFD msg, qint64 host_us, quint32 tag)
+{
+    Q_UNUSED(host_us);
 
-    //read freq of TPDO 5
-    qstr_to_uchar("4004180500000000",ask_msg.DATA);
-    pcan_send(ask_msg);
+    if(!manual_tx_pending.remove(tag))
+        return;
 
+    QString tpdo_id_hex = QString("0x%1").arg(msg.ID, 3, 16, QLatin1Char( '0' ));
+    QString line=tr("(%1) PTO:%2, DLC:%3, DATA:%4")
+            .arg("TX")
+            .arg(tpdo_id_hex)
+            .arg(can_dlc_to_len(msg.DLC))
+            .arg(uchar_to_qstr(msg.DATA,can_dlc_to_len(msg.DLC)));
+    ui->TB_fastsdo_msgbox->append(line);
 }
 
-void PCAN_QT::reading_cfg()
+void PCAN_QT::node_config_loaded(int node, const nodeConfig &cfg, bool from_cache, qint64 elapsed_us)
 {
-    if(flag_readcfg_succ){
-        ui->GB_qsc_content->setEnabled(true);
-    }else{
-        ui->GB_qsc_content->setEnabled(false);
+    for(int i=0;i<ui->CB_can_baud->count();i++){
+        if(ui->CB_can_baud->itemText(i).toUInt()==cfg.bitrate/1000)
+            ui->CB_can_baud->setCurrentIndex(i);
+    }
+    ui->SB_change_node_id->setValue(int(cfg.node_id));
+    for(int n=0;n<5;n++){
+        const uint interval=cfg.tpdo_interval_ms[n];
+        config_tpdo_hz[n]=interval?1000/interval:0;
+        //event time is the sample period of packed TPDOs
+        if(interval)
+            m_unpacker.set_sample_period_us(n,interval*1000);
+        if(n<IMU_SIG_COUNT)
+            m_alarms->set_configured_hz(node,n,float(config_tpdo_hz[n]));
     }
-    flag_reading_cfg=false;
-    flag_readcfg_succ=false;
+    update_config_tpdo_hz();
+    ui->GB_qsc_content->setEnabled(true);
+
+    ui->TB_fastsdo_msgbox->append(tr("Config of node %1 %2 in %3 ms (usable %4 ms after connect).")
+                                  .arg(node)
+                                  .arg(from_cache?tr("validated from cache"):tr("read"))
+                                  .arg(elapsed_us/1000.0,0,'f',1)
+                                  .arg((host_monotonic_us()-connect_us)/1000.0,0,'f',1));
 }
 
 void PCAN_QT::update_config_tpdo_hz()
@@ -467,9 +904,85 @@ void PCAN_QT::update_config_tpdo_hz()
 }
 
 
+bool PCAN_QT::start_sync_acquisition()
+{
+    if(!m_tx->isRunning()){
+        ui->TB_fastsdo_msgbox->append(tr("SYNC: channel is not initialized."));
+        return false;
+    }
+
+    bool ok=false;
+    QString text=QInputDialog::getText(this,tr("SYNC acquisition"),tr("Node IDs (comma separated):"),
+                                       QLineEdit::Normal,QString::number(ui->SB_curr_node_id->value()),&ok);
+    if(!ok)
+        return false;
+    int hz=QInputDialog::getInt(this,tr("SYNC acquisition"),tr("SYNC rate [Hz]:"),100,1,1000,1,&ok);
+    if(!ok)
+        return false;
+
+    QVector<int> nodes;
+    for(const QString &s : text.split(",",Qt::SkipEmptyParts)){
+        int id=s.trimmed().toInt();
+        if(id>0&&id<128)
+            nodes.append(id);
+    }
+    if(!m_sync->start(nodes,quint32(1000000/hz))){
+        ui->TB_fastsdo_msgbox->append(tr("SYNC: invalid node list (1..%1 nodes).").arg(SYNC_MAX_NODES));
+        return false;
+    }
+    sync_cycle_index=0;
+    sync_cycle_missing=false;
+    ui->TB_fastsdo_msgbox->append(tr("SYNC: %1 Hz, %2 node(s), TPDOs set to synchronous.").arg(hz).arg(nodes.size()));
+    return true;
+}
+
+void PCAN_QT::sync_cycle_complete(const syncCycle &cycle)
+{
+    //the TPDOs of all nodes to one SYNC: how far they spread after it and
+    //which nodes stayed silent; without echo frames the SYNC time is the
+    //host send time, the TPDOs are compared by their host time then
+    const bool hw=m_sync->stats().hw_timestamps;
+    double spread_us=0;
+    QStringList silent;
+    for(int i=0;i<cycle.n_nodes;i++){
+        bool heard=false;
+        for(int n=0;n<SYNC_TPDOS;n++){
+            if(!cycle.valid[i][n])
+                continue;
+            const canFrame &frame=cycle.frames[i][n];
+            spread_us=qMax(spread_us,hw?double(frame.ts_us)-double(cycle.sync_ts_us)
+                                       :double(frame.host_us-cycle.sync_host_us));
+            heard=true;
+        }
+        if(!heard)
+            silent.append(QString::number(cycle.nodes[i]));
+    }
+    sync_cycle_index=cycle.index;
+    sync_cycle_received=cycle.received;
+    sync_cycle_expected=cycle.expected;
+    sync_cycle_spread_us=spread_us;
+
+    const bool missing=cycle.received<cycle.expected;
+    if(missing&&!sync_cycle_missing)
+        ui->TB_fastsdo_msgbox->append(tr("SYNC cycle %1: %2 of %3 TPDOs%4.")
+                                      .arg(cycle.index).arg(cycle.received).arg(cycle.expected)
+                                      .arg(silent.isEmpty()?QString():tr(", silent node(s) %1").arg(silent.join(", "))));
+    else if(!missing&&sync_cycle_missing)
+        ui->TB_fastsdo_msgbox->append(tr("SYNC cycle %1: all TPDOs again.").arg(cycle.index));
+    sync_cycle_missing=missing;
+}
+
+void PCAN_QT::stop_sync_acquisition()
+{
+    if(!m_sync->is_running())
+        return;
+    m_sync->stop();
+    ui->TB_fastsdo_msgbox->append(tr("SYNC: stopped, %1, restoring the TPDO settings.").arg(m_sync->summary()));
+}
+
 void PCAN_QT::on_BTN_refresh_channel_clicked()
 {
-    scan_channels();
+    m_channels->rescan();
 }
 void PCAN_QT::on_BTN_init_clicked()
 {
@@ -486,15 +999,15 @@ void PCAN_QT::on_BTN_read_config_clicked()
     node_id=ui->SB_curr_node_id->value();
     ui->Line_fastsdo_txid->setText(QString::number(node_id + 0x600, 16));
 
-    flag_reading_cfg=true;
-    fastsdo_readcfg();
-    QTimer::singleShot(500, this,SLOT(reading_cfg()));
+    //validated against the cache first, a full read only when it is stale
+    if(!m_config->busy())
+        m_config->load(node_id);
 
 }
 void PCAN_QT::on_BTN_fastsdo_send_clicked()
 {
 
-    TPCANMsg msg;
+    TPCANMsgFD msg={};
 
     //convert string to upper size
     QString upper_str=ui->Line_fastsdo_data->text().toUpper();
@@ -507,7 +1020,7 @@ void PCAN_QT::on_BTN_fastsdo_send_clicked()
 
     //save data in the msg package
     msg.ID=id_Hex;
-    msg.LEN=uchar(ui->SB_fastsdo_dlc->text().toUInt());
+    msg.DLC=can_len_to_dlc(ui->SB_fastsdo_dlc->text().toInt());
     qstr_to_uchar(tmp_data,msg.DATA);
 
     pcan_send(msg);
@@ -528,6 +1041,7 @@ void PCAN_QT::on_BTN_change_baud_clicked()
     ui->SB_fastsdo_dlc->setValue(8);
     ui->Line_fastsdo_data->setText("23002100"+reverse_hex);
 
+    m_config->invalidate(node_id);
     on_BTN_fastsdo_send_clicked();
     pop_msgbox(tr("Re-Power the module to apply change."));
 }
@@ -548,6 +1062,7 @@ void PCAN_QT::on_BTN_change_node_id_clicked()
     ui->SB_fastsdo_dlc->setValue(8);
     ui->Line_fastsdo_data->setText("23012100"+reverse_hex);
 
+    m_config->invalidate(node_id);
     on_BTN_fastsdo_send_clicked();
     pop_msgbox(tr("Re-Power the module to apply change."));
 }
@@ -578,6 +1093,7 @@ void PCAN_QT::on_BTN_change_tpdo_hz_clicked()
     ui->SB_fastsdo_dlc->setValue(8);
     ui->Line_fastsdo_data->setText("2B"+channel_tpdo_hex+"1805"+reverse_hex);
 
+    m_config->invalidate(node_id);
     on_BTN_fastsdo_send_clicked();
     pop_msgbox(tr("Re-Power the module to apply change."));
 }
@@ -590,3 +1106,468 @@ void PCAN_QT::on_BTN_clr_TB_fastsdo_msgbox_clicked()
     ui->TB_fastsdo_msgbox->clear();
 }
 
+bool PCAN_QT::start_capture()
+{
+    QString path=QFileDialog::getSaveFileName(this,tr("Record capture"),QString(),tr("PCAN_QT capture (*.pqc)"));
+    if(path.isEmpty())
+        return false;
+    if(!m_capture->open(path)){
+        pop_msgbox(tr("Cannot open %1: %2").arg(path).arg(m_capture->error()));
+        return false;
+    }
+    //the pyramid of the decoded signals grows next to the capture
+    const QString sidecar=SignalPyramid::sidecar_path(path);
+    if(!m_pyramid.open(sidecar))
+        ui->TB_fastsdo_msgbox->append(tr("Pyramid %1: %2").arg(sidecar).arg(m_pyramid.error()));
+    m_pyramid_unpacker.set_packing(m_unpacker.packing());
+    m_pyramid_unpacker.reset();
+    ui->TB_fastsdo_msgbox->append(tr("Recording to %1").arg(path));
+    return true;
+}
+
+void PCAN_QT::stop_capture()
+{
+    if(!m_capture->is_open())
+        return;
+    m_capture->close();
+    m_pyramid.close();
+    const captureStats st=m_capture->stats();
+    ui->TB_fastsdo_msgbox->append(tr("Capture closed: %1 frames, %2 kB -> %3 kB (%4:1), %5 MB/s, %6 dropped")
+                                  .arg(st.frames)
+                                  .arg(st.raw_bytes/1024.0,0,'f',1)
+                                  .arg(st.stored_bytes/1024.0,0,'f',1)
+                                  .arg(st.ratio(),0,'f',1)
+                                  .arg(st.encode_mb_s(),0,'f',0)
+                                  .arg(st.dropped));
+}
+
+void PCAN_QT::index_capture()
+{
+    if(m_indexer->isRunning())
+        return;
+    QString path=QFileDialog::getOpenFileName(this,tr("Index capture"),QString(),tr("PCAN_QT capture (*.pqc)"));
+    if(path.isEmpty())
+        return;
+    //a sidecar newer than its capture is complete, it is only loaded
+    const QFileInfo capture(path);
+    const QFileInfo sidecar(SignalPyramid::sidecar_path(path));
+    if(!m_pyramid.is_open()&&sidecar.exists()&&sidecar.lastModified()>=capture.lastModified()
+            &&m_pyramid.load(sidecar.filePath())){
+        ui->TB_fastsdo_msgbox->append(tr("Pyramid %1: %2 samples of %3 signals")
+                                      .arg(sidecar.filePath()).arg(m_pyramid.samples()).arg(m_pyramid.series_count()));
+        for(const QString &line : m_pyramid.report())
+            ui->TB_fastsdo_msgbox->append(line);
+        return;
+    }
+    ui->TB_fastsdo_msgbox->append(tr("Indexing %1").arg(path));
+    m_indexer->index(path,m_unpacker.packing());
+}
+
+void PCAN_QT::detect_bitrate()
+{
+    if(m_detect->isRunning())
+        return;
+    if(channel_handle||!ui->CB_can_channels->count()){
+        pop_msgbox(tr("Bit rate detection needs a channel that is not initialized."));
+        return;
+    }
+    if(ui->CK_fd_mode->isChecked()){
+        pop_msgbox(tr("Bit rate detection is for classic CAN, the FD bit timing is not searched."));
+        return;
+    }
+    //the selected rate first, it is the likely one
+    QVector<TPCANBaudrate> candidates;
+    candidates.append(baudrate_of(ui->CB_bitrate->currentText()));
+    for(int i=0;i<ui->CB_bitrate->count();i++){
+        const TPCANBaudrate rate=baudrate_of(ui->CB_bitrate->itemText(i));
+        if(rate&&!candidates.contains(rate))
+            candidates.append(rate);
+    }
+    candidates.removeAll(0);
+    ui->BTN_init->setEnabled(false);
+    ui->TB_fastsdo_msgbox->append(tr("Detecting the bit rate of channel 0x%1 in listen-only mode")
+                                  .arg(ui->CB_can_channels->currentData().toUInt(),0,16));
+    m_detect->detect(m_can,TPCANHandle(ui->CB_can_channels->currentData().toUInt()),candidates);
+}
+
+void PCAN_QT::bitrate_detected(const detectResult &result)
+{
+    for(const QString &line : BitrateDetector::report(result))
+        ui->TB_fastsdo_msgbox->append(line);
+    for(int i=0;i<ui->CB_bitrate->count();i++){
+        if(baudrate_of(ui->CB_bitrate->itemText(i))==result.bitrate)
+            ui->CB_bitrate->setCurrentIndex(i);
+    }
+    //the current node stays when it is on the bus
+    const QList<int> nodes=result.nodes();
+    if(!nodes.isEmpty()&&!nodes.contains(ui->SB_curr_node_id->value()))
+        ui->SB_curr_node_id->setValue(nodes.first());
+    ui->BTN_init->setEnabled(true);
+    on_BTN_init_clicked();
+}
+
+void PCAN_QT::batch_analysis()
+{
+    if(m_batch->isRunning())
+        return;
+    QString dir=QFileDialog::getExistingDirectory(this,tr("Batch analysis"));
+    if(dir.isEmpty())
+        return;
+    const QStringList paths=batch_collect(dir);
+    if(paths.isEmpty()){
+        pop_msgbox(tr("No captures or traces in %1").arg(dir));
+        return;
+    }
+    ui->TB_fastsdo_msgbox->append(tr("Analyzing %1 files in %2").arg(paths.size()).arg(dir));
+    m_batch->analyze(paths,m_unpacker.packing());
+}
+
+void PCAN_QT::batch_analyzed(const batchStats &stats)
+{
+    ui->TB_fastsdo_msgbox->append(tr("Batch: %1 files (%2 failed), %3 frames, %4 MB in %5 ms, %6 MB/s on %7 threads")
+                                  .arg(stats.files)
+                                  .arg(stats.failed)
+                                  .arg(stats.frames)
+                                  .arg(stats.bytes/1048576.0,0,'f',1)
+                                  .arg(stats.elapsed_us/1000.0,0,'f',1)
+                                  .arg(stats.mb_per_s(),0,'f',0)
+                                  .arg(stats.threads));
+    for(const QString &line : m_batch->report())
+        ui->TB_fastsdo_msgbox->append(line);
+}
+
+void PCAN_QT::pyramid_indexed(QString sidecar_path, const pyramidIndexStats &stats)
+{
+    ui->TB_fastsdo_msgbox->append(tr("Indexed %1 frames, %2 samples of %3 signals in %4 ms -> %5 (%6 kB)")
+                                  .arg(stats.frames)
+                                  .arg(stats.samples)
+                                  .arg(stats.series)
+                                  .arg(stats.elapsed_us/1000.0,0,'f',1)
+                                  .arg(sidecar_path)
+                                  .arg(stats.file_bytes/1024.0,0,'f',1));
+    //the live pyramid of a running recording is kept
+    if(m_pyramid.is_open())
+        return;
+    if(!m_pyramid.load(sidecar_path)){
+        ui->TB_fastsdo_msgbox->append(tr("Pyramid %1: %2").arg(sidecar_path).arg(m_pyramid.error()));
+        return;
+    }
+    for(const QString &line : m_pyramid.report())
+        ui->TB_fastsdo_msgbox->append(line);
+}
+
+bool PCAN_QT::start_trigger_capture()
+{
+    bool ok=false;
+    QString text=QInputDialog::getMultiLineText(this,tr("Trigger capture"),
+                                                tr("Windows (pre/post/holdoff [s], memory [MB]) and rules, one per line:\n"
+                                                   "  |acc| > 3, acc.z < -1.5, gyr.x > 200, |gyr| > 500\n"
+                                                   "  id 0x708, id 0x180/0x780 b0=0x05/0x7F\n"
+                                                   "  bus_error"),
+                                                trigger_rules,&ok);
+    if(!ok)
+        return false;
+    triggerConfig config;
+    QString error;
+    if(!trigger_parse(text,config,error)){
+        pop_msgbox(tr("Trigger rules: %1").arg(error));
+        return false;
+    }
+    trigger_rules=text;
+    //the ring stays within its share of the budget
+    if(memory_budget)
+        config.max_frames=qMin(config.max_frames,int(memory_budget_split(memory_budget).trigger/qint64(sizeof(canFrame))));
+
+    QString dir=QFileDialog::getExistingDirectory(this,tr("Trigger dump directory"));
+    if(dir.isEmpty())
+        return false;
+    if(!m_trigger->arm(config,dir)){
+        pop_msgbox(m_trigger->error());
+        return false;
+    }
+    ui->TB_fastsdo_msgbox->append(tr("Trigger capture armed: %1 rules, %2 s before, %3 s after, ring of %4 frames, dumps to %5")
+                                  .arg(config.rules.size())
+                                  .arg(config.pre_ms/1000.0)
+                                  .arg(config.post_ms/1000.0)
+                                  .arg(config.max_frames)
+                                  .arg(dir));
+    return true;
+}
+
+void PCAN_QT::stop_trigger_capture()
+{
+    if(!m_trigger->is_armed())
+        return;
+    m_trigger->disarm();
+    const triggerStats st=m_trigger->stats();
+    ui->TB_fastsdo_msgbox->append(tr("Trigger capture stopped: %1 frames, %2 triggers (%3 suppressed), %4 dumps with %5 frames, %6 dropped, rules %7 ns/frame")
+                                  .arg(st.frames)
+                                  .arg(st.triggers)
+                                  .arg(st.suppressed)
+                                  .arg(st.dumps)
+                                  .arg(st.dump_frames)
+                                  .arg(st.dropped_dumps)
+                                  .arg(st.eval_ns_per_frame(),0,'f',0));
+}
+
+bool PCAN_QT::start_alarms()
+{
+    bool ok=false;
+    QString text=QInputDialog::getMultiLineText(this,tr("Alarm rules"),
+                                                tr("One rule per line, name: expr <|> expr [hyst h] [on ms] [off ms]\n"
+                                                   "  fields acc gyr eul .x .y .z, roll pitch yaw, quat .w-.z, |acc| |gyr|\n"
+                                                   "  rates hz.acc hz.gyr hz.eul hz.quat, configured cfg.acc ... cfg.quat\n"
+                                                   "  functions abs() sqrt() min() max()"),
+                                                alarm_rules,&ok);
+    if(!ok)
+        return false;
+    if(!m_alarms->set_rules(text)){
+        pop_msgbox(tr("Alarm rules: %1").arg(m_alarms->error()));
+        return false;
+    }
+    alarm_rules=text;
+
+    //cancel runs without a log
+    QString path=QFileDialog::getSaveFileName(this,tr("Alarm log"),"alarms.log",tr("Log (*.log *.txt)"));
+    m_alarms->set_log(path);
+    if(!m_alarms->start_engine()){
+        pop_msgbox(m_alarms->error());
+        return false;
+    }
+    QString server=tr("not listening");
+    if(m_alarm_server->listen("pcan_qt_alarms"))
+        server=tr("local socket pcan_qt_alarms");
+    else
+        ui->TB_fastsdo_msgbox->append(tr("Alarm socket: %1").arg(m_alarm_server->error()));
+    ui->TB_fastsdo_msgbox->append(tr("Alarms running: %1 rules, log %2, %3")
+                                  .arg(m_alarms->rule_count())
+                                  .arg(path.isEmpty()?tr("off"):path)
+                                  .arg(server));
+    return true;
+}
+
+void PCAN_QT::stop_alarms()
+{
+    if(!m_alarms->is_running())
+        return;
+    m_alarms->stop_engine();
+    m_alarm_server->close();
+    const alarmStats st=m_alarms->stats();
+    ui->TB_fastsdo_msgbox->append(tr("Alarms stopped: %1 samples, %2 rule evaluations, %3 raised, %4 cleared, %5 dropped")
+                                  .arg(st.samples)
+                                  .arg(st.evaluations)
+                                  .arg(st.raised)
+                                  .arg(st.cleared)
+                                  .arg(st.dropped));
+}
+
+bool PCAN_QT::start_bounded_memory()
+{
+    bool ok=false;
+    const int mb=QInputDialog::getInt(this,tr("Bounded memory"),tr("Memory budget [MB]:"),16,MEMORY_BUDGET_MIN_MB,4096,1,&ok);
+    if(!ok)
+        return false;
+    apply_memory_budget(qint64(mb)<<20);
+
+    const memoryBudget budget=memory_budget_split(memory_budget);
+    ui->TB_fastsdo_msgbox->append(tr("Bounded memory: %1 MB, capture %2 blocks, trigger ring %3 frames, alarm queue %4 samples, log %5 lines, display every 100 ms.")
+                                  .arg(mb)
+                                  .arg(budget.capture/qint64(CAPTURE_BLOCK_FRAMES*sizeof(canFrame)))
+                                  .arg(budget.trigger/qint64(sizeof(canFrame)))
+                                  .arg(budget.alarms/qint64(2*sizeof(imuSample)))
+                                  .arg(budget.log/MEMORY_LOG_LINE_BYTES));
+    if(m_capture->is_open()||m_trigger->is_armed()||m_alarms->is_running())
+        ui->TB_fastsdo_msgbox->append(tr("Bounded memory: capture, trigger and alarms take the budget when they are started again."));
+    return true;
+}
+
+void PCAN_QT::stop_bounded_memory()
+{
+    if(!memory_budget)
+        return;
+    apply_memory_budget(0);
+    render_display();
+    ui->TB_fastsdo_msgbox->append(tr("Bounded memory off."));
+}
+
+void PCAN_QT::apply_memory_budget(qint64 bytes)
+{
+    memory_budget=bytes;
+    const memoryBudget budget=memory_budget_split(bytes);
+    //pools are allocated by the next open(), arm() and start_engine()
+    m_capture->set_block_pool(int(budget.capture/qint64(CAPTURE_BLOCK_FRAMES*sizeof(canFrame))));
+    m_alarms->set_max_pending(int(budget.alarms/qint64(2*sizeof(imuSample))),bytes!=0);
+    ui->TB_fastsdo_msgbox->document()->setMaximumBlockCount(int(budget.log/MEMORY_LOG_LINE_BYTES));
+    if(bytes)
+        tmr_render->start();
+    else
+        tmr_render->stop();
+}
+
+QVector<memoryUsage> PCAN_QT::memory_usage()
+{
+    const memoryBudget budget=memory_budget_split(memory_budget);
+    QVector<memoryUsage> usage;
+    usage.append({tr("frame table"),qint64(m_frames.memory_bytes()),0});
+    usage.append({tr("IMU decode"),qint64(sizeof(m_unpacker)+sizeof(m_pyramid_unpacker)+sizeof(m_imu_data)),0});
+    usage.append({tr("DBC"),m_dbc.memory_bytes()+dbc_values.capacity()*qint64(sizeof(double))+dbc_seen.capacity()*qint64(sizeof(bool)),0});
+    usage.append({tr("message log"),ui->TB_fastsdo_msgbox->document()->characterCount()*qint64(sizeof(QChar)),budget.log});
+    usage.append({tr("capture blocks"),m_capture->memory_bytes(),budget.capture});
+    usage.append({tr("trigger ring"),m_trigger->memory_bytes(),budget.trigger});
+    usage.append({tr("alarm queue"),m_alarms->memory_bytes(),budget.alarms});
+    usage.append({tr("replay trace"),qint64(replay_frames.capacity()*sizeof(canFrame)),0});
+    usage.append({tr("signal pyramid"),m_pyramid.memory_bytes(),0});
+    return usage;
+}
+
+void PCAN_QT::memory_report()
+{
+    const QVector<memoryUsage> usage=memory_usage();
+    qint64 total=0;
+    ui->TB_fastsdo_msgbox->append(memory_budget?tr("Memory use, budget %1 MB:").arg(memory_budget>>20):tr("Memory use:"));
+    for(const memoryUsage &u : usage){
+        total+=u.used;
+        if(u.limit)
+            ui->TB_fastsdo_msgbox->append(tr("  %1 %2 kB of %3 kB").arg(u.name,-16).arg(u.used/1024.0,0,'f',1).arg(u.limit/1024.0,0,'f',0));
+        else
+            ui->TB_fastsdo_msgbox->append(tr("  %1 %2 kB").arg(u.name,-16).arg(u.used/1024.0,0,'f',1));
+    }
+    ui->TB_fastsdo_msgbox->append(tr("  %1 %2 kB").arg(tr("total"),-16).arg(total/1024.0,0,'f',1));
+}
+
+void PCAN_QT::send_nmt(uchar command)
+{
+    if(!m_nmt->send(command)){
+        pop_msgbox(tr("NMT: the channel is not initialized."));
+        return;
+    }
+    ui->TB_fastsdo_msgbox->append(tr("NMT: %1 sent to all nodes.")
+                                  .arg(command==NMT_START?tr("start"):command==NMT_STOP?tr("stop"):tr("pre-operational")));
+}
+
+void PCAN_QT::stop_idle_nodes()
+{
+    if(!m_tx->isRunning()){
+        pop_msgbox(tr("NMT: the channel is not initialized."));
+        return;
+    }
+    //stopped nodes drop their PDOs, the bus is left to the node in use
+    const int node=ui->SB_curr_node_id->value();
+    const int n=m_nmt->stop_idle({node});
+    ui->TB_fastsdo_msgbox->append(tr("NMT: stop sent to %1 nodes, node %2 kept running.").arg(n).arg(node));
+}
+
+void PCAN_QT::node_report()
+{
+    const QStringList lines=m_nmt->report();
+    if(lines.isEmpty()){
+        ui->TB_fastsdo_msgbox->append(tr("NMT: no heartbeat received."));
+        return;
+    }
+    ui->TB_fastsdo_msgbox->append(m_nmt->summary());
+    for(const QString &line : lines)
+        ui->TB_fastsdo_msgbox->append("  "+line);
+}
+
+bool PCAN_QT::start_load_test()
+{
+    bool ok=false;
+    QString text=QInputDialog::getMultiLineText(this,tr("Load test"),
+                                                tr("Traffic sent from a second channel at the bit rate of this one:\n"
+                                                   "  channel 0x52 (or virtual), load 10 90 10 [%], step 2 [s]\n"
+                                                   "  ch100 4, random 10 [%], burst 32 100 [ms], fd, latency 20 [ms]"),
+                                                load_config,&ok);
+    if(!ok)
+        return false;
+    loadConfig config;
+    QString error;
+    if(!load_parse(text,config,error)){
+        pop_msgbox(tr("Load test: %1").arg(error));
+        return false;
+    }
+    load_config=text;
+    //the generated nodes stay clear of the one in use and all heard so far
+    config.live_nodes.append(ui->SB_curr_node_id->value());
+    for(int id=1;id<128;id++){
+        if(m_nmt->node(id).heartbeats)
+            config.live_nodes.append(id);
+    }
+    if(!m_load->start_load(config,m_can)){
+        pop_msgbox(m_load->error());
+        return false;
+    }
+    ui->TB_fastsdo_msgbox->append(tr("Load test: %1 % to %2 % of the bus in %3 s steps, %4 CH100 nodes, %5 % random frames")
+                                  .arg(config.start_pct,0,'f',0)
+                                  .arg(config.stop_pct,0,'f',0)
+                                  .arg(config.step_ms/1000.0)
+                                  .arg(config.ch100_nodes)
+                                  .arg(config.random_pct));
+    return true;
+}
+
+void PCAN_QT::stop_load_test()
+{
+    if(!m_load->is_active())
+        return;
+    m_load->stop_load();
+    act_load->setChecked(false);
+    ui->TB_fastsdo_msgbox->append(tr("Load test stopped."));
+    for(const QString &line : m_load->report())
+        ui->TB_fastsdo_msgbox->append("  "+line);
+}
+
+bool PCAN_QT::start_sdo_profile()
+{
+    if(!channel_handle){
+        ui->TB_fastsdo_msgbox->append(tr("SDO profile: channel is not initialized."));
+        return false;
+    }
+    bool ok=false;
+    QString text=QInputDialog::getMultiLineText(this,tr("SDO latency profile"),
+                                                tr("Expedited reads sent round robin, timed from the echo of the request:\n"
+                                                   "  nodes 1-4 (current node without), object 0x1018 4 (one per line)\n"
+                                                   "  rate 50 [probes/s], timeout 100 [ms]"),
+                                                profile_config,&ok);
+    if(!ok)
+        return false;
+    sdoProfileConfig config;
+    QString error;
+    if(!sdo_profile_parse(text,config,error)){
+        pop_msgbox(tr("SDO profile: %1").arg(error));
+        return false;
+    }
+    profile_config=text;
+    if(config.nodes.isEmpty())
+        config.nodes.append(ui->SB_curr_node_id->value());
+    if(!m_profiler->start(config))
+        return false;
+    ui->TB_fastsdo_msgbox->append(tr("SDO profile: %1 probes/s over %2 node(s) and %3 object(s)%4")
+                                  .arg(config.rate_hz)
+                                  .arg(config.nodes.size())
+                                  .arg(config.objects.size())
+                                  .arg(m_profiler->stats().hw_timestamps?QString():tr(", no echo frames: timed from the send call")));
+    return true;
+}
+
+void PCAN_QT::stop_sdo_profile()
+{
+    if(!m_profiler->is_active())
+        return;
+    m_profiler->stop();
+    act_profile->setChecked(false);
+    ui->TB_fastsdo_msgbox->append(tr("SDO profile stopped, %1").arg(m_profiler->summary()));
+    for(const QString &line : m_profiler->report())
+        ui->TB_fastsdo_msgbox->append("  "+line);
+}
+
+void PCAN_QT::finish_load_test()
+{
+    if(!m_load->is_active())
+        return;
+    //overruns of the receive queue show up as lost frames
+    m_load->stop_load();
+    act_load->setChecked(false);
+    ui->TB_fastsdo_msgbox->append(tr("Load test finished:"));
+    for(const QString &line : m_load->report())
+        ui->TB_fastsdo_msgbox->append("  "+line);
+}
@@ -2,40 +2,70 @@
 #define PCAN_QT_H
 
 #include "include/PCANBasic.h"
+#include "alarm_rules.h"
+#include "batch_analysis.h"
+#include "bitrate_detect.h"
+#include "bounded_memory.h"
+#include "bus_health.h"
+#include "capture_writer.h"
+#include "can_transport.h"
+#include "channel_monitor.h"
+#include "clock_sync.h"
+#include "dbc_decoder.h"
+#include "nmt_monitor.h"
+#include "sdo_client.h"
+#include "sdo_profiler.h"
+#include "sdo_transfer.h"
+#include "signal_pyramid.h"
+#include "sync_acquisition.h"
+#include "tx_scheduler.h"
+#include "imu_packing.h"
+#include "load_generator.h"
+#include "node_config.h"
+#include "trace_import.h"
+#include "trigger_capture.h"
 #include <QMainWindow>
 #include <QDebug>
 #include <QTimer>
 #include <QMap>
+#include <QSet>
 #include <QMessageBox>
+#include <QAction>
 
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class PCAN_QT; }
 QT_END_NAMESPACE
 
-struct imuData{
-    float acc[3]={0};
-    float gyr[3]={0};
-    float eul[3]={0};
-    float quat[4]={0};
-    float prs=0;
-};
-
-
 class PCAN_QT : public QMainWindow
 {
     Q_OBJECT
 
 public:
-    PCAN_QT(QWidget *parent = nullptr);
+    //takes ownership of can, nullptr opens PCAN-Basic hardware channels
+    PCAN_QT(QWidget *parent = nullptr, CanTransport *can = nullptr);
     ~PCAN_QT();
 
+    //called once the window is on screen, start_us taken at process start
+    void report_startup(qint64 start_us);
+
 private slots:
     void pcan_read();
-    void pcan_send(TPCANMsg msg);
+    void pcan_send(TPCANMsgFD msg);
+    void pcan_sent(TPCANMsgFD msg, qint64 host_us, quint32 tag);
     void calc_hz();
-    void scan_channels();
-    void reading_cfg();
+    void channel_attached(const TPCANChannelInformation &info);
+    void channel_detached(ushort handle);
+    void channel_scan_finished(int count, qint64 elapsed_us);
+    void try_reconnect();
+    void node_config_loaded(int node, const nodeConfig &cfg, bool from_cache, qint64 elapsed_us);
+    void trace_imported(const traceImportStats &stats);
+    void pyramid_indexed(QString sidecar_path, const pyramidIndexStats &stats);
+    void batch_analyzed(const batchStats &stats);
+    void bitrate_detected(const detectResult &result);
+    void sync_cycle_complete(const syncCycle &cycle);
+    void replay_tick();
+    void render_display();
 
     void on_BTN_init_clicked();
     void on_BTN_refresh_channel_clicked();
@@ -52,39 +82,140 @@ private slots:
     void on_BTN_clr_TB_fastsdo_msgbox_clicked();
 
 private:
+    //drives the parsers and the read loop headless (bench/)
+    friend class PcanQtBench;
+
     Ui::PCAN_QT *ui;
-    QString uchar_to_qstr(uchar *str, const int len );
+    QString uchar_to_qstr(const uchar *str, const int len );
     void qstr_to_uchar(QString qstr, uchar *str);
     void can_init();
     void can_uninit();
 
 
-    void data_parser(TPCANMsg msg);
-    void imu_parser(TPCANMsg msg);
+    //everything after stamping, shared by the read loop and trace replay
+    void dispatch_frame(const canFrame &frame);
+    void data_parser(const canFrame &frame);
+    void imu_parser(const canFrame &frame);
+    void render_rx();
+    void render_imu();
     void pop_msgbox(QString text);
     void update_config_tpdo_hz();
-    void fastsdo_readcfg();
+    bool start_sync_acquisition();
+    void stop_sync_acquisition();
+    bool start_capture();
+    void stop_capture();
+    void index_capture();
+    void batch_analysis();
+    void detect_bitrate();
+    bool start_replay();
+    void begin_replay(std::vector<canFrame> frames);
+    void stop_replay();
+    bool start_trigger_capture();
+    void stop_trigger_capture();
+    bool start_alarms();
+    void stop_alarms();
+    bool load_dbc();
+    bool start_bounded_memory();
+    void stop_bounded_memory();
+    //0 lifts the budget
+    void apply_memory_budget(qint64 bytes);
+    QVector<memoryUsage> memory_usage();
+    void memory_report();
+    void send_nmt(uchar command);
+    void stop_idle_nodes();
+    void node_report();
+    bool start_load_test();
+    void stop_load_test();
+    void finish_load_test();
+    bool start_sdo_profile();
+    void stop_sdo_profile();
 
     //current channel informations
-    TPCANChannelInformation channels;
+    ChannelMonitor *m_channels;
     ushort channel_handle=0;
     ushort bitrate=0;
     ushort node_id=8;
+    bool fd_mode=false;
+    //adapter unplugged while running, capture state is kept until it returns
+    bool link_lost=false;
+    qint64 link_lost_us=0;
+    int reconnect_attempts=0;
+    qint64 connect_us=0;
+
+    //channel access (PCAN-Basic or virtual bus)
+    CanTransport *m_can;
+    ClockSync m_clock;
+    BusHealth *m_health;
+    TxScheduler *m_tx;
+    //TX tags of the frames queued by pcan_send() and not written yet: only
+    //these are logged, the frames of the SDO engine, SYNC or load tests are not
+    QSet<quint32> manual_tx_pending;
+    quint32 manual_tx_tag=0;
+    SyncAcquisition *m_sync;
+    //last closed SYNC cycle for the status line; incomplete cycles are
+    //logged when they start and when the cycles are complete again
+    quint32 sync_cycle_index=0;
+    int sync_cycle_received=0;
+    int sync_cycle_expected=0;
+    double sync_cycle_spread_us=0;  //SYNC to the last TPDO of the cycle
+    bool sync_cycle_missing=false;
+    NmtMonitor *m_nmt;
+    SdoClient *m_sdo;
+    SdoTransfer *m_xfer;
+    CaptureWriter *m_capture;
+    //min/max/mean pyramid of the recording, or of the last indexed capture
+    SignalPyramid m_pyramid;
+    PyramidIndexer *m_indexer;
+    BatchAnalyzer *m_batch;
+    //listen-only bit rate and node discovery, before the channel is opened
+    BitrateDetector *m_detect;
+    NodeConfigLoader *m_config;
+    TraceImporter *m_import;
+    TriggerCapture *m_trigger;
+    QString trigger_rules="pre 5\npost 2\n|acc| > 3\nbus_error\n";
+    AlarmEngine *m_alarms;
+    AlarmBroadcaster *m_alarm_server;
+    LoadGenerator *m_load;
+    QAction *act_load;
+    QString load_config="channel 0x52\nload 10 90 10\nstep 2\nch100 4\nrandom 10\n";
+    SdoProfiler *m_profiler;
+    QAction *act_profile;
+    QString profile_config="object 0x1000 0\nobject 0x1800 5\nrate 50\ntimeout 100\n";
+    QString alarm_rules="shock: |acc| > 4 hyst 0.5 off 500\ntilt: abs(roll) > 30 hyst 2 on 200\nrate: hz.acc < 0.9*cfg.acc on 2000\n";
+
+    //trace replay, frames are due at their offset from the replay start
+    QAction *act_replay;
+    std::vector<canFrame> replay_frames;
+    size_t replay_pos=0;
+    quint64 replay_first_us=0;
+    qint64 replay_start_us=0;
+
+    //signals of other ECUs, values indexed like the DBC signal table
+    DbcDecoder m_dbc;
+    QVector<double> dbc_values;
+    QVector<bool> dbc_seen;
 
     //IMU data storage
-    QMap<QString, QString> tdpo_data;
-    QMap<QString, int> tdpo_hz;
-    QMap<QString, int> tdpo_ctr;    
+    FrameTable m_frames;
     uint config_tpdo_hz[5];
 
+    //bounded memory mode: pools sized from the budget and the display
+    //rendered by tmr_render instead of on every frame; 0 when off
+    qint64 memory_budget=0;
+    bool rx_changed=false;
+    bool imu_changed=false;
+
     //QT timer
     QTimer *tmr_read;
+    QTimer *tmr_replay;
+    QTimer *tmr_render;
     QTimer *tmr_1000ms;
 
     //imu data
     imuData m_imu_data;
-
-    bool flag_reading_cfg=false,flag_readcfg_succ=false;
+    ImuUnpacker m_unpacker;
+    //every node, for the pyramid next to a recording
+    ImuUnpacker m_pyramid_unpacker;
 
 };
 #endif // PCAN_QT_H
@@ -0,0 +1,350 @@
+"""Python bindings of the PCAN_QT C API (capi/pcanqt.h), over ctypes.
+
+Decoded samples are views of the library's memory, not copies: with NumPy
+installed they are ndarrays, otherwise buffer-protocol memoryviews. A view
+keeps its Samples alive, so the memory is freed only when the last view
+is gone.
+
+    import pcanqt
+    s = pcanqt.decode_file("run.pqc", node_id=8)
+    acc = s.acc.values          # (n, 3) float32, [G]
+    t = s.acc.ts_us             # (n,) uint64
+
+The library is looked up in $PCANQT_LIB, next to this file, in ../capi
+and then on the system library path.
+"""
+
+import ctypes
+import os
+import sys
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+API_VERSION = 1
+
+SIG_ACC, SIG_GYR, SIG_EUL, SIG_QUAT = range(4)
+SIGNALS = ("acc", "gyr", "eul", "quat")
+AXES = (3, 3, 3, 4)
+
+PACK_NONE, PACK_FD, PACK_DELTA = range(3)
+
+# PCAN-Basic values for pq_channel_open()
+PCAN_USBBUS1 = 0x51
+PCAN_BAUD_125K = 0x031C
+PCAN_BAUD_250K = 0x011C
+PCAN_BAUD_500K = 0x001C
+PCAN_BAUD_1M = 0x0014
+PCAN_MESSAGE_STANDARD = 0x00
+PCAN_MESSAGE_EXTENDED = 0x02
+PCAN_MESSAGE_FD = 0x04
+PCAN_MESSAGE_BRS = 0x08
+
+
+class Error(RuntimeError):
+    pass
+
+
+class Frame(ctypes.Structure):
+    """pq_frame, one CAN or CAN FD frame."""
+    _fields_ = [
+        ("ts_us", ctypes.c_uint64),
+        ("host_us", ctypes.c_int64),
+        ("id", ctypes.c_uint32),
+        ("msgtype", ctypes.c_uint8),
+        ("dlc", ctypes.c_uint8),
+        ("len", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8),
+        ("data", ctypes.c_uint8 * 64),
+    ]
+
+    @property
+    def payload(self):
+        return bytes(self.data[:self.len])
+
+
+def _library_names():
+    if sys.platform == "win32":
+        return ["pcanqt.dll"]
+    if sys.platform == "darwin":
+        return ["libpcanqt.dylib"]
+    return ["libpcanqt.so", "libpcanqt.so.1"]
+
+
+def _load():
+    path = os.environ.get("PCANQT_LIB")
+    if path:
+        return ctypes.CDLL(path)
+    here = os.path.dirname(os.path.abspath(__file__))
+    for folder in (here, os.path.join(here, "..", "capi")):
+        for name in _library_names():
+            candidate = os.path.join(folder, name)
+            if os.path.exists(candidate):
+                return ctypes.CDLL(candidate)
+    for name in _library_names():
+        try:
+            return ctypes.CDLL(name)
+        except OSError:
+            pass
+    raise Error("pcanqt library not found, set PCANQT_LIB")
+
+
+def _declare(lib):
+    p = ctypes.c_void_p
+    size = ctypes.c_size_t
+    sig = [
+        ("pq_api_version", ctypes.c_int, []),
+        ("pq_last_error", ctypes.c_char_p, []),
+        ("pq_samples_count", size, [p, ctypes.c_int]),
+        ("pq_samples_ts_us", p, [p, ctypes.c_int]),
+        ("pq_samples_host_us", p, [p, ctypes.c_int]),
+        ("pq_samples_nodes", p, [p, ctypes.c_int]),
+        ("pq_samples_values", p, [p, ctypes.c_int]),
+        ("pq_samples_free", None, [p]),
+        ("pq_decoder_new", p, [ctypes.c_int]),
+        ("pq_decoder_free", None, [p]),
+        ("pq_decoder_set_packing", None, [p, ctypes.c_int]),
+        ("pq_decoder_set_sample_period_us", None, [p, ctypes.c_int, ctypes.c_uint32]),
+        ("pq_decoder_feed", size, [p, ctypes.POINTER(Frame), size]),
+        ("pq_decoder_take", p, [p]),
+        ("pq_decoder_decode_file", p, [p, ctypes.c_char_p]),
+        ("pq_capture_open", p, [ctypes.c_char_p]),
+        ("pq_capture_read", ctypes.c_int, [p, ctypes.POINTER(Frame), ctypes.c_int]),
+        ("pq_capture_close", None, [p]),
+        ("pq_channel_open", p, [ctypes.c_uint16, ctypes.c_uint16, ctypes.c_char_p]),
+        ("pq_channel_read", ctypes.c_int, [p, ctypes.POINTER(Frame), ctypes.c_int]),
+        ("pq_channel_write", ctypes.c_int, [p, ctypes.POINTER(Frame)]),
+        ("pq_channel_close", None, [p]),
+    ]
+    for name, restype, argtypes in sig:
+        fn = getattr(lib, name)
+        fn.restype = restype
+        fn.argtypes = argtypes
+    if lib.pq_api_version() != API_VERSION:
+        raise Error("pcanqt library API %d, bindings API %d" % (lib.pq_api_version(), API_VERSION))
+    return lib
+
+
+_lib = None
+
+
+def lib():
+    global _lib
+    if _lib is None:
+        _lib = _declare(_load())
+    return _lib
+
+
+def _error():
+    return Error(lib().pq_last_error().decode("utf-8", "replace"))
+
+
+def _path(path):
+    return os.fsencode(path) if sys.platform != "win32" else str(path).encode("utf-8")
+
+
+_DTYPES = {
+    ctypes.c_uint64: ("<u8", "Q"),
+    ctypes.c_int64: ("<i8", "q"),
+    ctypes.c_uint8: ("u1", "B"),
+    ctypes.c_float: ("<f4", "f"),
+}
+
+
+def _view(owner, address, ctype, shape):
+    """Array over native memory; the buffer object holds owner alive."""
+    count = 1
+    for n in shape:
+        count *= n
+    dtype, fmt = _DTYPES[ctype]
+    if count == 0 or not address:
+        if np is not None:
+            return np.empty(shape, dtype=dtype)
+        return memoryview(b"").cast(fmt)
+    buf = (ctype * count).from_address(address)
+    buf._owner = owner
+    if np is not None:
+        array = np.frombuffer(buf, dtype=dtype).reshape(shape)
+        array.flags.writeable = False
+        return array
+    return memoryview(buf).cast("B").cast(fmt, shape)
+
+
+class SignalView(object):
+    """Columns of one signal: ts_us, host_us, node and values."""
+
+    def __init__(self, samples, signal):
+        handle = samples._handle
+        l = lib()
+        n = l.pq_samples_count(handle, signal)
+        self.signal = signal
+        self.name = SIGNALS[signal]
+        self.count = n
+        self.ts_us = _view(samples, l.pq_samples_ts_us(handle, signal), ctypes.c_uint64, (n,))
+        self.host_us = _view(samples, l.pq_samples_host_us(handle, signal), ctypes.c_int64, (n,))
+        self.node = _view(samples, l.pq_samples_nodes(handle, signal), ctypes.c_uint8, (n,))
+        # rows of 4 floats in memory; NumPy gets the used axes as a strided
+        # view, a memoryview cannot slice columns and keeps all 4
+        values = _view(samples, l.pq_samples_values(handle, signal), ctypes.c_float, (n, 4))
+        if np is not None:
+            values = values[:, :AXES[signal]]
+        self.values = values
+
+    def __len__(self):
+        return self.count
+
+
+class Samples(object):
+    """Decoded samples owned by the library, see pq_samples."""
+
+    def __init__(self, handle):
+        if not handle:
+            raise _error()
+        self._handle = handle
+
+    def __del__(self):
+        if getattr(self, "_handle", None) and _lib is not None:
+            _lib.pq_samples_free(self._handle)
+            self._handle = None
+
+    def signal(self, signal):
+        if isinstance(signal, str):
+            signal = SIGNALS.index(signal)
+        return SignalView(self, signal)
+
+    acc = property(lambda self: self.signal(SIG_ACC))
+    gyr = property(lambda self: self.signal(SIG_GYR))
+    eul = property(lambda self: self.signal(SIG_EUL))
+    quat = property(lambda self: self.signal(SIG_QUAT))
+
+    def __len__(self):
+        return sum(lib().pq_samples_count(self._handle, s) for s in range(len(SIGNALS)))
+
+
+class Decoder(object):
+    """CH100 TPDO decoder, node_id 0 decodes every node."""
+
+    def __init__(self, node_id=0, packing=PACK_NONE, periods_us=None):
+        self._handle = lib().pq_decoder_new(node_id)
+        if not self._handle:
+            raise _error()
+        lib().pq_decoder_set_packing(self._handle, packing)
+        for signal, period in enumerate(periods_us or ()):
+            if period:
+                lib().pq_decoder_set_sample_period_us(self._handle, signal, period)
+
+    def close(self):
+        if getattr(self, "_handle", None):
+            lib().pq_decoder_free(self._handle)
+            self._handle = None
+
+    __del__ = close
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def feed(self, frames, count=None):
+        """Decodes a Frame array, returns the number of samples added."""
+        if count is None:
+            count = len(frames)
+        return lib().pq_decoder_feed(self._handle, frames, count)
+
+    def take(self):
+        """The samples decoded since the last take()."""
+        return Samples(lib().pq_decoder_take(self._handle))
+
+    def decode_file(self, path):
+        """Decodes a whole capture file in one call."""
+        return Samples(lib().pq_decoder_decode_file(self._handle, _path(path)))
+
+
+def decode_file(path, node_id=0, packing=PACK_NONE, periods_us=None):
+    """Samples of every CH100 TPDO in a .pqc, .trc, candump or .asc file."""
+    with Decoder(node_id, packing, periods_us) as decoder:
+        return decoder.decode_file(path)
+
+
+class _FrameSource(object):
+    _handle = None
+
+    def _read(self, fn, max_frames):
+        # a new block per call, the frames returned are a view of it
+        block = (Frame * max_frames)()
+        n = fn(self._handle, block, max_frames)
+        if n < 0:
+            raise _error()
+        return (Frame * n).from_buffer(block)
+
+
+class Capture(_FrameSource):
+    """Frames of a capture file, in blocks."""
+
+    def __init__(self, path):
+        self._handle = lib().pq_capture_open(_path(path))
+        if not self._handle:
+            raise _error()
+
+    def read(self, max_frames=8192):
+        return self._read(lib().pq_capture_read, max_frames)
+
+    def __iter__(self):
+        while True:
+            frames = self.read()
+            if not len(frames):
+                return
+            yield frames
+
+    def close(self):
+        if getattr(self, "_handle", None):
+            lib().pq_capture_close(self._handle)
+            self._handle = None
+
+    __del__ = close
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class Channel(_FrameSource):
+    """PCAN-Basic channel; FD when bitrate_fd is given."""
+
+    def __init__(self, channel=PCAN_USBBUS1, bitrate=PCAN_BAUD_500K, bitrate_fd=None):
+        self._handle = lib().pq_channel_open(channel, bitrate, bitrate_fd.encode("ascii") if bitrate_fd else None)
+        if not self._handle:
+            raise _error()
+
+    def read(self, max_frames=1024):
+        """Frames received since the last read, without waiting."""
+        return self._read(lib().pq_channel_read, max_frames)
+
+    def write(self, can_id, data, msgtype=PCAN_MESSAGE_STANDARD):
+        data = bytes(data)
+        frame = Frame()
+        frame.id = can_id
+        frame.msgtype = msgtype
+        lens = (0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64)
+        frame.dlc = next(d for d, n in enumerate(lens) if n >= len(data))
+        ctypes.memmove(frame.data, data, len(data))
+        if lib().pq_channel_write(self._handle, ctypes.byref(frame)) < 0:
+            raise _error()
+
+    def close(self):
+        if getattr(self, "_handle", None):
+            lib().pq_channel_close(self._handle)
+            self._handle = None
+
+    __del__ = close
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
@@ -0,0 +1,156 @@
+#include "sdo_client.h"
+#include "clock_sync.h"
+
+SdoClient::SdoClient(TxScheduler *tx, QObject *parent)
+    : QObject(parent)
+    , tx(tx)
+{
+    qRegisterMetaType<sdoResult>("sdoResult");
+    tmr_timeout=new QTimer(this);
+    tmr_timeout->setInterval(50);
+    connect(tmr_timeout, &QTimer::timeout, this, &SdoClient::check_timeouts);
+}
+
+quint32 SdoClient::submit(int node, const job &j)
+{
+    std::deque<job> &q=queues[node];
+    q.push_back(j);
+    q.back().id=next_id++;
+    if(q.size()==1)
+        kick(node);
+    if(!tmr_timeout->isActive())
+        tmr_timeout->start();
+    return q.back().id;
+}
+
+quint32 SdoClient::read(int node, ushort index, uchar sub)
+{
+    return submit(node,job{0,index,sub,false,QByteArray(),0});
+}
+
+quint32 SdoClient::write(int node, ushort index, uchar sub, const QByteArray &data)
+{
+    return submit(node,job{0,index,sub,true,data,0});
+}
+
+void SdoClient::read_bulk(int node, const QVector<QPair<ushort,uchar>> &objects)
+{
+    for(const auto &o : objects)
+        read(node,o.first,o.second);
+}
+
+int SdoClient::pending() const
+{
+    int n=0;
+    for(const auto &q : queues)
+        n+=int(q.size());
+    return n;
+}
+
+void SdoClient::cancel(int node)
+{
+    queues.remove(node);
+}
+
+void SdoClient::cancel_all()
+{
+    queues.clear();
+    tmr_timeout->stop();
+}
+
+void SdoClient::kick(int node)
+{
+    auto it=queues.find(node);
+    if(it==queues.end()||it->empty())
+        return;
+
+    job &j=it->front();
+    if(j.write&&(j.data.isEmpty()||j.data.size()>4)){
+        //expedited transfers carry 1..4 bytes, complete() moves on
+        complete(node,QByteArray(),SDO_ABORT_LENGTH);
+        return;
+    }
+
+    TPCANMsgFD msg;
+    if(j.write){
+        uint value=0;
+        for(int i=0;i<j.data.size();i++)
+            value|=uint(uchar(j.data[i]))<<(8*i);
+        msg=sdo_download_expedited(node,j.index,j.sub,value,j.data.size());
+    }else{
+        msg=sdo_upload_request(node,j.index,j.sub);
+    }
+    j.sent_us=host_monotonic_us();
+    tx->enqueue(msg,TX_PRIO_SDO);
+}
+
+void SdoClient::complete(int node, const QByteArray &data, quint32 abort_code)
+{
+    auto it=queues.find(node);
+    if(it==queues.end()||it->empty())
+        return;
+    job j=it->front();
+    it->pop_front();
+
+    sdoResult r;
+    r.id=j.id;
+    r.node=node;
+    r.index=j.index;
+    r.sub=j.sub;
+    r.write=j.write;
+    r.data=j.write?j.data:data;
+    r.abort_code=abort_code;
+    r.rtt_us=j.sent_us?host_monotonic_us()-j.sent_us:0;
+
+    kick(node);
+    emit finished(r);
+}
+
+bool SdoClient::process_frame(const canFrame &frame)
+{
+    const TPCANMsgFD &msg=frame.msg;
+    if(msg.ID<CO_SDO_TX+1||msg.ID>CO_SDO_TX+127||msg.DLC<8)
+        return false;
+    const int node=int(msg.ID-CO_SDO_TX);
+    auto it=queues.find(node);
+    if(it==queues.end()||it->empty()||!it->front().sent_us)
+        return false;
+
+    const job &j=it->front();
+    if(sdo_index(msg)!=j.index||msg.DATA[3]!=j.sub)
+        return false;
+
+    const uchar cmd=msg.DATA[0];
+    if(cmd==SDO_ABORT){
+        complete(node,QByteArray(),sdo_value(msg));
+    }
+    else if(j.write){
+        complete(node,QByteArray(),cmd==SDO_DOWNLOAD_RESP?0:SDO_ABORT_COMMAND);
+    }
+    else if((cmd&0xE2)==0x42){
+        //expedited upload, n = 4 - bytes used when the size bit is set
+        int len=(cmd&0x01)?4-((cmd>>2)&0x03):4;
+        complete(node,QByteArray(reinterpret_cast<const char*>(msg.DATA+4),len),0);
+    }
+    else{
+        //segmented upload initiate: not an expedited object, release the
+        //server and leave the object to SdoTransfer
+        tx->enqueue(sdo_abort_request(node,j.index,j.sub,SDO_ABORT_LENGTH),TX_PRIO_SDO);
+        complete(node,QByteArray(),SDO_ABORT_LENGTH);
+    }
+    return true;
+}
+
+void SdoClient::check_timeouts()
+{
+    const qint64 now=host_monotonic_us();
+    QList<int> expired;
+    for(auto it=queues.begin();it!=queues.end();++it){
+        if(!it->empty()&&it->front().sent_us&&now-it->front().sent_us>timeout_us)
+            expired.append(it.key());
+    }
+    for(int node : qAsConst(expired))
+        complete(node,QByteArray(),SDO_ABORT_TIMEOUT);
+    if(!pending())
+        tmr_timeout->stop();
+}
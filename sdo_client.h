@@ -0,0 +1,75 @@
+#ifndef SDO_CLIENT_H
+#define SDO_CLIENT_H
+
+#include "canopen.h"
+#include "tx_scheduler.h"
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QVector>
+#include <QPair>
+#include <deque>
+
+struct sdoResult{
+    quint32 id=0;
+    int node=0;
+    ushort index=0;
+    uchar sub=0;
+    bool write=false;
+    QByteArray data;
+    quint32 abort_code=0;   //0 on success
+    qint64 rtt_us=0;
+};
+Q_DECLARE_METATYPE(sdoResult)
+
+//expedited SDO client for any number of nodes. A server handles one
+//transfer at a time, so each node has its own queue and the next request
+//goes out as soon as the previous response arrives: no fixed waits, and
+//requests to different nodes overlap.
+class SdoClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SdoClient(TxScheduler *tx, QObject *parent = nullptr);
+
+    quint32 read(int node, ushort index, uchar sub);
+    quint32 write(int node, ushort index, uchar sub, const QByteArray &data);
+    void read_bulk(int node, const QVector<QPair<ushort,uchar>> &objects);
+
+    //from the read loop: returns true when the frame answered a request
+    bool process_frame(const canFrame &frame);
+
+    void cancel(int node);
+    void cancel_all();
+    int pending() const;
+    void set_timeout_ms(int ms) {timeout_us=qint64(ms)*1000;}
+
+signals:
+    void finished(const sdoResult &result);
+
+private slots:
+    void check_timeouts();
+
+private:
+    struct job{
+        quint32 id;
+        ushort index;
+        uchar sub;
+        bool write;
+        QByteArray data;
+        qint64 sent_us;
+    };
+
+    quint32 submit(int node, const job &j);
+    void kick(int node);
+    void complete(int node, const QByteArray &data, quint32 abort_code);
+
+    TxScheduler *tx;
+    QHash<int, std::deque<job>> queues;
+    QTimer *tmr_timeout;
+    quint32 next_id=1;
+    qint64 timeout_us=500000;
+};
+
+#endif // SDO_CLIENT_H
@@ -0,0 +1,336 @@
+#include "sdo_profiler.h"
+#include "clock_sync.h"
+
+//"1-32" or "5", appended to ids
+static bool parse_nodes(const QString &token, QList<int> &ids)
+{
+    bool ok=true;
+    const QStringList range=token.split('-');
+    const int from=range.at(0).toInt(&ok);
+    int to=from;
+    if(ok&&range.size()==2)
+        to=range.at(1).toInt(&ok);
+    ok&=range.size()<=2&&from>=1&&to<=127&&from<=to;
+    for(int id=from;ok&&id<=to;id++){
+        if(!ids.contains(id))
+            ids.append(id);
+    }
+    return ok;
+}
+
+bool sdo_profile_parse(const QString &text, sdoProfileConfig &config, QString &error)
+{
+    config=sdoProfileConfig();
+    const QStringList lines=text.split('\n');
+    for(int n=0;n<lines.size();n++){
+        QString line=lines.at(n);
+        const int comment=line.indexOf('#');
+        if(comment>=0)
+            line.truncate(comment);
+        line=line.simplified();
+        if(line.isEmpty())
+            continue;
+
+        const QStringList t=line.split(' ');
+        const QString key=t.at(0).toLower();
+        bool ok=true;
+
+        if(key=="nodes"){
+            //nodes 1-4 8
+            ok=t.size()>=2;
+            for(int i=1;ok&&i<t.size();i++)
+                ok=parse_nodes(t.at(i),config.nodes);
+        }
+        else if(key=="object"){
+            //object <index> <sub>
+            ok=t.size()==3&&config.objects.size()<SDO_PROF_MAX_OBJECTS;
+            const uint index=ok?t.at(1).toUInt(&ok,0):0;
+            const uint sub=ok?t.at(2).toUInt(&ok,0):0;
+            ok&=index>0&&index<=0xFFFF&&sub<=0xFF;
+            if(ok)
+                config.objects.append(qMakePair(ushort(index),uchar(sub)));
+        }
+        else if(key=="rate"){
+            config.rate_hz=t.size()==2?t.at(1).toDouble(&ok):0;
+            ok&=config.rate_hz>0&&config.rate_hz<=10000;
+        }
+        else if(key=="timeout"){
+            config.timeout_ms=t.size()==2?t.at(1).toInt(&ok):0;
+            ok&=config.timeout_ms>0;
+        }
+        else{
+            ok=false;
+        }
+
+        if(!ok){
+            error=QObject::tr("line %1: %2").arg(n+1).arg(lines.at(n).trimmed());
+            return false;
+        }
+    }
+    if(config.objects.isEmpty())
+        config.objects.append(qMakePair(ushort(0x1000),uchar(0)));
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// latencyHistogram
+//----------------------------------------------------------------------------
+void latencyHistogram::add(double us)
+{
+    if(buckets.empty())
+        buckets.assign(SDO_PROF_BUCKETS+1,0);
+    min_us=n?qMin(min_us,us):us;
+    max_us=n?qMax(max_us,us):us;
+    n++;
+    sum_us+=us;
+    buckets[size_t(qBound(0,int(us/SDO_PROF_BUCKET_US),SDO_PROF_BUCKETS))]++;
+}
+
+double latencyHistogram::percentile(double pct) const
+{
+    if(!n)
+        return 0;
+    //upper edge of the bucket that holds the rank, the max when sooner
+    const quint64 rank=qMax<quint64>(1,quint64(double(n)*pct/100+0.999));
+    quint64 seen=0;
+    for(int b=0;b<=SDO_PROF_BUCKETS;b++){
+        seen+=buckets[size_t(b)];
+        if(seen>=rank)
+            return b<SDO_PROF_BUCKETS?qMin(double(b+1)*SDO_PROF_BUCKET_US,max_us):max_us;
+    }
+    return max_us;
+}
+
+static QString histogram_line(const latencyHistogram &h)
+{
+    return QObject::tr("%1 round trips, min %2 / p50 %3 / p90 %4 / p99 %5 / max %6 us")
+            .arg(h.n)
+            .arg(h.min_us,0,'f',0)
+            .arg(h.percentile(50),0,'f',0)
+            .arg(h.percentile(90),0,'f',0)
+            .arg(h.percentile(99),0,'f',0)
+            .arg(h.max_us,0,'f',0);
+}
+
+//----------------------------------------------------------------------------
+// SdoProfiler
+//----------------------------------------------------------------------------
+SdoProfiler::SdoProfiler(CanTransport *can, TxScheduler *tx, QObject *parent)
+    : QObject(parent)
+    , can(can)
+    , tx(tx)
+{
+    tmr_probe=new QTimer(this);
+    tmr_probe->setTimerType(Qt::PreciseTimer);
+    tmr_probe->setInterval(1);
+    connect(tmr_probe, &QTimer::timeout, this, [this](){
+        tick(host_monotonic_us());
+    });
+}
+
+bool SdoProfiler::start(const sdoProfileConfig &cfg)
+{
+    if(running||cfg.nodes.isEmpty()||cfg.objects.isEmpty()||cfg.rate_hz<=0)
+        return false;
+    config=cfg;
+    rates=can->is_fd()?can_bitrates_fd(can->bitrate_fd()):can_bitrates(can->bitrate());
+
+    //echo frames carry the hardware time our request actually left
+    echo=can->acquire_echo();
+
+    m_stats=sdoProfileStats();
+    m_stats.hw_timestamps=echo;
+    by_node.assign(128,latencyHistogram());
+    by_object.assign(size_t(config.objects.size()),latencyHistogram());
+    by_load.assign(SDO_PROF_LOAD_LEVELS,latencyHistogram());
+    for(probe &p : probes)
+        p=probe();
+    window_start_us=0;
+    window_busy_us=0;
+    cursor=0;
+    period_us=qMax<qint64>(1,qint64(1e6/config.rate_hz));
+    next_probe_us=host_monotonic_us();
+    running=true;
+    tmr_probe->start();
+    return true;
+}
+
+void SdoProfiler::stop()
+{
+    if(!running)
+        return;
+    tmr_probe->stop();
+    if(echo)
+        can->release_echo();
+    running=false;
+}
+
+void SdoProfiler::tick(qint64 now_us)
+{
+    if(!running)
+        return;
+
+    const qint64 timeout_us=qint64(config.timeout_ms)*1000;
+    for(int node : qAsConst(config.nodes)){
+        probe &p=probes[node];
+        if(p.pending&&now_us-p.host_sent_us>timeout_us){
+            p.pending=false;
+            m_stats.timeouts++;
+        }
+    }
+
+    if(now_us-next_probe_us>SDO_PROF_MAX_LAG*period_us)
+        next_probe_us=now_us;
+    const int pairs=config.nodes.size()*config.objects.size();
+    while(next_probe_us<=now_us){
+        next_probe_us+=period_us;
+        //all objects of a node, then the next node
+        const int node=config.nodes.at(cursor/config.objects.size());
+        const int object=cursor%config.objects.size();
+        cursor=(cursor+1)%pairs;
+        probe &p=probes[node];
+        if(p.pending){
+            m_stats.skipped++;
+            continue;
+        }
+        const QPair<ushort,uchar> &o=config.objects.at(object);
+        if(!tx->enqueue(sdo_upload_request(node,o.first,o.second),TX_PRIO_SDO)){
+            m_stats.skipped++;
+            continue;
+        }
+        p.pending=true;
+        p.object=object;
+        p.host_sent_us=now_us;
+        p.tx_ts_us=0;
+        m_stats.sent++;
+    }
+}
+
+void SdoProfiler::on_sent(const TPCANMsgFD &msg, qint64 host_us)
+{
+    //the write call, closer to the wire than the enqueue
+    if(!running||msg.ID<CO_SDO_RX+1||msg.ID>CO_SDO_RX+127)
+        return;
+    const int node=int(msg.ID-CO_SDO_RX);
+    if(probes[node].pending&&!probes[node].tx_ts_us&&matches(msg,node))
+        probes[node].host_sent_us=host_us;
+}
+
+bool SdoProfiler::matches(const TPCANMsgFD &msg, int node) const
+{
+    const QPair<ushort,uchar> &o=config.objects.at(probes[node].object);
+    return msg.DLC>=8&&sdo_index(msg)==o.first&&msg.DATA[3]==o.second;
+}
+
+void SdoProfiler::account_load(const canFrame &frame)
+{
+    if(!window_start_us||frame.ts_us<window_start_us){
+        window_start_us=frame.ts_us;
+        window_busy_us=0;
+    }
+    else if(frame.ts_us-window_start_us>=SDO_PROF_LOAD_WINDOW_US){
+        m_stats.load_pct=window_busy_us*100/double(frame.ts_us-window_start_us);
+        window_start_us=frame.ts_us;
+        window_busy_us=0;
+    }
+    window_busy_us+=can_frame_time_us(frame.msg,rates);
+}
+
+void SdoProfiler::process_frame(const canFrame &frame)
+{
+    if(!running)
+        return;
+    const TPCANMsgFD &msg=frame.msg;
+    if(msg.MSGTYPE&(PCAN_MESSAGE_STATUS|PCAN_MESSAGE_ERRFRAME))
+        return;
+    //our own frames are on the bus once, as echoes
+    account_load(frame);
+
+    if(msg.MSGTYPE&PCAN_MESSAGE_ECHO){
+        if(msg.ID<CO_SDO_RX+1||msg.ID>CO_SDO_RX+127)
+            return;
+        probe &p=probes[msg.ID-CO_SDO_RX];
+        if(p.pending&&!p.tx_ts_us&&matches(msg,int(msg.ID-CO_SDO_RX)))
+            p.tx_ts_us=frame.ts_us;
+        return;
+    }
+    if(msg.ID<CO_SDO_TX+1||msg.ID>CO_SDO_TX+127||(msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_RTR)))
+        return;
+    const int node=int(msg.ID-CO_SDO_TX);
+    probe &p=probes[node];
+    if(!p.pending||!matches(msg,node))
+        return;
+    p.pending=false;
+
+    double rtt_us;
+    if(p.tx_ts_us&&frame.ts_us>=p.tx_ts_us){
+        rtt_us=double(frame.ts_us-p.tx_ts_us);
+        m_stats.hw_timed++;
+    }
+    else{
+        rtt_us=double(qMax<qint64>(0,frame.host_us-p.host_sent_us));
+        m_stats.host_timed++;
+    }
+    m_stats.answered++;
+    if(msg.DATA[0]==SDO_ABORT)
+        m_stats.aborted++;
+    by_node[size_t(node)].add(rtt_us);
+    by_object[size_t(p.object)].add(rtt_us);
+    by_load[size_t(qBound(0,int(m_stats.load_pct/10),SDO_PROF_LOAD_LEVELS-1))].add(rtt_us);
+}
+
+latencyHistogram SdoProfiler::total() const
+{
+    //every round trip is in exactly one load level
+    latencyHistogram sum;
+    for(const latencyHistogram &h : by_load){
+        if(!h.n)
+            continue;
+        if(sum.buckets.empty())
+            sum.buckets.assign(SDO_PROF_BUCKETS+1,0);
+        sum.min_us=sum.n?qMin(sum.min_us,h.min_us):h.min_us;
+        sum.max_us=sum.n?qMax(sum.max_us,h.max_us):h.max_us;
+        sum.n+=h.n;
+        sum.sum_us+=h.sum_us;
+        for(size_t b=0;b<h.buckets.size();b++)
+            sum.buckets[b]+=h.buckets[b];
+    }
+    return sum;
+}
+
+QStringList SdoProfiler::report() const
+{
+    QStringList lines;
+    lines.append(tr("all: %1").arg(histogram_line(total())));
+    for(int node : config.nodes){
+        const latencyHistogram &h=by_node[size_t(node)];
+        if(h.n)
+            lines.append(tr("node %1: %2").arg(node).arg(histogram_line(h)));
+    }
+    for(int i=0;i<config.objects.size();i++){
+        if(by_object[size_t(i)].n)
+            lines.append(tr("0x%1 sub %2: %3")
+                         .arg(config.objects.at(i).first,4,16,QLatin1Char('0'))
+                         .arg(config.objects.at(i).second)
+                         .arg(histogram_line(by_object[size_t(i)])));
+    }
+    for(int level=0;level<SDO_PROF_LOAD_LEVELS;level++){
+        if(by_load[size_t(level)].n)
+            lines.append(tr("load %1-%2 %: %3").arg(level*10).arg(level*10+10)
+                         .arg(histogram_line(by_load[size_t(level)])));
+    }
+    return lines;
+}
+
+QString SdoProfiler::summary() const
+{
+    const latencyHistogram all=total();
+    return tr("SDO %1 sent, %2 answered (%3 hardware timed), %4 timeouts, %5 skipped, p99 %6 us at %7 % load")
+            .arg(m_stats.sent)
+            .arg(m_stats.answered)
+            .arg(m_stats.hw_timed)
+            .arg(m_stats.timeouts)
+            .arg(m_stats.skipped)
+            .arg(all.percentile(99),0,'f',0)
+            .arg(m_stats.load_pct,0,'f',0);
+}
@@ -0,0 +1,126 @@
+#ifndef SDO_PROFILER_H
+#define SDO_PROFILER_H
+
+#include "canopen.h"
+#include "load_generator.h"
+#include "tx_scheduler.h"
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <QPair>
+#include <vector>
+
+#define SDO_PROF_MAX_OBJECTS        16
+//latency histograms: buckets of this width, the last one open
+#define SDO_PROF_BUCKET_US          50
+#define SDO_PROF_BUCKETS            400
+//bus load levels of 10 %, measured over windows of this length
+#define SDO_PROF_LOAD_LEVELS        10
+#define SDO_PROF_LOAD_WINDOW_US     100000
+//probes that fell behind by more than this many periods start again from now
+#define SDO_PROF_MAX_LAG            10
+
+struct sdoProfileConfig{
+    QList<int> nodes;           //empty: the caller's current node
+    QVector<QPair<ushort,uchar>> objects;   //0x1000 sub 0 when empty
+    double rate_hz=50;          //probes per second over all nodes and objects
+    int timeout_ms=100;
+};
+bool sdo_profile_parse(const QString &text, sdoProfileConfig &config, QString &error);
+
+//round trip times of one group of probes
+struct latencyHistogram{
+    quint64 n=0;
+    double sum_us=0;
+    double min_us=0;
+    double max_us=0;
+    std::vector<quint32> buckets;   //allocated with the first sample
+
+    void add(double us);
+    double mean_us() const {return n?sum_us/n:0;}
+    double percentile(double pct) const;
+};
+
+struct sdoProfileStats{
+    quint64 sent=0;
+    quint64 answered=0;
+    quint64 aborted=0;          //answered with an abort, timed as well
+    quint64 timeouts=0;
+    quint64 skipped=0;          //due while the node still worked on the last one
+    quint64 hw_timed=0;         //echo to response, both hardware timestamps
+    quint64 host_timed=0;       //send call to response, no echo came back
+    double load_pct=0;          //last load window
+    bool hw_timestamps=false;   //echo frames switched on
+};
+
+//SDO round trip profiler: expedited uploads of the configured objects go
+//out at a fixed rate, round robin over the nodes, one outstanding per node.
+//Echo frames give the hardware time a request actually left, the response
+//its hardware receive time, so queueing in the driver and the read loop is
+//not in the figures; without an echo the host send time is used. Each round
+//trip goes into the histogram of its node, its object and the bus load
+//level, the load being the bus time of all frames seen per window
+class SdoProfiler : public QObject
+{
+    Q_OBJECT
+
+public:
+    SdoProfiler(CanTransport *can, TxScheduler *tx, QObject *parent = nullptr);
+
+    //switches echo frames on; the bus load uses the rate of the channel
+    bool start(const sdoProfileConfig &config);
+    void stop();
+    bool is_active() const {return running;}
+
+    //sends the probes due at now_us and times out the lost ones, from the
+    //own timer or a caller with its own loop
+    void tick(qint64 now_us);
+    //from the read loop, echo frames of our own requests included
+    void process_frame(const canFrame &frame);
+
+    sdoProfileStats stats() const {return m_stats;}
+    latencyHistogram total() const;
+    const latencyHistogram &node_histogram(int node) const {return by_node[size_t(node&0x7F)];}
+    const latencyHistogram &object_histogram(int object) const {return by_object[size_t(object)];}
+    const latencyHistogram &load_histogram(int level) const {return by_load[size_t(level)];}
+    QStringList report() const;
+    QString summary() const;
+
+public slots:
+    void on_sent(const TPCANMsgFD &msg, qint64 host_us);
+
+private:
+    struct probe{
+        bool pending=false;
+        int object=0;
+        qint64 host_sent_us=0;
+        TPCANTimestampFD tx_ts_us=0;    //0 until the echo came back
+    };
+
+    bool matches(const TPCANMsgFD &msg, int node) const;
+    void account_load(const canFrame &frame);
+
+    CanTransport *can;
+    TxScheduler *tx;
+    QTimer *tmr_probe;
+    sdoProfileConfig config;
+    canBitrates rates;
+    bool running=false;
+    bool echo=false;
+    qint64 period_us=0;
+    qint64 next_probe_us=0;
+    int cursor=0;
+    probe probes[128];
+
+    //bus time of the frames in the current window
+    TPCANTimestampFD window_start_us=0;
+    double window_busy_us=0;
+
+    sdoProfileStats m_stats;
+    std::vector<latencyHistogram> by_node;
+    std::vector<latencyHistogram> by_object;
+    std::vector<latencyHistogram> by_load;
+};
+
+#endif // SDO_PROFILER_H
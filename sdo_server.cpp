@@ -0,0 +1,294 @@
+#include "sdo_server.h"
+#include <cstring>
+
+SdoServer::SdoServer(int node_id)
+    : node_id(node_id)
+{
+}
+
+void SdoServer::set_object(ushort idx, uchar sb, const QByteArray &data)
+{
+    objects.insert(key(idx,sb),data);
+}
+
+QByteArray SdoServer::object(ushort idx, uchar sb) const
+{
+    return objects.value(key(idx,sb));
+}
+
+bool SdoServer::has_object(ushort idx, uchar sb) const
+{
+    return objects.contains(key(idx,sb));
+}
+
+TPCANMsgFD SdoServer::response(uchar cmd) const
+{
+    TPCANMsgFD msg={};
+    msg.ID=CO_SDO_TX+node_id;
+    msg.DLC=8;
+    msg.DATA[0]=cmd;
+    msg.DATA[1]=uchar(index&0xFF);
+    msg.DATA[2]=uchar(index>>8);
+    msg.DATA[3]=sub;
+    return msg;
+}
+
+bool SdoServer::abort(quint32 code, std::vector<TPCANMsgFD> &out)
+{
+    TPCANMsgFD msg=response(SDO_ABORT);
+    for(int i=0;i<4;i++)
+        msg.DATA[4+i]=uchar(code>>(8*i));
+    out.push_back(msg);
+    st=ST_IDLE;
+    buf.clear();
+    return true;
+}
+
+bool SdoServer::lose_segment(bool last_of_sub_block)
+{
+    //a lost last segment is only detected by the peer's timeout
+    return loss_every>0&&++n_segments%quint64(loss_every)==0&&!last_of_sub_block;
+}
+
+bool SdoServer::process(const TPCANMsgFD &req, std::vector<TPCANMsgFD> &out)
+{
+    if(req.ID!=DWORD(CO_SDO_RX+node_id)||req.DLC<8||(req.MSGTYPE&PCAN_MESSAGE_ECHO))
+        return false;
+
+    const uchar cmd=req.DATA[0];
+    //segment number 0 is never used, so 0x80 is an abort in every state
+    if(cmd==SDO_ABORT){
+        st=ST_IDLE;
+        buf.clear();
+        return true;
+    }
+    //while a block download runs every other frame is a segment
+    if(st==ST_BLK_DL){
+        block_download_segment(req,out);
+        return true;
+    }
+
+    switch(cmd>>5){
+    case 1:{    //download initiate
+        index=sdo_index(req);
+        sub=req.DATA[3];
+        if(cmd&0x02){
+            const int len=(cmd&0x01)?4-((cmd>>2)&0x03):4;
+            set_object(index,sub,QByteArray(reinterpret_cast<const char*>(req.DATA+4),len));
+            n_completed++;
+            st=ST_IDLE;
+        }else{
+            buf.clear();
+            if(cmd&0x01)
+                buf.reserve(int(sdo_value(req)));
+            toggle=false;
+            st=ST_SEG_DL;
+        }
+        out.push_back(response(SDO_DOWNLOAD_RESP));
+        break;
+    }
+    case 0:{    //download segment
+        if(st!=ST_SEG_DL)
+            return abort(SDO_ABORT_COMMAND,out);
+        if(bool(cmd&0x10)!=toggle)
+            return abort(SDO_ABORT_TOGGLE,out);
+        buf.append(reinterpret_cast<const char*>(req.DATA+1),7-((cmd>>1)&0x07));
+        TPCANMsgFD msg=response(uchar(0x20|(cmd&0x10)));
+        std::memset(msg.DATA+1,0,7);
+        out.push_back(msg);
+        toggle=!toggle;
+        if(cmd&0x01){
+            set_object(index,sub,buf);
+            n_completed++;
+            st=ST_IDLE;
+        }
+        break;
+    }
+    case 2:{    //upload initiate
+        index=sdo_index(req);
+        sub=req.DATA[3];
+        if(!has_object(index,sub))
+            return abort(SDO_ABORT_NO_OBJECT,out);
+        buf=object(index,sub);
+        if(buf.size()<=4&&!buf.isEmpty()){
+            TPCANMsgFD msg=response(uchar(0x43|(4-buf.size())<<2));
+            std::memcpy(msg.DATA+4,buf.constData(),size_t(buf.size()));
+            out.push_back(msg);
+            n_completed++;
+            st=ST_IDLE;
+            break;
+        }
+        TPCANMsgFD msg=response(0x41);
+        for(int i=0;i<4;i++)
+            msg.DATA[4+i]=uchar(uint(buf.size())>>(8*i));
+        out.push_back(msg);
+        pos=0;
+        toggle=false;
+        st=ST_SEG_UL;
+        break;
+    }
+    case 3:{    //upload segment
+        if(st!=ST_SEG_UL)
+            return abort(SDO_ABORT_COMMAND,out);
+        if(bool(cmd&0x10)!=toggle)
+            return abort(SDO_ABORT_TOGGLE,out);
+        const int n=qMin(7,buf.size()-pos);
+        const bool last=pos+n>=buf.size();
+        TPCANMsgFD msg=response(uchar((cmd&0x10)|(7-n)<<1|(last?0x01:0)));
+        std::memset(msg.DATA+1,0,7);
+        std::memcpy(msg.DATA+1,buf.constData()+pos,size_t(n));
+        out.push_back(msg);
+        pos+=n;
+        toggle=!toggle;
+        if(last){
+            n_completed++;
+            st=ST_IDLE;
+        }
+        break;
+    }
+    case 6:     //block download
+        if(!block_support)
+            return abort(SDO_ABORT_COMMAND,out);
+        if((cmd&0x01)==0){
+            index=sdo_index(req);
+            sub=req.DATA[3];
+            use_crc=crc_enabled&&(cmd&0x04);
+            buf.clear();
+            if(cmd&0x02)
+                buf.reserve(int(sdo_value(req))+7);
+            TPCANMsgFD msg=response(uchar(0xA0|(crc_enabled?0x04:0)));
+            msg.DATA[4]=uchar(block_size);
+            out.push_back(msg);
+            blksize=block_size;
+            expected_seq=1;
+            last_received=false;
+            st=ST_BLK_DL;
+        }else{
+            if(st!=ST_BLK_DL_END)
+                return abort(SDO_ABORT_COMMAND,out);
+            buf.chop((cmd>>2)&0x07);
+            if(use_crc&&quint16(req.DATA[1]|req.DATA[2]<<8)
+                    !=sdo_crc16(reinterpret_cast<const uchar*>(buf.constData()),buf.size()))
+                return abort(SDO_ABORT_CRC,out);
+            set_object(index,sub,buf);
+            TPCANMsgFD msg=response(0xA1);
+            std::memset(msg.DATA+1,0,7);
+            out.push_back(msg);
+            n_completed++;
+            st=ST_IDLE;
+            buf.clear();
+        }
+        break;
+    case 5:     //block upload
+        if(!block_support)
+            return abort(SDO_ABORT_COMMAND,out);
+        switch(cmd&0x03){
+        case 0:{
+            index=sdo_index(req);
+            sub=req.DATA[3];
+            if(!has_object(index,sub))
+                return abort(SDO_ABORT_NO_OBJECT,out);
+            if(req.DATA[4]<1||req.DATA[4]>127)
+                return abort(SDO_ABORT_BLKSIZE,out);
+            buf=object(index,sub);
+            blksize=req.DATA[4];
+            use_crc=crc_enabled&&(cmd&0x04);
+            TPCANMsgFD msg=response(uchar(0xC2|(crc_enabled?0x04:0)));
+            for(int i=0;i<4;i++)
+                msg.DATA[4+i]=uchar(uint(buf.size())>>(8*i));
+            out.push_back(msg);
+            pos=0;
+            st=ST_BLK_UL_INIT;
+            break;
+        }
+        case 3:
+            if(st!=ST_BLK_UL_INIT)
+                return abort(SDO_ABORT_COMMAND,out);
+            send_sub_block(out);
+            break;
+        case 2:{
+            if(st!=ST_BLK_UL)
+                return abort(SDO_ABORT_COMMAND,out);
+            const int ackseq=req.DATA[1];
+            if(ackseq>sent_segments)
+                return abort(SDO_ABORT_SEQNO,out);
+            if(req.DATA[2]<1||req.DATA[2]>127)
+                return abort(SDO_ABORT_BLKSIZE,out);
+            blksize=req.DATA[2];
+            pos=qMin(sub_start+ackseq*7,buf.size());
+            if(ackseq==sent_segments&&pos>=buf.size()){
+                const int last_len=buf.isEmpty()?0:(buf.size()-1)%7+1;
+                TPCANMsgFD msg=response(uchar(0xC1|(7-last_len)<<2));
+                std::memset(msg.DATA+1,0,7);
+                if(use_crc){
+                    quint16 crc=sdo_crc16(reinterpret_cast<const uchar*>(buf.constData()),buf.size());
+                    msg.DATA[1]=uchar(crc&0xFF);
+                    msg.DATA[2]=uchar(crc>>8);
+                }
+                out.push_back(msg);
+                st=ST_BLK_UL_END;
+            }else{
+                send_sub_block(out);
+            }
+            break;
+        }
+        case 1:
+            if(st==ST_BLK_UL_END)
+                n_completed++;
+            st=ST_IDLE;
+            buf.clear();
+            break;
+        }
+        break;
+    default:
+        abort(SDO_ABORT_COMMAND,out);
+        break;
+    }
+    return true;
+}
+
+void SdoServer::send_sub_block(std::vector<TPCANMsgFD> &out)
+{
+    sub_start=pos;
+    int p=pos;
+    int seq=0;
+    while(seq<blksize){
+        seq++;
+        const int n=qMin(7,buf.size()-p);
+        const bool last=p+n>=buf.size();
+        TPCANMsgFD msg=response(uchar(seq|(last?0x80:0)));
+        std::memset(msg.DATA+1,0,7);
+        std::memcpy(msg.DATA+1,buf.constData()+p,size_t(n));
+        if(!lose_segment(last||seq==blksize))
+            out.push_back(msg);
+        p+=n;
+        if(last)
+            break;
+    }
+    sent_segments=seq;
+    st=ST_BLK_UL;
+}
+
+void SdoServer::block_download_segment(const TPCANMsgFD &req, std::vector<TPCANMsgFD> &out)
+{
+    const uchar cmd=req.DATA[0];
+    const int seq=cmd&0x7F;
+    if(lose_segment(seq>=blksize||(cmd&0x80)))
+        return;
+    if(seq==expected_seq){
+        buf.append(reinterpret_cast<const char*>(req.DATA+1),7);
+        expected_seq++;
+        last_received=cmd&0x80;
+    }
+    if(seq<blksize&&!(cmd&0x80))
+        return;
+
+    TPCANMsgFD msg=response(0xA2);
+    std::memset(msg.DATA+1,0,7);
+    msg.DATA[1]=uchar(expected_seq-1);
+    msg.DATA[2]=uchar(blksize);
+    out.push_back(msg);
+    expected_seq=1;
+    if(last_received)
+        st=ST_BLK_DL_END;
+}
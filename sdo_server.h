@@ -0,0 +1,74 @@
+#ifndef SDO_SERVER_H
+#define SDO_SERVER_H
+
+#include "canopen.h"
+#include <QHash>
+#include <vector>
+
+//SDO server of one node over an in-memory object dictionary: expedited,
+//segmented and block transfers (CiA 301). Plays the node side for the
+//emulator and the SDO benchmarks.
+class SdoServer
+{
+public:
+    explicit SdoServer(int node_id);
+
+    void set_object(ushort index, uchar sub, const QByteArray &data);
+    QByteArray object(ushort index, uchar sub) const;
+    bool has_object(ushort index, uchar sub) const;
+
+    void set_block_size(int segments) {block_size=qBound(1,segments,127);}
+    void set_crc(bool on) {crc_enabled=on;}
+    void set_block_support(bool on) {block_support=on;}
+    //fault injection: lose every nth block segment in both directions, except
+    //the last of a sub-block which only a timeout recovers, 0 = off
+    void set_segment_loss(int every_n) {loss_every=every_n;}
+
+    //handles one request, appends the responses to out; false when the
+    //frame is not addressed to this server
+    bool process(const TPCANMsgFD &req, std::vector<TPCANMsgFD> &out);
+
+    int node() const {return node_id;}
+    quint64 completed() const {return n_completed;}
+
+private:
+    enum state{
+        ST_IDLE=0,
+        ST_SEG_DL, ST_SEG_UL,
+        ST_BLK_DL, ST_BLK_DL_END,
+        ST_BLK_UL_INIT, ST_BLK_UL, ST_BLK_UL_END
+    };
+
+    static quint32 key(ushort index, uchar sub) {return quint32(index)<<8|sub;}
+    TPCANMsgFD response(uchar cmd) const;
+    //always true, so process() can return it
+    bool abort(quint32 code, std::vector<TPCANMsgFD> &out);
+    bool lose_segment(bool last_of_sub_block);
+    void send_sub_block(std::vector<TPCANMsgFD> &out);
+    void block_download_segment(const TPCANMsgFD &req, std::vector<TPCANMsgFD> &out);
+
+    int node_id;
+    QHash<quint32, QByteArray> objects;
+    int block_size=127;
+    bool crc_enabled=true;
+    bool block_support=true;
+    int loss_every=0;
+    quint64 n_segments=0;
+    quint64 n_completed=0;
+
+    //transfer in progress
+    state st=ST_IDLE;
+    ushort index=0;
+    uchar sub=0;
+    QByteArray buf;
+    int pos=0;
+    int sub_start=0;
+    int sent_segments=0;
+    int blksize=0;
+    int expected_seq=1;
+    bool toggle=false;
+    bool use_crc=false;
+    bool last_received=false;
+};
+
+#endif // SDO_SERVER_H
@@ -0,0 +1,458 @@
+#include "sdo_transfer.h"
+#include "clock_sync.h"
+#include <QMutexLocker>
+#include <cstring>
+
+//progress is reported at most once per this many bytes
+#define SDO_PROGRESS_STEP       4096
+
+//client command specifiers
+#define SDO_SEG_DL_INIT         0x21    //ccs 1, size indicated
+#define SDO_SEG_UL_REQ          0x60    //ccs 3
+#define SDO_BLK_DL_INIT         0xC2    //ccs 6, size indicated
+#define SDO_BLK_DL_END          0xC1    //ccs 6, cs 1
+#define SDO_BLK_UL_INIT         0xA0    //ccs 5
+#define SDO_BLK_UL_START        0xA3    //ccs 5, cs 3
+#define SDO_BLK_ACK             0xA2    //ccs/scs 5, cs/ss 2
+#define SDO_BLK_UL_END_RESP     0xA1    //ccs 5, cs 1
+#define SDO_BLK_CRC             0x04    //cc/sc bit
+#define SDO_BLK_LAST            0x80    //c bit of a block segment
+
+SdoTransfer::SdoTransfer(TxScheduler *tx, QObject *parent)
+    : QThread(parent)
+    , tx(tx)
+{
+    qRegisterMetaType<sdoTransferResult>("sdoTransferResult");
+}
+
+SdoTransfer::~SdoTransfer()
+{
+    shutdown();
+}
+
+void SdoTransfer::shutdown()
+{
+    {
+        QMutexLocker lock(&mutex);
+        quit=true;
+        wake.wakeAll();
+    }
+    wait();
+    QMutexLocker lock(&mutex);
+    quit=false;
+    jobs.clear();
+    rx.clear();
+    rx_node=0;
+    ph=PH_IDLE;
+}
+
+quint32 SdoTransfer::submit(const job &j)
+{
+    QMutexLocker lock(&mutex);
+    jobs.push_back(j);
+    jobs.back().id=next_id++;
+    wake.wakeOne();
+    return jobs.back().id;
+}
+
+quint32 SdoTransfer::upload(int node, ushort index, uchar sub, sdoMode mode)
+{
+    return submit(job{0,node,index,sub,true,mode,QByteArray()});
+}
+
+quint32 SdoTransfer::download(int node, ushort index, uchar sub, const QByteArray &data, sdoMode mode)
+{
+    return submit(job{0,node,index,sub,false,mode,data});
+}
+
+void SdoTransfer::post_frame(const canFrame &frame)
+{
+    if(frame.msg.MSGTYPE&(PCAN_MESSAGE_ECHO|PCAN_MESSAGE_STATUS|PCAN_MESSAGE_ERRFRAME)
+            ||frame.msg.DLC<8)
+        return;
+    QMutexLocker lock(&mutex);
+    if(!rx_node||frame.msg.ID!=DWORD(CO_SDO_TX+rx_node))
+        return;
+    rx.push_back(frame.msg);
+    wake.wakeOne();
+}
+
+void SdoTransfer::run()
+{
+    for(;;){
+        TPCANMsgFD msg;
+        {
+            QMutexLocker lock(&mutex);
+            if(quit)
+                break;
+            if(ph==PH_IDLE&&!jobs.empty()){
+                job j=jobs.front();
+                jobs.pop_front();
+                rx.clear();
+                rx_node=j.node;
+                lock.unlock();
+                begin(j);
+                continue;
+            }
+            if(rx.empty()){
+                if(ph==PH_IDLE)
+                    wake.wait(&mutex);
+                else{
+                    qint64 left=deadline_us-host_monotonic_us();
+                    if(left>0)
+                        wake.wait(&mutex,ulong(qMax<qint64>(1,left/1000)));
+                }
+                if(rx.empty()){
+                    lock.unlock();
+                    if(ph!=PH_IDLE&&host_monotonic_us()>=deadline_us)
+                        abort(SDO_ABORT_TIMEOUT);
+                    continue;
+                }
+            }
+            msg=rx.front();
+            rx.pop_front();
+        }
+        handle(msg);
+    }
+}
+
+TPCANMsgFD SdoTransfer::request(uchar cmd) const
+{
+    TPCANMsgFD msg={};
+    msg.ID=CO_SDO_RX+cur.node;
+    msg.DLC=8;
+    msg.DATA[0]=cmd;
+    msg.DATA[1]=uchar(cur.index&0xFF);
+    msg.DATA[2]=uchar(cur.index>>8);
+    msg.DATA[3]=cur.sub;
+    return msg;
+}
+
+void SdoTransfer::send(const TPCANMsgFD &msg)
+{
+    deadline_us=host_monotonic_us()+timeout_us;
+    tx->enqueue(msg,TX_PRIO_SDO);
+}
+
+void SdoTransfer::begin(const job &j)
+{
+    cur=j;
+    buf.clear();
+    offset=0;
+    total=j.upload?0:j.data.size();
+    toggle=false;
+    use_crc=false;
+    size_known=!j.upload;
+    last_progress=0;
+    start_us=host_monotonic_us();
+
+    TPCANMsgFD msg;
+    if(j.mode==SDO_MODE_BLOCK&&j.upload){
+        msg=request(uchar(SDO_BLK_UL_INIT|(crc_enabled?SDO_BLK_CRC:0)));
+        msg.DATA[4]=uchar(block_size);
+        msg.DATA[5]=0;  //no protocol switch
+        ph=PH_BLK_UL_INIT;
+    }
+    else if(j.mode==SDO_MODE_BLOCK){
+        msg=request(uchar(SDO_BLK_DL_INIT|(crc_enabled?SDO_BLK_CRC:0)));
+        ph=PH_BLK_DL_INIT;
+    }
+    else if(j.upload){
+        msg=request(SDO_UPLOAD_REQ);
+        ph=PH_SEG_UL_INIT;
+    }
+    else{
+        msg=request(SDO_SEG_DL_INIT);
+        ph=PH_SEG_DL_INIT;
+    }
+    if(!j.upload)
+        for(int i=0;i<4;i++)
+            msg.DATA[4+i]=uchar(quint32(total)>>(8*i));
+    send(msg);
+}
+
+void SdoTransfer::finish(quint32 abort_code)
+{
+    sdoTransferResult r;
+    r.id=cur.id;
+    r.node=cur.node;
+    r.index=cur.index;
+    r.sub=cur.sub;
+    r.upload=cur.upload;
+    r.data=cur.upload?buf:cur.data;
+    r.abort_code=abort_code;
+    r.elapsed_us=host_monotonic_us()-start_us;
+    if(!abort_code&&r.elapsed_us>0)
+        r.bytes_per_s=r.data.size()*1e6/r.elapsed_us;
+
+    ph=PH_IDLE;
+    buf.clear();
+    {
+        QMutexLocker lock(&mutex);
+        rx_node=0;
+        rx.clear();
+    }
+    if(!abort_code)
+        emit progress(r.id,r.data.size(),r.data.size());
+    emit finished(r);
+}
+
+void SdoTransfer::abort(quint32 code)
+{
+    tx->enqueue(sdo_abort_request(cur.node,cur.index,cur.sub,code),TX_PRIO_SDO);
+    finish(code);
+}
+
+void SdoTransfer::report(qint64 done)
+{
+    if(done-last_progress<SDO_PROGRESS_STEP)
+        return;
+    last_progress=done;
+    emit progress(cur.id,done,size_known?total:-1);
+}
+
+void SdoTransfer::handle(const TPCANMsgFD &msg)
+{
+    const uchar cmd=msg.DATA[0];
+    //a block segment may legally start with 0x80 only with seqno 0, which
+    //is never used, so this is always an abort
+    if(cmd==SDO_ABORT){
+        //a server without block support: fall back to segmented
+        const bool initiating=ph==PH_BLK_UL_INIT||ph==PH_BLK_DL_INIT;
+        if(initiating&&sdo_value(msg)==SDO_ABORT_COMMAND){
+            job j=cur;
+            j.mode=SDO_MODE_SEGMENTED;
+            const qint64 t0=start_us;
+            begin(j);
+            start_us=t0;
+            return;
+        }
+        finish(sdo_value(msg));
+        return;
+    }
+
+    switch(ph){
+    case PH_SEG_DL_INIT:
+        if(cmd!=SDO_DOWNLOAD_RESP||sdo_index(msg)!=cur.index||msg.DATA[3]!=cur.sub)
+            return abort(SDO_ABORT_COMMAND);
+        ph=PH_SEG_DL;
+        send_segment();
+        break;
+
+    case PH_SEG_DL:
+        if((cmd&0xE0)!=0x20)
+            return abort(SDO_ABORT_COMMAND);
+        if(bool(cmd&0x10)!=toggle)
+            return abort(SDO_ABORT_TOGGLE);
+        offset=qMin(offset+7,total);
+        toggle=!toggle;
+        if(offset>=total)
+            return finish(0);
+        report(offset);
+        send_segment();
+        break;
+
+    case PH_SEG_UL_INIT:
+        if((cmd&0xE0)!=0x40||sdo_index(msg)!=cur.index||msg.DATA[3]!=cur.sub)
+            return abort(SDO_ABORT_COMMAND);
+        if(cmd&0x02){
+            //the server answered expedited
+            int len=(cmd&0x01)?4-((cmd>>2)&0x03):4;
+            buf=QByteArray(reinterpret_cast<const char*>(msg.DATA+4),len);
+            return finish(0);
+        }
+        size_known=cmd&0x01;
+        total=size_known?qint64(sdo_value(msg)):0;
+        if(size_known)
+            buf.reserve(int(total));
+        ph=PH_SEG_UL;
+        send(request(SDO_SEG_UL_REQ));
+        break;
+
+    case PH_SEG_UL:{
+        if((cmd&0xE0)!=0x00)
+            return abort(SDO_ABORT_COMMAND);
+        if(bool(cmd&0x10)!=toggle)
+            return abort(SDO_ABORT_TOGGLE);
+        const int n=7-((cmd>>1)&0x07);
+        buf.append(reinterpret_cast<const char*>(msg.DATA+1),n);
+        if(cmd&0x01){
+            if(size_known&&buf.size()!=total)
+                return abort(SDO_ABORT_LENGTH);
+            return finish(0);
+        }
+        toggle=!toggle;
+        report(buf.size());
+        TPCANMsgFD req=request(uchar(SDO_SEG_UL_REQ|(toggle?0x10:0)));
+        for(int i=1;i<8;i++)
+            req.DATA[i]=0;
+        send(req);
+        break;
+    }
+
+    case PH_BLK_DL_INIT:
+        if((cmd&0xE3)!=0xA0||sdo_index(msg)!=cur.index||msg.DATA[3]!=cur.sub)
+            return abort(SDO_ABORT_COMMAND);
+        if(msg.DATA[4]<1||msg.DATA[4]>127)
+            return abort(SDO_ABORT_BLKSIZE);
+        use_crc=crc_enabled&&(cmd&SDO_BLK_CRC);
+        blksize=msg.DATA[4];
+        send_sub_block();
+        break;
+
+    case PH_BLK_DL_ACK:{
+        if(cmd!=SDO_BLK_ACK)
+            return abort(SDO_ABORT_COMMAND);
+        const int ackseq=msg.DATA[1];
+        if(ackseq>sent_segments)
+            return abort(SDO_ABORT_SEQNO);
+        if(msg.DATA[2]<1||msg.DATA[2]>127)
+            return abort(SDO_ABORT_BLKSIZE);
+        blksize=msg.DATA[2];
+        //segments after ackseq were lost and go out again
+        offset=qMin(sub_start+qint64(ackseq)*7,total);
+        if(ackseq==sent_segments&&offset>=total)
+            return send_block_end();
+        report(offset);
+        send_sub_block();
+        break;
+    }
+
+    case PH_BLK_DL_END:
+        if((cmd&0xE3)!=0xA1)
+            return abort(SDO_ABORT_COMMAND);
+        finish(0);
+        break;
+
+    case PH_BLK_UL_INIT:
+        if((cmd&0xE1)!=0xC0||sdo_index(msg)!=cur.index||msg.DATA[3]!=cur.sub)
+            return abort(SDO_ABORT_COMMAND);
+        use_crc=crc_enabled&&(cmd&SDO_BLK_CRC);
+        size_known=cmd&0x02;
+        total=size_known?qint64(sdo_value(msg)):0;
+        if(size_known)
+            buf.reserve(int(total)+7);
+        blksize=block_size;
+        expected_seq=1;
+        last_received=false;
+        ph=PH_BLK_UL;
+        {
+            TPCANMsgFD req=request(SDO_BLK_UL_START);
+            for(int i=1;i<8;i++)
+                req.DATA[i]=0;
+            send(req);
+        }
+        break;
+
+    case PH_BLK_UL:{
+        const int seq=cmd&0x7F;
+        if(seq==expected_seq){
+            buf.append(reinterpret_cast<const char*>(msg.DATA+1),7);
+            expected_seq++;
+            last_received=cmd&SDO_BLK_LAST;
+        }
+        //acknowledge at the end of a sub-block; an out of order segment is
+        //dropped and everything after the last good one is sent again
+        if(seq>=blksize||(cmd&SDO_BLK_LAST))
+            ack_sub_block(uchar(expected_seq-1));
+        else
+            deadline_us=host_monotonic_us()+timeout_us;
+        break;
+    }
+
+    case PH_BLK_UL_END:{
+        if((cmd&0xE3)!=0xC1)
+            return abort(SDO_ABORT_COMMAND);
+        const int n=(cmd>>2)&0x07;
+        buf.chop(n);
+        if(size_known&&buf.size()!=total)
+            return abort(SDO_ABORT_LENGTH);
+        if(use_crc){
+            quint16 crc=quint16(msg.DATA[1]|msg.DATA[2]<<8);
+            if(crc!=sdo_crc16(reinterpret_cast<const uchar*>(buf.constData()),buf.size()))
+                return abort(SDO_ABORT_CRC);
+        }
+        TPCANMsgFD req=request(SDO_BLK_UL_END_RESP);
+        for(int i=1;i<8;i++)
+            req.DATA[i]=0;
+        tx->enqueue(req,TX_PRIO_SDO);
+        finish(0);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+//segmented download: one segment per confirmation, toggle bit alternates
+void SdoTransfer::send_segment()
+{
+    const int n=int(qMin<qint64>(7,total-offset));
+    const bool last=offset+n>=total;
+    TPCANMsgFD msg=request(uchar((toggle?0x10:0)|(7-n)<<1|(last?0x01:0)));
+    for(int i=1;i<8;i++)
+        msg.DATA[i]=0;
+    std::memcpy(msg.DATA+1,cur.data.constData()+offset,size_t(n));
+    send(msg);
+}
+
+//block download: up to blksize segments go out back to back, the server
+//confirms the whole sub-block with one acknowledge
+void SdoTransfer::send_sub_block()
+{
+    std::vector<TPCANMsgFD> msgs;
+    msgs.reserve(size_t(blksize));
+    sub_start=offset;
+    qint64 pos=offset;
+    int seq=0;
+    while(seq<blksize){
+        seq++;
+        const int n=int(qMin<qint64>(7,total-pos));
+        const bool last=pos+n>=total;
+        TPCANMsgFD msg=request(uchar(seq|(last?SDO_BLK_LAST:0)));
+        for(int i=1;i<8;i++)
+            msg.DATA[i]=0;
+        std::memcpy(msg.DATA+1,cur.data.constData()+pos,size_t(n));
+        msgs.push_back(msg);
+        pos+=n;
+        if(last)
+            break;
+    }
+    sent_segments=seq;
+    ph=PH_BLK_DL_ACK;
+    deadline_us=host_monotonic_us()+timeout_us;
+    if(!tx->enqueue_batch(msgs,TX_PRIO_SDO))
+        abort(SDO_ABORT_MEMORY);
+}
+
+void SdoTransfer::send_block_end()
+{
+    //bytes of the last segment that carry no data
+    const int last_len=total?int((total-1)%7)+1:0;
+    TPCANMsgFD msg=request(uchar(SDO_BLK_DL_END|(7-last_len)<<2));
+    for(int i=1;i<8;i++)
+        msg.DATA[i]=0;
+    if(use_crc){
+        quint16 crc=sdo_crc16(reinterpret_cast<const uchar*>(cur.data.constData()),cur.data.size());
+        msg.DATA[1]=uchar(crc&0xFF);
+        msg.DATA[2]=uchar(crc>>8);
+    }
+    ph=PH_BLK_DL_END;
+    send(msg);
+}
+
+void SdoTransfer::ack_sub_block(uchar seq)
+{
+    TPCANMsgFD msg=request(SDO_BLK_ACK);
+    for(int i=1;i<8;i++)
+        msg.DATA[i]=0;
+    msg.DATA[1]=seq;
+    msg.DATA[2]=uchar(blksize);
+    expected_seq=1;
+    if(last_received)
+        ph=PH_BLK_UL_END;
+    else
+        report(buf.size());
+    send(msg);
+}
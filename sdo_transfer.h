@@ -0,0 +1,124 @@
+#ifndef SDO_TRANSFER_H
+#define SDO_TRANSFER_H
+
+#include "canopen.h"
+#include "tx_scheduler.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+
+enum sdoMode{
+    SDO_MODE_SEGMENTED=0,
+    SDO_MODE_BLOCK
+};
+
+struct sdoTransferResult{
+    quint32 id=0;
+    int node=0;
+    ushort index=0;
+    uchar sub=0;
+    bool upload=false;
+    QByteArray data;
+    quint32 abort_code=0;   //0 on success
+    qint64 elapsed_us=0;
+    double bytes_per_s=0;
+};
+Q_DECLARE_METATYPE(sdoTransferResult)
+
+
+//segmented and block SDO transfers (CiA 301) for objects of any size.
+//Transfers run one after another on the engine thread; server responses
+//are handed over with post_frame() from the read loop.
+class SdoTransfer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SdoTransfer(TxScheduler *tx, QObject *parent = nullptr);
+    ~SdoTransfer() override;
+
+    quint32 upload(int node, ushort index, uchar sub, sdoMode mode=SDO_MODE_BLOCK);
+    quint32 download(int node, ushort index, uchar sub, const QByteArray &data, sdoMode mode=SDO_MODE_BLOCK);
+
+    //block transfers: segments per sub-block (1..127) and CRC check
+    void set_block_size(int segments) {block_size=qBound(1,segments,127);}
+    void set_crc(bool on) {crc_enabled=on;}
+    void set_timeout_ms(int ms) {timeout_us=qint64(ms)*1000;}
+
+    //thread safe, only SDO server responses are kept
+    void post_frame(const canFrame &frame);
+    void shutdown();
+
+signals:
+    void finished(const sdoTransferResult &result);
+    void progress(quint32 id, qint64 done, qint64 total);  //total -1 when unknown
+
+protected:
+    void run() override;
+
+private:
+    enum phase{
+        PH_IDLE=0,
+        PH_SEG_DL_INIT, PH_SEG_DL,
+        PH_SEG_UL_INIT, PH_SEG_UL,
+        PH_BLK_DL_INIT, PH_BLK_DL_ACK, PH_BLK_DL_END,
+        PH_BLK_UL_INIT, PH_BLK_UL, PH_BLK_UL_END
+    };
+    struct job{
+        quint32 id;
+        int node;
+        ushort index;
+        uchar sub;
+        bool upload;
+        sdoMode mode;
+        QByteArray data;
+    };
+
+    quint32 submit(const job &j);
+    void begin(const job &j);
+    void handle(const TPCANMsgFD &msg);
+    void finish(quint32 abort_code);
+    void abort(quint32 code);
+    void send(const TPCANMsgFD &msg);
+    TPCANMsgFD request(uchar cmd) const;
+
+    void report(qint64 done);
+    void send_segment();
+    void send_sub_block();
+    void send_block_end();
+    void ack_sub_block(uchar seq);
+
+    TxScheduler *tx;
+    QMutex mutex;
+    QWaitCondition wake;
+    std::deque<job> jobs;
+    std::deque<TPCANMsgFD> rx;
+    bool quit=false;
+    int rx_node=0;          //node of the running transfer, 0 when idle
+    quint32 next_id=1;
+
+    int block_size=127;
+    bool crc_enabled=true;
+    qint64 timeout_us=1000000;
+
+    //current transfer, engine thread only
+    job cur;
+    phase ph=PH_IDLE;
+    QByteArray buf;
+    qint64 offset=0;
+    qint64 total=0;
+    bool size_known=false;
+    qint64 last_progress=0;
+    bool toggle=false;
+    bool use_crc=false;
+    int blksize=0;
+    int sent_segments=0;
+    qint64 sub_start=0;
+    int expected_seq=1;
+    bool last_received=false;
+    qint64 deadline_us=0;
+    qint64 start_us=0;
+};
+
+#endif // SDO_TRANSFER_H
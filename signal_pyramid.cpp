@@ -0,0 +1,431 @@
+#include "signal_pyramid.h"
+#include "capture_codec.h"
+#include "clock_sync.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <algorithm>
+
+static const char *pyramid_signal_names[IMU_SIG_COUNT]={"acc","gyr","eul","quat"};
+
+//b into the running bucket acc of the same series
+static void pyramid_merge(pyramidBucket &acc, double *sum, const pyramidBucket &b, int axes)
+{
+    if(!acc.count){
+        acc.t0_us=b.t0_us;
+        for(int a=0;a<axes;a++){
+            acc.min[a]=b.min[a];
+            acc.max[a]=b.max[a];
+        }
+    }
+    acc.t1_us=b.t1_us;
+    acc.count+=b.count;
+    for(int a=0;a<axes;a++){
+        acc.min[a]=qMin(acc.min[a],b.min[a]);
+        acc.max[a]=qMax(acc.max[a],b.max[a]);
+        sum[a]+=double(b.mean[a])*b.count;
+    }
+}
+
+static void pyramid_finish(pyramidBucket &b, const double *sum, int axes)
+{
+    for(int a=0;a<axes;a++)
+        b.mean[a]=b.count?float(sum[a]/b.count):0;
+}
+
+//----------------------------------------------------------------------------
+// SignalPyramid
+//----------------------------------------------------------------------------
+SignalPyramid::SignalPyramid()
+{
+}
+
+SignalPyramid::~SignalPyramid()
+{
+    close();
+}
+
+void SignalPyramid::clear()
+{
+    for(auto &s : series)
+        s.reset();
+    pending.clear();
+    n_samples=0;
+}
+
+bool SignalPyramid::open(const QString &path)
+{
+    close();
+    clear();
+    m_error.clear();
+    file.setFileName(path);
+    if(!file.open(QIODevice::WriteOnly|QIODevice::Truncate)){
+        m_error=file.errorString();
+        return false;
+    }
+    pyramidFileHeader hdr;
+    hdr.magic=PYRAMID_MAGIC;
+    hdr.version=PYRAMID_VERSION;
+    hdr.base=PYRAMID_BASE;
+    hdr.fanout=PYRAMID_FANOUT;
+    hdr.created_ms=QDateTime::currentMSecsSinceEpoch();
+    if(file.write(reinterpret_cast<const char*>(&hdr),sizeof(hdr))!=qint64(sizeof(hdr))){
+        m_error=file.errorString();
+        file.close();
+        return false;
+    }
+    return true;
+}
+
+void SignalPyramid::close()
+{
+    if(!file.isOpen())
+        return;
+    finish();
+    flush();
+    file.close();
+}
+
+bool SignalPyramid::flush()
+{
+    if(!file.isOpen()){
+        pending.clear();
+        return false;
+    }
+    if(pending.empty())
+        return true;
+    const qint64 size=qint64(pending.size()*sizeof(pyramidRecord));
+    const bool ok=file.write(reinterpret_cast<const char*>(pending.data()),size)==size;
+    if(!ok)
+        m_error=file.errorString();
+    pending.clear();
+    return ok;
+}
+
+bool SignalPyramid::load(const QString &path)
+{
+    close();
+    clear();
+    m_error.clear();
+    QFile in(path);
+    if(!in.open(QIODevice::ReadOnly)){
+        m_error=in.errorString();
+        return false;
+    }
+    pyramidFileHeader hdr;
+    if(in.read(reinterpret_cast<char*>(&hdr),sizeof(hdr))!=qint64(sizeof(hdr))
+            ||hdr.magic!=PYRAMID_MAGIC||hdr.version!=PYRAMID_VERSION
+            ||hdr.base!=PYRAMID_BASE||hdr.fanout!=PYRAMID_FANOUT){
+        m_error=QObject::tr("not a pyramid file");
+        return false;
+    }
+
+    //a trailing partial record is what a crash leaves, it is dropped
+    std::vector<pyramidRecord> records(size_t((in.size()-qint64(sizeof(hdr)))/qint64(sizeof(pyramidRecord))));
+    const qint64 size=qint64(records.size()*sizeof(pyramidRecord));
+    if(in.read(reinterpret_cast<char*>(records.data()),size)!=size){
+        m_error=in.errorString();
+        return false;
+    }
+    for(const pyramidRecord &r : records){
+        if(r.series>=PYRAMID_SERIES||!r.bucket.count)
+            continue;
+        pyramidSeries *s=series_at(r.series);
+        add_bucket(*s,r.series,0,r.bucket);
+        n_samples+=r.bucket.count;
+    }
+    finish();
+    pending.clear();
+    return true;
+}
+
+QString SignalPyramid::sidecar_path(const QString &capture_path)
+{
+    const QFileInfo info(capture_path);
+    return info.path()+"/"+info.completeBaseName()+".pqp";
+}
+
+SignalPyramid::pyramidSeries *SignalPyramid::series_at(int id)
+{
+    if(!series[id])
+        series[id].reset(new pyramidSeries());
+    return series[id].get();
+}
+
+void SignalPyramid::append(const imuSample *samples, int n)
+{
+    for(int i=0;i<n;i++){
+        const imuSample &smp=samples[i];
+        const int id=(smp.node&0x7F)*IMU_SIG_COUNT+smp.signal;
+        pyramidSeries &s=*series_at(id);
+        openBucket &o=s.open[0];
+        pyramidBucket &b=o.bucket;
+        const int axes=imu_signal_axes(smp.signal);
+        if(!b.count){
+            b.t0_us=smp.ts_us;
+            for(int a=0;a<axes;a++){
+                b.min[a]=smp.v[a];
+                b.max[a]=smp.v[a];
+            }
+        }
+        b.t1_us=smp.ts_us;
+        b.count++;
+        for(int a=0;a<axes;a++){
+            b.min[a]=qMin(b.min[a],smp.v[a]);
+            b.max[a]=qMax(b.max[a],smp.v[a]);
+            o.sum[a]+=smp.v[a];
+        }
+        if(++o.children==PYRAMID_BASE)
+            close_bucket(s,id,0);
+    }
+    n_samples+=quint64(n);
+}
+
+void SignalPyramid::add_bucket(pyramidSeries &s, int id, int level, const pyramidBucket &b)
+{
+    openBucket &o=s.open[level];
+    pyramidBucket &acc=o.bucket;
+    const int axes=imu_signal_axes(id%IMU_SIG_COUNT);
+    pyramid_merge(acc,o.sum,b,axes);
+    if(++o.children==(level?PYRAMID_FANOUT:1))
+        close_bucket(s,id,level);
+}
+
+void SignalPyramid::close_bucket(pyramidSeries &s, int id, int level)
+{
+    openBucket &o=s.open[level];
+    pyramid_finish(o.bucket,o.sum,imu_signal_axes(id%IMU_SIG_COUNT));
+    const pyramidBucket b=o.bucket;
+    o=openBucket();
+    s.levels[level].push_back(b);
+    if(level==0&&file.isOpen()){
+        pyramidRecord r={};
+        r.series=quint16(id);
+        r.bucket=b;
+        pending.push_back(r);
+    }
+    if(level+1<PYRAMID_LEVELS)
+        add_bucket(s,id,level+1,b);
+}
+
+void SignalPyramid::finish()
+{
+    //bottom up, so each partial bucket also lands in the one above
+    for(int id=0;id<PYRAMID_SERIES;id++){
+        if(!series[id])
+            continue;
+        pyramidSeries &s=*series[id];
+        for(int level=0;level<PYRAMID_LEVELS;level++){
+            if(s.open[level].children)
+                close_bucket(s,id,level);
+        }
+    }
+}
+
+int SignalPyramid::query(int node, int signal, quint64 t0_us, quint64 t1_us, int max_points,
+                         std::vector<pyramidBucket> &out) const
+{
+    out.clear();
+    const int id=(node&0x7F)*IMU_SIG_COUNT+signal;
+    if(signal<0||signal>=IMU_SIG_COUNT||!series[id]||t1_us<t0_us)
+        return -1;
+    const pyramidSeries &s=*series[id];
+    max_points=qMax(max_points,1);
+
+    //finest level with few enough buckets in the range, two binary searches each
+    typedef std::vector<pyramidBucket>::const_iterator iter;
+    int level=0;
+    iter first, last;
+    for(;;level++){
+        const std::vector<pyramidBucket> &v=s.levels[level];
+        first=std::lower_bound(v.begin(),v.end(),t0_us,[](const pyramidBucket &b, quint64 t){
+            return b.t1_us<t;
+        });
+        last=std::upper_bound(first,v.end(),t1_us,[](quint64 t, const pyramidBucket &b){
+            return t<b.t0_us;
+        });
+        if(last-first<=max_points||level==PYRAMID_LEVELS-1)
+            break;
+    }
+
+    const int axes=imu_signal_axes(signal);
+    const qint64 n=last-first;
+    //only the top level of a huge range can have too many, they are merged
+    const qint64 group=(n+max_points-1)/max_points;
+    out.reserve(size_t(qMin<qint64>(n,max_points)+1));
+    for(iter it=first;it!=last;){
+        if(group<=1){
+            out.push_back(*it++);
+            continue;
+        }
+        pyramidBucket b;
+        double sum[4]={0};
+        for(qint64 k=0;k<group&&it!=last;k++)
+            pyramid_merge(b,sum,*it++,axes);
+        pyramid_finish(b,sum,axes);
+        out.push_back(b);
+    }
+
+    //the samples not yet in a closed bucket of this level
+    pyramidBucket tail;
+    double sum[4]={0};
+    for(int l=level;l>=0;l--){
+        const openBucket &o=s.open[l];
+        if(!o.children)
+            continue;
+        pyramidBucket b=o.bucket;
+        pyramid_finish(b,o.sum,axes);
+        pyramid_merge(tail,sum,b,axes);
+    }
+    if(tail.count&&tail.t1_us>=t0_us&&tail.t0_us<=t1_us){
+        pyramid_finish(tail,sum,axes);
+        out.push_back(tail);
+    }
+    return out.empty()?-1:level;
+}
+
+pyramidBucket SignalPyramid::overview(int node, int signal) const
+{
+    pyramidBucket total;
+    std::vector<pyramidBucket> buckets;
+    if(query(node,signal,0,~quint64(0),1,buckets)<0)
+        return total;
+    const int axes=imu_signal_axes(signal);
+    double sum[4]={0};
+    for(const pyramidBucket &b : buckets)
+        pyramid_merge(total,sum,b,axes);
+    pyramid_finish(total,sum,axes);
+    return total;
+}
+
+int SignalPyramid::series_count() const
+{
+    int n=0;
+    for(const auto &s : series){
+        if(s)
+            n++;
+    }
+    return n;
+}
+
+qint64 SignalPyramid::memory_bytes() const
+{
+    qint64 bytes=qint64(pending.capacity()*sizeof(pyramidRecord));
+    for(const auto &s : series){
+        if(!s)
+            continue;
+        bytes+=qint64(sizeof(pyramidSeries));
+        for(const auto &v : s->levels)
+            bytes+=qint64(v.capacity()*sizeof(pyramidBucket));
+    }
+    return bytes;
+}
+
+QStringList SignalPyramid::report() const
+{
+    QStringList lines;
+    for(int id=0;id<PYRAMID_SERIES;id++){
+        if(!series[id])
+            continue;
+        const int node=id/IMU_SIG_COUNT;
+        const int signal=id%IMU_SIG_COUNT;
+        const pyramidBucket b=overview(node,signal);
+        if(!b.count)
+            continue;
+        QStringList ranges;
+        for(int a=0;a<imu_signal_axes(signal);a++){
+            ranges.append(QObject::tr("%1 .. %2 (mean %3)")
+                          .arg(double(b.min[a]),0,'g',4)
+                          .arg(double(b.max[a]),0,'g',4)
+                          .arg(double(b.mean[a]),0,'g',4));
+        }
+        lines.append(QObject::tr("node %1 %2: %3 samples over %4 s, %5")
+                     .arg(node)
+                     .arg(pyramid_signal_names[signal])
+                     .arg(b.count)
+                     .arg((b.t1_us-b.t0_us)/1e6,0,'f',1)
+                     .arg(ranges.join(", ")));
+    }
+    return lines;
+}
+
+//----------------------------------------------------------------------------
+// PyramidIndexer
+//----------------------------------------------------------------------------
+PyramidIndexer::PyramidIndexer(QObject *parent)
+    : QThread(parent)
+{
+    qRegisterMetaType<pyramidIndexStats>("pyramidIndexStats");
+}
+
+PyramidIndexer::~PyramidIndexer()
+{
+    wait();
+}
+
+void PyramidIndexer::index(const QString &capture_path, imuPacking mode)
+{
+    if(isRunning())
+        return;
+    {
+        QMutexLocker lock(&mutex);
+        path=capture_path;
+        packing=mode;
+    }
+    start(QThread::LowPriority);
+}
+
+void PyramidIndexer::run()
+{
+    QString capture_path;
+    ImuUnpacker unpacker;
+    {
+        QMutexLocker lock(&mutex);
+        capture_path=path;
+        unpacker.set_packing(packing);
+    }
+    const qint64 t0=host_monotonic_us();
+
+    CaptureReader reader;
+    if(!reader.open(capture_path)){
+        emit failed(tr("%1: %2").arg(capture_path,reader.error()));
+        return;
+    }
+    const QString sidecar=SignalPyramid::sidecar_path(capture_path);
+    SignalPyramid pyramid;
+    if(!pyramid.open(sidecar)){
+        emit failed(tr("%1: %2").arg(sidecar,pyramid.error()));
+        return;
+    }
+
+    pyramidIndexStats stats;
+    std::vector<canFrame> frames;
+    imuSample samples[IMU_FD_MAX_SAMPLES];
+    while(reader.next(frames)){
+        for(const canFrame &frame : frames){
+            const TPCANMsgFD &msg=frame.msg;
+            if(msg.MSGTYPE&(PCAN_MESSAGE_EXTENDED|PCAN_MESSAGE_RTR|PCAN_MESSAGE_STATUS))
+                continue;
+            const int n=unpacker.decode(frame,int(msg.ID&0x7F),samples,IMU_FD_MAX_SAMPLES);
+            if(n>0)
+                pyramid.append(samples,n);
+        }
+        stats.frames+=frames.size();
+        //one block at a time, the sidecar grows with the index
+        if(!pyramid.flush()){
+            emit failed(tr("%1: %2").arg(sidecar,pyramid.error()));
+            return;
+        }
+    }
+    if(!reader.error().isEmpty()){
+        emit failed(tr("%1: %2").arg(capture_path,reader.error()));
+        return;
+    }
+    pyramid.close();
+
+    stats.samples=pyramid.samples();
+    stats.series=pyramid.series_count();
+    stats.file_bytes=QFileInfo(sidecar).size();
+    stats.elapsed_us=host_monotonic_us()-t0;
+    emit indexed(sidecar,stats);
+}
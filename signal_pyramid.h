@@ -0,0 +1,152 @@
+#ifndef SIGNAL_PYRAMID_H
+#define SIGNAL_PYRAMID_H
+
+#include "imu_packing.h"
+#include <QThread>
+#include <QMutex>
+#include <QFile>
+#include <QMetaType>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+//pyramid sidecar (.pqp) next to a capture: a file header followed by the
+//level 0 buckets of every signal as they close, fixed size records only
+//appended, so a file cut short by a crash loads up to its last record.
+//The upper levels are rebuilt from level 0 on load
+#define PYRAMID_MAGIC           0x50515050u   //"PPQP"
+#define PYRAMID_VERSION         1u
+//samples per level 0 bucket, level L buckets span BASE*FANOUT^L samples
+#define PYRAMID_BASE            64
+#define PYRAMID_FANOUT          8
+#define PYRAMID_LEVELS          8
+//one series per node and signal
+#define PYRAMID_SERIES          (128*IMU_SIG_COUNT)
+
+struct pyramidFileHeader{
+    quint32 magic;
+    quint32 version;
+    quint32 base;
+    quint32 fanout;
+    qint64 created_ms;      //UTC, ms since epoch
+};
+
+//min, max and mean of every axis over count consecutive samples
+struct pyramidBucket{
+    quint64 t0_us=0;        //timestamp of the first sample
+    quint64 t1_us=0;        //and of the last one
+    quint32 count=0;
+    quint32 reserved=0;
+    float min[4]={0};
+    float max[4]={0};
+    float mean[4]={0};
+};
+
+//record of the sidecar file
+struct pyramidRecord{
+    quint16 series;         //node*IMU_SIG_COUNT+signal
+    quint16 reserved;
+    quint32 reserved2;
+    pyramidBucket bucket;
+};
+
+struct pyramidIndexStats{
+    quint64 frames=0;
+    quint64 samples=0;
+    int series=0;
+    qint64 file_bytes=0;
+    qint64 elapsed_us=0;
+};
+Q_DECLARE_METATYPE(pyramidIndexStats)
+
+//min/max/mean pyramid of every decoded signal, built incrementally as the
+//samples come in. A query for a time range reads the finest level with at
+//most max_points buckets in the range, so a plot of any zoom level costs
+//O(pixels) no matter how long the recording is; below level 0 the range
+//holds at most max_points*PYRAMID_BASE samples, read from the capture
+class SignalPyramid
+{
+public:
+    SignalPyramid();
+    ~SignalPyramid();
+
+    void clear();
+    //starts an empty pyramid that writes its buckets to the sidecar at path
+    bool open(const QString &path);
+    //closes the partial buckets and the sidecar, the pyramid stays
+    void close();
+    bool is_open() const {return file.isOpen();}
+    //writes the level 0 buckets closed since the last flush
+    bool flush();
+    //replaces the pyramid by the one of a sidecar
+    bool load(const QString &path);
+    static QString sidecar_path(const QString &capture_path);
+
+    void append(const imuSample *samples, int n);
+
+    //buckets of one signal overlapping [t0_us, t1_us] in time order, the
+    //samples of the buckets still open merged into the last one; returns
+    //the level read, -1 when the signal has no samples in the range
+    int query(int node, int signal, quint64 t0_us, quint64 t1_us, int max_points,
+              std::vector<pyramidBucket> &out) const;
+    //the whole series in one bucket, count 0 when never seen
+    pyramidBucket overview(int node, int signal) const;
+
+    int series_count() const;
+    quint64 samples() const {return n_samples;}
+    qint64 memory_bytes() const;
+    //one line per series
+    QStringList report() const;
+    QString error() const {return m_error;}
+
+private:
+    struct openBucket{
+        pyramidBucket bucket;
+        double sum[4]={0};
+        int children=0;
+    };
+    struct pyramidSeries{
+        std::vector<pyramidBucket> levels[PYRAMID_LEVELS];
+        openBucket open[PYRAMID_LEVELS];
+    };
+
+    pyramidSeries *series_at(int id);
+    void add_bucket(pyramidSeries &s, int id, int level, const pyramidBucket &b);
+    void close_bucket(pyramidSeries &s, int id, int level);
+    void finish();
+
+    std::unique_ptr<pyramidSeries> series[PYRAMID_SERIES];
+    std::vector<pyramidRecord> pending;
+    quint64 n_samples=0;
+    QFile file;
+    QString m_error;
+};
+
+
+//builds the pyramid of a capture file in the background and writes its
+//sidecar; every node is decoded, not only the one shown in the window
+class PyramidIndexer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit PyramidIndexer(QObject *parent = nullptr);
+    ~PyramidIndexer() override;
+
+    //indexes in the background, indexed() or failed() when done
+    void index(const QString &capture_path, imuPacking packing);
+
+signals:
+    void indexed(QString sidecar_path, const pyramidIndexStats &stats);
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    QMutex mutex;
+    QString path;
+    imuPacking packing=IMU_PACK_NONE;
+};
+
+#endif // SIGNAL_PYRAMID_H
@@ -0,0 +1,273 @@
+#include "sync_acquisition.h"
+#include <cmath>
+
+SyncAcquisition::SyncAcquisition(CanTransport *can, TxScheduler *tx, SdoClient *sdo, QObject *parent)
+    : QObject(parent)
+    , can(can)
+    , tx(tx)
+    , sdo(sdo)
+{
+    for(auto &s : slot_of_node)
+        s=-1;
+    connect(sdo, &SdoClient::finished, this, &SyncAcquisition::sdo_finished);
+}
+
+//TPDO parameter bits of tpdoParams::have, by sub-index
+static int param_bit(uchar sub)
+{
+    return sub==1?1:sub==2?2:sub==5?4:0;
+}
+
+void SyncAcquisition::write_param(int node, int tpdo, uchar sub, uint value, int size)
+{
+    QByteArray data;
+    for(int i=0;i<size;i++)
+        data.append(char(value>>(8*i)));
+    const quint32 id=sdo->write(node,ushort(0x1800+tpdo),sub,data);
+    requests.insert(id,slot_of_node[node&0x7F]<<8|tpdo<<4);
+}
+
+void SyncAcquisition::restore_tpdos()
+{
+    restore_due=false;
+    restoring=true;
+    for(int i=0;i<nodes.size();i++){
+        for(int n=0;n<SYNC_TPDOS;n++){
+            if(!(tpdo_mask&(1u<<n)))
+                continue;
+            const tpdoParams &p=saved[i][n];
+            if(p.have!=7){
+                emit message(tr("SYNC: node %1 TPDO%2 left synchronous, its parameters could not be read.")
+                             .arg(nodes[i]).arg(n+1));
+                continue;
+            }
+            //CiA 301: the PDO is invalidated while its parameters change,
+            //the saved COB-ID last, valid or not as it was
+            write_param(nodes[i],n,1,p.cob_id|0x80000000u,4);
+            write_param(nodes[i],n,2,p.type,1);
+            write_param(nodes[i],n,5,p.event_ms,2);
+            write_param(nodes[i],n,1,p.cob_id,4);
+        }
+    }
+    restoring=!requests.isEmpty();
+}
+
+void SyncAcquisition::sdo_finished(const sdoResult &result)
+{
+    auto it=requests.find(result.id);
+    if(it==requests.end())
+        return;
+    const int slot=it.value()>>8;
+    const int tpdo=(it.value()>>4)&0xF;
+    const bool read=it.value()&1;
+    requests.erase(it);
+
+    if(result.abort_code){
+        m_stats.sdo_failures++;
+        emit message(tr("SYNC: node %1 0x%2 sub %3 %4 failed, abort 0x%5")
+                     .arg(result.node).arg(result.index,4,16,QLatin1Char('0')).arg(result.sub)
+                     .arg(read?tr("read"):tr("write")).arg(result.abort_code,8,16,QLatin1Char('0')));
+        //a node that does not answer at all, drop the rest of its requests
+        if(result.abort_code==SDO_ABORT_TIMEOUT){
+            sdo->cancel(result.node);
+            for(auto r=requests.begin();r!=requests.end();){
+                if((r.value()>>8)==slot){
+                    reads_open-=r.value()&1;
+                    r=requests.erase(r);
+                }
+                else{
+                    ++r;
+                }
+            }
+        }
+    }
+    else if(read){
+        quint32 v=0;
+        for(int i=0;i<result.data.size()&&i<4;i++)
+            v|=quint32(uchar(result.data[i]))<<(8*i);
+        tpdoParams &p=saved[slot][tpdo];
+        if(result.sub==1)
+            p.cob_id=v;
+        else if(result.sub==2)
+            p.type=v;
+        else
+            p.event_ms=v;
+        p.have|=param_bit(result.sub);
+    }
+    if(read)
+        reads_open--;
+    if(restore_due&&!reads_open)
+        restore_tpdos();
+    if(restoring&&requests.isEmpty()){
+        restoring=false;
+        emit message(m_stats.sdo_failures?tr("SYNC: TPDO settings restored, %1 SDO request(s) failed.").arg(m_stats.sdo_failures)
+                                         :tr("SYNC: TPDO settings restored."));
+    }
+}
+
+bool SyncAcquisition::start(const QVector<int> &node_list, quint32 period, uint mask)
+{
+    if(running||node_list.isEmpty()||node_list.size()>SYNC_MAX_NODES||!period)
+        return false;
+
+    nodes=node_list;
+    period_us=period;
+    tpdo_mask=mask;
+    for(auto &s : slot_of_node)
+        s=-1;
+    for(int i=0;i<nodes.size();i++)
+        slot_of_node[nodes[i]&0x7F]=char(i);
+    //requests of an earlier run still open are not followed any more; per
+    //node they go out before ours, so the reads see a finished restore
+    requests.clear();
+    reads_open=0;
+    restore_due=false;
+    restoring=false;
+
+    //echo frames carry the hardware time our SYNC actually left
+    echo=can->acquire_echo();
+
+    m_stats=syncStats();
+    m_stats.hw_timestamps=echo;
+    jitter_sq_sum=0;
+    jitter_n=0;
+    last_sync_us=0;
+    have_cycle=false;
+
+    //the parameters as they are, then transmission type 1: send on every
+    //SYNC, no event timer; the SDO client sends one request per node at a
+    //time, in this order
+    for(int i=0;i<nodes.size();i++){
+        for(int n=0;n<SYNC_TPDOS;n++){
+            saved[i][n]=tpdoParams();
+            if(!(tpdo_mask&(1u<<n)))
+                continue;
+            for(uchar sub : {uchar(1),uchar(2),uchar(5)}){
+                requests.insert(sdo->read(nodes[i],ushort(0x1800+n),sub),i<<8|n<<4|1);
+                reads_open++;
+            }
+            const uint cobid=ch100_tpdo_base[n]+uint(nodes[i]);
+            write_param(nodes[i],n,1,cobid|0x80000000u,4);
+            write_param(nodes[i],n,2,1,1);
+            write_param(nodes[i],n,5,0,2);
+            write_param(nodes[i],n,1,cobid,4);
+        }
+    }
+
+    TPCANMsgFD sync={};
+    sync.ID=CO_SYNC;
+    sync.DLC=0;
+    sync_handle=tx->add_periodic(sync,period_us);
+    running=true;
+    return true;
+}
+
+void SyncAcquisition::stop()
+{
+    if(!running)
+        return;
+    tx->remove_periodic(sync_handle);
+    //the open cycle is cut short, its TPDOs may still be on the way
+    have_cycle=false;
+    //the saved parameters go back once all of them are read
+    if(reads_open)
+        restore_due=true;
+    else
+        restore_tpdos();
+    if(echo)
+        can->release_echo();
+    running=false;
+}
+
+void SyncAcquisition::open_cycle(TPCANTimestampFD ts_us, qint64 host_us)
+{
+    close_cycle();
+
+    if(last_sync_us&&ts_us>last_sync_us){
+        double dev=double(ts_us-last_sync_us)-double(period_us);
+        jitter_sq_sum+=dev*dev;
+        jitter_n++;
+        m_stats.jitter_rms_us=std::sqrt(jitter_sq_sum/jitter_n);
+        m_stats.jitter_max_us=qMax(m_stats.jitter_max_us,std::fabs(dev));
+    }
+    last_sync_us=ts_us;
+
+    quint32 index=current.index+1;
+    current.index=index;
+    current.sync_ts_us=ts_us;
+    current.sync_host_us=host_us;
+    current.received=0;
+    current.expected=0;
+    for(int n=0;n<SYNC_TPDOS;n++)
+        if(tpdo_mask&(1u<<n))
+            current.expected+=nodes.size();
+    current.n_nodes=nodes.size();
+    for(int i=0;i<nodes.size();i++){
+        current.nodes[i]=uchar(nodes[i]);
+        for(int n=0;n<SYNC_TPDOS;n++)
+            current.valid[i][n]=false;
+    }
+    have_cycle=true;
+}
+
+void SyncAcquisition::close_cycle()
+{
+    if(!have_cycle)
+        return;
+    have_cycle=false;
+
+    m_stats.cycles++;
+    if(current.received>=current.expected)
+        m_stats.complete_cycles++;
+    double c=current.expected?double(current.received)/current.expected:0;
+    m_stats.completeness_avg+=(c-m_stats.completeness_avg)/double(m_stats.cycles);
+    emit cycle_complete(current);
+}
+
+void SyncAcquisition::on_sent(const TPCANMsgFD &msg, qint64 host_us)
+{
+    //without echo frames the cycle opens on the host send time
+    if(!running||echo||msg.ID!=CO_SYNC)
+        return;
+    open_cycle(TPCANTimestampFD(host_us),host_us);
+}
+
+void SyncAcquisition::process_frame(const canFrame &frame)
+{
+    if(!running)
+        return;
+
+    const TPCANMsgFD &msg=frame.msg;
+    if(msg.ID==CO_SYNC){
+        if(echo&&(msg.MSGTYPE&PCAN_MESSAGE_ECHO))
+            open_cycle(frame.ts_us,frame.host_us);
+        return;
+    }
+    if(!have_cycle||(msg.MSGTYPE&PCAN_MESSAGE_ECHO))
+        return;
+
+    const int node=int(msg.ID&0x7F);
+    const int slot=slot_of_node[node];
+    if(slot<0)
+        return;
+    for(int n=0;n<SYNC_TPDOS;n++){
+        if(msg.ID!=ch100_tpdo_base[n]+uint(node)||!(tpdo_mask&(1u<<n)))
+            continue;
+        if(!current.valid[slot][n]){
+            current.valid[slot][n]=true;
+            current.received++;
+        }
+        current.frames[slot][n]=frame;
+        break;
+    }
+}
+
+QString SyncAcquisition::summary() const
+{
+    return tr("SYNC %1 cycles, %2% complete, jitter rms %3 us max %4 us (%5)")
+            .arg(m_stats.cycles)
+            .arg(m_stats.cycles?100.0*m_stats.complete_cycles/m_stats.cycles:0.0,0,'f',1)
+            .arg(m_stats.jitter_rms_us,0,'f',1)
+            .arg(m_stats.jitter_max_us,0,'f',1)
+            .arg(m_stats.hw_timestamps?tr("hw"):tr("host"));
+}
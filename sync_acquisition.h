@@ -0,0 +1,110 @@
+#ifndef SYNC_ACQUISITION_H
+#define SYNC_ACQUISITION_H
+
+#include "canopen.h"
+#include "sdo_client.h"
+#include "tx_scheduler.h"
+#include <QObject>
+#include <QHash>
+#include <QVector>
+
+#define SYNC_MAX_NODES  16
+#define SYNC_TPDOS      5
+
+//all TPDOs that followed one SYNC
+struct syncCycle{
+    quint32 index=0;
+    TPCANTimestampFD sync_ts_us=0;
+    qint64 sync_host_us=0;
+    int expected=0;
+    int received=0;
+    int n_nodes=0;
+    uchar nodes[SYNC_MAX_NODES]={0};
+    bool valid[SYNC_MAX_NODES][SYNC_TPDOS]={};
+    canFrame frames[SYNC_MAX_NODES][SYNC_TPDOS];
+};
+
+struct syncStats{
+    quint64 cycles=0;
+    quint64 complete_cycles=0;
+    double completeness_avg=0;  //received/expected
+    double jitter_rms_us=0;     //SYNC period vs configured period
+    double jitter_max_us=0;
+    bool hw_timestamps=false;   //SYNC times from echo frames
+    quint64 sdo_failures=0;     //TPDO parameter reads and writes that failed
+};
+
+//switches the node TPDOs to synchronous transmission, sends SYNC from the
+//TX thread and groups the TPDOs that follow each SYNC into one cycle. The
+//TPDO parameters (0x1800+n sub 1, 2 and 5) are read before they change and
+//written back on stop, one confirmed SDO request after the other per node
+class SyncAcquisition : public QObject
+{
+    Q_OBJECT
+
+public:
+    SyncAcquisition(CanTransport *can, TxScheduler *tx, SdoClient *sdo, QObject *parent = nullptr);
+
+    //tpdo_mask: bit n = TPDO n+1 is expected from every node
+    bool start(const QVector<int> &nodes, quint32 period_us, uint tpdo_mask=0x1F);
+    //restores the TPDO parameters each node had before start()
+    void stop();
+    bool is_running() const {return running;}
+    //SDO requests of the switch to SYNC or of the restore still open
+    bool is_configuring() const {return !requests.isEmpty();}
+
+    //from the read loop, echo frames of our own SYNC included
+    void process_frame(const canFrame &frame);
+    void on_sent(const TPCANMsgFD &msg, qint64 host_us);
+
+    syncStats stats() const {return m_stats;}
+    QString summary() const;
+
+signals:
+    void cycle_complete(const syncCycle &cycle);
+    void message(QString text);
+
+private slots:
+    void sdo_finished(const sdoResult &result);
+
+private:
+    //TPDO parameters as read before the switch, have: bit per sub read
+    struct tpdoParams{
+        uint cob_id=0;
+        uint type=0;
+        uint event_ms=0;
+        int have=0;
+    };
+
+    void write_param(int node, int tpdo, uchar sub, uint value, int size);
+    void restore_tpdos();
+    void open_cycle(TPCANTimestampFD ts_us, qint64 host_us);
+    void close_cycle();
+
+    CanTransport *can;
+    TxScheduler *tx;
+    SdoClient *sdo;
+    bool running=false;
+    int sync_handle=0;
+    quint32 period_us=0;
+    uint tpdo_mask=0x1F;
+    QVector<int> nodes;
+    signed char slot_of_node[128];
+
+    tpdoParams saved[SYNC_MAX_NODES][SYNC_TPDOS];
+    //our SDO requests: id -> node slot<<8 | tpdo<<4 | read flag
+    QHash<quint32,int> requests;
+    int reads_open=0;
+    bool restore_due=false;
+    bool restoring=false;
+
+    syncCycle current;
+    bool have_cycle=false;
+    bool echo=false;
+    TPCANTimestampFD last_sync_us=0;
+    double jitter_sq_sum=0;
+    quint64 jitter_n=0;
+    syncStats m_stats;
+};
+
+#endif // SYNC_ACQUISITION_H
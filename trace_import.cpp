@@ -0,0 +1,766 @@
+#include "trace_import.h"
+#include "clock_sync.h"
+#include <QFile>
+#include <QDateTime>
+#include <QLocale>
+#include <QMutexLocker>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+
+//chunks smaller than this are not worth a thread
+#define TRACE_MIN_CHUNK     (1<<20)
+//OLE automation date (PCAN-View $STARTTIME) of 1970-01-01
+#define OLE_DATE_EPOCH      25569.0
+
+const char *trace_format_name(traceFormat format)
+{
+    switch(format){
+    case TRACE_PCAN_TRC: return "PCAN-View trc";
+    case TRACE_CANDUMP: return "candump";
+    case TRACE_VECTOR_ASC: return "Vector ASC";
+    default: return "unknown";
+    }
+}
+
+//----------------------------------------------------------------------------
+// in place parsing, pointers into the mapped file
+//----------------------------------------------------------------------------
+static inline bool is_space(char c)
+{
+    return c==' '||c=='\t'||c=='\r';
+}
+
+//next whitespace separated token of the line, false at the end of the line
+static inline bool next_token(const char *&p, const char *end, const char *&tok, const char *&tok_end)
+{
+    while(p<end&&is_space(*p))
+        p++;
+    if(p>=end)
+        return false;
+    tok=p;
+    while(p<end&&!is_space(*p))
+        p++;
+    tok_end=p;
+    return true;
+}
+
+static inline int hex_digit(char c)
+{
+    if(c>='0'&&c<='9')
+        return c-'0';
+    c=char(c|0x20);
+    if(c>='a'&&c<='f')
+        return c-'a'+10;
+    return -1;
+}
+
+static inline bool parse_hex(const char *p, const char *end, quint32 &value)
+{
+    if(p>=end||end-p>8)
+        return false;
+    quint32 v=0;
+    for(;p<end;p++){
+        const int d=hex_digit(*p);
+        if(d<0)
+            return false;
+        v=v<<4|quint32(d);
+    }
+    value=v;
+    return true;
+}
+
+static inline bool parse_dec(const char *p, const char *end, quint32 &value)
+{
+    if(p>=end||end-p>9)
+        return false;
+    quint32 v=0;
+    for(;p<end;p++){
+        if(*p<'0'||*p>'9')
+            return false;
+        v=v*10+quint32(*p-'0');
+    }
+    value=v;
+    return true;
+}
+
+//fixed point: "1059.9" with 3 fraction digits -> 1059900, extra digits are cut
+static inline bool parse_fixed(const char *p, const char *end, int frac_digits, qint64 &value)
+{
+    if(p>=end)
+        return false;
+    qint64 v=0;
+    int frac=-1;
+    for(;p<end;p++){
+        if(*p=='.'){
+            if(frac>=0)
+                return false;
+            frac=0;
+            continue;
+        }
+        if(*p<'0'||*p>'9')
+            return false;
+        if(frac<0)
+            v=v*10+(*p-'0');
+        else if(frac<frac_digits){
+            v=v*10+(*p-'0');
+            frac++;
+        }
+    }
+    for(frac=qMax(frac,0);frac<frac_digits;frac++)
+        v*=10;
+    value=v;
+    return true;
+}
+
+static inline bool parse_byte(const char *p, const char *end, bool dec, uchar &value)
+{
+    quint32 v;
+    if(dec?!parse_dec(p,end,v):(end-p!=2||!parse_hex(p,end,v)))
+        return false;
+    if(v>0xFF)
+        return false;
+    value=uchar(v);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// header: format and the settings the line parsers depend on
+//----------------------------------------------------------------------------
+struct traceLayout{
+    traceFormat format=TRACE_UNKNOWN;
+    //trc column letters: N number, O offset [ms], T type, B bus, I ID,
+    //d direction, R reserved, l DLC, L length, D data
+    char columns[16]={0};
+    bool asc_dec=false;         //"base dec"
+    bool asc_relative=false;    //"timestamps relative"
+    qint64 start_ms=0;
+};
+
+static bool starts_with(const char *p, const char *end, const char *text)
+{
+    const size_t n=strlen(text);
+    return size_t(end-p)>=n&&memcmp(p,text,n)==0;
+}
+
+static void set_trc_columns(traceLayout &layout, const QByteArray &columns)
+{
+    int n=0;
+    for(char c : columns){
+        if(c!=','&&!is_space(c)&&n<int(sizeof(layout.columns))-1)
+            layout.columns[n++]=c;
+    }
+    layout.columns[n]=0;
+}
+
+static qint64 parse_asc_date(const QByteArray &text)
+{
+    //"Wed Jun 12 10:22:13.123 am 2019", the seconds fraction and am/pm are optional
+    const QString date=QString::fromLatin1(text).simplified();
+    static const char *formats[]={"ddd MMM d hh:mm:ss.zzz ap yyyy","ddd MMM d hh:mm:ss ap yyyy",
+                                  "ddd MMM d hh:mm:ss.zzz yyyy","ddd MMM d hh:mm:ss yyyy"};
+    for(const char *format : formats){
+        const QDateTime dt=QLocale::c().toDateTime(date,format);
+        if(dt.isValid())
+            return dt.toMSecsSinceEpoch();
+    }
+    return 0;
+}
+
+static bool scan_layout(const char *data, qint64 size, traceLayout &layout, QString &error)
+{
+    QByteArray version;
+    const char *p=data;
+    const char *end=data+size;
+    for(int line=0;p<end&&line<256;line++){
+        const char *eol=static_cast<const char*>(memchr(p,'\n',size_t(end-p)));
+        if(!eol)
+            eol=end;
+        const char *q=p;
+        while(q<eol&&is_space(*q))
+            q++;
+        const char *next=eol+1;
+        if(q==eol){
+            p=next;
+            continue;
+        }
+
+        const QByteArray text=QByteArray(q,int(eol-q)).trimmed();
+        if(*q==';'){
+            layout.format=TRACE_PCAN_TRC;
+            if(text.startsWith(";$FILEVERSION="))
+                version=text.mid(14);
+            else if(text.startsWith(";$STARTTIME="))
+                layout.start_ms=qint64((text.mid(12).toDouble()-OLE_DATE_EPOCH)*86400000.0);
+            else if(text.startsWith(";$COLUMNS="))
+                set_trc_columns(layout,text.mid(10));
+        }
+        else if(starts_with(q,eol,"date ")){
+            layout.format=TRACE_VECTOR_ASC;
+            layout.start_ms=parse_asc_date(text.mid(5));
+        }
+        else if(starts_with(q,eol,"base ")){
+            layout.format=TRACE_VECTOR_ASC;
+            layout.asc_dec=text.contains("base dec");
+            layout.asc_relative=text.contains("timestamps relative");
+        }
+        else if(starts_with(q,eol,"Begin Trigger")||starts_with(q,eol,"//")
+                ||starts_with(q,eol,"internal events")||starts_with(q,eol,"no internal events")){
+            layout.format=TRACE_VECTOR_ASC;
+        }
+        else{
+            //first data line
+            const char *tokp=q;
+            const char *tok[3]={nullptr,nullptr,nullptr};
+            const char *tok_end[3]={nullptr,nullptr,nullptr};
+            int n=0;
+            while(n<3&&next_token(tokp,eol,tok[n],tok_end[n]))
+                n++;
+            if(layout.format==TRACE_UNKNOWN){
+                if(*q=='('||memchr(q,'#',size_t(eol-q))||(n>=3&&*tok[2]=='['))
+                    layout.format=TRACE_CANDUMP;
+                else if(n>=1&&tok_end[0][-1]==')')
+                    layout.format=TRACE_PCAN_TRC;
+            }
+            //version 1.0 files have no header, 1.1 adds the direction
+            if(layout.format==TRACE_PCAN_TRC&&version.isEmpty())
+                version=(n>=3&&tok_end[2]-tok[2]==2&&tok[2][1]=='x')?"1.1":"1.0";
+            break;
+        }
+        p=next;
+    }
+
+    if(layout.format==TRACE_PCAN_TRC&&!layout.columns[0]){
+        static const struct{const char *version; const char *columns;} defaults[]={
+            {"1.0","NOIlD"},{"1.1","NOdIlD"},{"1.2","NOBdIlD"},{"1.3","NOBdIRlD"},
+            {"2.0","NOTIdlD"},{"2.1","NOTBIdRLD"}};
+        for(const auto &d : defaults){
+            if(version==d.version)
+                set_trc_columns(layout,d.columns);
+        }
+        if(!layout.columns[0]){
+            error=QObject::tr("unsupported trc file version %1").arg(QString::fromLatin1(version));
+            return false;
+        }
+    }
+    if(layout.format==TRACE_UNKNOWN){
+        error=QObject::tr("not a trc, candump or ASC trace");
+        return false;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// line parsers, true for a data frame
+//----------------------------------------------------------------------------
+static bool parse_trc_line(const char *p, const char *end, const traceLayout &layout, canFrame &frame)
+{
+    const char *tok,*te;
+    TPCANMessageType type=PCAN_MESSAGE_STANDARD;
+    int len=0;
+    quint32 v;
+    qint64 ts;
+
+    for(const char *c=layout.columns;*c;c++){
+        //frames without payload may end before the data column
+        if(*c=='D'&&(len==0||(type&PCAN_MESSAGE_RTR)))
+            break;
+        if(!next_token(p,end,tok,te))
+            return false;
+        switch(*c){
+        case 'O':
+            if(!parse_fixed(tok,te,3,ts))
+                return false;
+            frame.ts_us=TPCANTimestampFD(ts);
+            break;
+        case 'T':
+            //DT data, FD/FB/FE/BI FD without/with BRS/ESI, RR remote; the
+            //rest (ST, ER, EC, EV) are events
+            if(te-tok!=2)
+                return false;
+            if(tok[0]=='D'&&tok[1]=='T') {}
+            else if(tok[0]=='F'&&tok[1]=='D') type|=PCAN_MESSAGE_FD;
+            else if(tok[0]=='F'&&tok[1]=='B') type|=PCAN_MESSAGE_FD|PCAN_MESSAGE_BRS;
+            else if(tok[0]=='F'&&tok[1]=='E') type|=PCAN_MESSAGE_FD|PCAN_MESSAGE_ESI;
+            else if(tok[0]=='B'&&tok[1]=='I') type|=PCAN_MESSAGE_FD|PCAN_MESSAGE_BRS|PCAN_MESSAGE_ESI;
+            else if(tok[0]=='R'&&tok[1]=='R') type|=PCAN_MESSAGE_RTR;
+            else return false;
+            break;
+        case 'd':
+            //1.x: Warng and Error lines are bus events
+            if(te-tok!=2||(tok[0]!='R'&&tok[0]!='T')||tok[1]!='x')
+                return false;
+            break;
+        case 'I':
+            if(!parse_hex(tok,te,v))
+                return false;
+            frame.msg.ID=v;
+            if(te-tok>4)
+                type|=PCAN_MESSAGE_EXTENDED;
+            break;
+        case 'l':
+            if(!parse_dec(tok,te,v)||v>15)
+                return false;
+            frame.msg.DLC=uchar(v);
+            len=can_dlc_to_len(uchar(v));
+            if(!(type&PCAN_MESSAGE_FD)&&len>8)
+                len=8;
+            break;
+        case 'L':
+            if(!parse_dec(tok,te,v)||v>64)
+                return false;
+            frame.msg.DLC=can_len_to_dlc(int(v));
+            len=int(v);
+            break;
+        case 'D':
+            if(te-tok==3&&memcmp(tok,"RTR",3)==0){
+                type|=PCAN_MESSAGE_RTR;
+                break;
+            }
+            for(int i=0;i<len;i++){
+                if(i&&!next_token(p,end,tok,te))
+                    return false;
+                if(!parse_byte(tok,te,false,frame.msg.DATA[i]))
+                    return false;
+            }
+            break;
+        default:    //N, B, R
+            break;
+        }
+    }
+    frame.msg.MSGTYPE=type;
+    return true;
+}
+
+static bool parse_candump_line(const char *p, const char *end, canFrame &frame)
+{
+    while(p<end&&is_space(*p))
+        p++;
+    qint64 ts=0;
+    if(p<end&&*p=='('){
+        const char *close=static_cast<const char*>(memchr(p,')',size_t(end-p)));
+        if(!close||!parse_fixed(p+1,close,6,ts))
+            return false;
+        p=close+1;
+    }
+    frame.ts_us=TPCANTimestampFD(ts);
+
+    const char *tok,*te;
+    if(!next_token(p,end,tok,te))   //interface
+        return false;
+    if(!next_token(p,end,tok,te))
+        return false;
+
+    TPCANMessageType type=PCAN_MESSAGE_STANDARD;
+    quint32 id;
+    int len=0;
+    const char *hash=static_cast<const char*>(memchr(tok,'#',size_t(te-tok)));
+    if(hash){
+        //log format: ID#data, ID##<flags>data (FD), ID#R<dlc> (remote)
+        if(!parse_hex(tok,hash,id))
+            return false;
+        const char *d=hash+1;
+        if(d<te&&*d=='#'){
+            const int flags=d+1<te?hex_digit(d[1]):-1;
+            if(flags<0)
+                return false;
+            type|=PCAN_MESSAGE_FD;
+            if(flags&1) type|=PCAN_MESSAGE_BRS;
+            if(flags&2) type|=PCAN_MESSAGE_ESI;
+            d+=2;
+        }
+        else if(d<te&&(*d=='R'||*d=='r')){
+            type|=PCAN_MESSAGE_RTR;
+            const int dlc=d+1<te?hex_digit(d[1]):0;
+            frame.msg.DLC=uchar(qMax(dlc,0));
+            d=te;
+        }
+        while(d<te&&len<64){
+            if(*d=='.'){
+                d++;
+                continue;
+            }
+            //classic frame with a DLC above 8: data_<dlc>
+            if(*d=='_'){
+                const int dlc=d+1<te?hex_digit(d[1]):-1;
+                if(dlc<9)
+                    return false;
+                frame.msg.DLC=uchar(dlc);
+                len=-1;
+                break;
+            }
+            if(te-d<2||!parse_byte(d,d+2,false,frame.msg.DATA[len]))
+                return false;
+            len++;
+            d+=2;
+        }
+        if(len>=0&&!(type&PCAN_MESSAGE_RTR))
+            frame.msg.DLC=can_len_to_dlc(len);
+        //extended IDs are printed with 8 digits
+        if(hash-tok>3)
+            type|=PCAN_MESSAGE_EXTENDED;
+    }
+    else{
+        //screen format: ID [len] data, or "remote request"
+        if(!parse_hex(tok,te,id))
+            return false;
+        if(te-tok>3)
+            type|=PCAN_MESSAGE_EXTENDED;
+        const char *ltok,*lte;
+        quint32 n;
+        if(!next_token(p,end,ltok,lte)||lte-ltok<3||*ltok!='['||lte[-1]!=']'||!parse_dec(ltok+1,lte-1,n)||n>64)
+            return false;
+        if(!next_token(p,end,tok,te))
+            tok=te=end;
+        if(te-tok==6&&memcmp(tok,"remote",6)==0){
+            type|=PCAN_MESSAGE_RTR;
+            frame.msg.DLC=uchar(qMin(n,15u));
+        }
+        else{
+            for(len=0;len<int(n);len++){
+                if(len&&!next_token(p,end,tok,te))
+                    return false;
+                if(!parse_byte(tok,te,false,frame.msg.DATA[len]))
+                    return false;
+            }
+            frame.msg.DLC=can_len_to_dlc(len);
+            if(len>8)
+                type|=PCAN_MESSAGE_FD;
+        }
+    }
+    //error frames carry CAN_ERR_FLAG in the ID
+    if(id&0xE0000000u)
+        return false;
+    frame.msg.ID=id;
+    frame.msg.MSGTYPE=type;
+    return true;
+}
+
+static bool parse_asc_id(const char *tok, const char *te, const traceLayout &layout, quint32 &id, TPCANMessageType &type)
+{
+    if(te>tok&&(te[-1]=='x'||te[-1]=='X')){
+        te--;
+        type|=PCAN_MESSAGE_EXTENDED;
+    }
+    return layout.asc_dec?parse_dec(tok,te,id):parse_hex(tok,te,id);
+}
+
+//has_ts is set for every line that starts with a timestamp, relative
+//timestamps count on event lines too
+static bool parse_asc_line(const char *p, const char *end, const traceLayout &layout, canFrame &frame, bool &has_ts)
+{
+    const char *tok,*te;
+    qint64 ts;
+    has_ts=false;
+    if(!next_token(p,end,tok,te)||!parse_fixed(tok,te,6,ts))
+        return false;
+    has_ts=true;
+    frame.ts_us=TPCANTimestampFD(ts);
+
+    TPCANMessageType type=PCAN_MESSAGE_STANDARD;
+    quint32 v;
+    int len=0;
+    if(!next_token(p,end,tok,te))
+        return false;
+
+    if(te-tok==5&&memcmp(tok,"CANFD",5)==0){
+        //CANFD <ch> <dir> <id> [name] <brs> <esi> <dlc> <len> <data>
+        if(!next_token(p,end,tok,te)||!parse_dec(tok,te,v))
+            return false;
+        if(!next_token(p,end,tok,te)||te-tok!=2||tok[1]!='x'||(tok[0]!='R'&&tok[0]!='T'))
+            return false;
+        if(!next_token(p,end,tok,te)||!parse_asc_id(tok,te,layout,frame.msg.ID,type))
+            return false;
+        if(!next_token(p,end,tok,te))
+            return false;
+        //the symbolic name is optional, BRS is a single 0/1
+        if(te-tok!=1&&!next_token(p,end,tok,te))
+            return false;
+        if(te-tok!=1)
+            return false;
+        const bool brs=*tok=='1';
+        if(!next_token(p,end,tok,te)||te-tok!=1)
+            return false;
+        const bool esi=*tok=='1';
+        if(!next_token(p,end,tok,te)||!parse_hex(tok,te,v)||v>15)
+            return false;
+        const uchar dlc=uchar(v);
+        if(!next_token(p,end,tok,te)||!parse_dec(tok,te,v)||v>64)
+            return false;
+        len=int(v);
+        //a data length below 9 with DLC <= 8 is a classic frame on an FD channel
+        if(dlc>8||brs||esi)
+            type|=PCAN_MESSAGE_FD;
+        if(brs) type|=PCAN_MESSAGE_BRS;
+        if(esi) type|=PCAN_MESSAGE_ESI;
+        frame.msg.DLC=dlc;
+    }
+    else{
+        //<ch> <id> <dir> d <dlc> <data> or <ch> <id> <dir> r [dlc]
+        if(!parse_dec(tok,te,v))
+            return false;
+        if(!next_token(p,end,tok,te)||!parse_asc_id(tok,te,layout,frame.msg.ID,type))
+            return false;
+        if(!next_token(p,end,tok,te)||te-tok!=2||tok[1]!='x'||(tok[0]!='R'&&tok[0]!='T'))
+            return false;
+        if(!next_token(p,end,tok,te)||te-tok!=1)
+            return false;
+        if(*tok=='r'){
+            type|=PCAN_MESSAGE_RTR;
+            frame.msg.DLC=(next_token(p,end,tok,te)&&parse_hex(tok,te,v)&&v<=8)?uchar(v):0;
+        }
+        else if(*tok=='d'){
+            if(!next_token(p,end,tok,te)||!parse_hex(tok,te,v)||v>15)
+                return false;
+            frame.msg.DLC=uchar(v);
+            len=qMin(int(v),8);
+        }
+        else
+            return false;
+    }
+
+    for(int i=0;i<len;i++){
+        if(!next_token(p,end,tok,te)||!parse_byte(tok,te,layout.asc_dec,frame.msg.DATA[i]))
+            return false;
+    }
+    frame.msg.MSGTYPE=type;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// chunks
+//----------------------------------------------------------------------------
+struct chunkResult{
+    size_t frames=0;
+    quint64 lines=0;
+    quint64 skipped=0;
+    qint64 ts_sum=0;        //relative ASC timestamps: all deltas of the chunk
+};
+
+//lines of a chunk, the last one may lack its newline; every frame is a
+//line, so this is the room the chunk's frames need
+static quint64 count_lines(const char *p, const char *end)
+{
+    quint64 n=0;
+    while(p<end){
+        const char *eol=static_cast<const char*>(memchr(p,'\n',size_t(end-p)));
+        n++;
+        if(!eol)
+            break;
+        p=eol+1;
+    }
+    return n;
+}
+
+//writes the frames to dst, which has room for every line of the chunk
+static void parse_chunk(const char *p, const char *end, const traceLayout &layout, canFrame *dst, chunkResult &out)
+{
+    canFrame frame;
+    while(p<end){
+        const char *eol=static_cast<const char*>(memchr(p,'\n',size_t(end-p)));
+        if(!eol)
+            eol=end;
+        out.lines++;
+
+        frame.msg=TPCANMsgFD();
+        bool ok=false;
+        bool has_ts=false;
+        switch(layout.format){
+        case TRACE_PCAN_TRC: ok=parse_trc_line(p,eol,layout,frame); break;
+        case TRACE_CANDUMP: ok=parse_candump_line(p,eol,frame); break;
+        case TRACE_VECTOR_ASC: ok=parse_asc_line(p,eol,layout,frame,has_ts); break;
+        default: break;
+        }
+        if(layout.asc_relative&&has_ts){
+            out.ts_sum+=qint64(frame.ts_us);
+            frame.ts_us=TPCANTimestampFD(out.ts_sum);
+        }
+        if(ok)
+            dst[out.frames++]=frame;
+        else
+            out.skipped++;
+        p=eol+1;
+    }
+}
+
+//fn(i) for i in [0,n), items handed out in order to the calling thread
+//and threads-1 helpers
+static void run_parallel(int threads, int n, const std::function<void(int)> &fn)
+{
+    std::atomic<int> next(0);
+    auto work=[&](){
+        for(int i=next++;i<n;i=next++)
+            fn(i);
+    };
+    std::vector<QThread*> helpers;
+    for(int t=1;t<qMin(threads,n);t++){
+        QThread *helper=QThread::create(work);
+        helper->start();
+        helpers.push_back(helper);
+    }
+    work();
+    for(QThread *helper : helpers){
+        helper->wait();
+        delete helper;
+    }
+}
+
+//----------------------------------------------------------------------------
+// TraceImporter
+//----------------------------------------------------------------------------
+TraceImporter::TraceImporter(QObject *parent)
+    : QThread(parent)
+{
+    qRegisterMetaType<traceImportStats>("traceImportStats");
+}
+
+TraceImporter::~TraceImporter()
+{
+    wait();
+}
+
+void TraceImporter::import(const QString &file_path)
+{
+    if(isRunning())
+        return;
+    {
+        QMutexLocker lock(&mutex);
+        path=file_path;
+    }
+    start(QThread::LowPriority);
+}
+
+std::vector<canFrame> TraceImporter::take_frames()
+{
+    QMutexLocker lock(&mutex);
+    std::vector<canFrame> out;
+    out.swap(frames);
+    return out;
+}
+
+bool TraceImporter::parse(const char *data, qint64 size, std::vector<canFrame> &frames,
+                          traceImportStats &stats, QString &error, int threads)
+{
+    const qint64 t0=host_monotonic_us();
+    stats=traceImportStats();
+    stats.bytes=size;
+    frames.clear();
+    if(size<=0){
+        error=QObject::tr("empty file");
+        return false;
+    }
+
+    traceLayout layout;
+    if(!scan_layout(data,size,layout,error))
+        return false;
+    stats.format=layout.format;
+    stats.start_ms=layout.start_ms;
+
+    //a few chunks per thread evens out lines of different length
+    if(threads<=0)
+        threads=qMax(1,QThread::idealThreadCount());
+    const int n_chunks=int(qBound<qint64>(1,size/TRACE_MIN_CHUNK,qint64(threads)*4));
+    std::vector<const char*> bounds(size_t(n_chunks)+1);
+    bounds[0]=data;
+    for(int i=1;i<n_chunks;i++){
+        const char *p=qMax(bounds[size_t(i)-1],data+size/n_chunks*i);
+        const char *eol=static_cast<const char*>(memchr(p,'\n',size_t(data+size-p)));
+        bounds[size_t(i)]=eol?eol+1:data+size;
+    }
+    bounds[size_t(n_chunks)]=data+size;
+
+    //first pass: lines per chunk, which places every chunk in the output;
+    //the frames are then parsed straight into it, with no copy per chunk
+    std::vector<quint64> lines(size_t(n_chunks),0);
+    run_parallel(threads,n_chunks,[&](int i){
+        lines[size_t(i)]=count_lines(bounds[size_t(i)],bounds[size_t(i)+1]);
+    });
+    std::vector<size_t> room(size_t(n_chunks)+1,0);
+    for(int i=0;i<n_chunks;i++)
+        room[size_t(i)+1]=room[size_t(i)]+size_t(lines[size_t(i)]);
+    frames.resize(room.back());
+
+    std::vector<chunkResult> chunks(static_cast<size_t>(n_chunks));
+    run_parallel(threads,n_chunks,[&](int i){
+        parse_chunk(bounds[size_t(i)],bounds[size_t(i)+1],layout,frames.data()+room[size_t(i)],chunks[size_t(i)]);
+    });
+
+    //skipped lines (headers, comments, events) leave gaps at the chunk
+    //ends, the chunks move down in order to close them
+    std::vector<size_t> offsets(size_t(n_chunks)+1,0);
+    std::vector<qint64> ts_base(size_t(n_chunks),0);
+    for(int i=0;i<n_chunks;i++){
+        const chunkResult &chunk=chunks[size_t(i)];
+        offsets[size_t(i)+1]=offsets[size_t(i)]+chunk.frames;
+        if(offsets[size_t(i)]!=room[size_t(i)])
+            std::move(frames.begin()+qint64(room[size_t(i)]),frames.begin()+qint64(room[size_t(i)]+chunk.frames),
+                      frames.begin()+qint64(offsets[size_t(i)]));
+        if(i+1<n_chunks)
+            ts_base[size_t(i)+1]=ts_base[size_t(i)]+chunk.ts_sum;
+        stats.lines+=chunk.lines;
+        stats.skipped+=chunk.skipped;
+    }
+    frames.resize(offsets.back());
+
+    //candump stamps are wall clock, the trace starts at the first frame
+    qint64 shift=0;
+    if(layout.format==TRACE_CANDUMP&&!frames.empty()){
+        shift=-qint64(frames.front().ts_us);
+        stats.start_ms=-shift/1000;
+    }
+
+    run_parallel(threads,n_chunks,[&](int i){
+        const qint64 add=shift+ts_base[size_t(i)];
+        canFrame *frame=frames.data()+offsets[size_t(i)];
+        canFrame *last=frames.data()+offsets[size_t(i)+1];
+        for(;frame<last;frame++){
+            frame->ts_us=TPCANTimestampFD(qint64(frame->ts_us)+add);
+            frame->host_us=qint64(frame->ts_us);
+        }
+    });
+
+    stats.frames=frames.size();
+    stats.threads=qMin(threads,n_chunks);
+    stats.elapsed_us=host_monotonic_us()-t0;
+    return true;
+}
+
+void TraceImporter::run()
+{
+    QString file_path;
+    {
+        QMutexLocker lock(&mutex);
+        file_path=path;
+    }
+
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly)){
+        emit failed(tr("%1: %2").arg(file_path,file.errorString()));
+        return;
+    }
+    //the pages are read by the parser threads straight from the page cache
+    const qint64 size=file.size();
+    uchar *data=size?file.map(0,size):nullptr;
+    if(size&&!data){
+        emit failed(tr("%1: %2").arg(file_path,file.errorString()));
+        return;
+    }
+
+    std::vector<canFrame> parsed;
+    traceImportStats stats;
+    QString error;
+    const bool ok=parse(reinterpret_cast<const char*>(data),size,parsed,stats,error);
+    if(data)
+        file.unmap(data);
+    if(!ok){
+        emit failed(tr("%1: %2").arg(file_path,error));
+        return;
+    }
+
+    {
+        QMutexLocker lock(&mutex);
+        frames.swap(parsed);
+    }
+    emit imported(stats);
+}
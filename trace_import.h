@@ -0,0 +1,66 @@
+#ifndef TRACE_IMPORT_H
+#define TRACE_IMPORT_H
+
+#include "can_transport.h"
+#include <QThread>
+#include <QMutex>
+#include <QMetaType>
+#include <vector>
+
+enum traceFormat{
+    TRACE_UNKNOWN=0,
+    TRACE_PCAN_TRC,     //PCAN-View .trc, file versions 1.0 .. 2.1
+    TRACE_CANDUMP,      //candump -l log and candump screen output
+    TRACE_VECTOR_ASC    //Vector ASCII log, classic and CANFD lines
+};
+
+struct traceImportStats{
+    traceFormat format=TRACE_UNKNOWN;
+    qint64 bytes=0;
+    quint64 lines=0;
+    quint64 frames=0;
+    quint64 skipped=0;      //lines that are not a data frame (events, errors, comments)
+    qint64 start_ms=0;      //UTC of the trace start from the header, 0 when unknown
+    qint64 elapsed_us=0;
+    int threads=0;
+    double mb_per_s() const {return elapsed_us?bytes/double(elapsed_us):0;}
+};
+Q_DECLARE_METATYPE(traceImportStats)
+
+const char *trace_format_name(traceFormat format);
+
+//the file is memory mapped, split into chunks at line boundaries and the
+//chunks are parsed on all cores; numbers are parsed in place, without
+//QString or locale conversions. Frames come out in file order with ts_us
+//relative to the trace start and host_us equal to ts_us
+class TraceImporter : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit TraceImporter(QObject *parent = nullptr);
+    ~TraceImporter() override;
+
+    //imports in the background, imported() or failed() when done
+    void import(const QString &path);
+    //frames of the last import, the importer keeps none
+    std::vector<canFrame> take_frames();
+
+    //synchronous import of a buffer, threads 0 = one per core
+    static bool parse(const char *data, qint64 size, std::vector<canFrame> &frames,
+                      traceImportStats &stats, QString &error, int threads=0);
+
+signals:
+    void imported(const traceImportStats &stats);
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    QMutex mutex;
+    QString path;
+    std::vector<canFrame> frames;
+};
+
+#endif // TRACE_IMPORT_H
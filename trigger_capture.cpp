@@ -0,0 +1,455 @@
+#include "trigger_capture.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QStringList>
+#include <climits>
+#include <cmath>
+
+#define TRIGGER_CHUNK_FRAMES    4096
+//dumps waiting for the writer before new ones are dropped
+#define TRIGGER_MAX_PENDING     4
+//every n-th evaluation is timed, a clock read per frame would cost more
+//than the rules themselves
+#define TRIGGER_EVAL_SAMPLE     256
+
+static const char *const trigger_field_names[TRIGGER_FIELD_COUNT]={
+    "acc.x","acc.y","acc.z",
+    "gyr.x","gyr.y","gyr.z",
+    "eul.x","eul.y","eul.z",
+    "quat.w","quat.x","quat.y","quat.z",
+    "prs",
+    "|acc|",
+    "|gyr|"
+};
+
+static inline float trigger_field_value(const imuData &imu, int field)
+{
+    switch(field){
+    case TRIGGER_ACC_X: case TRIGGER_ACC_Y: case TRIGGER_ACC_Z:
+        return imu.acc[field-TRIGGER_ACC_X];
+    case TRIGGER_GYR_X: case TRIGGER_GYR_Y: case TRIGGER_GYR_Z:
+        return imu.gyr[field-TRIGGER_GYR_X];
+    case TRIGGER_EUL_X: case TRIGGER_EUL_Y: case TRIGGER_EUL_Z:
+        return imu.eul[field-TRIGGER_EUL_X];
+    case TRIGGER_QUAT_W: case TRIGGER_QUAT_X: case TRIGGER_QUAT_Y: case TRIGGER_QUAT_Z:
+        return imu.quat[field-TRIGGER_QUAT_W];
+    case TRIGGER_PRS:
+        return imu.prs;
+    case TRIGGER_ACC_NORM:
+        return std::sqrt(imu.acc[0]*imu.acc[0]+imu.acc[1]*imu.acc[1]+imu.acc[2]*imu.acc[2]);
+    case TRIGGER_GYR_NORM:
+        return std::sqrt(imu.gyr[0]*imu.gyr[0]+imu.gyr[1]*imu.gyr[1]+imu.gyr[2]*imu.gyr[2]);
+    default:
+        return 0;
+    }
+}
+
+//<value>[/<mask>], decimal or 0x hex
+static bool parse_masked(const QString &text, quint32 &value, quint32 &mask)
+{
+    const int slash=text.indexOf('/');
+    bool ok=false, ok_mask=true;
+    value=text.left(slash<0?text.size():slash).toUInt(&ok,0);
+    if(slash>=0)
+        mask=text.mid(slash+1).toUInt(&ok_mask,0);
+    return ok&&ok_mask;
+}
+
+bool trigger_parse(const QString &text, triggerConfig &config, QString &error)
+{
+    config=triggerConfig();
+    const QStringList lines=text.split('\n');
+    for(int n=0;n<lines.size();n++){
+        QString line=lines.at(n);
+        const int comment=line.indexOf('#');
+        if(comment>=0)
+            line.truncate(comment);
+        line=line.simplified();
+        if(line.isEmpty())
+            continue;
+
+        const QStringList t=line.split(' ');
+        const QString key=t.at(0).toLower();
+        triggerRule rule;
+        rule.text=line;
+        bool ok=true;
+
+        if(key=="pre"||key=="post"||key=="holdoff"||key=="memory"){
+            const double v=t.size()==2?t.at(1).toDouble(&ok):-1;
+            ok&=v>=0;
+            if(ok){
+                if(key=="pre")
+                    config.pre_ms=int(v*1000);
+                else if(key=="post")
+                    config.post_ms=int(v*1000);
+                else if(key=="holdoff")
+                    config.holdoff_ms=int(v*1000);
+                else
+                    config.max_frames=int(qMin(v*1048576.0/sizeof(canFrame),double(INT_MAX)));
+            }
+            if(ok)
+                continue;
+        }
+        else if(key=="bus_error"){
+            rule.kind=TRIGGER_BUS_ERROR;
+            ok=t.size()==1;
+        }
+        else if(key=="id"){
+            //id <id>[/<mask>] [b<n>=<value>[/<mask>]]
+            rule.kind=TRIGGER_FRAME;
+            ok=t.size()==2||t.size()==3;
+            if(ok)
+                ok=parse_masked(t.at(1),rule.id,rule.id_mask);
+            rule.id&=rule.id_mask;
+            if(ok&&t.size()==3){
+                const QString &b=t.at(2);
+                const int eq=b.indexOf('=');
+                quint32 value=0, mask=0xFF;
+                ok=b.startsWith('b')&&eq>1;
+                if(ok)
+                    rule.byte=b.mid(1,eq-1).toInt(&ok);
+                if(ok)
+                    ok=parse_masked(b.mid(eq+1),value,mask)&&rule.byte<64&&value<=0xFF&&mask<=0xFF;
+                rule.value_mask=uchar(mask);
+                rule.value=uchar(value&mask);
+            }
+        }
+        else{
+            //<field> <|> <threshold>
+            rule.kind=TRIGGER_IMU;
+            rule.field=-1;
+            for(int f=0;f<TRIGGER_FIELD_COUNT;f++){
+                if(key==trigger_field_names[f])
+                    rule.field=f;
+            }
+            ok=rule.field>=0&&t.size()==3;
+            if(ok){
+                const QString &op=t.at(1);
+                ok=op==">"||op==">="||op=="<"||op=="<=";
+                rule.above=op.startsWith('>');
+            }
+            if(ok)
+                rule.threshold=t.at(2).toFloat(&ok);
+        }
+
+        if(!ok){
+            error=QObject::tr("line %1: %2").arg(n+1).arg(lines.at(n).trimmed());
+            return false;
+        }
+        config.rules.append(rule);
+    }
+    if(config.rules.isEmpty()){
+        error=QObject::tr("no trigger rules");
+        return false;
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// FrameRing
+//----------------------------------------------------------------------------
+FrameRing::FrameRing()
+{
+    configure(0,0);
+}
+
+void FrameRing::configure(qint64 keep, int frames)
+{
+    clear();
+    keep_us=keep;
+    //at least two chunks, trimming drops whole chunks
+    max_frames=quint64(qMax(frames,2*TRIGGER_CHUNK_FRAMES));
+    chunks.reserve(size_t(qMin<quint64>(max_frames/TRIGGER_CHUNK_FRAMES+2,1024)));
+}
+
+void FrameRing::clear()
+{
+    chunks.clear();
+    current.reset();
+    n_frames=0;
+}
+
+void FrameRing::push(const canFrame &frame)
+{
+    if(!current){
+        if(spare.empty()){
+            current=std::make_shared<std::vector<canFrame>>();
+            current->reserve(TRIGGER_CHUNK_FRAMES);
+        }
+        else{
+            current=std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    current->push_back(frame);
+    n_frames++;
+    if(current->size()>=TRIGGER_CHUNK_FRAMES){
+        seal();
+        trim();
+    }
+}
+
+void FrameRing::seal()
+{
+    if(current&&!current->empty())
+        chunks.push_back(std::move(current));
+    current.reset();
+}
+
+void FrameRing::trim()
+{
+    if(chunks.empty())
+        return;
+    const qint64 newest_us=chunks.back()->back().host_us;
+    while(!chunks.empty()){
+        chunk &oldest=chunks.front();
+        if(n_frames<=max_frames&&oldest->back().host_us>=newest_us-keep_us)
+            break;
+        n_frames-=oldest->size();
+        //chunks still referenced by a dump are left to it
+        if(oldest.use_count()==1&&spare.size()<2){
+            oldest->clear();
+            spare.push_back(std::move(oldest));
+        }
+        chunks.erase(chunks.begin());
+    }
+}
+
+qint64 FrameRing::memory_bytes() const
+{
+    const size_t n=chunks.size()+spare.size()+(current?1:0);
+    return qint64(n*TRIGGER_CHUNK_FRAMES*sizeof(canFrame));
+}
+
+void FrameRing::collect(qint64 from_us, std::vector<chunk> &out)
+{
+    seal();
+    for(const chunk &c : chunks){
+        if(c->back().host_us>=from_us)
+            out.push_back(c);
+    }
+}
+
+//----------------------------------------------------------------------------
+// TriggerCapture
+//----------------------------------------------------------------------------
+TriggerCapture::TriggerCapture(QObject *parent)
+    : QThread(parent)
+{
+}
+
+TriggerCapture::~TriggerCapture()
+{
+    disarm();
+}
+
+bool TriggerCapture::arm(const triggerConfig &cfg, const QString &path)
+{
+    disarm();
+    if(!QDir(path).exists()){
+        m_error=tr("%1 does not exist").arg(path);
+        return false;
+    }
+    config=cfg;
+    dir=path;
+    active.fill(false,config.rules.size());
+    ring.configure(qint64(config.pre_ms+config.post_ms)*1000,config.max_frames);
+    counters=triggerStats();
+    dump_open=false;
+    have_fired=false;
+    {
+        QMutexLocker lock(&mutex);
+        n_dumps=0;
+        n_dump_frames=0;
+        quit=false;
+    }
+    m_error.clear();
+    armed=true;
+    start(QThread::LowPriority);
+    return true;
+}
+
+void TriggerCapture::disarm()
+{
+    if(!armed)
+        return;
+    armed=false;
+    //a trigger still in its post window is written with what has arrived
+    if(dump_open)
+        finish_dump();
+    {
+        QMutexLocker lock(&mutex);
+        quit=true;
+        wake.wakeAll();
+    }
+    wait();
+    ring.clear();
+}
+
+int TriggerCapture::evaluate(const canFrame &frame, const imuData &imu)
+{
+    const TPCANMsgFD &msg=frame.msg;
+    int hit=-1;
+    for(int i=0;i<config.rules.size();i++){
+        const triggerRule &r=config.rules.at(i);
+        if(r.kind==TRIGGER_IMU){
+            //levels fire on the edge, not on every frame above the threshold
+            const float v=trigger_field_value(imu,r.field);
+            const bool on=r.above?v>r.threshold:v<r.threshold;
+            if(on&&!active.at(i)&&hit<0)
+                hit=i;
+            active[i]=on;
+        }
+        else if(r.kind==TRIGGER_FRAME){
+            if((msg.ID&r.id_mask)!=r.id)
+                continue;
+            if(r.byte>=0&&(r.byte>=can_dlc_to_len(msg.DLC)||(msg.DATA[r.byte]&r.value_mask)!=r.value))
+                continue;
+            if(hit<0)
+                hit=i;
+        }
+    }
+    return hit;
+}
+
+bool TriggerCapture::process(const canFrame &frame, const imuData &imu)
+{
+    ring.push(frame);
+    counters.frames++;
+
+    int hit;
+    if((counters.frames&(TRIGGER_EVAL_SAMPLE-1))==0){
+        QElapsedTimer timer;
+        timer.start();
+        hit=evaluate(frame,imu);
+        counters.eval_ns+=timer.nsecsElapsed();
+        counters.eval_samples++;
+    }
+    else{
+        hit=evaluate(frame,imu);
+    }
+
+    if(dump_open&&frame.host_us>=trigger_us+qint64(config.post_ms)*1000)
+        finish_dump();
+    if(hit<0)
+        return false;
+    fire(hit,frame.host_us);
+    return true;
+}
+
+bool TriggerCapture::process_error(const canFrame &frame)
+{
+    ring.push(frame);
+    counters.frames++;
+    if(dump_open&&frame.host_us>=trigger_us+qint64(config.post_ms)*1000)
+        finish_dump();
+    for(int i=0;i<config.rules.size();i++){
+        if(config.rules.at(i).kind==TRIGGER_BUS_ERROR){
+            fire(i,frame.host_us);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TriggerCapture::fire(int rule, qint64 host_us)
+{
+    counters.triggers++;
+    //one dump at a time, triggers inside its window or the hold-off are only counted
+    if(dump_open||(have_fired&&host_us-last_fire_us<qint64(config.holdoff_ms)*1000)){
+        counters.suppressed++;
+        return;
+    }
+    have_fired=true;
+    last_fire_us=host_us;
+    dump_open=true;
+    dump_rule=rule;
+    trigger_us=host_us;
+    trigger_wall_ms=QDateTime::currentMSecsSinceEpoch();
+    if(config.post_ms==0)
+        finish_dump();
+}
+
+void TriggerCapture::finish_dump()
+{
+    dump_open=false;
+    dumpJob job;
+    job.from_us=trigger_us-qint64(config.pre_ms)*1000;
+    job.to_us=trigger_us+qint64(config.post_ms)*1000;
+    job.wall_ms=trigger_wall_ms;
+    job.rule=config.rules.at(dump_rule).text;
+    //the chunks are shared, not copied
+    ring.collect(job.from_us,job.chunks);
+
+    QMutexLocker lock(&mutex);
+    if(pending.size()>=TRIGGER_MAX_PENDING){
+        counters.dropped_dumps++;
+        return;
+    }
+    pending.push_back(std::move(job));
+    wake.wakeOne();
+}
+
+triggerStats TriggerCapture::stats()
+{
+    triggerStats st=counters;
+    st.ring_frames=ring.size();
+    QMutexLocker lock(&mutex);
+    st.dumps=n_dumps;
+    st.dump_frames=n_dump_frames;
+    return st;
+}
+
+void TriggerCapture::run()
+{
+    QMutexLocker lock(&mutex);
+    for(;;){
+        if(pending.empty()){
+            if(quit)
+                break;
+            wake.wait(&mutex);
+            continue;
+        }
+        dumpJob job=std::move(pending.front());
+        pending.pop_front();
+        lock.unlock();
+        write_dump(job);
+        job.chunks.clear();
+        lock.relock();
+    }
+}
+
+void TriggerCapture::write_dump(const dumpJob &job)
+{
+    std::vector<canFrame> frames;
+    for(const FrameRing::chunk &c : job.chunks){
+        for(const canFrame &f : *c){
+            if(f.host_us>=job.from_us&&f.host_us<=job.to_us)
+                frames.push_back(f);
+        }
+    }
+
+    const QString path=QDir(dir).filePath(QString("trigger_%1.pqc")
+                                          .arg(QDateTime::fromMSecsSinceEpoch(job.wall_ms).toString("yyyyMMdd_HHmmss_zzz")));
+    QFile file(path);
+    captureStats st;
+    bool ok=file.open(QIODevice::WriteOnly|QIODevice::Truncate)&&capture_write_header(file);
+    for(size_t i=0;ok&&i<frames.size();i+=CAPTURE_BLOCK_FRAMES){
+        const int n=int(qMin(frames.size()-i,size_t(CAPTURE_BLOCK_FRAMES)));
+        ok=capture_write_block(file,frames.data()+i,n,1,st);
+    }
+    if(!ok){
+        emit failed(tr("Trigger dump %1: %2").arg(path).arg(file.errorString()));
+        return;
+    }
+    file.close();
+
+    {
+        QMutexLocker lock(&mutex);
+        n_dumps++;
+        n_dump_frames+=frames.size();
+    }
+    emit dumped(path,int(frames.size()),job.rule);
+}
@@ -0,0 +1,181 @@
+#ifndef TRIGGER_CAPTURE_H
+#define TRIGGER_CAPTURE_H
+
+#include "capture_writer.h"
+#include "imu_packing.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <deque>
+#include <memory>
+
+enum triggerKind{
+    TRIGGER_IMU=0,      //a decoded imuData field crosses a threshold
+    TRIGGER_FRAME,      //a frame matches an ID and optionally one data byte
+    TRIGGER_BUS_ERROR   //an error frame from the controller
+};
+
+//imuData fields a rule can watch, the norms are over the three axes
+enum triggerField{
+    TRIGGER_ACC_X=0, TRIGGER_ACC_Y, TRIGGER_ACC_Z,
+    TRIGGER_GYR_X, TRIGGER_GYR_Y, TRIGGER_GYR_Z,
+    TRIGGER_EUL_X, TRIGGER_EUL_Y, TRIGGER_EUL_Z,
+    TRIGGER_QUAT_W, TRIGGER_QUAT_X, TRIGGER_QUAT_Y, TRIGGER_QUAT_Z,
+    TRIGGER_PRS,
+    TRIGGER_ACC_NORM,
+    TRIGGER_GYR_NORM,
+    TRIGGER_FIELD_COUNT
+};
+
+struct triggerRule{
+    int kind=TRIGGER_IMU;
+    QString text;           //the line it was parsed from
+    //TRIGGER_IMU, fires when the comparison becomes true
+    int field=TRIGGER_ACC_NORM;
+    bool above=true;
+    float threshold=0;
+    //TRIGGER_FRAME, fires on every match
+    quint32 id=0;
+    quint32 id_mask=0x1FFFFFFF;
+    int byte=-1;            //-1 for any payload
+    uchar value=0;
+    uchar value_mask=0xFF;
+};
+
+//rules and windows, parsed from text with one item per line:
+//  pre 5 | post 2 | holdoff 1     seconds
+//  memory 32                      MB of frames kept in the ring
+//  |acc| > 3.5  acc.z < -1.5      fields: acc gyr eul .x .y .z, quat .w-.z, prs
+//  id 0x708  id 0x180/0x780 b0=0x05/0x7F
+//  bus_error
+struct triggerConfig{
+    int pre_ms=5000;
+    int post_ms=2000;
+    int holdoff_ms=1000;
+    int max_frames=262144;
+    QVector<triggerRule> rules;
+};
+bool trigger_parse(const QString &text, triggerConfig &config, QString &error);
+
+struct triggerStats{
+    quint64 frames=0;
+    quint64 triggers=0;
+    quint64 suppressed=0;       //within the hold-off or an open post window
+    quint64 dumps=0;
+    quint64 dump_frames=0;
+    quint64 dropped_dumps=0;    //writer too far behind
+    quint64 ring_frames=0;
+    qint64 eval_ns=0;           //sampled rule evaluation time, clock read included
+    quint64 eval_samples=0;
+    double eval_ns_per_frame() const {return eval_samples?double(eval_ns)/eval_samples:0;}
+};
+
+
+//frames of the last seconds in chunks; full chunks are shared with the
+//dump writer by reference, so a trigger does not copy the window
+class FrameRing
+{
+public:
+    typedef std::shared_ptr<std::vector<canFrame>> chunk;
+
+    FrameRing();
+    void configure(qint64 keep_us, int max_frames);
+    void clear();
+
+    void push(const canFrame &frame);
+    //closes the chunk being filled and hands out every chunk that reaches
+    //from_us or later
+    void collect(qint64 from_us, std::vector<chunk> &out);
+    quint64 size() const {return n_frames;}
+    //chunks held, spares included [bytes]
+    qint64 memory_bytes() const;
+
+private:
+    void seal();
+    void trim();
+
+    //oldest first; a vector, so the steady state does not allocate
+    std::vector<chunk> chunks;
+    std::vector<chunk> spare;
+    chunk current;
+    quint64 n_frames=0;
+    qint64 keep_us=0;
+    quint64 max_frames=0;
+};
+
+
+//always-on ring of raw frames; when a rule fires, the frames from pre_ms
+//before to post_ms after the trigger are written to a .pqc capture on
+//the writer thread while acquisition goes on
+class TriggerCapture : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit TriggerCapture(QObject *parent = nullptr);
+    ~TriggerCapture() override;
+
+    //dumps go to dir/trigger_<time>.pqc
+    bool arm(const triggerConfig &config, const QString &dir);
+    void disarm();
+    bool is_armed() const {return armed;}
+    QString error() const {return m_error;}
+
+    //read loop, frames stamped; returns true when a rule fired
+    bool process(const canFrame &frame, const imuData &imu);
+    bool process_error(const canFrame &frame);
+    //rule evaluation only, -1 or the rule that fired
+    int evaluate(const canFrame &frame, const imuData &imu);
+
+    //from the thread that calls process()
+    triggerStats stats();
+    qint64 memory_bytes() const {return ring.memory_bytes();}
+
+signals:
+    void dumped(QString path, int frames, QString rule);
+    void failed(QString text);
+
+protected:
+    void run() override;
+
+private:
+    struct dumpJob{
+        std::vector<FrameRing::chunk> chunks;
+        qint64 from_us;
+        qint64 to_us;
+        qint64 wall_ms;
+        QString rule;
+    };
+
+    void fire(int rule, qint64 host_us);
+    void finish_dump();
+    void write_dump(const dumpJob &job);
+
+    triggerConfig config;
+    QVector<bool> active;
+    QString dir;
+    QString m_error;
+    bool armed=false;
+    FrameRing ring;
+
+    //trigger waiting for its post window
+    bool dump_open=false;
+    int dump_rule=-1;
+    qint64 trigger_us=0;
+    qint64 trigger_wall_ms=0;
+    qint64 last_fire_us=0;
+    bool have_fired=false;
+
+    //read loop side, only touched from the thread that calls process()
+    triggerStats counters;
+
+    QMutex mutex;
+    QWaitCondition wake;
+    std::deque<dumpJob> pending;
+    bool quit=false;
+    quint64 n_dumps=0;
+    quint64 n_dump_frames=0;
+};
+
+#endif // TRIGGER_CAPTURE_H
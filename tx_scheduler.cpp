@@ -0,0 +1,273 @@
+#include "tx_scheduler.h"
+#include "clock_sync.h"
+#include <QMutexLocker>
+
+//the last stretch before a periodic deadline is spun instead of slept, the
+//OS timer granularity is about 1 ms
+#define TX_SPIN_US              1500
+//PCAN_ERROR_QXMTFULL: retry this often for this long before dropping
+#define TX_RETRY_US             200
+#define TX_RETRY_MAX            50
+//frames sent per wake-up before periodic deadlines are checked again
+#define TX_BATCH                32
+
+TxScheduler::TxScheduler(CanTransport *can, QObject *parent)
+    : QThread(parent)
+    , can(can)
+{
+    qRegisterMetaType<TPCANMsgFD>("TPCANMsgFD");
+}
+
+TxScheduler::~TxScheduler()
+{
+    shutdown();
+}
+
+void TxScheduler::shutdown()
+{
+    {
+        QMutexLocker lock(&mutex);
+        quit=true;
+        wake.wakeAll();
+    }
+    wait();
+    QMutexLocker lock(&mutex);
+    quit=false;
+    for(auto &q : queues)
+        q.clear();
+}
+
+bool TxScheduler::enqueue(const TPCANMsgFD &msg, txPriority prio, quint32 tag)
+{
+    QMutexLocker lock(&mutex);
+    std::deque<queuedFrame> &q=queues[prio];
+    if(int(q.size())>=queue_limit){
+        m_stats.dropped++;
+        return false;
+    }
+    q.push_back({msg,tag});
+    wake.wakeOne();
+    return true;
+}
+
+bool TxScheduler::enqueue_batch(const std::vector<TPCANMsgFD> &msgs, txPriority prio)
+{
+    QMutexLocker lock(&mutex);
+    std::deque<queuedFrame> &q=queues[prio];
+    if(int(q.size()+msgs.size())>queue_limit){
+        m_stats.dropped+=msgs.size();
+        return false;
+    }
+    for(const TPCANMsgFD &msg : msgs)
+        q.push_back({msg,0});
+    wake.wakeOne();
+    return true;
+}
+
+int TxScheduler::add_periodic(const TPCANMsgFD &msg, quint32 period_us)
+{
+    QMutexLocker lock(&mutex);
+    periodicEntry entry;
+    entry.handle=next_handle++;
+    entry.msg=msg;
+    entry.period_us=qMax<quint32>(period_us,100);
+    entry.deadline_us=host_monotonic_us()+entry.period_us;
+    periodic.push_back(entry);
+    wake.wakeOne();
+    return entry.handle;
+}
+
+void TxScheduler::remove_periodic(int handle)
+{
+    QMutexLocker lock(&mutex);
+    for(size_t i=0;i<periodic.size();i++){
+        if(periodic[i].handle==handle){
+            periodic.erase(periodic.begin()+i);
+            break;
+        }
+    }
+}
+
+void TxScheduler::clear_periodic()
+{
+    QMutexLocker lock(&mutex);
+    periodic.clear();
+}
+
+void TxScheduler::set_paused(bool on)
+{
+    QMutexLocker lock(&mutex);
+    if(paused&&!on){
+        //restart the periodic schedule instead of catching up
+        const qint64 now=host_monotonic_us();
+        for(periodicEntry &p : periodic)
+            p.deadline_us=now+p.period_us;
+    }
+    paused=on;
+    wake.wakeAll();
+    while(on&&writing)
+        idle.wait(&mutex);
+}
+
+bool TxScheduler::is_paused()
+{
+    QMutexLocker lock(&mutex);
+    return paused;
+}
+
+void TxScheduler::set_rate_limit(DWORD id, quint32 min_interval_us)
+{
+    QMutexLocker lock(&mutex);
+    if(min_interval_us)
+        rate_limit_us[id]=min_interval_us;
+    else
+        rate_limit_us.remove(id);
+}
+
+txStats TxScheduler::stats()
+{
+    QMutexLocker lock(&mutex);
+    return m_stats;
+}
+
+//call with the mutex held: takes the first frame, by priority, whose ID is
+//not held back by its rate limit. Frames of a limited ID keep their order.
+bool TxScheduler::pop_ready(queuedFrame &frame, qint64 now_us, qint64 &next_allowed_us)
+{
+    next_allowed_us=0;
+    for(auto &q : queues){
+        for(auto it=q.begin();it!=q.end();++it){
+            auto limit=rate_limit_us.constFind(it->msg.ID);
+            if(limit!=rate_limit_us.constEnd()){
+                qint64 allowed=last_sent_us.value(it->msg.ID,0)+limit.value();
+                if(allowed>now_us){
+                    if(!next_allowed_us||allowed<next_allowed_us)
+                        next_allowed_us=allowed;
+                    //skip the rest of this ID, later frames must not overtake
+                    DWORD held=it->msg.ID;
+                    while(it+1!=q.end()&&(it+1)->msg.ID==held)
+                        ++it;
+                    continue;
+                }
+                last_sent_us[it->msg.ID]=now_us;
+            }
+            frame=*it;
+            q.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+//called without the mutex held
+bool TxScheduler::write_frame(const TPCANMsgFD &msg, quint32 tag)
+{
+    TPCANStatus result=PCAN_ERROR_OK;
+    int retries=0;
+    for(;;){
+        result=can->write(msg);
+        if(result!=PCAN_ERROR_QXMTFULL&&result!=PCAN_ERROR_XMTFULL)
+            break;
+        if(++retries>TX_RETRY_MAX)
+            break;
+        QThread::usleep(TX_RETRY_US);
+    }
+
+    QMutexLocker lock(&mutex);
+    m_stats.retries+=retries;
+    if(result!=PCAN_ERROR_OK){
+        m_stats.errors++;
+        lock.unlock();
+        char strMsg[256];
+        CAN_GetErrorText(result, 0, strMsg);
+        emit error(tr("TX 0x%1 failed: %2").arg(msg.ID,3,16,QLatin1Char('0')).arg(strMsg),tag);
+        return false;
+    }
+    m_stats.sent++;
+    lock.unlock();
+    emit sent(msg,host_monotonic_us(),tag);
+    return true;
+}
+
+//mutex held on entry and exit, released for the write
+void TxScheduler::write_unlocked(QMutexLocker &lock, const TPCANMsgFD &msg, quint32 tag)
+{
+    writing=true;
+    lock.unlock();
+    write_frame(msg,tag);
+    lock.relock();
+    writing=false;
+    idle.wakeAll();
+}
+
+void TxScheduler::wait_until(qint64 deadline_us)
+{
+    //mutex held on entry and exit
+    qint64 now=host_monotonic_us();
+    if(deadline_us-now>TX_SPIN_US){
+        wake.wait(&mutex,ulong((deadline_us-now-TX_SPIN_US)/1000));
+        return;
+    }
+    mutex.unlock();
+    while(host_monotonic_us()<deadline_us)
+        QThread::yieldCurrentThread();
+    mutex.lock();
+}
+
+void TxScheduler::run()
+{
+    QMutexLocker lock(&mutex);
+    while(!quit){
+        if(paused){
+            wake.wait(&mutex);
+            continue;
+        }
+        qint64 now=host_monotonic_us();
+
+        //periodic frames whose deadline has passed go first; they are taken
+        //out under the mutex, the list may change while one is written
+        due.clear();
+        for(periodicEntry &p : periodic){
+            if(p.deadline_us>now)
+                continue;
+            due.push_back(p.msg);
+            double late=double(now-p.deadline_us);
+            //absolute schedule, skip whole periods only after a stall
+            p.deadline_us+=p.period_us;
+            if(p.deadline_us<=now)
+                p.deadline_us=now+p.period_us;
+
+            m_stats.periodic_sent++;
+            jitter_sum_us+=late;
+            m_stats.jitter_avg_us=jitter_sum_us/m_stats.periodic_sent;
+            m_stats.jitter_max_us=qMax(m_stats.jitter_max_us,late);
+        }
+        for(const TPCANMsgFD &msg : due){
+            write_unlocked(lock,msg);
+            if(paused)
+                break;
+        }
+        now=host_monotonic_us();
+
+        //then a batch of queued frames
+        qint64 next_allowed=0;
+        int n=0;
+        queuedFrame frame;
+        while(!paused&&n<TX_BATCH&&pop_ready(frame,now,next_allowed)){
+            write_unlocked(lock,frame.msg,frame.tag);
+            n++;
+            now=host_monotonic_us();
+        }
+        if(n==TX_BATCH)
+            continue;
+
+        //sleep until the next periodic deadline, rate limit release or new frame
+        qint64 deadline=now+100000;
+        for(const periodicEntry &p : periodic)
+            deadline=qMin(deadline,p.deadline_us);
+        if(next_allowed)
+            deadline=qMin(deadline,next_allowed);
+        if(deadline>now)
+            wait_until(deadline);
+    }
+}
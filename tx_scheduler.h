@@ -0,0 +1,107 @@
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include "can_transport.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QMetaType>
+#include <deque>
+#include <vector>
+
+Q_DECLARE_METATYPE(TPCANMsgFD)
+
+//lower value goes first
+enum txPriority{
+    TX_PRIO_NMT=0,  //NMT, SYNC, heartbeat
+    TX_PRIO_SDO,    //SDO requests
+    TX_PRIO_USER,   //frames typed in by the user
+    TX_PRIO_COUNT
+};
+
+struct txStats{
+    quint64 sent=0;
+    quint64 retries=0;      //PCAN_ERROR_QXMTFULL retries
+    quint64 dropped=0;
+    quint64 errors=0;
+    quint64 periodic_sent=0;
+    double jitter_max_us=0; //periodic send time vs deadline
+    double jitter_avg_us=0;
+};
+
+//owns all writes to one channel: priority queues, per-ID rate limits and
+//periodic frames, sent from a dedicated thread so button handlers never
+//block on CAN_Write and a full transmit queue never reaches the UI
+class TxScheduler : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit TxScheduler(CanTransport *can, QObject *parent = nullptr);
+    ~TxScheduler() override;
+
+    //tag comes back with sent() or error(), 0 for frames nobody follows
+    bool enqueue(const TPCANMsgFD &msg, txPriority prio, quint32 tag=0);
+    bool enqueue_batch(const std::vector<TPCANMsgFD> &msgs, txPriority prio);
+
+    //periodic frames run at TX_PRIO_NMT on absolute deadlines (no drift)
+    int add_periodic(const TPCANMsgFD &msg, quint32 period_us);
+    void remove_periodic(int handle);
+    void clear_periodic();
+
+    //minimum interval between two frames with this ID, 0 removes the limit
+    void set_rate_limit(DWORD id, quint32 min_interval_us);
+
+    void set_queue_limit(int frames) {queue_limit=frames;}
+    //while paused queued frames are held and periodic frames are skipped,
+    //e.g. while the adapter is unplugged; pausing returns once a write in
+    //progress is done, so the channel can be reset right after
+    void set_paused(bool on);
+    bool is_paused();
+    void shutdown();
+    txStats stats();
+
+signals:
+    void sent(TPCANMsgFD msg, qint64 host_us, quint32 tag);
+    void error(QString text, quint32 tag);
+
+protected:
+    void run() override;
+
+private:
+    struct queuedFrame{
+        TPCANMsgFD msg;
+        quint32 tag;
+    };
+    struct periodicEntry{
+        int handle;
+        TPCANMsgFD msg;
+        quint32 period_us;
+        qint64 deadline_us;
+    };
+
+    bool pop_ready(queuedFrame &frame, qint64 now_us, qint64 &next_allowed_us);
+    bool write_frame(const TPCANMsgFD &msg, quint32 tag);
+    void write_unlocked(QMutexLocker &lock, const TPCANMsgFD &msg, quint32 tag=0);
+    void wait_until(qint64 deadline_us);
+
+    CanTransport *can;
+    QMutex mutex;
+    QWaitCondition wake;
+    QWaitCondition idle;
+    std::deque<queuedFrame> queues[TX_PRIO_COUNT];
+    std::vector<periodicEntry> periodic;
+    std::vector<TPCANMsgFD> due;    //periodic frames of one pass, TX thread only
+    QHash<DWORD, quint32> rate_limit_us;
+    QHash<DWORD, qint64> last_sent_us;
+    int next_handle=1;
+    int queue_limit=4096;
+    bool quit=false;
+    bool paused=false;
+    bool writing=false;
+    txStats m_stats;
+    double jitter_sum_us=0;
+};
+
+#endif // TX_SCHEDULER_H